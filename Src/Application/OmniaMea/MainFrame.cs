@@ -2020,6 +2020,10 @@ namespace JetBrains.Omea
             MyPalStorage.ResourceCacheSize = _iniFile.ReadInt( "ResourceStore", "ResourceCacheSize", 4096 );
             Database.DBIndex._cacheSizeMultiplier =
                 _iniFile.ReadInt( "ResourceStore", "DBindexCacheSizeMultiplier", 2 );
+            OmniaMeaBTree.SetSharedCacheMemory(
+                _iniFile.ReadInt( "ResourceStore", "DBindexCacheMemoryMB", 0 ) * 1024L * 1024 );
+            OmniaMeaBTree.SetReadAheadPages( _iniFile.ReadInt( "ResourceStore", "DBindexReadAheadPages", 8 ) );
+            Database.DBIndex._usePageFilters = _iniFile.ReadBool( "ResourceStore", "DBindexPageFilters", false );
             MyPalStorage.TraceOperations = _iniFile.ReadBool( "ResourceStore", "TraceOperations", false );
             MyPalStorage.SetProgressWindow( Core.ProgressWindow );
 
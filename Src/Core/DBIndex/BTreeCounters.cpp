@@ -0,0 +1,68 @@
+﻿// SPDX-FileCopyrightText: 2003-2008 JetBrains s.r.o.
+//
+// SPDX-License-Identifier: GPL-2.0-only
+
+#pragma unmanaged
+
+#include "BTreeCounters.h"
+
+namespace DBIndex
+{
+	__int64 BTreeCounters::_frequency = 0;
+
+	BTreeCounters::BTreeCounters()
+	{
+		if( _frequency == 0 )
+		{
+			_frequency = GetTicksPerSecond();
+		}
+		Reset();
+	}
+
+	void BTreeCounters::Reset()
+	{
+		for( int i = 0; i < COUNTERS_COUNT; ++i )
+		{
+			AtomicWrite64( &_counters[ i ], 0 );
+		}
+		for( int i = 0; i < OPERATIONS_COUNT; ++i )
+		{
+			for( int j = 0; j < LATENCY_BUCKETS; ++j )
+			{
+				AtomicWrite64( &_latencies[ i ][ j ], 0 );
+			}
+		}
+	}
+
+	void BTreeCounters::Add( int counter, __int64 value )
+	{
+		AtomicAdd64( &_counters[ counter ], value );
+	}
+
+	__int64 BTreeCounters::Get( int counter ) const
+	{
+		return AtomicRead64( const_cast< volatile __int64* >( &_counters[ counter ] ) );
+	}
+
+	__int64 BTreeCounters::StartTiming()
+	{
+		return GetTicks();
+	}
+
+	void BTreeCounters::Time( int operation, __int64 start )
+	{
+		__int64 microseconds = ( StartTiming() - start ) * 1000000 / _frequency;
+		int bucket = 0;
+		while( microseconds > 0 && bucket < LATENCY_BUCKETS - 1 )
+		{
+			microseconds >>= 1;
+			++bucket;
+		}
+		AtomicAdd64( &_latencies[ operation ][ bucket ], 1 );
+	}
+
+	__int64 BTreeCounters::GetLatencies( int operation, int bucket ) const
+	{
+		return AtomicRead64( const_cast< volatile __int64* >( &_latencies[ operation ][ bucket ] ) );
+	}
+}
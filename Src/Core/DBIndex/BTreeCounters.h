@@ -0,0 +1,75 @@
+﻿// SPDX-FileCopyrightText: 2003-2008 JetBrains s.r.o.
+//
+// SPDX-License-Identifier: GPL-2.0-only
+
+#ifndef _OMEA_BTREECOUNTERS_H
+#define _OMEA_BTREECOUNTERS_H
+
+#include "DBIndexHeapObject.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// latencies are counted in logarithmic buckets: bucket 0 holds operations
+// faster than a microsecond, bucket i holds operations taking from 2^(i-1)
+// to 2^i microseconds, the last bucket holds all slower operations
+///////////////////////////////////////////////////////////////////////////////
+
+#define LATENCY_BUCKETS		24
+
+namespace DBIndex
+{
+	// counters, in the order of JetBrains.Omea.Containers.BTreeCounter
+	enum {	lookups_Counter,
+			inserts_Counter,
+			deletes_Counter,
+			splits_Counter,
+			merges_Counter,
+			pageReads_Counter,
+			pageWrites_Counter,
+			bytesRead_Counter,
+			bytesWritten_Counter,
+			evictions_Counter,
+			filterSkips_Counter,
+			COUNTERS_COUNT
+	};
+
+	// timed operations, in the order of JetBrains.Omea.Containers.BTreeOperation
+	enum {	lookup_Operation,
+			insert_Operation,
+			delete_Operation,
+			pageRead_Operation,
+			pageWrite_Operation,
+			OPERATIONS_COUNT
+	};
+
+	///////////////////////////////////////////////////////////////////////////
+	// Performance counters and latency histograms of a btree.
+	// Pages are read ahead and evicted from the pages pool on other threads,
+	// so all updates are interlocked.
+	///////////////////////////////////////////////////////////////////////////
+
+	class BTreeCounters : public DBIndexHeapObject
+	{
+	public:
+
+		BTreeCounters();
+
+		void Reset();
+		void Add( int counter, __int64 value );
+		__int64 Get( int counter ) const;
+
+		// returns the time to pass to Time() when the operation is completed
+		static __int64 StartTiming();
+		// adds latency of an operation started at the given time to its histogram
+		void Time( int operation, __int64 start );
+		__int64 GetLatencies( int operation, int bucket ) const;
+
+	private:
+
+		volatile __int64	_counters[ COUNTERS_COUNT ];
+		volatile __int64	_latencies[ OPERATIONS_COUNT ][ LATENCY_BUCKETS ];
+
+		static __int64		_frequency;
+	};
+}
+
+#endif
@@ -6,6 +6,7 @@
 #define _OMEA_BTREEHEADER_H
 
 #include <map>
+#include <vector>
 #include "DBIndexHeapObject.h"
 #include "BTreeKey.h"
 
@@ -28,15 +29,162 @@ namespace DBIndex
 	{
 	public:
 
+		BTreeHeaderBase() : _filterBits( 0 ) {}
+		virtual ~BTreeHeaderBase() {}
+
 		virtual void GetPage( const BTreeKeyBase& key, BTreeHeaderIteratorBase& ) const = 0;
 		virtual void GetMinimumPage( BTreeHeaderIteratorBase& ) const = 0;
 		virtual void GetMaximumPage( BTreeHeaderIteratorBase& ) const = 0;
 		virtual void SetPageOffset( const BTreeKeyBase& key, int offset ) = 0;
 		virtual void DeletePageOffset( const BTreeKeyBase& key ) = 0;
 		virtual void Clear() = 0;
-		virtual bool Load( int fileHandle ) = 0;
-		virtual bool Save( int fileHandle ) const = 0;
+		// header is loaded from and saved at the given position of the file
+		virtual bool Load( int fileHandle, int position, int size ) = 0;
+		virtual bool Save( int fileHandle, int position ) const = 0;
 		virtual unsigned Size() const = 0;
+
+		// number of keys in the page at offset, -1 if unknown
+		int GetPageCount( int offset ) const
+		{
+			countsType::const_iterator it = _pageCounts.find( offset );
+			return ( it == _pageCounts.end() ) ? -1 : it->second;
+		}
+		void SetPageCount( int offset, int count )
+		{
+			_pageCounts[ offset ] = count;
+		}
+		void DeletePageCount( int offset )
+		{
+			_pageCounts.erase( offset );
+		}
+
+		// Bloom filters of keys in pages are kept in memory only, a page without a filter may
+		// contain any key; filters of the given number of bits replace existing ones, 0 drops them
+		void SetPageFilterBits( unsigned bits )
+		{
+			_filterBits = ( bits + FILTER_WORD_BITS - 1 ) / FILTER_WORD_BITS * FILTER_WORD_BITS;
+			_pageFilters.clear();
+		}
+		bool HasPageFilters() const
+		{
+			return _filterBits != 0;
+		}
+		bool HasPageFilter( int offset ) const
+		{
+			return _pageFilters.find( offset ) != _pageFilters.end();
+		}
+		// the page at offset has no keys yet
+		void ClearPageFilter( int offset )
+		{
+			if( _filterBits )
+			{
+				filterType& filter = _pageFilters[ offset ];
+				filter.assign( _filterBits / FILTER_WORD_BITS, 0 );
+			}
+		}
+		void AddToPageFilter( int offset, unsigned hash )
+		{
+			filtersType::iterator it = _pageFilters.find( offset );
+			if( it != _pageFilters.end() )
+			{
+				unsigned step = ( ( hash >> 17 ) | ( hash << 15 ) ) | 1;
+				for( int i = 0; i < FILTER_PROBES; ++i, hash += step )
+				{
+					unsigned bit = hash % _filterBits;
+					it->second[ bit / FILTER_WORD_BITS ] |= 1u << ( bit % FILTER_WORD_BITS );
+				}
+			}
+		}
+		bool PageFilterMayContain( int offset, unsigned hash ) const
+		{
+			filtersType::const_iterator it = _pageFilters.find( offset );
+			if( it != _pageFilters.end() )
+			{
+				unsigned step = ( ( hash >> 17 ) | ( hash << 15 ) ) | 1;
+				for( int i = 0; i < FILTER_PROBES; ++i, hash += step )
+				{
+					unsigned bit = hash % _filterBits;
+					if( ( it->second[ bit / FILTER_WORD_BITS ] & ( 1u << ( bit % FILTER_WORD_BITS ) ) ) == 0 )
+					{
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+		void MovePageFilter( int fromOffset, int toOffset )
+		{
+			filtersType::iterator it = _pageFilters.find( fromOffset );
+			if( it != _pageFilters.end() )
+			{
+				_pageFilters[ toOffset ] = it->second;
+				_pageFilters.erase( fromOffset );
+			}
+			else
+			{
+				_pageFilters.erase( toOffset );
+			}
+		}
+		void DeletePageFilter( int offset )
+		{
+			_pageFilters.erase( offset );
+		}
+
+		// page counts are saved as ( offset, count ) pairs
+		bool LoadPageCounts( int fileHandle, int position, int size )
+		{
+			_pageCounts.clear();
+			if( size > 0 )
+			{
+				if( size % sizeof( PageCount ) != 0 )
+				{
+					return false;
+				}
+				PageCount* counts = (PageCount*) DBIndexHeapObject::operator new( size );
+				int read = ReadIndexFile( fileHandle, (void*) counts, size, position );
+				if( read == size )
+				{
+					for( int i = 0; i < size / (int) sizeof( PageCount ); ++i )
+					{
+						_pageCounts[ counts[ i ].first ] = counts[ i ].second;
+					}
+				}
+				DBIndexHeapObject::operator delete( counts );
+				return read == size;
+			}
+			return true;
+		}
+		bool SavePageCounts( int fileHandle, int position ) const
+		{
+			int size = _pageCounts.size();
+			if( size )
+			{
+				int rawSize = sizeof( PageCount ) * size;
+				PageCount* counts = (PageCount*) DBIndexHeapObject::operator new( rawSize );
+				int i = 0;
+				for( countsType::const_iterator it = _pageCounts.begin(); it != _pageCounts.end(); ++it, ++i )
+				{
+					counts[ i ] = *it;
+				}
+				int written = WriteIndexFile( fileHandle, (const void*) counts, rawSize, position );
+				DBIndexHeapObject::operator delete( counts );
+				return written == rawSize;
+			}
+			return true;
+		}
+
+	protected:
+
+		typedef pair< int, int > PageCount;
+		typedef map< int, int, less< int >, DBIndex_allocator< pair< const int, int > > > countsType;
+		typedef vector< unsigned, DBIndex_allocator< unsigned > > filterType;
+		typedef map< int, filterType, less< int >, DBIndex_allocator< pair< const int, filterType > > > filtersType;
+
+		enum { FILTER_WORD_BITS = 32, FILTER_PROBES = 7 };
+
+		countsType	_pageCounts;
+		filtersType	_pageFilters;
+		unsigned	_filterBits;
 	};
 
 	template< class Key > class BTreeHeaderIterator : public BTreeHeaderIteratorBase
@@ -44,7 +192,7 @@ namespace DBIndex
 		typedef BTreeKey< Key > KeyType;
 		typedef BTreeHeaderKey< Key > HeaderKeyType;
 		typedef map< HeaderKeyType, int, less< HeaderKeyType >,
-			DBIndex_allocator< pair< HeaderKeyType, int > > > headerType;
+			DBIndex_allocator< pair< const HeaderKeyType, int > > > headerType;
 
 	public:
 
@@ -94,7 +242,7 @@ namespace DBIndex
 		typedef BTreeKey< Key > KeyType;
 		typedef BTreeHeaderKey< Key > HeaderKeyType;
 		typedef pair< HeaderKeyType, int > HeaderKeyOffset;
-		typedef map< HeaderKeyType, int, less< HeaderKeyType >, DBIndex_allocator< HeaderKeyOffset > > headerType;
+		typedef map< HeaderKeyType, int, less< HeaderKeyType >, DBIndex_allocator< pair< const HeaderKeyType, int > > > headerType;
 		typedef BTreeHeaderIterator< Key > headerIteratorType;
 
 	public:
@@ -103,7 +251,7 @@ namespace DBIndex
 		{
 			const KeyType& realKey = static_cast<const KeyType&>( key );
 			HeaderKeyType headerKey( realKey.GetKey(), realKey.GetOffset() );
-			headerType::const_iterator i = _header.upper_bound( headerKey );
+			typename headerType::const_iterator i = _header.upper_bound( headerKey );
 			if( i != _header.begin() )
 			{
 				--i;
@@ -116,8 +264,8 @@ namespace DBIndex
 		}
 		virtual void GetMaximumPage( BTreeHeaderIteratorBase& it ) const
 		{
-			headerType::const_iterator begin = _header.begin();
-			headerType::const_iterator end = _header.end();
+			typename headerType::const_iterator begin = _header.begin();
+			typename headerType::const_iterator end = _header.end();
 			for( unsigned i = 1; i < _header.size(); ++i )
 			{
 				++begin;
@@ -139,18 +287,17 @@ namespace DBIndex
 		virtual void Clear()
 		{
 			_header.clear();
+			_pageCounts.clear();
+			_pageFilters.clear();
 		}
 
-		virtual bool Load( int fileHandle )
+		virtual bool Load( int fileHandle, int position, int size )
 		{
-			HANDLE file = (HANDLE) fileHandle;
-			int size = ::GetFileSize( file, NULL ) - ::SetFilePointer( file, 0, NULL, FILE_CURRENT );
 			if( size > 0 )
 			{
-				DWORD rawSize = size;
+				int rawSize = size;
 				HeaderKeyOffset* keys = (HeaderKeyOffset*) DBIndexHeapObject::operator new( rawSize );
-				DWORD read;
-				::ReadFile( file, (LPVOID) keys, rawSize, &read, NULL );
+				int read = ReadIndexFile( fileHandle, (void*) keys, rawSize, position );
 				size /= sizeof( HeaderKeyOffset );
 				for( int i = 0; i < size; ++i )
 				{
@@ -162,7 +309,7 @@ namespace DBIndex
 			return true;
 		}
 
-		virtual bool Save( int fileHandle ) const
+		virtual bool Save( int fileHandle, int position ) const
 		{
 			int size = _header.size();
 			if( size )
@@ -170,12 +317,11 @@ namespace DBIndex
 				int rawSize = sizeof( HeaderKeyOffset ) * size;
 				HeaderKeyOffset* keys = (HeaderKeyOffset*) DBIndexHeapObject::operator new( rawSize );
 				int i = 0;
-				for( headerType::const_iterator it = _header.begin(); it != _header.end(); ++it, ++i )
+				for( typename headerType::const_iterator it = _header.begin(); it != _header.end(); ++it, ++i )
 				{
 					keys[ i ] = *it;
 				}
-				DWORD written = 0;
-				::WriteFile( (HANDLE) fileHandle, (LPCVOID) keys, size * sizeof( HeaderKeyOffset ), &written, NULL );
+				int written = WriteIndexFile( fileHandle, (const void*) keys, rawSize, position );
 				DBIndexHeapObject::operator delete( keys );
 				return written == rawSize;
 			}
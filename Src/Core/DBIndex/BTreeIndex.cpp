@@ -0,0 +1,1115 @@
+﻿// SPDX-FileCopyrightText: 2003-2008 JetBrains s.r.o.
+//
+// SPDX-License-Identifier: GPL-2.0-only
+
+#pragma unmanaged
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "BTreeIndex.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// the first byte of the file is non-zero if the btree was successfully closed
+// and its header can be loaded; with PAGE_COUNTS_SAVED page key counts are
+// stored before the header, their position follows the header position
+///////////////////////////////////////////////////////////////////////////////
+
+#define PAGE_COUNTS_SAVED 2
+
+///////////////////////////////////////////////////////////////////////////////
+// positions of the number of keys, of the btree header and of page counts
+// in the file header, they are valid if the btree was successfully closed
+///////////////////////////////////////////////////////////////////////////////
+
+#define KEYS_COUNT_POSITION		1
+#define HEADER_POSITION			5
+#define COUNTS_POSITION			9
+
+///////////////////////////////////////////////////////////////////////////////
+// position of the page geometry in the file header, it is valid if the btree
+// was successfully closed, older files have zero there, i.e. default geometry
+///////////////////////////////////////////////////////////////////////////////
+
+#define PAGE_GEOMETRY_POSITION 13
+
+///////////////////////////////////////////////////////////////////////////////
+// a scan is considered sequential and starts reading pages ahead when it
+// comes to the page with the number defined below
+///////////////////////////////////////////////////////////////////////////////
+
+#define READ_AHEAD_AFTER_PAGES 2
+
+///////////////////////////////////////////////////////////////////////////////
+// compaction merges adjacent pages if their keys fill no more than the share
+// of a page defined below, so that merged pages have room for inserts
+///////////////////////////////////////////////////////////////////////////////
+
+#define MERGED_PAGE_FILL_DIVISOR 2
+
+///////////////////////////////////////////////////////////////////////////////
+// bits of a page filter per key the page can hold, with 7 probes per key
+// about 1% of keys missing in a page pass its full filter
+///////////////////////////////////////////////////////////////////////////////
+
+#define FILTER_BITS_PER_KEY 10
+
+namespace DBIndex
+{
+	BTreeIndexError::BTreeIndexError( int kind, const char* message )
+		: _kind( kind )
+	{
+		strncpy( _message, message, sizeof( _message ) - 1 );
+		_message[ sizeof( _message ) - 1 ] = 0;
+	}
+
+	// ints of the file header are little-endian, as BinaryReader reads them
+	static int ReadHeaderInt( int file, int position )
+	{
+		int value = 0;
+		ReadIndexFile( file, &value, sizeof( value ), position );
+		return value;
+	}
+
+	static void WriteHeaderInt( int file, int position, int value )
+	{
+		WriteIndexFile( file, &value, sizeof( value ), position );
+	}
+
+	static void WriteHeaderByte( int file, unsigned char value )
+	{
+		WriteIndexFile( file, &value, 1, 0 );
+	}
+
+	static void CheckKeysCount( unsigned count, const BTreePageBase* page )
+	{
+		if( count > (unsigned) page->GetCapacity() )
+		{
+			throw BTreeIndexError( corrupted_Error, "BTree contains cycles. Possible memory corruption." );
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	// BTreeIndex implementation
+	///////////////////////////////////////////////////////////////////////////
+
+	BTreeIndex::BTreeIndex( int keyType, int pageGeometry )
+		: _page( 0 ), _freePage( 0 ), _tempKeys( 0 ), _headerKey( 0 ), _nextHeaderKey( 0 ), _keyComparer( 0 ),
+		  _btreeHeader( 0 ), _btreeHeaderIterator( 0 ), _readAheadIterator( 0 ), _compactIterator( 0 ), _compactKey( 0 ),
+		  _file( -1 ), _keysInIndex( 0 ), _keyType( keyType ), _pageGeometry( pageGeometry ), _numberOfPages( 0 ),
+		  _loadedPages( 0 ), _compactionPhase( idle_Compaction ), _usePageFilters( false )
+	{
+		DBIndexHeapObject::CreateHeap();
+		_pagesCache = BTreePagesCache::Create( 16 );
+		_counters = &_pagesCache->GetCounters();
+	}
+
+	BTreeIndex::~BTreeIndex()
+	{
+		BTreePagesCache::Delete( _pagesCache );
+		SetPageGeometry( _pageGeometry );
+		if( _headerKey )
+		{
+			TypeFactory::DeleteKey( _headerKey );
+		}
+		if( _nextHeaderKey )
+		{
+			TypeFactory::DeleteKey( _nextHeaderKey );
+		}
+		if( _btreeHeader )
+		{
+			TypeFactory::DeleteHeader( _btreeHeader );
+		}
+		if( _btreeHeaderIterator )
+		{
+			TypeFactory::DeleteHeaderIterator( _btreeHeaderIterator );
+		}
+		if( _readAheadIterator )
+		{
+			TypeFactory::DeleteHeaderIterator( _readAheadIterator );
+		}
+		if( _compactIterator )
+		{
+			TypeFactory::DeleteHeaderIterator( _compactIterator );
+		}
+		if( _compactKey )
+		{
+			TypeFactory::DeleteKey( _compactKey );
+		}
+		if( _keyComparer )
+		{
+			TypeFactory::DeleteKeyComparer( _keyComparer );
+		}
+	}
+
+	int BTreeIndex::Open( int file )
+	{
+		InstantiateTypes();
+		_file = file;
+		_keysInIndex = 0;
+
+		/**
+		 * check whether the btree was successfully closed, and load header if it was
+		 */
+		unsigned char closed = 0;
+		if( GetIndexFileLength( file ) >= HEADER_SIZE )
+		{
+			ReadIndexFile( file, &closed, 1, 0 );
+		}
+		if( closed )
+		{
+			// pages of a closed btree keep the geometry it was created with
+			int geometry = ReadHeaderInt( file, PAGE_GEOMETRY_POSITION );
+			if( TypeFactory::GetPageCapacity( geometry ) == 0 )
+			{
+				return badGeometry_Open;
+			}
+			if( geometry != _pageGeometry )
+			{
+				SetPageGeometry( geometry );
+				InstantiateTypes();
+			}
+		}
+
+		SetPageFilters( _usePageFilters );
+		_page->SetFileHandle( file );
+		if( _freePage )
+		{
+			_freePage->SetFileHandle( file );
+		}
+
+		if( !closed )
+		{
+			char header[ HEADER_SIZE ];
+			memset( header, 0, sizeof( header ) );
+			WriteIndexFile( file, header, HEADER_SIZE, 0 );
+			return created_Open;
+		}
+
+		WriteHeaderByte( file, 0 );
+		_keysInIndex = ReadHeaderInt( file, KEYS_COUNT_POSITION );
+		int size = ReadHeaderInt( file, HEADER_POSITION );
+		int countsPosition = ReadHeaderInt( file, COUNTS_POSITION );
+		if( !_btreeHeader->Load( file, size, GetIndexFileLength( file ) - size ) )
+		{
+			return badHeader_Open;
+		}
+		// counts missing in older files are collected by CountRange()
+		if( closed == PAGE_COUNTS_SAVED && countsPosition >= HEADER_SIZE && countsPosition <= size )
+		{
+			_btreeHeader->LoadPageCounts( file, countsPosition, size - countsPosition );
+			size = countsPosition;
+		}
+		SetIndexFileLength( file, size );
+		_numberOfPages = _btreeHeader->Size();
+		return closed_Open;
+	}
+
+	void BTreeIndex::Flush()
+	{
+		// if btree was opened
+		if( _page )
+		{
+			_pagesCache->Clear( *_btreeHeader );
+		}
+	}
+
+	bool BTreeIndex::SaveHeader( int file )
+	{
+		WriteHeaderByte( file, 0 );
+		WriteHeaderInt( file, KEYS_COUNT_POSITION, _keysInIndex );
+		int countsPosition = GetIndexFileLength( file );
+		bool countsSaved = _btreeHeader->SavePageCounts( file, countsPosition );
+		int size = GetIndexFileLength( file );
+		WriteHeaderInt( file, HEADER_POSITION, size );
+		WriteHeaderInt( file, COUNTS_POSITION, countsPosition );
+		WriteHeaderInt( file, PAGE_GEOMETRY_POSITION, _pageGeometry );
+		if( !_btreeHeader->Save( file, size ) )
+		{
+			return false;
+		}
+		WriteHeaderByte( file, countsSaved ? PAGE_COUNTS_SAVED : 1 );
+		return true;
+	}
+
+	void BTreeIndex::Reset()
+	{
+		if( _btreeHeader )
+		{
+			_btreeHeader->Clear();
+		}
+		_freeOffsets.clear();
+		_keysInIndex = 0;
+		_numberOfPages = 0;
+		_compactionPhase = idle_Compaction;
+	}
+
+	void BTreeIndex::Clear()
+	{
+		// if btree is opened
+		if( _page )
+		{
+			_btreeHeader->Clear();
+			_freeOffsets.clear();
+			_pagesCache->ClearWithoutSaving();
+			_keysInIndex = 0;
+			SetIndexFileLength( _file, HEADER_SIZE );
+			char header[ HEADER_SIZE ];
+			memset( header, 0, sizeof( header ) );
+			WriteIndexFile( _file, header, HEADER_SIZE, 0 );
+			_numberOfPages = 0;
+			_compactionPhase = idle_Compaction;
+		}
+	}
+
+	void BTreeIndex::Insert( const BTreeKeyBase& key )
+	{
+		__int64 start = BTreeCounters::StartTiming();
+		InsertKey( key );
+		_counters->Add( inserts_Counter, 1 );
+		_counters->Time( insert_Operation, start );
+	}
+
+	void BTreeIndex::Delete( const BTreeKeyBase& key )
+	{
+		__int64 start = BTreeCounters::StartTiming();
+		_btreeHeader->GetPage( key, *_btreeHeaderIterator );
+		if( !_btreeHeaderIterator->Exhausted() )
+		{
+			BTreePageBase* page = GetPageByOffset( _btreeHeaderIterator->GetCurrentOffset() );
+			if( page->Delete( key ) )
+			{
+				--_keysInIndex;
+				_btreeHeaderIterator->GetCurrentKey( *_headerKey );
+				UpdateDeletedPage( page );
+			}
+		}
+		_counters->Add( deletes_Counter, 1 );
+		_counters->Time( delete_Operation, start );
+	}
+
+	// a batch is timed as one operation
+	void BTreeIndex::InsertBatch( const BTreeKeyBase* const* keys, int count )
+	{
+		if( count == 0 )
+		{
+			return;
+		}
+		__int64 start = BTreeCounters::StartTiming();
+		for( int i = 0; i < count; )
+		{
+			_btreeHeader->GetPage( *keys[ i ], *_btreeHeaderIterator );
+			if( !_btreeHeaderIterator->Exhausted() )
+			{
+				BTreePageBase* page = GetPageByOffset( _btreeHeaderIterator->GetCurrentOffset() );
+				_btreeHeaderIterator->GetCurrentKey( *_headerKey );
+				bool bounded = _btreeHeaderIterator->MoveNextPage();
+				if( bounded )
+				{
+					_btreeHeaderIterator->GetCurrentKey( *_nextHeaderKey );
+				}
+
+				// insert all keys of the batch which belong to the page while there is
+				// room, new minimums and almost full pages are left to InsertKey()
+				if( !page->IsAlmostFull() && !_keyComparer->Less( *keys[ i ], *_headerKey ) )
+				{
+					do
+					{
+						page->Insert( *keys[ i ] );
+						AddToPageFilter( page, *keys[ i ] );
+						++_keysInIndex;
+					}
+					while( ++i < count && !page->IsAlmostFull() && !_keyComparer->Less( *keys[ i ], *_headerKey ) &&
+						( !bounded || _keyComparer->Less( *keys[ i ], *_nextHeaderKey ) ) );
+					_btreeHeader->SetPageCount( page->GetOffset(), page->GetCount() );
+					continue;
+				}
+			}
+			InsertKey( *keys[ i++ ] );
+		}
+		_counters->Add( inserts_Counter, count );
+		_counters->Time( insert_Operation, start );
+	}
+
+	void BTreeIndex::DeleteBatch( const BTreeKeyBase* const* keys, int count )
+	{
+		if( count == 0 )
+		{
+			return;
+		}
+		__int64 start = BTreeCounters::StartTiming();
+		for( int i = 0; i < count; )
+		{
+			_btreeHeader->GetPage( *keys[ i ], *_btreeHeaderIterator );
+			if( _btreeHeaderIterator->Exhausted() )
+			{
+				break;
+			}
+			BTreePageBase* page = GetPageByOffset( _btreeHeaderIterator->GetCurrentOffset() );
+			_btreeHeaderIterator->GetCurrentKey( *_headerKey );
+			bool bounded = _btreeHeaderIterator->MoveNextPage();
+			if( bounded )
+			{
+				_btreeHeaderIterator->GetCurrentKey( *_nextHeaderKey );
+			}
+
+			// delete all keys of the batch which belong to the page
+			bool deleted = false;
+			do
+			{
+				if( page->Delete( *keys[ i ] ) )
+				{
+					--_keysInIndex;
+					deleted = true;
+				}
+			}
+			while( ++i < count && !_keyComparer->Less( *keys[ i ], *_headerKey ) &&
+				( !bounded || _keyComparer->Less( *keys[ i ], *_nextHeaderKey ) ) );
+
+			if( deleted )
+			{
+				UpdateDeletedPage( page );
+			}
+		}
+		_counters->Add( deletes_Counter, count );
+		_counters->Time( delete_Operation, start );
+	}
+
+	int BTreeIndex::CountRange( const BTreeKeyBase& first, const BTreeKeyBase& last )
+	{
+		__int64 start = BTreeCounters::StartTiming();
+		int result = 0;
+
+		_btreeHeader->GetPage( first, *_btreeHeaderIterator );
+		while( !_btreeHeaderIterator->Exhausted() )
+		{
+			_btreeHeaderIterator->GetCurrentKey( *_headerKey );
+			if( _keyComparer->Less( last, *_headerKey ) )
+			{
+				break;
+			}
+			// keys of a page are not less than its header key and less than the next one,
+			// so a page is inside the range if both header keys are
+			bool inside = !_keyComparer->Less( *_headerKey, first );
+			int offset = _btreeHeaderIterator->GetCurrentOffset();
+			if( _btreeHeaderIterator->MoveNextPage() )
+			{
+				_btreeHeaderIterator->GetCurrentKey( *_headerKey );
+				inside = inside && !_keyComparer->Less( last, *_headerKey );
+			}
+			else
+			{
+				inside = false;
+			}
+			int count = inside ? _btreeHeader->GetPageCount( offset ) : -1;
+			if( count < 0 )
+			{
+				BTreePageBase* page = GetPageByOffset( offset );
+				if( inside )
+				{
+					count = page->GetCount();
+					_btreeHeader->SetPageCount( offset, count );
+				}
+				else
+				{
+					count = page->SearchForRange( first, last, _tempKeys );
+					CheckKeysCount( count, page );
+				}
+			}
+			result += count;
+		}
+		_counters->Add( lookups_Counter, 1 );
+		_counters->Time( lookup_Operation, start );
+		return result;
+	}
+
+	void BTreeIndex::SetPageFilters( bool enabled )
+	{
+		_usePageFilters = enabled;
+		if( _btreeHeader )
+		{
+			_btreeHeader->SetPageFilterBits( enabled ? GetPageCapacity() * FILTER_BITS_PER_KEY : 0 );
+		}
+	}
+
+	bool BTreeIndex::Contains( const BTreeKeyBase& first, const BTreeKeyBase& last )
+	{
+		__int64 start = BTreeCounters::StartTiming();
+		_counters->Add( lookups_Counter, 1 );
+		bool result = false;
+		unsigned hash = _keyComparer->Hash( first );
+		_btreeHeader->GetPage( first, *_btreeHeaderIterator );
+		while( !result && !_btreeHeaderIterator->Exhausted() )
+		{
+			_btreeHeaderIterator->GetCurrentKey( *_headerKey );
+			if( _keyComparer->Less( last, *_headerKey ) )
+			{
+				break;
+			}
+			int offset = _btreeHeaderIterator->GetCurrentOffset();
+			if( _usePageFilters && !_btreeHeader->PageFilterMayContain( offset, hash ) )
+			{
+				_counters->Add( filterSkips_Counter, 1 );
+			}
+			else
+			{
+				BTreePageBase* page = GetPageByOffset( offset );
+				unsigned count = page->SearchForRange( first, last, _tempKeys );
+				CheckKeysCount( count, page );
+				result = count > 0;
+			}
+			_btreeHeaderIterator->MoveNextPage();
+		}
+		_counters->Time( lookup_Operation, start );
+		return result;
+	}
+
+	const BTreeKeyBase* BTreeIndex::GetMinimum()
+	{
+		__int64 start = BTreeCounters::StartTiming();
+		_counters->Add( lookups_Counter, 1 );
+		const BTreeKeyBase* result = 0;
+		_btreeHeader->GetMinimumPage( *_btreeHeaderIterator );
+		if( !_btreeHeaderIterator->Exhausted() )
+		{
+			result = &GetPageByOffset( _btreeHeaderIterator->GetCurrentOffset() )->GetMinimum();
+		}
+		_counters->Time( lookup_Operation, start );
+		return result;
+	}
+
+	const BTreeKeyBase* BTreeIndex::GetMaximum()
+	{
+		__int64 start = BTreeCounters::StartTiming();
+		_counters->Add( lookups_Counter, 1 );
+		const BTreeKeyBase* result = 0;
+		_btreeHeader->GetMaximumPage( *_btreeHeaderIterator );
+		if( !_btreeHeaderIterator->Exhausted() )
+		{
+			result = &GetPageByOffset( _btreeHeaderIterator->GetCurrentOffset() )->GetMaximum();
+		}
+		_counters->Time( lookup_Operation, start );
+		return result;
+	}
+
+	// the pass keeps its position in _compactKey between calls, so the btree
+	// may be modified between them; a step is either a merge of two pages, or
+	// a move of one page, so a call may take longer than the given time
+	bool BTreeIndex::Compact( int milliseconds )
+	{
+		// if btree is opened
+		if( !_page )
+		{
+			return false;
+		}
+		__int64 deadline = GetTicks() + GetTicksPerSecond() * milliseconds / 1000;
+		do
+		{
+			switch( _compactionPhase )
+			{
+				case idle_Compaction:
+				{
+					_btreeHeader->GetMinimumPage( *_compactIterator );
+					if( _compactIterator->Exhausted() )
+					{
+						_compactionPhase = relocate_Compaction;
+						CollectFreeOffsets();
+					}
+					else
+					{
+						_compactIterator->GetCurrentKey( *_compactKey );
+						_compactionPhase = merge_Compaction;
+					}
+					break;
+				}
+				case merge_Compaction:
+				{
+					if( !MergeNextPage() )
+					{
+						_compactionPhase = relocate_Compaction;
+						CollectFreeOffsets();
+					}
+					break;
+				}
+				case relocate_Compaction:
+				{
+					if( !RelocateLastPage() )
+					{
+						_compactionPhase = idle_Compaction;
+						return false;
+					}
+					break;
+				}
+			}
+		}
+		while( GetTicks() < deadline );
+		return true;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	// implementation details (private members)
+	///////////////////////////////////////////////////////////////////////////
+
+	void BTreeIndex::InstantiateTypes()
+	{
+		int type = _keyType;
+		if( !_page )
+		{
+			_page = TypeFactory::NewPage( type, _pageGeometry );
+		}
+		if( !_tempKeys )
+		{
+			_tempKeys = (const BTreeKeyBase**)
+				DBIndexHeapObject::operator new( _page->GetCapacity() * sizeof( const BTreeKeyBase* ) );
+		}
+		if( !_headerKey )
+		{
+			_headerKey = TypeFactory::NewKey( type );
+		}
+		if( !_nextHeaderKey )
+		{
+			_nextHeaderKey = TypeFactory::NewKey( type );
+		}
+		if( !_btreeHeader )
+		{
+			_btreeHeader = TypeFactory::NewHeader( type );
+		}
+		if( !_btreeHeaderIterator )
+		{
+			_btreeHeaderIterator = TypeFactory::NewHeaderIterator( type );
+		}
+		if( !_readAheadIterator )
+		{
+			_readAheadIterator = TypeFactory::NewHeaderIterator( type );
+		}
+		if( !_compactIterator )
+		{
+			_compactIterator = TypeFactory::NewHeaderIterator( type );
+		}
+		if( !_compactKey )
+		{
+			_compactKey = TypeFactory::NewKey( type );
+		}
+		if( !_keyComparer )
+		{
+			_keyComparer = TypeFactory::NewKeyComparer( type );
+		}
+	}
+
+	// pages of the previous geometry are deleted, InstantiateTypes() creates new ones;
+	// the btree should have no cached pages
+	void BTreeIndex::SetPageGeometry( int geometry )
+	{
+		_pageGeometry = geometry;
+		if( _page )
+		{
+			TypeFactory::DeletePage( _page );
+			_page = 0;
+		}
+		if( _freePage )
+		{
+			TypeFactory::DeletePage( _freePage );
+			_freePage = 0;
+		}
+		if( _tempKeys )
+		{
+			DBIndexHeapObject::operator delete( _tempKeys );
+			_tempKeys = 0;
+		}
+	}
+
+	void BTreeIndex::InsertKey( const BTreeKeyBase& key )
+	{
+		++_keysInIndex;
+
+		BTreePageBase* page;
+		_btreeHeader->GetPage( key, *_btreeHeaderIterator );
+
+		if( _btreeHeaderIterator->Exhausted() )
+		{
+			page = AllocPage();
+			page->Insert( key );
+			AddToPageFilter( page, key );
+			_btreeHeader->SetPageOffset( key, page->GetOffset() );
+			_btreeHeader->SetPageCount( page->GetOffset(), 1 );
+		}
+		else
+		{
+			page = GetPageByOffset( _btreeHeaderIterator->GetCurrentOffset() );
+			if( !page->IsFull() )
+			{
+				if( page->IsAlmostFull() )
+				{
+					if( _keyComparer->Less( page->GetMaximum(), key ) ||
+						_keyComparer->Less( key, page->GetMinimum() ) )
+					{
+						BTreePageBase* newPage = AllocPage();
+						newPage->Insert( key );
+						AddToPageFilter( newPage, key );
+						_btreeHeader->SetPageOffset( key, newPage->GetOffset() );
+						_btreeHeader->SetPageCount( newPage->GetOffset(), 1 );
+						return;
+					}
+				}
+				page->Insert( key );
+				AddToPageFilter( page, key );
+			}
+			else
+			{
+				BTreePageBase* rightPage = AllocPage();
+				page->Split( *rightPage );
+				BuildPageFilter( page );
+				BuildPageFilter( rightPage );
+				_counters->Add( splits_Counter, 1 );
+				const BTreeKeyBase& minKey = rightPage->GetMinimum();
+				_btreeHeader->SetPageOffset( minKey, rightPage->GetOffset() );
+				if( _keyComparer->Less( key, minKey ) )
+				{
+					page->Insert( key );
+					AddToPageFilter( page, key );
+					_btreeHeader->SetPageCount( rightPage->GetOffset(), rightPage->GetCount() );
+				}
+				else
+				{
+					rightPage->Insert( key );
+					AddToPageFilter( rightPage, key );
+					_btreeHeader->SetPageCount( rightPage->GetOffset(), rightPage->GetCount() );
+					_btreeHeader->SetPageCount( page->GetOffset(), page->GetCount() );
+					return;
+				}
+			}
+			_btreeHeader->SetPageCount( page->GetOffset(), page->GetCount() );
+			_btreeHeaderIterator->GetCurrentKey( *_headerKey );
+			if( _keyComparer->Less( key, *_headerKey ) )
+			{
+				_btreeHeader->DeletePageOffset( *_headerKey );
+				_btreeHeader->SetPageOffset( key, page->GetOffset() );
+			}
+		}
+	}
+
+	// updates the header after keys were deleted from the page, _headerKey is the page's header key
+	void BTreeIndex::UpdateDeletedPage( BTreePageBase* page )
+	{
+		int offset = page->GetOffset();
+		if( page->GetCount() == 0 )
+		{
+			_freeOffsets.push_back( offset );
+			_pagesCache->RemovePage( offset );
+			_btreeHeader->DeletePageOffset( *_headerKey );
+			_btreeHeader->DeletePageCount( offset );
+			_btreeHeader->DeletePageFilter( offset );
+			--_numberOfPages;
+		}
+		else
+		{
+			_btreeHeader->SetPageCount( offset, page->GetCount() );
+			const BTreeKeyBase& minKey = page->GetMinimum();
+			if( _keyComparer->Less( *_headerKey, minKey ) )
+			{
+				_btreeHeader->DeletePageOffset( *_headerKey );
+				_btreeHeader->SetPageOffset( minKey, offset );
+			}
+		}
+	}
+
+	// offsets of pages following the current page of _btreeHeaderIterator are passed to the pages cache
+	// for reading ahead; a scan bounded by the last key stops at the page beyond it and overwrites _headerKey
+	void BTreeIndex::ReadAhead( int scannedPages, const BTreeKeyBase* last )
+	{
+		if( scannedPages < READ_AHEAD_AFTER_PAGES )
+		{
+			return;
+		}
+		int offsets[ MAX_READ_AHEAD_PAGES ];
+		unsigned count = 0;
+		unsigned maxCount = BTreePagesCache::GetReadAheadPages();
+		*_readAheadIterator = *_btreeHeaderIterator;
+		while( count < maxCount && _readAheadIterator->MoveNextPage() )
+		{
+			if( last )
+			{
+				_readAheadIterator->GetCurrentKey( *_headerKey );
+				if( _keyComparer->Less( *last, *_headerKey ) )
+				{
+					break;
+				}
+			}
+			offsets[ count++ ] = _readAheadIterator->GetCurrentOffset();
+		}
+		if( count )
+		{
+			_pagesCache->ReadAhead( *_page, offsets, count );
+		}
+	}
+
+	int BTreeIndex::GetKnownPageCount( int offset )
+	{
+		int count = _btreeHeader->GetPageCount( offset );
+		if( count < 0 )
+		{
+			count = GetPageByOffset( offset )->GetCount();
+			_btreeHeader->SetPageCount( offset, count );
+		}
+		return count;
+	}
+
+	void BTreeIndex::BuildPageFilter( BTreePageBase* page )
+	{
+		if( _usePageFilters )
+		{
+			int offset = page->GetOffset();
+			_btreeHeader->ClearPageFilter( offset );
+			unsigned count = page->GetAllKeys( _tempKeys );
+			CheckKeysCount( count, page );
+			for( unsigned i = 0; i < count; ++i )
+			{
+				_btreeHeader->AddToPageFilter( offset, _keyComparer->Hash( *_tempKeys[ i ] ) );
+			}
+		}
+	}
+
+	void BTreeIndex::AddToPageFilter( BTreePageBase* page, const BTreeKeyBase& key )
+	{
+		if( _usePageFilters )
+		{
+			_btreeHeader->AddToPageFilter( page->GetOffset(), _keyComparer->Hash( key ) );
+		}
+	}
+
+	// merges the page following the one with the _compactKey header key into it if both
+	// fit the merged page, otherwise moves _compactKey to the next page; returns false
+	// at the last page
+	bool BTreeIndex::MergeNextPage()
+	{
+		_btreeHeader->GetPage( *_compactKey, *_compactIterator );
+		if( _compactIterator->Exhausted() )
+		{
+			return false;
+		}
+		_compactIterator->GetCurrentKey( *_compactKey );
+		int offset = _compactIterator->GetCurrentOffset();
+		if( !_compactIterator->MoveNextPage() )
+		{
+			return false;
+		}
+		_compactIterator->GetCurrentKey( *_headerKey );
+		int nextOffset = _compactIterator->GetCurrentOffset();
+		int count = GetKnownPageCount( offset );
+		int nextCount = GetKnownPageCount( nextOffset );
+		if( count + nextCount > _page->GetCapacity() / MERGED_PAGE_FILL_DIVISOR )
+		{
+			TypeFactory::CopyKey( _keyType, *_compactKey, *_headerKey );
+			return true;
+		}
+
+		// the page merged into is loaded last, so that it isn't evicted from the cache
+		BTreePageBase* nextPage = GetPageByOffset( nextOffset );
+		BTreePageBase* page = GetPageByOffset( offset );
+		page->Merge( *nextPage );
+		CheckKeysCount( page->GetCount(), page );
+		_btreeHeader->SetPageCount( offset, page->GetCount() );
+		BuildPageFilter( page );
+		nextPage->Clear();
+		_btreeHeader->DeletePageOffset( *_headerKey );
+		_btreeHeader->DeletePageCount( nextOffset );
+		_btreeHeader->DeletePageFilter( nextOffset );
+		_pagesCache->RemovePage( nextOffset );
+		_freeOffsets.push_back( nextOffset );
+		--_numberOfPages;
+		_counters->Add( merges_Counter, 1 );
+		return true;
+	}
+
+	// free pages are the ones not referenced by the header, pages freed before the btree
+	// was reopened are found this way too; the lowest free offsets are allocated first
+	void BTreeIndex::CollectFreeOffsets()
+	{
+		offsetsType usedOffsets;
+		_btreeHeader->GetMinimumPage( *_compactIterator );
+		while( !_compactIterator->Exhausted() )
+		{
+			usedOffsets.push_back( _compactIterator->GetCurrentOffset() );
+			_compactIterator->MoveNextPage();
+		}
+		std::sort( usedOffsets.begin(), usedOffsets.end() );
+
+		_freeOffsets.clear();
+		int pageSize = _page->GetSize();
+		int fileLength = GetIndexFileLength( _file );
+		offsetsType::const_iterator used = usedOffsets.begin();
+		for( int offset = HEADER_SIZE; offset + pageSize <= fileLength; offset += pageSize )
+		{
+			while( used != usedOffsets.end() && *used < offset )
+			{
+				++used;
+			}
+			if( used == usedOffsets.end() || *used != offset )
+			{
+				_freeOffsets.push_back( offset );
+			}
+		}
+		std::reverse( _freeOffsets.begin(), _freeOffsets.end() );
+	}
+
+	// truncates free pages at the end of the file, or moves the last page of the file
+	// to the lowest free page; returns false if there is nothing to do
+	bool BTreeIndex::RelocateLastPage()
+	{
+		int pageSize = _page->GetSize();
+		int lastOffset = GetIndexFileLength( _file ) - pageSize;
+		if( lastOffset < HEADER_SIZE || _freeOffsets.empty() )
+		{
+			return false;
+		}
+		offsetsType::iterator lowest = std::min_element( _freeOffsets.begin(), _freeOffsets.end() );
+		offsetsType::iterator last = std::find( _freeOffsets.begin(), _freeOffsets.end(), lastOffset );
+		if( last == _freeOffsets.end() )
+		{
+			int newOffset = *lowest;
+			if( newOffset > lastOffset )
+			{
+				return false;
+			}
+			BTreePageBase* page = GetPageByOffset( lastOffset );
+			if( page->GetCount() == 0 )
+			{
+				return false;
+			}
+			_btreeHeader->GetPage( page->GetMinimum(), *_compactIterator );
+			if( _compactIterator->Exhausted() || _compactIterator->GetCurrentOffset() != lastOffset )
+			{
+				return false;
+			}
+			_compactIterator->GetCurrentKey( *_headerKey );
+			_freeOffsets.erase( lowest );
+
+			// the page is saved at the new offset before the file is truncated
+			page->SetOffset( newOffset );
+			SavePage( page );
+			_btreeHeader->SetPageOffset( *_headerKey, newOffset );
+			_btreeHeader->SetPageCount( newOffset, page->GetCount() );
+			_btreeHeader->DeletePageCount( lastOffset );
+			_btreeHeader->MovePageFilter( lastOffset, newOffset );
+		}
+		else
+		{
+			_freeOffsets.erase( last );
+		}
+		SetIndexFileLength( _file, lastOffset );
+		return true;
+	}
+
+	BTreePageBase* BTreeIndex::GetPageByOffset( int offset )
+	{
+		BTreePageBase* page = _pagesCache->TryOffset( offset );
+		if( page == 0 )
+		{
+			page = PrepareNewPage( offset );
+			LoadPage( page );
+		}
+		// filters are built when pages are used for the first time after the btree was
+		// opened or filters were enabled, and are kept for evicted pages
+		if( _usePageFilters && !_btreeHeader->HasPageFilter( offset ) )
+		{
+			BuildPageFilter( page );
+		}
+		return page;
+	}
+
+	BTreePageBase* BTreeIndex::AllocPage()
+	{
+		++_numberOfPages;
+
+		int newOffset;
+		BTreePageBase* page;
+
+		if( _freeOffsets.empty() )
+		{
+			newOffset = GetIndexFileLength( _file );
+			page = PrepareNewPage( newOffset );
+			page->Clear();
+			SavePage( page );
+		}
+		else
+		{
+			newOffset = _freeOffsets.back();
+			_freeOffsets.pop_back();
+			page = PrepareNewPage( newOffset );
+			page->Clear();
+		}
+		_btreeHeader->ClearPageFilter( newOffset );
+		return page;
+	}
+
+	BTreePageBase* BTreeIndex::PrepareNewPage( int offset )
+	{
+		BTreePageBase* page = _freePage;
+		if( !page )
+		{
+			page = _page->Clone();
+		}
+		page->SetOffset( offset );
+		_freePage = _pagesCache->CachePage( page );
+		return page;
+	}
+
+	void BTreeIndex::LoadPage( BTreePageBase* page )
+	{
+		CheckPageHandle( page );
+		__int64 start = BTreeCounters::StartTiming();
+		int loadedBytes = page->Load();
+		_counters->Time( pageRead_Operation, start );
+		_counters->Add( pageReads_Counter, 1 );
+		_counters->Add( bytesRead_Counter, loadedBytes );
+		int pageSize = page->GetSize();
+		if( loadedBytes != pageSize )
+		{
+			char s[ 200 ];
+			sprintf( s, "BTreePageBase.Load() returned %d, pageSize = %d, last error = %d.", loadedBytes, pageSize, GetLastSystemError() );
+			throw BTreeIndexError( io_Error, s );
+		}
+		_loadedPages++;
+	}
+
+	void BTreeIndex::SavePage( BTreePageBase* page )
+	{
+		CheckPageHandle( page );
+		__int64 start = BTreeCounters::StartTiming();
+		int savedBytes = page->Save();
+		_counters->Time( pageWrite_Operation, start );
+		_counters->Add( pageWrites_Counter, 1 );
+		_counters->Add( bytesWritten_Counter, savedBytes );
+		int pageSize = page->GetSize();
+		if( savedBytes != pageSize )
+		{
+			char s[ 200 ];
+			sprintf( s, "BTreePageBase.Save() returned %d, pageSize = %d, last error = %d.", savedBytes, pageSize, GetLastSystemError() );
+			throw BTreeIndexError( io_Error, s );
+		}
+	}
+
+	void BTreeIndex::CheckPageHandle( BTreePageBase* page )
+	{
+		int pageHandle = page->GetFileHandle();
+		if( pageHandle != _file )
+		{
+			char s[ 100 ];
+			sprintf( s, "Page handle(%d) is not equal to btree file handle(%d).", pageHandle, _file );
+			throw BTreeIndexError( io_Error, s );
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	// BTreeCursor implementation
+	///////////////////////////////////////////////////////////////////////////
+
+	BTreeCursor::BTreeCursor()
+		: _index( 0 ), _keys( 0 ), _capacity( 0 ), _firstKey( 0 ), _lastKey( 0 ), _headerKey( 0 ), _keyType( unknown_Key ),
+		  _bounded( false ), _timed( false ), _start( 0 ), _count( 0 ), _scannedPages( 0 )
+	{
+	}
+
+	BTreeCursor::~BTreeCursor()
+	{
+		if( _keys )
+		{
+			DBIndexHeapObject::operator delete( _keys );
+		}
+		if( _firstKey )
+		{
+			TypeFactory::DeleteKey( _firstKey );
+			TypeFactory::DeleteKey( _lastKey );
+			TypeFactory::DeleteKey( _headerKey );
+		}
+	}
+
+	void BTreeCursor::SeekAll( BTreeIndex& index, bool timed )
+	{
+		Prepare( index, timed );
+		_bounded = false;
+		index._btreeHeader->GetMinimumPage( *index._btreeHeaderIterator );
+	}
+
+	void BTreeCursor::SeekRange( BTreeIndex& index, const BTreeKeyBase& first, const BTreeKeyBase& last, bool timed )
+	{
+		Prepare( index, timed );
+		_bounded = true;
+		TypeFactory::CopyKey( _keyType, *_firstKey, first );
+		TypeFactory::CopyKey( _keyType, *_lastKey, last );
+		index._btreeHeader->GetPage( *_firstKey, *index._btreeHeaderIterator );
+	}
+
+	bool BTreeCursor::NextPage()
+	{
+		BTreeIndex& index = *_index;
+		BTreeHeaderIteratorBase& iterator = *index._btreeHeaderIterator;
+		if( iterator.Exhausted() )
+		{
+			Complete();
+			return false;
+		}
+		if( _bounded )
+		{
+			iterator.GetCurrentKey( *_headerKey );
+			if( index._keyComparer->Less( *_lastKey, *_headerKey ) )
+			{
+				Complete();
+				return false;
+			}
+		}
+		index.ReadAhead( ++_scannedPages, _bounded ? _lastKey : 0 );
+		BTreePageBase* page = index.GetPageByOffset( iterator.GetCurrentOffset() );
+		unsigned count = _bounded ? page->SearchForRange( *_firstKey, *_lastKey, _keys ) : page->GetAllKeys( _keys );
+		CheckKeysCount( count, page );
+		_count = (int) count;
+		iterator.MoveNextPage();
+		return true;
+	}
+
+	// pooled enumerators reuse cursors for btrees with different key types and page geometries
+	void BTreeCursor::Prepare( BTreeIndex& index, bool timed )
+	{
+		_index = &index;
+		int capacity = index.GetPageCapacity();
+		if( _capacity < capacity )
+		{
+			if( _keys )
+			{
+				DBIndexHeapObject::operator delete( _keys );
+			}
+			_keys = (const BTreeKeyBase**) DBIndexHeapObject::operator new( capacity * sizeof( const BTreeKeyBase* ) );
+			_capacity = capacity;
+		}
+		int keyType = index.GetKeyType();
+		if( _keyType != keyType )
+		{
+			if( _firstKey )
+			{
+				TypeFactory::DeleteKey( _firstKey );
+				TypeFactory::DeleteKey( _lastKey );
+				TypeFactory::DeleteKey( _headerKey );
+			}
+			_firstKey = TypeFactory::NewKey( keyType );
+			_lastKey = TypeFactory::NewKey( keyType );
+			_headerKey = TypeFactory::NewKey( keyType );
+			_keyType = keyType;
+		}
+		_timed = timed;
+		_start = timed ? BTreeCounters::StartTiming() : 0;
+		_count = 0;
+		_scannedPages = 0;
+	}
+
+	void BTreeCursor::Complete()
+	{
+		_count = 0;
+		if( _timed )
+		{
+			BTreeCounters& counters = _index->GetCounters();
+			counters.Add( lookups_Counter, 1 );
+			counters.Time( lookup_Operation, _start );
+			_timed = false;
+		}
+	}
+}
@@ -0,0 +1,209 @@
+﻿// SPDX-FileCopyrightText: 2003-2008 JetBrains s.r.o.
+//
+// SPDX-License-Identifier: GPL-2.0-only
+
+#ifndef _OMEA_BTREEINDEX_H
+#define _OMEA_BTREEINDEX_H
+
+#include <vector>
+#include "TypeFactory.h"
+#include "BTreePagesCache.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// size of the btree file header, pages follow the header
+///////////////////////////////////////////////////////////////////////////////
+
+#define HEADER_SIZE 1024
+
+namespace DBIndex
+{
+	// results of BTreeIndex::Open()
+	enum {	created_Open,
+			closed_Open,
+			badGeometry_Open,
+			badHeader_Open
+	};
+
+	// phases of a compaction pass
+	enum {	idle_Compaction,
+			merge_Compaction,
+			relocate_Compaction
+	};
+
+	// kinds of BTreeIndexError
+	enum {	io_Error,
+			corrupted_Error
+	};
+
+	///////////////////////////////////////////////////////////////////////////
+	// exception thrown by the native btree engine, the managed wrapper
+	// translates it to IOException or BadIndexesException
+	///////////////////////////////////////////////////////////////////////////
+
+	class BTreeIndexError
+	{
+	public:
+
+		BTreeIndexError( int kind, const char* message );
+
+		int GetKind() const { return _kind; }
+		const char* GetMessage() const { return _message; }
+
+	private:
+
+		int		_kind;
+		char	_message[ 200 ];
+	};
+
+	class BTreeCursor;
+
+	///////////////////////////////////////////////////////////////////////////
+	// Native btree engine: pages of one file, the in-memory header mapping
+	// minimum keys of pages to their offsets, and the pages cache.
+	// The file is opened and closed by the caller, keys are native keys of
+	// the index's key type created by TypeFactory.
+	///////////////////////////////////////////////////////////////////////////
+
+	class BTreeIndex : public DBIndexHeapObject
+	{
+	public:
+
+		BTreeIndex( int keyType, int pageGeometry );
+		~BTreeIndex();
+
+		// returns one of the *_Open results, the file should be opened for reading and writing;
+		// a closed btree file is opened with the geometry it was created with
+		int Open( int file );
+		// saves cached pages, the file stays open
+		void Flush();
+		// marks the flushed btree as closed, saves its header to the file and returns
+		// false if the header couldn't be saved; file is the btree file reopened exclusively
+		bool SaveHeader( int file );
+		// forgets the header of a closed btree
+		void Reset();
+		// removes all keys
+		void Clear();
+
+		int GetKeyType() const { return _keyType; }
+		int GetPageGeometry() const { return _pageGeometry; }
+		int GetPageCapacity() const { return TypeFactory::GetPageCapacity( _pageGeometry ); }
+		int GetPageSize() const { return _page ? _page->GetSize() : 0; }
+		int GetCount() const { return _keysInIndex; }
+		int GetLoadedPages() const { return _loadedPages; }
+		// Bloom filters of pages' keys are kept in memory, so Contains() reads no page for
+		// most keys missing in the btree; filters aren't saved and are built on first use of pages
+		void SetPageFilters( bool enabled );
+		bool HasPageFilters() const { return _usePageFilters; }
+		BTreePagesCache& GetPagesCache() { return *_pagesCache; }
+		BTreeCounters& GetCounters() { return *_counters; }
+
+		void Insert( const BTreeKeyBase& key );
+		void Delete( const BTreeKeyBase& key );
+		// batches are sorted and applied page by page
+		void InsertBatch( const BTreeKeyBase* const* keys, int count );
+		void DeleteBatch( const BTreeKeyBase* const* keys, int count );
+		// loads at most the two boundary pages, key counts of other pages are kept in the header
+		int CountRange( const BTreeKeyBase& first, const BTreeKeyBase& last );
+		// whether a key of the range is in the btree, first and last may differ in offsets only
+		bool Contains( const BTreeKeyBase& first, const BTreeKeyBase& last );
+		// return 0 if the btree is empty
+		const BTreeKeyBase* GetMinimum();
+		const BTreeKeyBase* GetMaximum();
+		// one step of a compaction pass, which merges adjacent underfull pages and then
+		// moves pages from the end of the file to free pages, truncating the file;
+		// works for about the given time and returns false when the pass is completed
+		bool Compact( int milliseconds );
+
+	private:
+
+		friend class BTreeCursor;
+
+		void InstantiateTypes();
+		void SetPageGeometry( int geometry );
+		void InsertKey( const BTreeKeyBase& key );
+		void UpdateDeletedPage( BTreePageBase* page );
+		void ReadAhead( int scannedPages, const BTreeKeyBase* last );
+		bool MergeNextPage();
+		void CollectFreeOffsets();
+		bool RelocateLastPage();
+		int GetKnownPageCount( int offset );
+		void BuildPageFilter( BTreePageBase* page );
+		void AddToPageFilter( BTreePageBase* page, const BTreeKeyBase& key );
+		BTreePageBase* GetPageByOffset( int offset );
+		BTreePageBase* AllocPage();
+		BTreePageBase* PrepareNewPage( int offset );
+		void LoadPage( BTreePageBase* );
+		void SavePage( BTreePageBase* );
+		void CheckPageHandle( BTreePageBase* );
+
+		typedef std::vector< int, DBIndex_allocator< int > > offsetsType;
+
+		BTreePageBase*				_page;
+		BTreePageBase*				_freePage;
+		const BTreeKeyBase**		_tempKeys;
+		BTreeKeyBase*				_headerKey;
+		BTreeKeyBase*				_nextHeaderKey;
+		IKeyComparer*				_keyComparer;
+		BTreePagesCache*			_pagesCache;
+		BTreeCounters*				_counters;
+		BTreeHeaderBase*			_btreeHeader;
+		BTreeHeaderIteratorBase*	_btreeHeaderIterator;
+		BTreeHeaderIteratorBase*	_readAheadIterator;
+		BTreeHeaderIteratorBase*	_compactIterator;
+		BTreeKeyBase*				_compactKey;
+		offsetsType					_freeOffsets;
+		int							_file;
+		int							_keysInIndex;
+		int							_keyType;
+		int							_pageGeometry;
+		unsigned					_numberOfPages;
+		int							_loadedPages;
+		int							_compactionPhase;
+		bool						_usePageFilters;
+	};
+
+	///////////////////////////////////////////////////////////////////////////
+	// Cursor scanning keys of a btree page by page.
+	// A cursor keeps its own range and a buffer for keys of the current page,
+	// but it moves the header iterator of the index, so an index is scanned
+	// by one cursor at a time. A cursor may be reused for different indexes.
+	///////////////////////////////////////////////////////////////////////////
+
+	class BTreeCursor : public DBIndexHeapObject
+	{
+	public:
+
+		BTreeCursor();
+		~BTreeCursor();
+
+		// a timed scan is timed as a lookup when the cursor comes to its end,
+		// enumerators consuming keys between pages aren't timed
+		void SeekAll( BTreeIndex& index, bool timed );
+		void SeekRange( BTreeIndex& index, const BTreeKeyBase& first, const BTreeKeyBase& last, bool timed );
+		// moves to the next page having keys of the range, returns false at the end of the scan
+		bool NextPage();
+
+		int GetCount() const { return _count; }
+		const BTreeKeyBase* const* GetKeys() const { return _keys; }
+
+	private:
+
+		void Prepare( BTreeIndex& index, bool timed );
+		void Complete();
+
+		BTreeIndex*				_index;
+		const BTreeKeyBase**	_keys;
+		int						_capacity;
+		BTreeKeyBase*			_firstKey;
+		BTreeKeyBase*			_lastKey;
+		BTreeKeyBase*			_headerKey;
+		int						_keyType;
+		bool					_bounded;
+		bool					_timed;
+		__int64					_start;
+		int						_count;
+		int						_scannedPages;
+	};
+}
+
+#endif
@@ -5,6 +5,7 @@
 #ifndef _OMEA_BTREEKEY_H
 #define _OMEA_BTREEKEY_H
 
+#include <memory.h>
 #include "DBIndexHeapObject.h"
 
 namespace DBIndex
@@ -19,6 +20,10 @@ namespace DBIndex
 // maximum value of record offset
 #define MAX_OFFSET	0x7fffffff
 
+// width of RBTree links kept by BTreeKeyBase
+#define BASE_LINK_BITS	10
+#define BASE_LINK_MASK	( ( 1 << BASE_LINK_BITS ) - 1 )
+
 //#define __forceinline
 
 	///////////////////////////////////////////////////////////////////////////
@@ -76,11 +81,53 @@ namespace DBIndex
 		// values: 1 - Red, 0 - Black
 		///////////////////////////////////////////////////////////////////////
 		unsigned		_color : 1;
-		unsigned		_parent : 10;
-		unsigned		_left : 10;
-		unsigned		_right : 10;
+		unsigned		_parent : BASE_LINK_BITS;
+		unsigned		_left : BASE_LINK_BITS;
+		unsigned		_right : BASE_LINK_BITS;
 	};
 
+	///////////////////////////////////////////////////////////////////////////
+	// hashing of key data for filters of pages' keys
+	// equal key parts have equal hashes, so +0.0 and -0.0 are hashed as zero
+	///////////////////////////////////////////////////////////////////////////
+
+	__forceinline unsigned MixHash( unsigned hash )
+	{
+		hash ^= hash >> 16;
+		hash *= 0x85ebca6b;
+		hash ^= hash >> 13;
+		hash *= 0xc2b2ae35;
+		hash ^= hash >> 16;
+		return hash;
+	}
+
+	template< class Part > __forceinline unsigned HashKeyPart( unsigned hash, const Part& part )
+	{
+		Part value = ( part == Part() ) ? Part() : part;
+		unsigned words[ ( sizeof( Part ) + sizeof( unsigned ) - 1 ) / sizeof( unsigned ) ];
+		words[ sizeof( words ) / sizeof( unsigned ) - 1 ] = 0;
+		memcpy( words, &value, sizeof( Part ) );
+		for( unsigned i = 0; i < sizeof( words ) / sizeof( unsigned ); ++i )
+		{
+			hash = MixHash( hash ^ words[ i ] ) + i;
+		}
+		return hash;
+	}
+
+	template < class Key1, class Key2 > class CompoundKey;
+	template < class Key1, class Key2, class Value > class CompoundKeyWithValue;
+
+	template< class Key1, class Key2 > __forceinline unsigned HashKeyPart( unsigned hash, const CompoundKey< Key1, Key2 >& part )
+	{
+		return HashKeyPart( HashKeyPart( hash, part._first ), part._second );
+	}
+
+	template< class Key1, class Key2, class Value > __forceinline unsigned HashKeyPart(
+		unsigned hash, const CompoundKeyWithValue< Key1, Key2, Value >& part )
+	{
+		return HashKeyPart( HashKeyPart( HashKeyPart( hash, part._first ), part._second ), part.GetValue() );
+	}
+
 	///////////////////////////////////////////////////////////////////////////
 	// The following class grants polymorphic way to compare BTree keys as
 	// instances of the BTreeKey template class. Each implementation of
@@ -92,8 +139,12 @@ namespace DBIndex
 	public:
 		virtual bool Equals( const BTreeKeyBase&, const BTreeKeyBase& ) const = 0;
 		virtual bool Less( const BTreeKeyBase&, const BTreeKeyBase& ) const = 0;
+		// hash of key data, offsets aren't hashed so that a key can be looked up with any offset
+		virtual unsigned Hash( const BTreeKeyBase& ) const = 0;
 	};
 
+	template< class Key > class BTreeKey;
+
 	template< class Key > class KeyComparer : public IKeyComparer
 	{
 		virtual bool Equals( const BTreeKeyBase& l, const BTreeKeyBase& r ) const
@@ -108,6 +159,11 @@ namespace DBIndex
 			const BTreeKey< Key >& keyR = static_cast< const BTreeKey< Key >& >( r );
 			return keyL < keyR;
 		}
+		virtual unsigned Hash( const BTreeKeyBase& key ) const
+		{
+			const BTreeKey< Key >& theKey = static_cast< const BTreeKey< Key >& >( key );
+			return HashKeyPart( 0, theKey.GetKey() );
+		}
 	};
 
 	///////////////////////////////////////////////////////////////////////////
@@ -148,6 +204,98 @@ namespace DBIndex
 		Key		_key;
 	};
 
+	///////////////////////////////////////////////////////////////////////////
+	// template class for keys as they are stored in BTree pages with RBTree
+	// links of LinkBits width
+	// high bits of links wider than BASE_LINK_BITS are placed after the key
+	// data, so that outside of its page a page key is an ordinary BTreeKey
+	///////////////////////////////////////////////////////////////////////////
+
+	template< class Key, unsigned LinkBits > class BTreePageKey : public BTreeKey< Key >
+	{
+		typedef BTreeKey< Key > baseType;
+		typedef BTreePageKey< Key, LinkBits > thisType;
+
+	public:
+
+		BTreePageKey() : baseType(), _parentHigh( 0 ), _leftHigh( 0 ), _rightHigh( 0 ) {}
+
+		// as with BTreeKey, only key data and offset are assigned
+		__forceinline thisType& operator= ( const baseType& key )
+		{
+			baseType::operator=( key );
+			return *this;
+		}
+		__forceinline thisType& operator= ( const thisType& key )
+		{
+			baseType::operator=( key );
+			return *this;
+		}
+
+		__forceinline void SetParent( unsigned parent )
+		{
+			baseType::SetParent( parent & BASE_LINK_MASK );
+			_parentHigh = parent >> BASE_LINK_BITS;
+		}
+		__forceinline unsigned GetParent() const { return baseType::GetParent() | ( _parentHigh << BASE_LINK_BITS ); }
+		__forceinline void SetLeft( unsigned left )
+		{
+			baseType::SetLeft( left & BASE_LINK_MASK );
+			_leftHigh = left >> BASE_LINK_BITS;
+		}
+		__forceinline unsigned GetLeft() const { return baseType::GetLeft() | ( _leftHigh << BASE_LINK_BITS ); }
+		__forceinline void SetRight( unsigned right )
+		{
+			baseType::SetRight( right & BASE_LINK_MASK );
+			_rightHigh = right >> BASE_LINK_BITS;
+		}
+		__forceinline unsigned GetRight() const { return baseType::GetRight() | ( _rightHigh << BASE_LINK_BITS ); }
+		__forceinline void SetLeftOrRight( unsigned newChild, unsigned oldLeft )
+		{
+			if( GetLeft() == oldLeft )
+			{
+				SetLeft( newChild );
+			}
+			else
+			{
+				SetRight( newChild );
+			}
+		}
+		__forceinline void SetRightOrLeft( unsigned newChild, unsigned oldRight )
+		{
+			if( GetRight() == oldRight )
+			{
+				SetRight( newChild );
+			}
+			else
+			{
+				SetLeft( newChild );
+			}
+		}
+
+	private:
+
+		unsigned		_parentHigh : LinkBits - BASE_LINK_BITS;
+		unsigned		_leftHigh : LinkBits - BASE_LINK_BITS;
+		unsigned		_rightHigh : LinkBits - BASE_LINK_BITS;
+	};
+
+	// links of BASE_LINK_BITS width are kept by BTreeKeyBase, a page key is laid out as BTreeKey
+	template< class Key > class BTreePageKey< Key, BASE_LINK_BITS > : public BTreeKey< Key >
+	{
+		typedef BTreeKey< Key > baseType;
+
+	public:
+
+		BTreePageKey() : baseType() {}
+
+		__forceinline BTreePageKey< Key, BASE_LINK_BITS >& operator= ( const baseType& key )
+		{
+			baseType::operator=( key );
+			return *this;
+		}
+	};
+
 	///////////////////////////////////////////////////////////////////////////
 	// template class for BTree keys with data placed in memory (BTree header)
 	// BTree header is supposed to be implemented by std::map
@@ -233,22 +381,22 @@ namespace DBIndex
 
 		__forceinline bool operator ==( const keyType& right ) const
 		{
-			return _first == right._first && _second == right._second && _value == right._value;
+			return this->_first == right._first && this->_second == right._second && _value == right._value;
 		}
 
 		__forceinline bool operator <( const keyType& right ) const
 		{
-			if( _first < right._first )
+			if( this->_first < right._first )
 			{
 				return true;
 			}
-			if( _first == right._first )
+			if( this->_first == right._first )
 			{
-				if( _second < right._second )
+				if( this->_second < right._second )
 				{
 					return true;
 				}
-				if( _second == right._second )
+				if( this->_second == right._second )
 				{
 					return _value < right._value;
 				}
@@ -6,16 +6,11 @@
 #define _OMEA_BTREEPAGE_H
 
 #include <memory.h>
-#ifdef _MSC_VER
-#include <windows.h>
-#else
-#include <io.h>
-#endif
 #include "DBIndexHeapObject.h"
 #include "BTreeKey.h"
 
 ///////////////////////////////////////////////////////////////////////////////
-// maximum number of keys in a page is equal to 2^10 - 2
+// maximum number of keys in a page of the default geometry is equal to 2^10 - 2
 // page size is actually greater on two keys: the first (zero-based) is null
 // object necessary for red-black tree fixup operations, and the second used
 // for storing extra info, such as count of keys and free list first index
@@ -59,6 +54,7 @@ namespace DBIndex
 		virtual void Clear() = 0;
 		virtual int GetSize() const = 0;
 		__forceinline void SetFileHandle( int fh ) { _fileHandle = fh; }
+		__forceinline bool IsDirty() const { return _dirty; }
 		__forceinline int GetFileHandle() const { return _fileHandle; }
 		__forceinline int GetOffset() const { return _fileOffset; }
 		__forceinline void SetOffset( int offset )
@@ -69,6 +65,9 @@ namespace DBIndex
 				_dirty = true;
 			}
 		}
+		// tick of the pages pool clock when the page was last used
+		__forceinline unsigned GetLastAccess() const { return _lastAccess; }
+		__forceinline void SetLastAccess( unsigned tick ) { _lastAccess = tick; }
 
 		virtual bool operator<( BTreePageBase& page ) = 0;
 
@@ -88,25 +87,50 @@ namespace DBIndex
 		virtual void SetCount( int count ) = 0;
 		virtual int IncCount() = 0;
 		virtual int DecCount() = 0;
-		__forceinline bool IsFull() const { return GetCount() == MAX_KEYS_IN_PAGE; }
-		__forceinline bool IsAlmostFull() const { return GetCount() >= ALMOST_FULL_PAGE_SIZE; }
+		// maximum number of keys in the page and count of keys starting from which it is almost full
+		virtual int GetCapacity() const = 0;
+		virtual int GetAlmostFullCount() const = 0;
+		__forceinline bool IsFull() const { return GetCount() == GetCapacity(); }
+		__forceinline bool IsAlmostFull() const { return GetCount() >= GetAlmostFullCount(); }
 
 	protected:
 
 		BTreePageBase( int fileHandle, int offset )
-			: _magickNumber( BTREE_PAGE_MAGIC_NUMBER ), _fileHandle( fileHandle ), _fileOffset( offset ), _dirty( true ) {}
+			: _magickNumber( BTREE_PAGE_MAGIC_NUMBER ), _fileHandle( fileHandle ), _fileOffset( offset ), _dirty( true ), _lastAccess( 0 ) {}
 
 		unsigned		_magickNumber;
 		int				_fileHandle;
 		int				_fileOffset;
 		bool			_dirty;
+		unsigned		_lastAccess;
 	};
 
 	///////////////////////////////////////////////////////////////////////////
-	// template class for pages with specified key
+	// page geometry: maximum number of keys, width of RBTree links in bits,
+	// which should be enough for indexes up to MaxKeys + 1, and count of keys
+	// starting from which the page is almost full
 	///////////////////////////////////////////////////////////////////////////
 
-	template< class Key > class BTreePage : public BTreePageBase
+	template< unsigned MaxKeys, unsigned LinkBits, unsigned AlmostFullKeys > class BTreePageGeometry
+	{
+	public:
+
+		enum { maxKeys = MaxKeys, linkBits = LinkBits, almostFullKeys = AlmostFullKeys };
+
+		static_assert( MaxKeys + 1 < ( 1u << LinkBits ), "RBTree links are too narrow for the page" );
+		static_assert( LinkBits >= BASE_LINK_BITS && LinkBits <= BASE_LINK_BITS + 10, "unsupported width of RBTree links" );
+		static_assert( AlmostFullKeys <= MaxKeys, "almost full page can't hold more keys than full one" );
+	};
+
+	typedef BTreePageGeometry< MAX_KEYS_IN_PAGE, BASE_LINK_BITS, ALMOST_FULL_PAGE_SIZE > DefaultPageGeometry;
+	typedef BTreePageGeometry< 254, BASE_LINK_BITS, 254 - 16 > SmallPageGeometry;
+	typedef BTreePageGeometry< 4094, 12, 4094 - 256 > LargePageGeometry;
+
+	///////////////////////////////////////////////////////////////////////////
+	// template class for pages with specified key and geometry
+	///////////////////////////////////////////////////////////////////////////
+
+	template< class Key, class Geometry = DefaultPageGeometry > class BTreePage : public BTreePageBase
 	{
 	public:
 
@@ -118,30 +142,23 @@ namespace DBIndex
 
 		virtual BTreePageBase* Clone() const
 		{
-			return new BTreePage< Key >( _fileHandle, _fileOffset );
+			return new thisType( _fileHandle, _fileOffset );
 		}
 
 		virtual int Load()
 		{
-			DWORD read;
-#ifdef _MSC_VER
-			DWORD pageSize = (DWORD) GetSize();
-			::SetFilePointer( (HANDLE) _fileHandle, (LONG) _fileOffset, NULL, FILE_BEGIN );
-			::ReadFile( (HANDLE) _fileHandle, (LPVOID) &_tree, pageSize, &read, NULL );
-			_dirty = ( pageSize != read );
-#else
-			_lseek( _fileHandle, _fileOffset, SEEK_SET );
+			// position is passed with the request, not through the shared file pointer,
+			// because a page may be saved by another thread evicting it from the pages pool
 			int pageSize = GetSize();
-			read = _read( _fileHandle, (void*)&_tree, pageSize );
-			_dirty = read != pageSize;
-#endif
+			int read = ReadIndexFile( _fileHandle, (void*) &_tree, pageSize, _fileOffset );
+			_dirty = ( pageSize != read );
 			_minimumIndex = _maximumIndex = 0;
 
 			// check page integrity
 			if( !_dirty )
 			{
 				unsigned rootIndex = GetRootIndex();
-				_dirty = ( rootIndex >> 10 ) != ( BTREE_PAGE_MAGIC_NUMBER >> 10 );
+				_dirty = ( rootIndex >> Geometry::linkBits ) != ( BTREE_PAGE_MAGIC_NUMBER >> Geometry::linkBits );
 				if( !_dirty )
 				{
 					// clear integrity marker
@@ -152,22 +169,14 @@ namespace DBIndex
 		}
 		virtual int Save()
 		{
-			DWORD pageSize = (DWORD) GetSize();
+			int pageSize = GetSize();
 			if( _dirty )
 			{
 				// set integrity marker
 				unsigned rootIndex = GetRootIndex();
 				SetRootIndex( rootIndex ^ BTREE_PAGE_MAGIC_NUMBER );
-				DWORD written;
-#ifdef _MSC_VER
-				::SetFilePointer( (HANDLE) _fileHandle, (LONG) _fileOffset, NULL, FILE_BEGIN );
-				::WriteFile( (HANDLE) _fileHandle, (LPCVOID) &_tree, pageSize, &written, NULL );
+				int written = WriteIndexFile( _fileHandle, (const void*) &_tree, pageSize, _fileOffset );
 				_dirty = written != pageSize;
-#else
-				_lseek( _fileHandle, _fileOffset, SEEK_SET );
-				written = _write( _fileHandle, (const void*) &_tree, pageSize );
-				_dirty = false;
-#endif
 				// clear integrity marker
 				SetRootIndex( rootIndex );
 				return written;
@@ -194,8 +203,8 @@ namespace DBIndex
 
 		virtual unsigned SearchForRange( const BTreeKeyBase& first, const BTreeKeyBase& last, const BTreeKeyBase* keys[] ) const
 		{
-			const KeyType& realFirst = static_cast< const KeyType& >( first );
-			const KeyType& realLast = static_cast< const KeyType& >( last );
+			const ValueType& realFirst = static_cast< const ValueType& >( first );
+			const ValueType& realLast = static_cast< const ValueType& >( last );
 
 			unsigned next = 0;
 			unsigned index = GetRootIndex();
@@ -223,7 +232,7 @@ namespace DBIndex
 				}
 				if( count == totalCount )
 				{
-					return MAX_KEYS_IN_PAGE + 1;
+					return Geometry::maxKeys + 1;
 				}
 				keys[ count++ ] = &key;
 				next = GetSuccessor( key, next );
@@ -239,7 +248,7 @@ namespace DBIndex
 			{
 				if( count == totalCount )
 				{
-					return MAX_KEYS_IN_PAGE + 1;
+					return Geometry::maxKeys + 1;
 				}
 				const KeyType& key = _tree[ index ];
 				keys[ count++ ] = &key;
@@ -250,7 +259,7 @@ namespace DBIndex
 
 		virtual void Insert( const BTreeKeyBase& key )
 		{
-			const KeyType& realKey = static_cast< const KeyType& >( key );
+			const ValueType& realKey = static_cast< const ValueType& >( key );
 			unsigned index = GetFirstFree(); // at first check free list
 			if( index )
 			{
@@ -361,7 +370,7 @@ namespace DBIndex
 		{
 			if( GetCount() > 0 )
 			{
-				const KeyType& realKey = static_cast< const KeyType& >( key );
+				const ValueType& realKey = static_cast< const ValueType& >( key );
 				unsigned index = GetRootIndex();
 				do
 				{
@@ -419,14 +428,15 @@ namespace DBIndex
 		// !!! Only full page can be splitted !!!
 		virtual void Split( BTreePageBase& rightPage )
 		{
-			KeyType root = _tree[ GetRootIndex() ];
+			ValueType root = _tree[ GetRootIndex() ];
 
-			// copy keys
-			KeyType	treeCopy[ MAX_KEYS_IN_PAGE ];
-			memcpy( &treeCopy, &_tree[ 2 ], sizeof( treeCopy ) );
+			// copy keys, large pages can't be copied on stack
+			const int treeCopySize = Geometry::maxKeys * sizeof( KeyType );
+			KeyType* treeCopy = (KeyType*) DBIndexHeapObject::operator new( treeCopySize );
+			memcpy( treeCopy, &_tree[ 2 ], treeCopySize );
 
 			Clear();
-			for( int i = 0; i < MAX_KEYS_IN_PAGE; ++i )
+			for( int i = 0; i < Geometry::maxKeys; ++i )
 			{
 				const KeyType& current = treeCopy[ i ];
 				if( root < current )
@@ -438,6 +448,7 @@ namespace DBIndex
 					Insert( current );
 				}
 			}
+			DBIndexHeapObject::operator delete( treeCopy );
 		}
 		virtual void Merge( const BTreePageBase& rightPage )
 		{
@@ -476,10 +487,15 @@ namespace DBIndex
 			return result;
 		}
 
+		virtual int GetCapacity() const { return Geometry::maxKeys; }
+		virtual int GetAlmostFullCount() const { return Geometry::almostFullKeys; }
+
 	private:
 
-		typedef BTreeKey< Key > KeyType;
-		typedef BTreePage< Key > thisType;
+		// keys are passed to the page as ValueType and stored in it as KeyType
+		typedef BTreeKey< Key > ValueType;
+		typedef BTreePageKey< Key, Geometry::linkBits > KeyType;
+		typedef BTreePage< Key, Geometry > thisType;
 
 		void ClearImpl()
 		{
@@ -711,7 +727,7 @@ namespace DBIndex
 			_tree[ index ].SetRight( fEmpty );
 		}
 
-		KeyType		_tree[ MAX_KEYS_IN_PAGE + 2 ];
+		KeyType		_tree[ Geometry::maxKeys + 2 ];
 		unsigned	_minimumIndex;
 		unsigned	_maximumIndex;
 	};
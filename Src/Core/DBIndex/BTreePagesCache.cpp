@@ -4,12 +4,42 @@
 
 #pragma unmanaged
 
-#define USE_ASSEMBLY_LANG
-
+#include <string.h>
 #include "BTreePagesCache.h"
 
+///////////////////////////////////////////////////////////////////////////////
+// an index operation works with at most two pages at once (a page being split
+// and the new right page), so that many most recently used pages of a cache
+// are never evicted in favour of another index
+///////////////////////////////////////////////////////////////////////////////
+
+#define MIN_CACHED_PAGES	2
+
+///////////////////////////////////////////////////////////////////////////////
+// default number of pages sequential scans read ahead
+///////////////////////////////////////////////////////////////////////////////
+
+#define READ_AHEAD_PAGES	8
+
 namespace DBIndex
 {
+	DBIndexLock			BTreePagesCache::_poolLock;
+	volatile int		BTreePagesCache::_poolState = 0;
+	BTreePagesCache*	BTreePagesCache::_poolFirst = 0;
+	unsigned			BTreePagesCache::_poolClock = 0;
+	unsigned __int64	BTreePagesCache::_poolBudget = 0;
+	unsigned __int64	BTreePagesCache::_poolUsage = 0;
+	unsigned			BTreePagesCache::_readAheadPages = READ_AHEAD_PAGES;
+
+	class PoolLock
+	{
+	public:
+		PoolLock( DBIndexLock& lock ) : _lock( lock ) { _lock.Enter(); }
+		~PoolLock() { _lock.Leave(); }
+	private:
+		DBIndexLock& _lock;
+	};
+
 	static PagePtr* AllocPagesArray( unsigned size )
 	{
 		PagePtr* result = (PagePtr*) DBIndexHeapObject::operator new( sizeof( PagePtr ) * size );
@@ -21,14 +51,43 @@ namespace DBIndex
 	}
 
 	BTreePagesCache::BTreePagesCache( unsigned size )
-		: _size( size ), _attempts( 1 ), _hits( 1 )
+		: _capacity( size ), _count( 0 ), _size( size ), _attempts( 1 ), _hits( 1 ), _prev( 0 ), _readAheadPending( 0 )
 	{
 		_pages = AllocPagesArray( size );
+		for( unsigned i = 0; i < MAX_READ_AHEAD_PAGES; ++i )
+		{
+			_readAhead[ i ]._cache = this;
+			_readAhead[ i ]._page = 0;
+		}
+		_readAheadDone.Create();
+		CreatePool();
+		PoolLock lock( _poolLock );
+		_next = _poolFirst;
+		if( _next )
+		{
+			_next->_prev = this;
+		}
+		_poolFirst = this;
 	}
 
 	BTreePagesCache::~BTreePagesCache()
 	{
+		WaitForReadAhead();
+		PoolLock lock( _poolLock );
+		_readAheadDone.Close();
 		ClearWithoutSaving();
+		if( _prev )
+		{
+			_prev->_next = _next;
+		}
+		else
+		{
+			_poolFirst = _next;
+		}
+		if( _next )
+		{
+			_next->_prev = _prev;
+		}
 		DBIndexHeapObject::operator delete( _pages );
 	}
 
@@ -44,34 +103,17 @@ namespace DBIndex
 
 	void BTreePagesCache::SetSize( unsigned size )
 	{
-		PagePtr* pages = AllocPagesArray( size );
-		PagePtr* oldPages = _pages;
-		unsigned i = 0;
-		PagePtr page;
-		for( ; i < _size && i < size; ++i )
-		{
-			page = oldPages[ i ];
-			if( page == 0 )
-			{
-				i = _size;
-				break;
-			}
-			pages[ i ] = page;
-		}
-		for( ; i < _size; ++i )
+		PoolLock lock( _poolLock );
+		_size = size;
+		if( _poolBudget == 0 )
 		{
-			page = oldPages[ i ];
-			if( page == 0 )
+			while( _count > size )
 			{
-				break;
+				delete PopTail();
 			}
-			page->Save();
-			delete page;
 		}
-		DBIndexHeapObject::operator delete( oldPages );
-		_pages = pages;
-		_size = size;
 	}
+
 	unsigned BTreePagesCache::GetSize() const
 	{
 		return _size;
@@ -82,143 +124,195 @@ namespace DBIndex
 		return (double) _hits / (double) _attempts;
 	}
 
+	BTreeCounters& BTreePagesCache::GetCounters()
+	{
+		return _counters;
+	}
+
 	bool BTreePagesCache::HasPages() const
 	{
-		return _pages[ 0 ] != 0;
+		return _count != 0;
 	}
 
-		// returns removed page is any
+	// returns removed page is any
 	PagePtr BTreePagesCache::CachePage( PagePtr page )
 	{
-		PagePtr* pages = _pages;
-		unsigned s = _size;
-		PagePtr removedPage = pages[ s - 1 ];
-		if( removedPage )
+		PoolLock lock( _poolLock );
+		PagePtr removedPage = 0;
+		if( _poolBudget == 0 )
 		{
-			removedPage->Save();
+			while( _count >= _size && _count != 0 )
+			{
+				PagePtr tail = PopTail();
+				if( removedPage )
+				{
+					delete tail;
+				}
+				else
+				{
+					removedPage = tail;
+				}
+			}
 		}
-#ifdef USE_ASSEMBLY_LANG
-		__asm
+		else
 		{
-			push	ebx
-			push	ecx
-			mov		ecx, s
-			mov		ebx, pages
-			dec		ecx
-			shl		ecx, 2
-			add		ebx, ecx
-			shr		ecx, 2
-__loop:
-			sub		ebx, 4
-			mov		eax, [ebx]
-			mov		[ebx+4], eax
-			loop	__loop
-			mov		eax, page
-			mov		[ebx], eax
-			pop		ecx
-			pop		ebx
-			mov		eax, removedPage
+			unsigned needed = (unsigned) page->GetSize();
+			while( _poolUsage + needed > _poolBudget )
+			{
+				BTreePagesCache* victim = SelectVictim( this );
+				if( !victim )
+				{
+					// every cache is at its minimum, let the pool overcommit
+					break;
+				}
+				PagePtr tail = victim->PopTail();
+				if( victim != this || removedPage )
+				{
+					delete tail;
+				}
+				else
+				{
+					removedPage = tail;
+				}
+			}
 		}
-#else
-		for( int i = s - 2; i >= 0; --i )
+		ReadAheadSlot* slot = FindReadAhead( page->GetOffset() );
+		if( slot )
 		{
-			pages[ i + 1 ] = pages[ i ];
+			slot->_cancelled = true;
 		}
-		pages[ 0 ] = page;
+		page->SetLastAccess( ++_poolClock );
+		PushFront( page );
 		return removedPage;
-#endif
 	}
 
 	// tries to load from cache a page by offset
 	PagePtr BTreePagesCache::TryOffset( int offset )
 	{
-		++_attempts;
-		PagePtr page;
-		PagePtr* pages = _pages;
-		unsigned i = 0, size = _size;
-		for( ; ; ++i )
+		bool attempted = false;
+		for( ;; )
 		{
-			if( i == size || !( page = pages[ i ] ) )
 			{
-				return 0;
+				PoolLock lock( _poolLock );
+				if( !attempted )
+				{
+					++_attempts;
+					attempted = true;
+				}
+				PagePtr* pages = _pages;
+				unsigned count = _count;
+				for( unsigned i = 0; i < count; ++i )
+				{
+					PagePtr page = pages[ i ];
+					if( page->GetOffset() == offset )
+					{
+						++_hits;
+						memmove( pages + 1, pages, i * sizeof( PagePtr ) );
+						pages[ 0 ] = page;
+						page->SetLastAccess( ++_poolClock );
+						return page;
+					}
+				}
+				if( !FindReadAhead( offset ) )
+				{
+					return 0;
+				}
 			}
-			if( page->GetOffset() == offset )
+			// the page is being read ahead, it's cheaper to wait for it than to read it once more
+			_readAheadDone.Wait();
+		}
+	}
+
+	void BTreePagesCache::ReadAhead( const BTreePageBase& proto, const int* offsets, unsigned count )
+	{
+		PoolLock lock( _poolLock );
+		unsigned limit = _readAheadPages;
+		if( _poolBudget == 0 )
+		{
+			// pages read ahead shouldn't evict each other before they are used
+			unsigned room = ( _size > MIN_CACHED_PAGES ) ? ( _size - MIN_CACHED_PAGES ) / 2 : 0;
+			if( limit > room )
 			{
-				++_hits;
-				break;
+				limit = room;
 			}
 		}
-#ifdef USE_ASSEMBLY_LANG
-		__asm
+		if( count > limit )
 		{
-			cmp		i, 0
-			jz		__no_loop
-			push	ebx
-			push	ecx
-			mov		ecx, i
-			mov		ebx, pages
-			shl		ecx, 2
-			add		ebx, ecx
-			shr		ecx, 2
-__loop:
-			sub		ebx, 4
-			mov		eax, [ebx]
-			mov		[ebx+4], eax
-			loop	__loop
-			mov		eax, page
-			mov		[ebx], eax
-			pop		ecx
-			pop		ebx
-			jmp		__exit
-__no_loop:
-			mov		eax, page
-__exit:
+			count = limit;
 		}
-#else
-		for( ; i != 0; --i )
+		unsigned slotIndex = 0;
+		for( unsigned i = 0; i < count; ++i )
 		{
-			pages[ i ] = pages[ i - 1 ];
+			int offset = offsets[ i ];
+			if( FindReadAhead( offset ) )
+			{
+				continue;
+			}
+			bool cached = false;
+			for( unsigned j = 0; j < _count; ++j )
+			{
+				if( _pages[ j ]->GetOffset() == offset )
+				{
+					cached = true;
+					break;
+				}
+			}
+			if( cached )
+			{
+				continue;
+			}
+			while( slotIndex < MAX_READ_AHEAD_PAGES && _readAhead[ slotIndex ]._page )
+			{
+				++slotIndex;
+			}
+			if( slotIndex == MAX_READ_AHEAD_PAGES )
+			{
+				break;
+			}
+			ReadAheadSlot* slot = &_readAhead[ slotIndex ];
+			PagePtr page = proto.Clone();
+			page->SetOffset( offset );
+			slot->_page = page;
+			slot->_cancelled = false;
+			++_readAheadPending;
+			if( !QueueWorkItem( ReadAheadProc, slot ) )
+			{
+				slot->_page = 0;
+				--_readAheadPending;
+				delete page;
+				break;
+			}
 		}
-		return ( pages[ 0 ] = page );
-#endif
 	}
 
 	void BTreePagesCache::RemovePage( int offset )
 	{
-		PagePtr page;
+		PoolLock lock( _poolLock );
 		PagePtr* pages = _pages;
-		unsigned i = 0, size = _size;
-		for( ; i < size; ++i )
+		unsigned count = _count;
+		for( unsigned i = 0; i < count; ++i )
 		{
-			page = pages[ i ];
-			if( page == 0 )
-			{
-				return;
-			}
+			PagePtr page = pages[ i ];
 			if( page->GetOffset() == offset )
 			{
-				break;
-			}
-		}
-		for( ; i < size - 1; ++i )
-		{
-			if( ( pages[ i ] = pages[ i + 1 ] ) == 0 )
-			{
-				break;
+				memmove( pages + i, pages + i + 1, ( count - i - 1 ) * sizeof( PagePtr ) );
+				pages[ --_count ] = 0;
+				_poolUsage -= (unsigned) page->GetSize();
+				SavePage( page );
+				delete page;
+				return;
 			}
-			pages[ i + 1 ] = 0;
 		}
-		page->Save();
-		delete page;
 	}
 
 	bool BTreePagesCache::Clear( BTreeHeaderBase& header )
 	{
+		WaitForReadAhead();
+		PoolLock lock( _poolLock );
 		PagePtr page, last;
 		PagePtr* pages = _pages;
-		unsigned size;
+		unsigned size = _count;
 
-		for( size = 0; size < _size && pages[ size ] != 0; ++size );
 		if( size )
 		{
 			// sort pages by offset
@@ -239,6 +333,8 @@ __exit:
 						last->SetOffset( offset );
 						header.SetPageOffset( page->GetMinimum(), lastOffset );
 						header.SetPageOffset( last->GetMinimum(), offset );
+						header.SetPageCount( lastOffset, page->GetCount() );
+						header.SetPageCount( offset, last->GetCount() );
 						continueSort = true;
 					}
 					else
@@ -253,26 +349,246 @@ __exit:
 		{
 			page = pages[ i ];
 			pages[ i ] = 0;
-			page->Save();
+			_poolUsage -= (unsigned) page->GetSize();
+			SavePage( page );
 			delete page;
 		}
+		_count = 0;
 		return true;
 	}
 
 	void BTreePagesCache::ClearWithoutSaving()
 	{
+		WaitForReadAhead();
+		PoolLock lock( _poolLock );
 		PagePtr page;
 		PagePtr* pages = _pages;
 
-		for( unsigned i = 0; i < _size; ++i )
+		for( unsigned i = 0; i < _count; ++i )
 		{
 			page = pages[ i ];
-			if( page == 0 )
+			pages[ i ] = 0;
+			_poolUsage -= (unsigned) page->GetSize();
+			delete page;
+		}
+		_count = 0;
+	}
+
+	void BTreePagesCache::SetPoolBudget( unsigned __int64 bytes )
+	{
+		CreatePool();
+		PoolLock lock( _poolLock );
+		_poolBudget = bytes;
+		if( bytes != 0 )
+		{
+			while( _poolUsage > bytes )
 			{
-				break;
+				BTreePagesCache* victim = SelectVictim( 0 );
+				if( !victim )
+				{
+					break;
+				}
+				delete victim->PopTail();
 			}
-			pages[ i ] = 0;
+		}
+	}
+
+	unsigned __int64 BTreePagesCache::GetPoolBudget()
+	{
+		return _poolBudget;
+	}
+
+	unsigned __int64 BTreePagesCache::GetPoolUsage()
+	{
+		return _poolUsage;
+	}
+
+	void BTreePagesCache::SetReadAheadPages( unsigned pages )
+	{
+		_readAheadPages = ( pages < MAX_READ_AHEAD_PAGES ) ? pages : MAX_READ_AHEAD_PAGES;
+	}
+
+	unsigned BTreePagesCache::GetReadAheadPages()
+	{
+		return _readAheadPages;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	// implementation details, callers other than of CreatePool() hold the pool lock
+	///////////////////////////////////////////////////////////////////////////
+
+	void BTreePagesCache::CreatePool()
+	{
+		if( _poolState != 2 )
+		{
+			if( AtomicCompareExchange( &_poolState, 1, 0 ) == 0 )
+			{
+				_poolLock.Initialize();
+				AtomicExchange( &_poolState, 2 );
+			}
+			else
+			{
+				while( _poolState != 2 )
+				{
+					YieldThread();
+				}
+			}
+		}
+	}
+
+	// the requester needs to keep only its front page, which is probably in use
+	BTreePagesCache* BTreePagesCache::SelectVictim( const BTreePagesCache* requester )
+	{
+		BTreePagesCache* victim = 0;
+		unsigned __int64 victimAge = 0;
+		unsigned __int64 victimSize = 1;
+		for( BTreePagesCache* cache = _poolFirst; cache; cache = cache->_next )
+		{
+			unsigned count = cache->_count;
+			if( count < 2 || ( cache != requester && count <= MIN_CACHED_PAGES ) )
+			{
+				continue;
+			}
+			unsigned __int64 age = _poolClock - cache->_pages[ count - 1 ]->GetLastAccess();
+			unsigned __int64 size = cache->_size ? cache->_size : 1;
+			// compare age / size without dividing
+			if( !victim || age * victimSize > victimAge * size )
+			{
+				victim = cache;
+				victimAge = age;
+				victimSize = size;
+			}
+		}
+		return victim;
+	}
+
+	void BTreePagesCache::PushFront( PagePtr page )
+	{
+		Insert( 0, page );
+	}
+
+	void BTreePagesCache::Insert( unsigned index, PagePtr page )
+	{
+		if( _count == _capacity )
+		{
+			unsigned capacity = _capacity ? _capacity * 2 : MIN_CACHED_PAGES;
+			PagePtr* pages = AllocPagesArray( capacity );
+			memcpy( pages, _pages, _count * sizeof( PagePtr ) );
+			DBIndexHeapObject::operator delete( _pages );
+			_pages = pages;
+			_capacity = capacity;
+		}
+		memmove( _pages + index + 1, _pages + index, ( _count - index ) * sizeof( PagePtr ) );
+		_pages[ index ] = page;
+		++_count;
+		_poolUsage += (unsigned) page->GetSize();
+	}
+
+	// the tail page is saved, caller either reuses or deletes it
+	PagePtr BTreePagesCache::PopTail()
+	{
+		PagePtr page = _pages[ --_count ];
+		_pages[ _count ] = 0;
+		_poolUsage -= (unsigned) page->GetSize();
+		_counters.Add( evictions_Counter, 1 );
+		SavePage( page );
+		return page;
+	}
+
+	void BTreePagesCache::SavePage( PagePtr page )
+	{
+		if( page->IsDirty() )
+		{
+			__int64 start = BTreeCounters::StartTiming();
+			int savedBytes = page->Save();
+			_counters.Time( pageWrite_Operation, start );
+			_counters.Add( pageWrites_Counter, 1 );
+			_counters.Add( bytesWritten_Counter, savedBytes );
+		}
+	}
+
+	BTreePagesCache::ReadAheadSlot* BTreePagesCache::FindReadAhead( int offset )
+	{
+		if( _readAheadPending )
+		{
+			for( unsigned i = 0; i < MAX_READ_AHEAD_PAGES; ++i )
+			{
+				PagePtr page = _readAhead[ i ]._page;
+				if( page && page->GetOffset() == offset )
+				{
+					return &_readAhead[ i ];
+				}
+			}
+		}
+		return 0;
+	}
+
+	void BTreePagesCache::ReadAheadProc( void* param )
+	{
+		ReadAheadSlot* slot = (ReadAheadSlot*) param;
+		PagePtr page = slot->_page;
+		BTreeCounters& counters = slot->_cache->_counters;
+		__int64 start = BTreeCounters::StartTiming();
+		int loadedBytes = page->Load();
+		counters.Time( pageRead_Operation, start );
+		counters.Add( pageReads_Counter, 1 );
+		counters.Add( bytesRead_Counter, loadedBytes );
+		slot->_cache->CompleteReadAhead( slot, loadedBytes == page->GetSize() );
+	}
+
+	// the page is cached behind the most recently used pages, which the owner of
+	// the cache may be working with, and it evicts only pages other than those;
+	// the event is set under the pool lock, so the cache isn't deleted until it's set
+	void BTreePagesCache::CompleteReadAhead( ReadAheadSlot* slot, bool loaded )
+	{
+		PoolLock lock( _poolLock );
+		PagePtr page = slot->_page;
+		bool cache = loaded && !slot->_cancelled;
+		if( cache )
+		{
+			if( _poolBudget == 0 )
+			{
+				while( _count >= _size && _count > MIN_CACHED_PAGES )
+				{
+					delete PopTail();
+				}
+				cache = _count < _size;
+			}
+			else
+			{
+				unsigned needed = (unsigned) page->GetSize();
+				while( _poolUsage + needed > _poolBudget )
+				{
+					BTreePagesCache* victim = SelectVictim( 0 );
+					if( !victim )
+					{
+						break;
+					}
+					delete victim->PopTail();
+				}
+				cache = _poolUsage + needed <= _poolBudget;
+			}
+		}
+		if( cache )
+		{
+			page->SetLastAccess( ++_poolClock );
+			Insert( ( _count < MIN_CACHED_PAGES ) ? _count : MIN_CACHED_PAGES, page );
+		}
+		else
+		{
 			delete page;
 		}
+		slot->_page = 0;
+		--_readAheadPending;
+		_readAheadDone.Set();
+	}
+
+	// is called by the owner of the cache without holding the pool lock
+	void BTreePagesCache::WaitForReadAhead()
+	{
+		while( _readAheadPending )
+		{
+			_readAheadDone.Wait();
+		}
 	}
 }
@@ -8,11 +8,29 @@
 #include "DBIndexHeapObject.h"
 #include "BTreeHeader.h"
 #include "BTreePage.h"
+#include "BTreeCounters.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// maximum number of pages a cache may be reading ahead at once
+///////////////////////////////////////////////////////////////////////////////
+
+#define MAX_READ_AHEAD_PAGES	16
 
 namespace DBIndex
 {
 	typedef BTreePageBase* PagePtr;
 
+	///////////////////////////////////////////////////////////////////////////
+	// All caches form a single process-wide pool of pages.
+	// If the pool has a memory budget, a cache grows as long as the budget
+	// allows, and then the page idle for the longest time relative to its
+	// cache's size is evicted, no matter which index it belongs to.
+	// Without a budget each cache holds at most its size pages.
+	// Pages read ahead are loaded on the thread pool and cached behind
+	// the most recently used pages, a read ahead page is discarded if the
+	// owner of the cache has cached a page with the same offset meanwhile.
+	///////////////////////////////////////////////////////////////////////////
+
 	class BTreePagesCache : public DBIndexHeapObject
 	{
 		/**
@@ -28,16 +46,23 @@ namespace DBIndex
 		static BTreePagesCache* Create( int size );
 		static void Delete( BTreePagesCache* );
 
+		// size is the weight of the cache in the pool if it has a budget
 		void SetSize( unsigned size );
 		unsigned GetSize() const;
 		double GetHitRate() const;
+		// counters of the cache's btree, the cache counts page reads ahead, evictions
+		// and writes of pages it saves
+		BTreeCounters& GetCounters();
 
 		// has cache pages?
 		bool HasPages() const;
 		// returns removed page is any
 		PagePtr CachePage( PagePtr page );
-		// tries to load from cache a page by offset
+		// tries to load from cache a page by offset, waits for the page if it is being read ahead
 		PagePtr TryOffset( int offset );
+		// starts loading in background pages that are neither cached nor being read ahead,
+		// proto is cloned for each page
+		void ReadAhead( const BTreePageBase& proto, const int* offsets, unsigned count );
 
 		void RemovePage( int offset );
 
@@ -45,12 +70,56 @@ namespace DBIndex
 		bool Clear( BTreeHeaderBase& );
 		void ClearWithoutSaving();
 
+		// pool memory budget in bytes, 0 means no budget
+		static void SetPoolBudget( unsigned __int64 bytes );
+		static unsigned __int64 GetPoolBudget();
+		// bytes of pages held by all caches
+		static unsigned __int64 GetPoolUsage();
+		// number of pages sequential scans read ahead, 0 disables read-ahead
+		static void SetReadAheadPages( unsigned pages );
+		static unsigned GetReadAheadPages();
+
 	private:
 
-		PagePtr*	_pages;
-		unsigned	_size;
-		unsigned	_attempts;
-		unsigned	_hits;
+		struct ReadAheadSlot
+		{
+			BTreePagesCache*	_cache;
+			PagePtr				_page;
+			bool				_cancelled;
+		};
+
+		static void CreatePool();
+		static BTreePagesCache* SelectVictim( const BTreePagesCache* requester );
+		static void ReadAheadProc( void* param );
+
+		void PushFront( PagePtr page );
+		void Insert( unsigned index, PagePtr page );
+		PagePtr PopTail();
+		void SavePage( PagePtr page );
+		ReadAheadSlot* FindReadAhead( int offset );
+		void CompleteReadAhead( ReadAheadSlot* slot, bool loaded );
+		void WaitForReadAhead();
+
+		PagePtr*			_pages;
+		unsigned			_capacity;
+		unsigned			_count;
+		unsigned			_size;
+		unsigned			_attempts;
+		unsigned			_hits;
+		BTreePagesCache*	_prev;
+		BTreePagesCache*	_next;
+		ReadAheadSlot		_readAhead[ MAX_READ_AHEAD_PAGES ];
+		volatile int		_readAheadPending;
+		DBIndexEvent		_readAheadDone;
+		BTreeCounters		_counters;
+
+		static DBIndexLock		_poolLock;
+		static volatile int		_poolState;
+		static BTreePagesCache*	_poolFirst;
+		static unsigned			_poolClock;
+		static unsigned __int64	_poolBudget;
+		static unsigned __int64	_poolUsage;
+		static unsigned			_readAheadPages;
 	};
 }
 
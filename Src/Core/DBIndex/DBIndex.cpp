@@ -5,14 +5,26 @@
 #include "DBIndex.h"
 #include "Enumerator.h"
 
-#define HEADER_SIZE 1024
-
 using namespace System::Diagnostics;
 using namespace JetBrains::Omea::Containers;
 
 namespace DBIndex
 {
 	OmniaMeaBTree::OmniaMeaBTree( String ^filename, IFixedLengthKey ^factoryKey )
+	{
+		Initialize( filename, factoryKey, default_Geometry );
+	}
+
+	OmniaMeaBTree::OmniaMeaBTree( String ^filename, IFixedLengthKey ^factoryKey, int pageGeometry )
+	{
+		if( TypeFactory::GetPageCapacity( pageGeometry ) == 0 )
+		{
+			throw gcnew System::ArgumentException( "Unknown page geometry", "pageGeometry" );
+		}
+		Initialize( filename, factoryKey, pageGeometry );
+	}
+
+	void OmniaMeaBTree::Initialize( String ^filename, IFixedLengthKey ^factoryKey, int pageGeometry )
 	{
 		Trace::Write( "OmeaBTree(" );
 		Trace::Write( System::IO::Path::GetFileName( filename ) );
@@ -20,22 +32,9 @@ namespace DBIndex
 		DBIndexHeapObject::CreateHeap();
 		_filename = filename;
 		_factoryKey = factoryKey->FactoryMethod();
-		_pagesCache = BTreePagesCache::Create( 16 );
 		_searchForRangeEnumerable = gcnew SearchForRangeEnumerable( this );
-		_freeOffsets = gcnew IntArrayList();
 		_oneItemList = gcnew ArrayList( 1 );
-		_keysInIndex = 0;
 		_keyType = unknown_Key;
-		_page = 0;
-		_freePage = 0;
-		_firstKey = 0;
-		_lastKey = 0;
-		_headerKey = 0;
-		_btreeHeader = 0;
-		_btreeHeaderIterator = 0;
-		_keyComparer = 0;
-		_numberOfPages = 0;
-        _loadedPages = 0;
 
 		Object ^key = factoryKey->Key;
 		Type ^keyType = key->GetType();
@@ -115,6 +114,11 @@ namespace DBIndex
 				}
 			}
 		}
+		// keys of an unknown type are null, Open() throws for them
+		_index = new BTreeIndex( _keyType, pageGeometry );
+		_cursor = new BTreeCursor();
+		_firstKey = TypeFactory::NewKey( _keyType );
+		_lastKey = TypeFactory::NewKey( _keyType );
 	}
 
 	OmniaMeaBTree::~OmniaMeaBTree()
@@ -122,96 +126,47 @@ namespace DBIndex
 		Trace::Write( "OmeaBTree(" );
 		Trace::Write( System::IO::Path::GetFileName( _filename ) );
 		Trace::WriteLine( "): Disposing..." );
-		if( _page )
-		{
-			TypeFactory::DeletePage( _page );
-			_page = 0;
-		}
-		if( _freePage )
-		{
-			TypeFactory::DeletePage( _freePage );
-			_freePage = 0;
-		}
-		if( !_firstKey )
+		if( _firstKey )
 		{
 			TypeFactory::DeleteKey( _firstKey );
 			_firstKey = 0;
 		}
-		if( !_lastKey )
+		if( _lastKey )
 		{
 			TypeFactory::DeleteKey( _lastKey );
 			_lastKey = 0;
 		}
-		if( !_headerKey )
-		{
-			TypeFactory::DeleteKey( _headerKey );
-			_headerKey = 0;
-		}
-		if( !_btreeHeader )
-		{
-			TypeFactory::DeleteHeader( _btreeHeader );
-			_btreeHeader = 0;
-		}
-		if( !_btreeHeaderIterator )
+		if( _cursor )
 		{
-			TypeFactory::DeleteHeaderIterator( _btreeHeaderIterator );
-			_btreeHeaderIterator = 0;
+			delete _cursor;
+			_cursor = 0;
 		}
-		if( !_keyComparer )
+		if( _index )
 		{
-			TypeFactory::DeleteKeyComparer( _keyComparer );
-			_keyComparer = 0;
+			delete _index;
+			_index = 0;
 		}
-		BTreePagesCache::Delete( _pagesCache );
-		_pagesCache = 0;
 	}
 
 	bool OmniaMeaBTree::Open()
 	{
-		InstantiateTypes();
-
-		_btreeFile = gcnew FileStream( _filename, FileMode::OpenOrCreate, FileAccess::ReadWrite, FileShare::Read, 8 );
-		int fileHandle = _btreeFile->Handle.ToInt32();
-		_page->SetFileHandle( fileHandle );
-		if( _freePage )
+		if( _keyType == unknown_Key )
 		{
-			_freePage->SetFileHandle( fileHandle );
+			throw gcnew System::Exception( "Key type is not supported!" );
 		}
-		_keysInIndex = 0;
 
-		/**
-		 * check whether the btree was successfully closed, and load header if it was
-		 */
-        byte closed = ( _btreeFile->Length < HEADER_SIZE ) ? 0 : _btreeFile->ReadByte();
-		_btreeFile->Position = 0;
-		_btreeFile->WriteByte( 0 );
-		if( !closed )
+		_btreeFile = gcnew FileStream( _filename, FileMode::OpenOrCreate, FileAccess::ReadWrite, FileShare::Read, 8 );
+		int result = _index->Open( _btreeFile->Handle.ToInt32() );
+		if( result == badGeometry_Open )
 		{
-			for( int i = 1; i < HEADER_SIZE; ++i )
-			{
-				_btreeFile->WriteByte( 0 );
-			}
+			CloseFile();
+			throw gcnew BadIndexesException( "BTree file has unknown page geometry." );
 		}
-		else
+		if( result == badHeader_Open )
 		{
-			BinaryReader ^reader = gcnew BinaryReader( _btreeFile );
-			_keysInIndex = reader->ReadInt32();
-			int size = reader->ReadInt32();
-			_btreeFile->Position = size;
-			if( !_btreeHeader->Load( fileHandle ) )
-			{
-				throw gcnew System::IO::IOException( "Failed to load BTree header" );
-			}
-			else
-			{
-				_btreeFile->SetLength( size );
-				_numberOfPages = _btreeHeader->Size();
-			}
+			throw gcnew System::IO::IOException( "Failed to load BTree header" );
 		}
-
-		_btreeFile->Flush();
-
-		return closed != 0;
+		return result == closed_Open;
 	}
 
 	void OmniaMeaBTree::Close()
@@ -227,25 +182,13 @@ namespace DBIndex
 			_btreeFile = gcnew FileStream( _filename, FileMode::OpenOrCreate, FileAccess::ReadWrite, FileShare::None, 8 );
 			if( _btreeFile->CanRead && _btreeFile->CanWrite )
 			{
-				BinaryWriter ^writer = gcnew BinaryWriter( _btreeFile );
-				_btreeFile->WriteByte( 0 );
-				writer->Write( _keysInIndex );
-				writer->Write( (int) _btreeFile->Length );
-				_btreeFile->Position = _btreeFile->Length;
-				if( _btreeHeader->Save( _btreeFile->Handle.ToInt32() ) )
-				{
-					_btreeFile->Position = 0;
-					_btreeFile->WriteByte( 1 );
-				}
+				_index->SaveHeader( _btreeFile->Handle.ToInt32() );
 				CloseFile();
 			}
 		}
 		catch(...) {}
 
-		_btreeHeader->Clear();
-		_freeOffsets->Clear();
-		_keysInIndex = 0;
-		_numberOfPages = 0;
+		_index->Reset();
 	}
 
 	void OmniaMeaBTree::CloseFile()
@@ -258,99 +201,112 @@ namespace DBIndex
 
 	void OmniaMeaBTree::Clear()
 	{
-		// if btree is opened and was not disposed
-		if( _page )
-		{
-			_btreeHeader->Clear();
-			_freeOffsets->Clear();
-			_pagesCache->ClearWithoutSaving();
-			_keysInIndex = 0;
-			_btreeFile->SetLength( HEADER_SIZE );
-			_btreeFile->Position = 0;
-			for( int i = 0; i < HEADER_SIZE; ++i )
-			{
-				_btreeFile->WriteByte( 0 );
-			}
-			_numberOfPages = 0;
-		}
+		_index->Clear();
 	}
 
 	void OmniaMeaBTree::Flush()
 	{
-		// if btree was opened and not disposed
-		if( _page )
+		try
+		{
+			_index->Flush();
+		}
+		catch( const BTreeIndexError& error )
 		{
-			_pagesCache->Clear( *_btreeHeader );
+			throw GetManagedError( error );
 		}
 	}
 
 	void OmniaMeaBTree::GetAllKeys( IntArrayList ^offsets )
 	{
-		const BTreeKeyBase* temp_keys[ MAX_KEYS_IN_PAGE ];
-
-		_btreeHeader->GetMinimumPage( *_btreeHeaderIterator );
-		while( !_btreeHeaderIterator->Exhausted() )
+		try
 		{
-			BTreePageBase* page = GetPageByOffset( _btreeHeaderIterator->GetCurrentOffset() );
-			unsigned keyCount = page->GetAllKeys( temp_keys );
-			if( keyCount > MAX_KEYS_IN_PAGE )
+			_cursor->SeekAll( *_index, true );
+			while( _cursor->NextPage() )
 			{
-				throw gcnew BadIndexesException( "BTree contains cycles. Possible memory corruption." );
+				CopyOffsets( _cursor->GetKeys(), _cursor->GetCount(), offsets );
 			}
-			CopyOffsets( temp_keys, keyCount, offsets );
-			_btreeHeaderIterator->MoveNextPage();
+		}
+		catch( const BTreeIndexError& error )
+		{
+			throw GetManagedError( error );
 		}
 	}
 
     void OmniaMeaBTree::GetAllKeys( ArrayList ^keys_offsets )
 	{
-		const BTreeKeyBase* temp_keys[ MAX_KEYS_IN_PAGE ];
+		try
+		{
+			_cursor->SeekAll( *_index, true );
+			while( _cursor->NextPage() )
+			{
+				CopyKeys( _cursor->GetKeys(), _cursor->GetCount(), keys_offsets );
+			}
+		}
+		catch( const BTreeIndexError& error )
+		{
+			throw GetManagedError( error );
+		}
+	}
 
-		_btreeHeader->GetMinimumPage( *_btreeHeaderIterator );
-		while( !_btreeHeaderIterator->Exhausted() )
+	void OmniaMeaBTree::GetAllKeys( KeyColumns ^columns )
+	{
+		try
 		{
-			BTreePageBase* page = GetPageByOffset( _btreeHeaderIterator->GetCurrentOffset() );
-			unsigned keyCount = page->GetAllKeys( temp_keys );
-			if( keyCount > MAX_KEYS_IN_PAGE )
+			_cursor->SeekAll( *_index, true );
+			while( _cursor->NextPage() )
 			{
-				throw gcnew BadIndexesException( "BTree contains cycles. Possible memory corruption." );
+				CopyColumns( _cursor->GetKeys(), _cursor->GetCount(), columns );
 			}
-			CopyKeys( temp_keys, keyCount, keys_offsets );
-			_btreeHeaderIterator->MoveNextPage();
+		}
+		catch( const BTreeIndexError& error )
+		{
+			throw GetManagedError( error );
 		}
 	}
 
+	// enumerations are counted as lookups, but they aren't timed
 	IEnumerable ^OmniaMeaBTree::GetAllKeys()
 	{
+		_index->GetCounters().Add( lookups_Counter, 1 );
 		return gcnew GetAllKeysEnumerable( this );
 	}
 
 	KeyPair ^OmniaMeaBTree::GetMinimum()
 	{
-		_btreeHeader->GetMinimumPage( *_btreeHeaderIterator );
-		if( _btreeHeaderIterator->Exhausted() )
+		const BTreeKeyBase* oneKey[ 1 ];
+		try
+		{
+			oneKey[ 0 ] = _index->GetMinimum();
+		}
+		catch( const BTreeIndexError& error )
+		{
+			throw GetManagedError( error );
+		}
+		if( !oneKey[ 0 ] )
 		{
 			return nullptr;
 		}
 		_oneItemList->Clear();
-		BTreePageBase* page = GetPageByOffset( _btreeHeaderIterator->GetCurrentOffset() );
-		const BTreeKeyBase* oneKey[ 1 ];
-		oneKey[ 0 ] = &page->GetMinimum();
 		CopyKeys( oneKey, 1, _oneItemList );
 		return dynamic_cast<KeyPair^>(_oneItemList[0]);
 	}
 
 	KeyPair ^OmniaMeaBTree::GetMaximum()
 	{
-		_btreeHeader->GetMaximumPage( *_btreeHeaderIterator );
-		if( _btreeHeaderIterator->Exhausted() )
+		const BTreeKeyBase* oneKey[ 1 ];
+		try
+		{
+			oneKey[ 0 ] = _index->GetMaximum();
+		}
+		catch( const BTreeIndexError& error )
+		{
+			throw GetManagedError( error );
+		}
+		if( !oneKey[ 0 ] )
 		{
 			return nullptr;
 		}
 		_oneItemList->Clear();
-		BTreePageBase* page = GetPageByOffset( _btreeHeaderIterator->GetCurrentOffset() );
-		const BTreeKeyBase* oneKey[ 1 ];
-		oneKey[ 0 ] = &page->GetMaximum();
 		CopyKeys( oneKey, 1, _oneItemList );
 		return dynamic_cast<KeyPair^>(_oneItemList[0]);
 	}
@@ -358,166 +314,175 @@ namespace DBIndex
 	void OmniaMeaBTree::SearchForRange( IFixedLengthKey ^beginKey, IFixedLengthKey ^endKey, IntArrayList ^offsets )
 	{
 		SetFirstAndLastKeys( beginKey, endKey );
-
-		const BTreeKeyBase& firstKey = *_firstKey;
-		const BTreeKeyBase& lastKey = *_lastKey;
-
-		const BTreeKeyBase* temp_keys[ MAX_KEYS_IN_PAGE ];
-
-		_btreeHeader->GetPage( firstKey, *_btreeHeaderIterator );
-		while( !_btreeHeaderIterator->Exhausted() )
+		try
 		{
-			_btreeHeaderIterator->GetCurrentKey( *_headerKey );
-			if( _keyComparer->Less( lastKey, *_headerKey ) )
-			{
-				break;
-			}
-			BTreePageBase* page = GetPageByOffset( _btreeHeaderIterator->GetCurrentOffset() );
-			unsigned keyCount = page->SearchForRange( firstKey, lastKey, temp_keys );
-			if( keyCount > MAX_KEYS_IN_PAGE )
+			_cursor->SeekRange( *_index, *_firstKey, *_lastKey, true );
+			while( _cursor->NextPage() )
 			{
-				throw gcnew BadIndexesException( "BTree contains cycles. Possible memory corruption." );
+				CopyOffsets( _cursor->GetKeys(), _cursor->GetCount(), offsets );
 			}
-			CopyOffsets( temp_keys, keyCount, offsets );
-			_btreeHeaderIterator->MoveNextPage();
+		}
+		catch( const BTreeIndexError& error )
+		{
+			throw GetManagedError( error );
 		}
 	}
 
 	void OmniaMeaBTree::SearchForRange( IFixedLengthKey ^beginKey, IFixedLengthKey ^endKey, ArrayList ^keys_offsets )
 	{
 		SetFirstAndLastKeys( beginKey, endKey );
-
-		const BTreeKeyBase& firstKey = *_firstKey;
-		const BTreeKeyBase& lastKey = *_lastKey;
-
-		const BTreeKeyBase* temp_keys[ MAX_KEYS_IN_PAGE ];
-
-		_btreeHeader->GetPage( firstKey, *_btreeHeaderIterator );
-		while( !_btreeHeaderIterator->Exhausted() )
+		try
 		{
-			_btreeHeaderIterator->GetCurrentKey( *_headerKey );
-			if( _keyComparer->Less( lastKey, *_headerKey ) )
+			_cursor->SeekRange( *_index, *_firstKey, *_lastKey, true );
+			while( _cursor->NextPage() )
 			{
-				break;
+				CopyKeys( _cursor->GetKeys(), _cursor->GetCount(), keys_offsets );
 			}
-			BTreePageBase* page = GetPageByOffset( _btreeHeaderIterator->GetCurrentOffset() );
-			unsigned keyCount = page->SearchForRange( firstKey, lastKey, temp_keys );
-			if( keyCount > MAX_KEYS_IN_PAGE )
+		}
+		catch( const BTreeIndexError& error )
+		{
+			throw GetManagedError( error );
+		}
+	}
+
+	void OmniaMeaBTree::SearchForRange( IFixedLengthKey ^beginKey, IFixedLengthKey ^endKey, KeyColumns ^columns )
+	{
+		SetFirstAndLastKeys( beginKey, endKey );
+		try
+		{
+			_cursor->SeekRange( *_index, *_firstKey, *_lastKey, true );
+			while( _cursor->NextPage() )
 			{
-				throw gcnew BadIndexesException( "BTree contains cycles. Possible memory corruption." );
+				CopyColumns( _cursor->GetKeys(), _cursor->GetCount(), columns );
 			}
-			CopyKeys( temp_keys, keyCount, keys_offsets );
-			_btreeHeaderIterator->MoveNextPage();
+		}
+		catch( const BTreeIndexError& error )
+		{
+			throw GetManagedError( error );
 		}
 	}
 
 	IEnumerable ^OmniaMeaBTree::SearchForRange( IFixedLengthKey ^beginKey, IFixedLengthKey ^endKey )
 	{
+		_index->GetCounters().Add( lookups_Counter, 1 );
 		dynamic_cast<SearchForRangeEnumerable^>( _searchForRangeEnumerable )->Init( beginKey, endKey );
 		return _searchForRangeEnumerable;
 	}
 
+	int OmniaMeaBTree::CountRange( IFixedLengthKey ^beginKey, IFixedLengthKey ^endKey )
+	{
+		SetFirstAndLastKeys( beginKey, endKey );
+		try
+		{
+			return _index->CountRange( *_firstKey, *_lastKey );
+		}
+		catch( const BTreeIndexError& error )
+		{
+			throw GetManagedError( error );
+		}
+	}
+
     void OmniaMeaBTree::DeleteKey( IFixedLengthKey^ akey, int offset )
 	{
-		SetFirstKey( akey );
+		SetNativeKey( akey, _firstKey );
 		_firstKey->SetOffset( offset );
+		try
+		{
+			_index->Delete( *_firstKey );
+		}
+		catch( const BTreeIndexError& error )
+		{
+			throw GetManagedError( error );
+		}
+	}
 
-		const BTreeKeyBase& firstKey = *_firstKey;
-		_btreeHeader->GetPage( firstKey, *_btreeHeaderIterator );
+	bool OmniaMeaBTree::ContainsKey( IFixedLengthKey ^akey, int offset )
+	{
+		SetNativeKey( akey, _firstKey );
+		_firstKey->SetOffset( offset );
+		try
+		{
+			return _index->Contains( *_firstKey, *_firstKey );
+		}
+		catch( const BTreeIndexError& error )
+		{
+			throw GetManagedError( error );
+		}
+	}
 
-		if( !_btreeHeaderIterator->Exhausted() )
+	bool OmniaMeaBTree::ContainsKey( IFixedLengthKey ^akey )
+	{
+		SetFirstAndLastKeys( akey, akey );
+		try
 		{
-			BTreePageBase* page = GetPageByOffset( _btreeHeaderIterator->GetCurrentOffset() );
-			if( page->Delete( firstKey ) )
-			{
-				--_keysInIndex;
-				_btreeHeaderIterator->GetCurrentKey( *_headerKey );
-				offset = page->GetOffset();
-				if( page->GetCount() == 0 )
-				{
-					_freeOffsets->Add( offset );
-					_pagesCache->RemovePage( offset );
-					_btreeHeader->DeletePageOffset( *_headerKey );
-					--_numberOfPages;
-				}
-				else
-				{
-					const BTreeKeyBase& minKey = page->GetMinimum();
-					if( _keyComparer->Less( firstKey, minKey ) )
-					{
-						_btreeHeader->DeletePageOffset( firstKey );
-						_btreeHeader->SetPageOffset( minKey, offset );
-					}
-				}
-			}
+			return _index->Contains( *_firstKey, *_lastKey );
+		}
+		catch( const BTreeIndexError& error )
+		{
+			throw GetManagedError( error );
 		}
 	}
 
+	void OmniaMeaBTree::SetPageFilters( bool enabled )
+	{
+		_index->SetPageFilters( enabled );
+	}
+
     void OmniaMeaBTree::InsertKey( IFixedLengthKey ^akey, int offset )
 	{
-		SetFirstKey( akey );
+		SetNativeKey( akey, _firstKey );
 		_firstKey->SetOffset( offset );
-		++_keysInIndex;
-
-		const BTreeKeyBase& firstKey = *_firstKey;
+		try
+		{
+			_index->Insert( *_firstKey );
+		}
+		catch( const BTreeIndexError& error )
+		{
+			throw GetManagedError( error );
+		}
+	}
 
-		BTreePageBase* page;
-		_btreeHeader->GetPage( firstKey, *_btreeHeaderIterator );
+	void OmniaMeaBTree::DeleteKeys( ArrayList ^keys_offsets )
+	{
+		ArrayList ^batch = SortBatch( keys_offsets );
+		BTreeKeyBase** keys = NewBatchKeys( batch );
+		try
+		{
+			_index->DeleteBatch( keys, batch->Count );
+		}
+		catch( const BTreeIndexError& error )
+		{
+			throw GetManagedError( error );
+		}
+		finally
+		{
+			DeleteBatchKeys( keys, batch->Count );
+		}
+	}
 
-		if( _btreeHeaderIterator->Exhausted() )
+	void OmniaMeaBTree::InsertKeys( ArrayList ^keys_offsets )
+	{
+		ArrayList ^batch = SortBatch( keys_offsets );
+		BTreeKeyBase** keys = NewBatchKeys( batch );
+		try
 		{
-			page = AllocPage();
-			page->Insert( firstKey );
-			_btreeHeader->SetPageOffset( firstKey, page->GetOffset() );
+			_index->InsertBatch( keys, batch->Count );
 		}
-		else
+		catch( const BTreeIndexError& error )
 		{
-			page = GetPageByOffset( _btreeHeaderIterator->GetCurrentOffset() );
-			if( !page->IsFull() )
-			{
-				if( page->IsAlmostFull() )
-				{
-					if( _keyComparer->Less( page->GetMaximum(), firstKey ) ||
-						_keyComparer->Less( firstKey, page->GetMinimum() ) )
-					{
-						BTreePageBase* newPage = AllocPage();
-						newPage->Insert( firstKey );
-						_btreeHeader->SetPageOffset( firstKey, newPage->GetOffset() );
-						return;
-					}
-				}
-				page->Insert( firstKey );
-			}
-			else
-			{
-				BTreePageBase* rightPage = AllocPage();
-				page->Split( *rightPage );
-				const BTreeKeyBase& minKey = rightPage->GetMinimum();
-				_btreeHeader->SetPageOffset( minKey, rightPage->GetOffset() );
-				if( _keyComparer->Less( firstKey, minKey ) )
-				{
-					page->Insert( firstKey );
-				}
-				else
-				{
-					rightPage->Insert( firstKey );
-					return;
-				}
-			}
-			_btreeHeaderIterator->GetCurrentKey( *_headerKey );
-			if( _keyComparer->Less( firstKey, *_headerKey ) )
-			{
-				_btreeHeader->DeletePageOffset( *_headerKey );
-				_btreeHeader->SetPageOffset( firstKey, page->GetOffset() );
-			}
+			throw GetManagedError( error );
+		}
+		finally
+		{
+			DeleteBatchKeys( keys, batch->Count );
 		}
 	}
 
-    int OmniaMeaBTree::MaxCount::get() { return MAX_KEYS_IN_PAGE; }
+    int OmniaMeaBTree::MaxCount::get() { return _index->GetPageCapacity(); }
 
     int OmniaMeaBTree::Count::get()
 	{
-		return _keysInIndex;
+		return _index->GetCount();
 	}
 
 	void OmniaMeaBTree::SetCacheSize( int numberOfPages )
@@ -526,12 +491,12 @@ namespace DBIndex
 		{
 			numberOfPages = 2;
 		}
-		_pagesCache->SetSize( (unsigned) numberOfPages );
+		_index->GetPagesCache().SetSize( (unsigned) numberOfPages );
 	}
 
     int OmniaMeaBTree::GetCacheSize()
 	{
-		return _pagesCache->GetSize();
+		return _index->GetPagesCache().GetSize();
 	}
 
 	int OmniaMeaBTree::GetObjectsCount()
@@ -544,55 +509,44 @@ namespace DBIndex
 		return DBIndexHeapObject::HeapSize();
 	}
 
-	///////////////////////////////////////////////////////////////////////////
-	// implementation details (private members)
-	///////////////////////////////////////////////////////////////////////////
+	void OmniaMeaBTree::SetSharedCacheMemory( __int64 bytes )
+	{
+		BTreePagesCache::SetPoolBudget( ( bytes > 0 ) ? (unsigned __int64) bytes : 0 );
+	}
 
-	void OmniaMeaBTree::InstantiateTypes()
+	__int64 OmniaMeaBTree::GetSharedCacheMemory()
 	{
-		int type = _keyType;
-		if( type == unknown_Key )
-		{
-			throw gcnew System::Exception( "Key type is not supported!" );
-		}
-		if( !_page )
-		{
-			_page = TypeFactory::NewPage( type );
-		}
-		if( !_firstKey )
-		{
-			_firstKey = TypeFactory::NewKey( type );
-		}
-		if( !_lastKey )
-		{
-			_lastKey = TypeFactory::NewKey( type );
-		}
-		if( !_headerKey )
-		{
-			_headerKey = TypeFactory::NewKey( type );
-		}
-		if( !_btreeHeader )
-		{
-			_btreeHeader = TypeFactory::NewHeader( type );
-		}
-		if( !_btreeHeaderIterator )
-		{
-			_btreeHeaderIterator = TypeFactory::NewHeaderIterator( type );
-		}
-		if( !_keyComparer )
-		{
-			_keyComparer = TypeFactory::NewKeyComparer( type );
-		}
+		return (__int64) BTreePagesCache::GetPoolBudget();
+	}
+
+	__int64 OmniaMeaBTree::GetCachedMemory()
+	{
+		return (__int64) BTreePagesCache::GetPoolUsage();
+	}
+
+	void OmniaMeaBTree::SetReadAheadPages( int pages )
+	{
+		BTreePagesCache::SetReadAheadPages( ( pages > 0 ) ? (unsigned) pages : 0 );
 	}
 
-	void OmniaMeaBTree::SetFirstKey( IFixedLengthKey ^akey )
+	int OmniaMeaBTree::GetReadAheadPages()
+	{
+		return (int) BTreePagesCache::GetReadAheadPages();
+	}
+
+
+	///////////////////////////////////////////////////////////////////////////
+	// implementation details (private members)
+	///////////////////////////////////////////////////////////////////////////
+
+	void OmniaMeaBTree::SetNativeKey( IFixedLengthKey ^akey, BTreeKeyBase* key )
 	{
 		switch( _keyType )
 		{
 			case int_Key:
 			{
 				int theKey = *dynamic_cast<Int32^>( akey->Key );
-				static_cast< BTreeKey<int>* >( _firstKey )->SetKey( theKey );
+				static_cast< BTreeKey<int>* >( key )->SetKey( theKey );
 				break;
 			}
 			case int_int_Key:
@@ -601,7 +555,7 @@ namespace DBIndex
 				CompoundKey<int,int> theKey;
 				theKey._first = *dynamic_cast<Int32^>( compound->_key1 );
 				theKey._second = *dynamic_cast<Int32^>( compound->_key2 );
-				static_cast< BTreeKey< CompoundKey<int,int> >* >( _firstKey )->SetKey( theKey );
+				static_cast< BTreeKey< CompoundKey<int,int> >* >( key )->SetKey( theKey );
 				break;
 			}
 			case int_datetime_Key:
@@ -610,7 +564,7 @@ namespace DBIndex
 				CompoundKey<int,long> theKey;
 				theKey._first = *dynamic_cast<Int32^>( compound->_key1 );
 				theKey._second = dynamic_cast<DateTime^>( compound->_key2 )->Ticks;
-				static_cast< BTreeKey< CompoundKey<int,long> >* >( _firstKey )->SetKey( theKey );
+				static_cast< BTreeKey< CompoundKey<int,long> >* >( key )->SetKey( theKey );
 				break;
 			}
 			case int_int_int_Key:
@@ -621,7 +575,7 @@ namespace DBIndex
 				theKey._second = *dynamic_cast<Int32^>( compound->_key2 );
 				int value = *dynamic_cast<Int32^>( compound->_value );
 				theKey.SetValue( value );
-				static_cast< BTreeKey< CompoundKeyWithValue<int,int,int> >* >( _firstKey )->SetKey( theKey );
+				static_cast< BTreeKey< CompoundKeyWithValue<int,int,int> >* >( key )->SetKey( theKey );
 				break;
 			}
 			case int_int_datetime_Key:
@@ -632,7 +586,7 @@ namespace DBIndex
 				theKey._second = *dynamic_cast<Int32^>( compound->_key2 );
 				long value = dynamic_cast<DateTime^>( compound->_value )->Ticks;
 				theKey.SetValue( value );
-				static_cast< BTreeKey< CompoundKeyWithValue<int,int,long> >* >( _firstKey )->SetKey( theKey );
+				static_cast< BTreeKey< CompoundKeyWithValue<int,int,long> >* >( key )->SetKey( theKey );
 				break;
 			}
 			case int_datetime_int_Key:
@@ -643,25 +597,25 @@ namespace DBIndex
 				theKey._second = dynamic_cast<DateTime^>( compound->_key2 )->Ticks;
 				int value = *dynamic_cast<Int32^>( compound->_value );
 				theKey.SetValue( value );
-				static_cast< BTreeKey< CompoundKeyWithValue<int,long,int> >* >( _firstKey )->SetKey( theKey );
+				static_cast< BTreeKey< CompoundKeyWithValue<int,long,int> >* >( key )->SetKey( theKey );
 				break;
 			}
 			case long_Key:
 			{
 				long theKey = *dynamic_cast<Int64^>( akey->Key );
-				static_cast< BTreeKey<long>* >( _firstKey )->SetKey( theKey );
+				static_cast< BTreeKey<long>* >( key )->SetKey( theKey );
 				break;
 			}
 			case datetime_Key:
 			{
 				long theKey = dynamic_cast<DateTime^>( akey->Key )->Ticks;
-				static_cast< BTreeKey<long>* >( _firstKey )->SetKey( theKey );
+				static_cast< BTreeKey<long>* >( key )->SetKey( theKey );
 				break;
 			}
 			case double_Key:
 			{
 				double theKey = *dynamic_cast<Double^>( akey->Key );
-				static_cast< BTreeKey<double>* >( _firstKey )->SetKey( theKey );
+				static_cast< BTreeKey<double>* >( key )->SetKey( theKey );
 				break;
 			}
 			default: throw gcnew System::Exception( "Key type is not supported!" );
@@ -670,185 +624,82 @@ namespace DBIndex
 
 	void OmniaMeaBTree::SetFirstAndLastKeys( IFixedLengthKey ^beginKey, IFixedLengthKey ^endKey )
 	{
-		switch( _keyType )
-		{
-			case int_Key:
-			{
-				int firstKey = *dynamic_cast<Int32^>( beginKey->Key );
-				int lastKey = *dynamic_cast<Int32^>( endKey->Key );
-				static_cast< BTreeKey<int>* >( _firstKey )->SetKey( firstKey );
-				static_cast< BTreeKey<int>* >( _lastKey )->SetKey( lastKey );
-				break;
-			}
-			case int_int_Key:
-			{
-				Compound ^compound1 = dynamic_cast<Compound^>( beginKey->Key );
-				Compound ^compound2 = dynamic_cast<Compound^>( endKey->Key );
-				CompoundKey<int,int> firstKey;
-				CompoundKey<int,int> lastKey;
-				firstKey._first = *dynamic_cast<Int32^>( compound1->_key1 );
-				firstKey._second = *dynamic_cast<Int32^>( compound1->_key2 );
-				lastKey._first = *dynamic_cast<Int32^>( compound2->_key1 );
-				lastKey._second = *dynamic_cast<Int32^>( compound2->_key2 );
-				static_cast< BTreeKey< CompoundKey<int,int> >* >( _firstKey )->SetKey( firstKey );
-				static_cast< BTreeKey< CompoundKey<int,int> >* >( _lastKey )->SetKey( lastKey );
-				break;
-			}
-			case int_datetime_Key:
-			{
-				Compound ^compound1 = dynamic_cast<Compound^>( beginKey->Key );
-				Compound ^compound2 = dynamic_cast<Compound^>( endKey->Key );
-				CompoundKey<int,long> firstKey;
-				CompoundKey<int,long> lastKey;
-				firstKey._first = *dynamic_cast<Int32^>( compound1->_key1 );
-				firstKey._second = dynamic_cast<DateTime^>( compound1->_key2 )->Ticks;
-				lastKey._first = *dynamic_cast<Int32^>( compound2->_key1 );
-				lastKey._second = dynamic_cast<DateTime^>( compound2->_key2 )->Ticks;
-				static_cast< BTreeKey< CompoundKey<int,long> >* >( _firstKey )->SetKey( firstKey );
-				static_cast< BTreeKey< CompoundKey<int,long> >* >( _lastKey )->SetKey( lastKey );
-				break;
-			}
-			case int_int_int_Key:
-			{
-				CompoundAndValue ^compound1 = dynamic_cast<CompoundAndValue^>( beginKey->Key );
-				CompoundAndValue ^compound2 = dynamic_cast<CompoundAndValue^>( endKey->Key );
-				CompoundKeyWithValue<int,int,int> firstKey;
-				CompoundKeyWithValue<int,int,int> lastKey;
-				firstKey._first = *dynamic_cast<Int32^>( compound1->_key1 );
-				firstKey._second = *dynamic_cast<Int32^>( compound1->_key2 );
-				int value = *dynamic_cast<Int32^>( compound1->_value );
-				firstKey.SetValue( value );
-				lastKey._first = *dynamic_cast<Int32^>( compound2->_key1 );
-				lastKey._second = *dynamic_cast<Int32^>( compound2->_key2 );
-				value = *dynamic_cast<Int32^>( compound2->_value );
-				lastKey.SetValue( value );
-				static_cast< BTreeKey< CompoundKeyWithValue<int,int,int> >* >( _firstKey )->SetKey( firstKey );
-				static_cast< BTreeKey< CompoundKeyWithValue<int,int,int> >* >( _lastKey )->SetKey( lastKey );
-				break;
-			}
-			case int_int_datetime_Key:
-			{
-				CompoundAndValue ^compound1 = dynamic_cast<CompoundAndValue^>( beginKey->Key );
-				CompoundAndValue ^compound2 = dynamic_cast<CompoundAndValue^>( endKey->Key );
-				CompoundKeyWithValue<int,int,long> firstKey;
-				CompoundKeyWithValue<int,int,long> lastKey;
-				firstKey._first = *dynamic_cast<Int32^>( compound1->_key1 );
-				firstKey._second = *dynamic_cast<Int32^>( compound1->_key2 );
-				long value = dynamic_cast<DateTime^>( compound1->_value )->Ticks;
-				firstKey.SetValue( value );
-				lastKey._first = *dynamic_cast<Int32^>( compound2->_key1 );
-				lastKey._second = *dynamic_cast<Int32^>( compound2->_key2 );
-				value = dynamic_cast<DateTime^>( compound2->_value )->Ticks;
-				lastKey.SetValue( value );
-				static_cast< BTreeKey< CompoundKeyWithValue<int,int,long> >* >( _firstKey )->SetKey( firstKey );
-				static_cast< BTreeKey< CompoundKeyWithValue<int,int,long> >* >( _lastKey )->SetKey( lastKey );
-				break;
-			}
-			case int_datetime_int_Key:
-			{
-				CompoundAndValue ^compound1 = dynamic_cast<CompoundAndValue^>( beginKey->Key );
-				CompoundAndValue ^compound2 = dynamic_cast<CompoundAndValue^>( endKey->Key );
-				CompoundKeyWithValue<int,long,int> firstKey;
-				CompoundKeyWithValue<int,long,int> lastKey;
-				firstKey._first = *dynamic_cast<Int32^>( compound1->_key1 );
-				firstKey._second = dynamic_cast<DateTime^>( compound1->_key2 )->Ticks;
-				int value = *dynamic_cast<Int32^>( compound1->_value );
-				firstKey.SetValue( value );
-				lastKey._first = *dynamic_cast<Int32^>( compound2->_key1 );
-				lastKey._second = dynamic_cast<DateTime^>( compound2->_key2 )->Ticks;
-				value = *dynamic_cast<Int32^>( compound2->_value );
-				lastKey.SetValue( value );
-				static_cast< BTreeKey< CompoundKeyWithValue<int,long,int> >* >( _firstKey )->SetKey( firstKey );
-				static_cast< BTreeKey< CompoundKeyWithValue<int,long,int> >* >( _lastKey )->SetKey( lastKey );
-				break;
-			}
-			case long_Key:
-			{
-				long firstKey = *dynamic_cast<Int64^>( beginKey->Key );
-				long lastKey = *dynamic_cast<Int64^>( endKey->Key );
-				static_cast< BTreeKey<long>* >( _firstKey )->SetKey( firstKey );
-				static_cast< BTreeKey<long>* >( _lastKey )->SetKey( lastKey );
-				break;
-			}
-			case datetime_Key:
-			{
-				long firstKey = dynamic_cast<DateTime^>( beginKey->Key )->Ticks;
-				long lastKey = dynamic_cast<DateTime^>( endKey->Key )->Ticks;
-				static_cast< BTreeKey<long>* >( _firstKey )->SetKey( firstKey );
-				static_cast< BTreeKey<long>* >( _lastKey )->SetKey( lastKey );
-				break;
-			}
-			case double_Key:
-			{
-				double firstKey = *dynamic_cast<Double^>( beginKey->Key );
-				double lastKey = *dynamic_cast<Double^>( endKey->Key );
-				static_cast< BTreeKey<double>* >( _firstKey )->SetKey( firstKey );
-				static_cast< BTreeKey<double>* >( _lastKey )->SetKey( lastKey );
-				break;
-			}
-			default: throw gcnew System::Exception( "Key type is not supported!" );
-		}
+		SetNativeKey( beginKey, _firstKey );
+		SetNativeKey( endKey, _lastKey );
 		_firstKey->SetOffset( 0 );
 		_lastKey->SetOffset( MAX_OFFSET );
 	}
 
-	BTreePageBase* OmniaMeaBTree::GetPageByOffset( int offset )
+	private ref class KeyPairComparer : public IComparer
 	{
-		BTreePageBase* page = _pagesCache->TryOffset( offset );
-		if( page == 0 )
+	public:
+
+		virtual int Compare( Object ^x, Object ^y )
 		{
-			page = PrepareNewPage( offset );
-			LoadPage( page );
+			KeyPair ^left = dynamic_cast<KeyPair^>( x );
+			KeyPair ^right = dynamic_cast<KeyPair^>( y );
+			int result = left->_key->CompareTo( right->_key );
+			if( result == 0 )
+			{
+				result = left->_offset.CompareTo( right->_offset );
+			}
+			return result;
 		}
-		return page;
-	}
 
-	BTreePageBase* OmniaMeaBTree::AllocPage()
-	{
-		++_numberOfPages;
+		static KeyPairComparer ^_instance = gcnew KeyPairComparer();
+	};
 
-		int newOffset;
-		BTreePageBase* page;
-		int freeOffsetsCount = _freeOffsets->Count;
+	ArrayList ^OmniaMeaBTree::SortBatch( ArrayList ^keys_offsets )
+	{
+		ArrayList ^batch = gcnew ArrayList( keys_offsets );
+		batch->Sort( KeyPairComparer::_instance );
+		return batch;
+	}
 
-		if( freeOffsetsCount == 0 )
+	// native keys of a sorted batch are deleted by DeleteBatchKeys()
+	BTreeKeyBase** OmniaMeaBTree::NewBatchKeys( ArrayList ^batch )
+	{
+		int count = batch->Count;
+		BTreeKeyBase** keys = (BTreeKeyBase**) DBIndexHeapObject::operator new( ( count + 1 ) * sizeof( BTreeKeyBase* ) );
+		for( int i = 0; i < count; ++i )
+		{
+			keys[ i ] = TypeFactory::NewKey( _keyType );
+		}
+		try
 		{
-			newOffset = (int) _btreeFile->Length;
-			page = PrepareNewPage( newOffset );
-			page->Clear();
-			SavePage( page );
+			for( int i = 0; i < count; ++i )
+			{
+				KeyPair ^pair = dynamic_cast<KeyPair^>( batch[ i ] );
+				SetNativeKey( pair->_key, keys[ i ] );
+				keys[ i ]->SetOffset( pair->_offset );
+			}
 		}
-		else
+		catch( Exception^ )
 		{
-			newOffset = _freeOffsets[freeOffsetsCount - 1];
-			_freeOffsets->RemoveAt( freeOffsetsCount - 1 );
-			page = PrepareNewPage( newOffset );
-			page->Clear();
+			DeleteBatchKeys( keys, count );
+			throw;
 		}
-		return page;
+		return keys;
 	}
 
-	BTreePageBase* OmniaMeaBTree::PrepareNewPage( int offset )
+	void OmniaMeaBTree::DeleteBatchKeys( BTreeKeyBase** keys, int count )
 	{
-		BTreePageBase* page = _freePage;
-		if( !page )
+		for( int i = 0; i < count; ++i )
 		{
-			page = _page->Clone();
+			TypeFactory::DeleteKey( keys[ i ] );
 		}
-		page->SetOffset( offset );
-		_freePage = _pagesCache->CachePage( page );
-		return page;
+		DBIndexHeapObject::operator delete( keys );
 	}
 
-	void OmniaMeaBTree::CopyOffsets( const BTreeKeyBase** temp_keys, unsigned count, IntArrayList ^offsets )
+	void OmniaMeaBTree::CopyOffsets( const BTreeKeyBase* const* temp_keys, int count, IntArrayList ^offsets )
 	{
-		for( unsigned i = 0; i < count; ++i )
+		for( int i = 0; i < count; ++i )
 		{
 			offsets->Add( temp_keys[ i ]->GetOffset() );
 		}
 	}
 
-	static void CopyLongKeys( const BTreeKeyBase** temp_keys, int count, ArrayList ^keys_offsets, IFixedLengthKey ^factoryKey )
+	static void CopyLongKeys( const BTreeKeyBase* const* temp_keys, int count, ArrayList ^keys_offsets, IFixedLengthKey ^factoryKey )
 	{
 		for( int i = 0; i < count; ++i )
 		{
@@ -863,7 +714,7 @@ namespace DBIndex
 		}
 	}
 
-	static void CopyIntKeys( const BTreeKeyBase** temp_keys, int count, ArrayList ^keys_offsets, IFixedLengthKey ^factoryKey )
+	static void CopyIntKeys( const BTreeKeyBase* const* temp_keys, int count, ArrayList ^keys_offsets, IFixedLengthKey ^factoryKey )
 	{
 		for( int i = 0; i < count; ++i )
 		{
@@ -878,7 +729,7 @@ namespace DBIndex
 		}
 	}
 
-	static void CopyIntIntIntKeys( const BTreeKeyBase** temp_keys, int count, ArrayList ^keys_offsets, IFixedLengthKey ^factoryKey )
+	static void CopyIntIntIntKeys( const BTreeKeyBase* const* temp_keys, int count, ArrayList ^keys_offsets, IFixedLengthKey ^factoryKey )
 	{
 		for( int i = 0; i < count; ++i )
 		{
@@ -900,7 +751,7 @@ namespace DBIndex
 		}
 	}
 
-	static void CopyIntIntDateTimeKeys( const BTreeKeyBase** temp_keys, int count, ArrayList ^keys_offsets, IFixedLengthKey ^factoryKey )
+	static void CopyIntIntDateTimeKeys( const BTreeKeyBase* const* temp_keys, int count, ArrayList ^keys_offsets, IFixedLengthKey ^factoryKey )
 	{
 		for( int i = 0; i < count; ++i )
 		{
@@ -922,7 +773,7 @@ namespace DBIndex
 		}
 	}
 
-	static void CopyIntDateTimeIntKeys( const BTreeKeyBase** temp_keys, int count, ArrayList ^keys_offsets, IFixedLengthKey ^factoryKey )
+	static void CopyIntDateTimeIntKeys( const BTreeKeyBase* const* temp_keys, int count, ArrayList ^keys_offsets, IFixedLengthKey ^factoryKey )
 	{
 		for( int i = 0; i < count; ++i )
 		{
@@ -944,7 +795,7 @@ namespace DBIndex
 		}
 	}
 
-	void OmniaMeaBTree::CopyKeys( const BTreeKeyBase** temp_keys, int count, ArrayList ^keys_offsets )
+	void OmniaMeaBTree::CopyKeys( const BTreeKeyBase* const* temp_keys, int count, ArrayList ^keys_offsets )
 	{
 		switch( _keyType )
 		{
@@ -976,54 +827,179 @@ namespace DBIndex
 		}
 	}
 
-	void OmniaMeaBTree::LoadPage( BTreePageBase* page )
+	///////////////////////////////////////////////////////////////////////////
+	// copying keys to columns, parts of keys are copied column by column
+	///////////////////////////////////////////////////////////////////////////
+
+	template< class Key, class Part > static void CopyKeyColumn(
+		const BTreeKeyBase* const* temp_keys, int count, array< Part > ^column, int start )
+	{
+		for( int i = 0; i < count; ++i )
+		{
+			column[ start + i ] = static_cast< const BTreeKey< Key >* >( temp_keys[ i ] )->GetKey();
+		}
+	}
+
+	template< class Key, class Part > static void CopyFirstColumn(
+		const BTreeKeyBase* const* temp_keys, int count, array< Part > ^column, int start )
+	{
+		for( int i = 0; i < count; ++i )
+		{
+			column[ start + i ] = static_cast< const BTreeKey< Key >* >( temp_keys[ i ] )->GetKey()._first;
+		}
+	}
+
+	template< class Key, class Part > static void CopySecondColumn(
+		const BTreeKeyBase* const* temp_keys, int count, array< Part > ^column, int start )
 	{
-		int pageHandle = page->GetFileHandle();
-		int fileHandle = _btreeFile->Handle.ToInt32();
-		if( pageHandle != fileHandle )
+		for( int i = 0; i < count; ++i )
 		{
-			char s[ 100 ];
-			sprintf( s, "Page handle(%d) is not equal to btree file handle(%d).", pageHandle, fileHandle );
-			throw gcnew System::IO::IOException(gcnew String(s));
+			column[ start + i ] = static_cast< const BTreeKey< Key >* >( temp_keys[ i ] )->GetKey()._second;
 		}
-		int loadedBytes = page->Load();
-		int pageSize = page->GetSize();
-		if( loadedBytes != pageSize )
+	}
+
+	template< class Key, class Part > static void CopyValueColumn(
+		const BTreeKeyBase* const* temp_keys, int count, array< Part > ^column, int start )
+	{
+		for( int i = 0; i < count; ++i )
 		{
-			char s[ 200 ];
-			sprintf( s, "BTreePageBase.Load() returned %d, pageSize = %d, last error = %d.", loadedBytes, pageSize, ::GetLastError() );
-			throw gcnew System::IO::IOException(gcnew String(s));
+			column[ start + i ] = static_cast< const BTreeKey< Key >* >( temp_keys[ i ] )->GetKey().GetValue();
 		}
-        _loadedPages++;
 	}
 
-	void OmniaMeaBTree::SavePage( BTreePageBase* page )
+	void OmniaMeaBTree::CopyColumns( const BTreeKeyBase* const* temp_keys, int count, KeyColumns ^columns )
 	{
-		int pageHandle = page->GetFileHandle();
-		int fileHandle = _btreeFile->Handle.ToInt32();
-		if( pageHandle != fileHandle )
+		if( count == 0 )
+		{
+			return;
+		}
+		int start;
+		switch( _keyType )
+		{
+			case int_Key:
+			{
+				start = columns->Append( count, KeyPartType::Int, KeyPartType::None, KeyPartType::None );
+				CopyKeyColumn< int >( temp_keys, count, columns->FirstInts, start );
+				break;
+			}
+			case long_Key:
+			case datetime_Key:
+			{
+				start = columns->Append( count, KeyPartType::Long, KeyPartType::None, KeyPartType::None );
+				CopyKeyColumn< long >( temp_keys, count, columns->FirstLongs, start );
+				break;
+			}
+			case double_Key:
+			{
+				start = columns->Append( count, KeyPartType::Double, KeyPartType::None, KeyPartType::None );
+				CopyKeyColumn< double >( temp_keys, count, columns->FirstDoubles, start );
+				break;
+			}
+			case int_int_Key:
+			{
+				start = columns->Append( count, KeyPartType::Int, KeyPartType::Int, KeyPartType::None );
+				CopyFirstColumn< CompoundKey<int,int> >( temp_keys, count, columns->FirstInts, start );
+				CopySecondColumn< CompoundKey<int,int> >( temp_keys, count, columns->SecondInts, start );
+				break;
+			}
+			case int_datetime_Key:
+			{
+				start = columns->Append( count, KeyPartType::Int, KeyPartType::Long, KeyPartType::None );
+				CopyFirstColumn< CompoundKey<int,long> >( temp_keys, count, columns->FirstInts, start );
+				CopySecondColumn< CompoundKey<int,long> >( temp_keys, count, columns->SecondLongs, start );
+				break;
+			}
+			case int_int_int_Key:
+			{
+				start = columns->Append( count, KeyPartType::Int, KeyPartType::Int, KeyPartType::Int );
+				CopyFirstColumn< CompoundKeyWithValue<int,int,int> >( temp_keys, count, columns->FirstInts, start );
+				CopySecondColumn< CompoundKeyWithValue<int,int,int> >( temp_keys, count, columns->SecondInts, start );
+				CopyValueColumn< CompoundKeyWithValue<int,int,int> >( temp_keys, count, columns->ValueInts, start );
+				break;
+			}
+			case int_int_datetime_Key:
+			{
+				start = columns->Append( count, KeyPartType::Int, KeyPartType::Int, KeyPartType::Long );
+				CopyFirstColumn< CompoundKeyWithValue<int,int,long> >( temp_keys, count, columns->FirstInts, start );
+				CopySecondColumn< CompoundKeyWithValue<int,int,long> >( temp_keys, count, columns->SecondInts, start );
+				CopyValueColumn< CompoundKeyWithValue<int,int,long> >( temp_keys, count, columns->ValueLongs, start );
+				break;
+			}
+			case int_datetime_int_Key:
+			{
+				start = columns->Append( count, KeyPartType::Int, KeyPartType::Long, KeyPartType::Int );
+				CopyFirstColumn< CompoundKeyWithValue<int,long,int> >( temp_keys, count, columns->FirstInts, start );
+				CopySecondColumn< CompoundKeyWithValue<int,long,int> >( temp_keys, count, columns->SecondLongs, start );
+				CopyValueColumn< CompoundKeyWithValue<int,long,int> >( temp_keys, count, columns->ValueInts, start );
+				break;
+			}
+			default: throw gcnew System::Exception( "Key type is not supported!" );
+		}
+		array< int > ^offsets = columns->Offsets;
+		for( int i = 0; i < count; ++i )
 		{
-			char s[ 100 ];
-			sprintf( s, "Page handle(%d) is not equal to btree file handle(%d).", pageHandle, fileHandle );
-			throw gcnew System::IO::IOException(gcnew String(s));
+			offsets[ start + i ] = temp_keys[ i ]->GetOffset();
 		}
-		int savedBytes = page->Save();
-		int pageSize = page->GetSize();
-		if( savedBytes != pageSize )
+	}
+
+	Exception ^OmniaMeaBTree::GetManagedError( const BTreeIndexError& error )
+	{
+		String ^message = gcnew String( error.GetMessage() );
+		if( error.GetKind() == corrupted_Error )
 		{
-			char s[ 200 ];
-			sprintf( s, "BTreePageBase.Save() returned %d, pageSize = %d, last error = %d.", savedBytes, pageSize, ::GetLastError() );
-			throw gcnew System::IO::IOException(gcnew String(s));
+			return gcnew BadIndexesException( message );
 		}
+		return gcnew System::IO::IOException( message );
 	}
 
     int OmniaMeaBTree::GetLoadedPages()
     {
-        return _loadedPages;
+        return _index->GetLoadedPages();
     }
 
     int OmniaMeaBTree::GetPageSize()
     {
-        return _page->GetSize();
+        return _index->GetPageSize();
     }
+
+	int OmniaMeaBTree::GetPageGeometry()
+	{
+		return _index->GetPageGeometry();
+	}
+
+	bool OmniaMeaBTree::Compact( int milliseconds )
+	{
+		try
+		{
+			return _index->Compact( milliseconds );
+		}
+		catch( const BTreeIndexError& error )
+		{
+			throw GetManagedError( error );
+		}
+	}
+
+	BTreeStatistics ^OmniaMeaBTree::GetStatistics()
+	{
+		BTreeCounters& nativeCounters = _index->GetCounters();
+		array< __int64 > ^counters = gcnew array< __int64 >( COUNTERS_COUNT );
+		for( int i = 0; i < COUNTERS_COUNT; ++i )
+		{
+			counters[ i ] = nativeCounters.Get( i );
+		}
+		array< __int64, 2 > ^latencies = gcnew array< __int64, 2 >( OPERATIONS_COUNT, LATENCY_BUCKETS );
+		for( int i = 0; i < OPERATIONS_COUNT; ++i )
+		{
+			for( int j = 0; j < LATENCY_BUCKETS; ++j )
+			{
+				latencies[ i, j ] = nativeCounters.GetLatencies( i, j );
+			}
+		}
+		return gcnew BTreeStatistics( counters, latencies );
+	}
+
+	void OmniaMeaBTree::ResetStatistics()
+	{
+		_index->GetCounters().Reset();
+	}
 }
@@ -5,8 +5,7 @@
 #ifndef _OMEA_DBINDEX_H
 #define _OMEA_DBINDEX_H
 
-#include "TypeFactory.h"
-#include "BTreePagesCache.h"
+#include "BTreeIndex.h"
 
 using namespace System;
 using namespace System::IO;
@@ -16,14 +15,21 @@ using namespace JetBrains::Omea::Containers;
 namespace DBIndex
 {
 	///////////////////////////////////////////////////////////////////////////
-	// OmniaMeaBTree is used from C# code
+	// OmniaMeaBTree is used from C# code, it translates managed keys to native
+	// ones and delegates to the native BTreeIndex
 	///////////////////////////////////////////////////////////////////////////
 
 	public ref class OmniaMeaBTree : public IBTree
 	{
 	public:
 
+		// page geometries, a closed btree file is opened with the geometry it was created with
+		literal int DefaultPages = default_Geometry;
+		literal int SmallPages = small_Geometry;
+		literal int LargePages = large_Geometry;
+
 		OmniaMeaBTree( String ^filename, IFixedLengthKey ^factoryKey );
+		OmniaMeaBTree( String ^filename, IFixedLengthKey ^factoryKey, int pageGeometry );
 
 		~OmniaMeaBTree();
 		bool Open() override;
@@ -35,15 +41,28 @@ namespace DBIndex
 		void GetAllKeys( IntArrayList ^offsets ) override;
         void GetAllKeys( ArrayList ^keys_offsets ) override;
 		IEnumerable ^GetAllKeys() override;
+		// keys are copied to the columns page by page, no objects are allocated per key
+		void GetAllKeys( KeyColumns ^columns ) override;
 		KeyPair ^GetMinimum();
 		KeyPair ^GetMaximum();
 
         void SearchForRange( IFixedLengthKey ^beginKey, IFixedLengthKey ^endKey, IntArrayList ^offsets ) override;
         void SearchForRange( IFixedLengthKey ^beginKey, IFixedLengthKey ^endKey, ArrayList ^keys_offsets ) override;
 		IEnumerable ^SearchForRange( IFixedLengthKey ^beginKey, IFixedLengthKey ^endKey ) override;
+		void SearchForRange( IFixedLengthKey ^beginKey, IFixedLengthKey ^endKey, KeyColumns ^columns ) override;
+		// loads at most the two boundary pages, key counts of other pages are kept in the header
+		int CountRange( IFixedLengthKey ^beginKey, IFixedLengthKey ^endKey ) override;
 
         void DeleteKey( IFixedLengthKey ^akey, int offset ) override;
         void InsertKey( IFixedLengthKey ^akey, int offset ) override;
+		// pages whose filters don't have the key aren't read
+		bool ContainsKey( IFixedLengthKey ^akey, int offset ) override;
+		bool ContainsKey( IFixedLengthKey ^akey ) override;
+		// filters are kept in memory, about 10 bits per key a page can hold
+		void SetPageFilters( bool enabled ) override;
+		// batches of KeyPairs are sorted and applied page by page
+		void DeleteKeys( ArrayList ^keys_offsets ) override;
+		void InsertKeys( ArrayList ^keys_offsets ) override;
 
         property int MaxCount { int get() override; }
         property int Count { int get() override; }
@@ -53,42 +72,51 @@ namespace DBIndex
 
         int GetLoadedPages() override;
         int GetPageSize() override;
+		int GetPageGeometry();
+		// merges underfull pages and moves pages to free space at the beginning of the file,
+		// the pass is continued by the next call until it returns false
+		bool Compact( int milliseconds ) override;
+		// counters are kept since the btree was created, they survive reopening
+		BTreeStatistics ^GetStatistics() override;
+		void ResetStatistics() override;
 
 		static int GetObjectsCount();
 		static int GetUsedMemory();
 
+		// memory budget in bytes shared by pages caches of all btrees, within the budget
+		// cache size is the btree's weight; 0 means each btree caches at most its cache size
+		static void SetSharedCacheMemory( __int64 bytes );
+		static __int64 GetSharedCacheMemory();
+		// bytes of pages cached by all btrees
+		static __int64 GetCachedMemory();
+		// number of pages sequential scans and enumerators load ahead in background, 0 disables read-ahead
+		static void SetReadAheadPages( int pages );
+		static int GetReadAheadPages();
+
 	private public:
 
-		void InstantiateTypes();
-		void SetFirstKey( IFixedLengthKey ^akey );
+		void Initialize( String ^filename, IFixedLengthKey ^factoryKey, int pageGeometry );
+		void SetNativeKey( IFixedLengthKey ^akey, BTreeKeyBase* key );
 		void SetFirstAndLastKeys( IFixedLengthKey ^beginKey, IFixedLengthKey ^endKey );
-		BTreePageBase* GetPageByOffset( int offset );
-		BTreePageBase* AllocPage();
-		BTreePageBase* PrepareNewPage( int offset );
-		void CopyOffsets( const BTreeKeyBase** temp_keys, unsigned count, IntArrayList ^offsets );
-		void CopyKeys( const BTreeKeyBase** temp_keys, int count, ArrayList ^keys_offsets  );
-		void LoadPage( BTreePageBase* );
-		void SavePage( BTreePageBase* );
+		ArrayList ^SortBatch( ArrayList ^keys_offsets );
+		BTreeKeyBase** NewBatchKeys( ArrayList ^batch );
+		void DeleteBatchKeys( BTreeKeyBase** keys, int count );
+		void CopyOffsets( const BTreeKeyBase* const* temp_keys, int count, IntArrayList ^offsets );
+		void CopyKeys( const BTreeKeyBase* const* temp_keys, int count, ArrayList ^keys_offsets  );
+		void CopyColumns( const BTreeKeyBase* const* temp_keys, int count, KeyColumns ^columns );
+		// managed exception for an error of the native engine
+		static Exception ^GetManagedError( const BTreeIndexError& error );
 
 		String^						_filename;
 		IFixedLengthKey^			_factoryKey;
 		FileStream^					_btreeFile;
-		BTreePageBase*				_page;
-		BTreePageBase*				_freePage;
+		BTreeIndex*					_index;
+		BTreeCursor*				_cursor;
 		BTreeKeyBase*				_firstKey;
 		BTreeKeyBase*				_lastKey;
-		BTreeKeyBase*				_headerKey;
-		IKeyComparer*				_keyComparer;
-		BTreePagesCache*			_pagesCache;
-		BTreeHeaderBase*			_btreeHeader;
-		BTreeHeaderIteratorBase*	_btreeHeaderIterator;
 		IEnumerable^				_searchForRangeEnumerable;
-		IntArrayList^				_freeOffsets;
 		ArrayList^					_oneItemList;
-		int							_keysInIndex;
 		int							_keyType;
-		unsigned					_numberOfPages;
-        int                         _loadedPages;
 	};
 }
 
@@ -6,42 +6,41 @@
 
 //#define CRT_ALLOCATIONS
 
-#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
 #include "DBIndexHeapObject.h"
 
 namespace DBIndex
 {
-	HANDLE   DBIndexHeapObject::_heap = NULL;
+	void*    DBIndexHeapObject::_heap = 0;
 	int      DBIndexHeapObject::_heapSize = 0;
 	int      DBIndexHeapObject::_objectsCount = 0;
 
 #ifndef CRT_ALLOCATIONS
 
-static __forceinline __int8 InterlockedExchange(volatile __int8* pTarget, __int8 c)
-{
-  __asm {
-         mov     ebx, pTarget
-         mov     al, c
-    lock xchg    byte ptr [ebx], al
-  }
-}
-
 #define STATIC_HEAP_SIZE 16384
 #define STATIC_HEAP_LONG_MULTIPLIER 4
+// size of a CRT allocated object precedes it, the prefix keeps objects 8-byte aligned
+#define SIZE_PREFIX sizeof( __int64 )
 
 		// each heap entry consists of 4 longs (32 bytes)
 		static __int64 _staticHeap[STATIC_HEAP_SIZE * STATIC_HEAP_LONG_MULTIPLIER];
-		static __int8  _staticHeapStates[STATIC_HEAP_SIZE];
+		static char    _staticHeapStates[STATIC_HEAP_SIZE];
 		static int	   _staticHeapObjects;
 #endif
 
 	void DBIndexHeapObject::CreateHeap()
 	{
 #ifndef CRT_ALLOCATIONS
-		if( _heap == NULL )
+		if( _heap == 0 )
 		{
+#ifdef _WIN32
 			_heap = ::HeapCreate( HEAP_GENERATE_EXCEPTIONS, 0, 0 );
-			::ZeroMemory( _staticHeapStates, sizeof( _staticHeapStates ) );
+#else
+			// objects not fitting the static heap are allocated by the CRT
+			_heap = _staticHeap;
+#endif
+			memset( _staticHeapStates, 0, sizeof( _staticHeapStates ) );
 			_staticHeapObjects = 0;
 		}
 #endif
@@ -60,11 +59,11 @@ static __forceinline __int8 InterlockedExchange(volatile __int8* pTarget, __int8
 			int index = ( _objectsCount + _heapSize + _staticHeapObjects ) % STATIC_HEAP_SIZE;
 			for( int i = 0; i < 16; ++i )
 			{
-				if( DBIndex::InterlockedExchange( &_staticHeapStates[ index ], 1 ) == 0 )
+				if( AtomicExchange8( &_staticHeapStates[ index ], 1 ) == 0 )
 				{
 					result = (int*) &_staticHeap[ index * STATIC_HEAP_LONG_MULTIPLIER ];
 					size = sizeof( __int64 ) * STATIC_HEAP_LONG_MULTIPLIER;
-					::InterlockedIncrement( (LPLONG)&_staticHeapObjects );
+					AtomicIncrement( (volatile int*)&_staticHeapObjects );
 					break;
 				}
 				index = ( 2717 * index + 3141 ) % STATIC_HEAP_SIZE;
@@ -72,13 +71,17 @@ static __forceinline __int8 InterlockedExchange(volatile __int8* pTarget, __int8
 		}
 		if( !result )
 		{
-			size += 4;
+			size += SIZE_PREFIX;
+#ifdef _WIN32
 			result = (int*)::HeapAlloc( _heap, 0, size );
+#else
+			result = (int*)malloc( size );
+#endif
 			*result = size;
-			++result;
+			result = (int*)( (char*)result + SIZE_PREFIX );
 		}
-		::InterlockedExchangeAdd( (LPLONG)&_heapSize, size );
-		::InterlockedIncrement( (LPLONG)&_objectsCount );
+		AtomicExchangeAdd( (volatile int*)&_heapSize, size );
+		AtomicIncrement( (volatile int*)&_objectsCount );
 		return result;
 #endif
 	}
@@ -94,17 +97,21 @@ static __forceinline __int8 InterlockedExchange(volatile __int8* pTarget, __int8
 		if( ptr >= (int*)_staticHeap && ptr <= (int*)&_staticHeap[ (STATIC_HEAP_SIZE - 1) * STATIC_HEAP_LONG_MULTIPLIER ] )
 		{
 			int index = (((__int64*)ptr ) - (__int64*)_staticHeap ) / STATIC_HEAP_LONG_MULTIPLIER;
-			DBIndex::InterlockedExchange( &_staticHeapStates[ index ], 0 );
-			::InterlockedDecrement( (LPLONG)&_staticHeapObjects );
+			AtomicExchange8( &_staticHeapStates[ index ], 0 );
+			AtomicDecrement( (volatile int*)&_staticHeapObjects );
 		}
 		else
 		{
-			--ptr;
+			ptr = (int*)( (char*)ptr - SIZE_PREFIX );
 			size = -*ptr;
+#ifdef _WIN32
 			::HeapFree( _heap, 0, ptr );
+#else
+			free( ptr );
+#endif
 		}
-		::InterlockedExchangeAdd( (LPLONG)&_heapSize, size );
-		::InterlockedDecrement( (LPLONG)&_objectsCount );
+		AtomicExchangeAdd( (volatile int*)&_heapSize, size );
+		AtomicDecrement( (volatile int*)&_objectsCount );
 #endif
 	}
 }
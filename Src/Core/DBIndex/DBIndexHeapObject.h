@@ -5,8 +5,8 @@
 #ifndef _OMEA_DBINDEX_HEAP_OBJECT_H
 #define _OMEA_DBINDEX_HEAP_OBJECT_H
 
-#include <windows.h>
 #include <memory>
+#include "DBIndexPlatform.h"
 
 namespace DBIndex
 {
@@ -22,7 +22,7 @@ namespace DBIndex
 		void operator delete( void* object );
 
 	private:
-		static HANDLE   _heap;
+		static void*	_heap;
 		static int		_heapSize;
 		static int		_objectsCount;
 	};
@@ -73,6 +73,9 @@ namespace DBIndex
 		};
 		template <class U> DBIndex_allocator( const DBIndex_allocator<U>& ) {}
 		template <class U> DBIndex_allocator& operator=( const DBIndex_allocator<U>& ) { return *this; }
+		// all allocators share the heap, so memory allocated by one is freed by another
+		template <class U> bool operator==( const DBIndex_allocator<U>& ) const { return true; }
+		template <class U> bool operator!=( const DBIndex_allocator<U>& ) const { return false; }
 	};
 }
 
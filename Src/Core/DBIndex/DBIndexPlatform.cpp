@@ -0,0 +1,377 @@
+﻿// SPDX-FileCopyrightText: 2003-2008 JetBrains s.r.o.
+//
+// SPDX-License-Identifier: GPL-2.0-only
+
+#pragma unmanaged
+
+#include "DBIndexPlatform.h"
+
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// number of threads of the POSIX work items pool
+///////////////////////////////////////////////////////////////////////////////
+
+#define WORK_THREADS	4
+
+namespace DBIndex
+{
+#ifdef _WIN32
+
+	///////////////////////////////////////////////////////////////////////////
+	// Win32 implementation
+	///////////////////////////////////////////////////////////////////////////
+
+	int OpenIndexFile( const char* path )
+	{
+		HANDLE file = ::CreateFileA( path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+			OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL );
+		return ( file == INVALID_HANDLE_VALUE ) ? -1 : (int) file;
+	}
+
+	void CloseIndexFile( int file )
+	{
+		::CloseHandle( (HANDLE) file );
+	}
+
+	int ReadIndexFile( int file, void* buffer, int size, int position )
+	{
+		DWORD read = 0;
+		OVERLAPPED overlapped;
+		::ZeroMemory( &overlapped, sizeof( overlapped ) );
+		overlapped.Offset = (DWORD) position;
+		::ReadFile( (HANDLE) file, (LPVOID) buffer, (DWORD) size, &read, &overlapped );
+		return (int) read;
+	}
+
+	int WriteIndexFile( int file, const void* buffer, int size, int position )
+	{
+		DWORD written = 0;
+		OVERLAPPED overlapped;
+		::ZeroMemory( &overlapped, sizeof( overlapped ) );
+		overlapped.Offset = (DWORD) position;
+		::WriteFile( (HANDLE) file, (LPCVOID) buffer, (DWORD) size, &written, &overlapped );
+		return (int) written;
+	}
+
+	int GetIndexFileLength( int file )
+	{
+		return (int) ::GetFileSize( (HANDLE) file, NULL );
+	}
+
+	bool SetIndexFileLength( int file, int length )
+	{
+		return ::SetFilePointer( (HANDLE) file, length, NULL, FILE_BEGIN ) != INVALID_SET_FILE_POINTER &&
+			::SetEndOfFile( (HANDLE) file ) != FALSE;
+	}
+
+	int GetLastSystemError()
+	{
+		return (int) ::GetLastError();
+	}
+
+	struct WorkItem
+	{
+		void	(*_proc)( void* );
+		void*	_param;
+	};
+
+	static DWORD WINAPI WorkItemProc( LPVOID param )
+	{
+		WorkItem item = *(WorkItem*) param;
+		delete (WorkItem*) param;
+		item._proc( item._param );
+		return 0;
+	}
+
+	bool QueueWorkItem( void (*proc)( void* ), void* param )
+	{
+		WorkItem* item = new WorkItem;
+		item->_proc = proc;
+		item->_param = param;
+		if( !::QueueUserWorkItem( WorkItemProc, item, WT_EXECUTEDEFAULT ) )
+		{
+			delete item;
+			return false;
+		}
+		return true;
+	}
+
+	void YieldThread()
+	{
+		::Sleep( 0 );
+	}
+
+	__int64 GetTicks()
+	{
+		LARGE_INTEGER now;
+		::QueryPerformanceCounter( &now );
+		return now.QuadPart;
+	}
+
+	__int64 GetTicksPerSecond()
+	{
+		LARGE_INTEGER frequency;
+		::QueryPerformanceFrequency( &frequency );
+		return frequency.QuadPart;
+	}
+
+	int AtomicIncrement( volatile int* value ) { return ::InterlockedIncrement( (volatile LONG*) value ) - 1; }
+	int AtomicDecrement( volatile int* value ) { return ::InterlockedDecrement( (volatile LONG*) value ) + 1; }
+	int AtomicExchange( volatile int* value, int exchange ) { return ::InterlockedExchange( (volatile LONG*) value, exchange ); }
+	int AtomicCompareExchange( volatile int* value, int exchange, int comparand )
+	{
+		return ::InterlockedCompareExchange( (volatile LONG*) value, exchange, comparand );
+	}
+	int AtomicExchangeAdd( volatile int* value, int addend ) { return ::InterlockedExchangeAdd( (volatile LONG*) value, addend ); }
+	char AtomicExchange8( volatile char* value, char exchange ) { return _InterlockedExchange8( value, exchange ); }
+	__int64 AtomicRead64( volatile __int64* value ) { return ::InterlockedCompareExchange64( value, 0, 0 ); }
+	void AtomicWrite64( volatile __int64* value, __int64 newValue ) { ::InterlockedExchange64( value, newValue ); }
+	void AtomicAdd64( volatile __int64* value, __int64 addend ) { ::InterlockedExchangeAdd64( value, addend ); }
+
+	void DBIndexLock::Initialize() { ::InitializeCriticalSection( &_cs ); }
+	void DBIndexLock::Delete() { ::DeleteCriticalSection( &_cs ); }
+	void DBIndexLock::Enter() { ::EnterCriticalSection( &_cs ); }
+	void DBIndexLock::Leave() { ::LeaveCriticalSection( &_cs ); }
+
+	void DBIndexEvent::Create() { _event = ::CreateEvent( NULL, FALSE, FALSE, NULL ); }
+	void DBIndexEvent::Close() { ::CloseHandle( _event ); }
+	void DBIndexEvent::Set() { ::SetEvent( _event ); }
+	void DBIndexEvent::Wait() { ::WaitForSingleObject( _event, INFINITE ); }
+
+#else
+
+	///////////////////////////////////////////////////////////////////////////
+	// POSIX implementation
+	///////////////////////////////////////////////////////////////////////////
+
+	int OpenIndexFile( const char* path )
+	{
+		return ::open( path, O_RDWR | O_CREAT, 0644 );
+	}
+
+	void CloseIndexFile( int file )
+	{
+		::close( file );
+	}
+
+	int ReadIndexFile( int file, void* buffer, int size, int position )
+	{
+		int done = 0;
+		while( done < size )
+		{
+			ssize_t read = ::pread( file, (char*) buffer + done, size - done, position + done );
+			if( read < 0 && errno == EINTR )
+			{
+				continue;
+			}
+			if( read <= 0 )
+			{
+				break;
+			}
+			done += (int) read;
+		}
+		return done;
+	}
+
+	int WriteIndexFile( int file, const void* buffer, int size, int position )
+	{
+		int done = 0;
+		while( done < size )
+		{
+			ssize_t written = ::pwrite( file, (const char*) buffer + done, size - done, position + done );
+			if( written < 0 && errno == EINTR )
+			{
+				continue;
+			}
+			if( written <= 0 )
+			{
+				break;
+			}
+			done += (int) written;
+		}
+		return done;
+	}
+
+	int GetIndexFileLength( int file )
+	{
+		struct stat status;
+		return ( ::fstat( file, &status ) == 0 ) ? (int) status.st_size : 0;
+	}
+
+	bool SetIndexFileLength( int file, int length )
+	{
+		return ::ftruncate( file, length ) == 0;
+	}
+
+	int GetLastSystemError()
+	{
+		return errno;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	// work items are queued to a small pool of detached threads started on
+	// first use, items are executed in the order they are queued
+	///////////////////////////////////////////////////////////////////////////
+
+	struct WorkItem
+	{
+		void		(*_proc)( void* );
+		void*		_param;
+		WorkItem*	_next;
+	};
+
+	static pthread_mutex_t	_workLock = PTHREAD_MUTEX_INITIALIZER;
+	static pthread_cond_t	_workQueued = PTHREAD_COND_INITIALIZER;
+	static WorkItem*		_workFirst = 0;
+	static WorkItem*		_workLast = 0;
+	static int				_workThreads = 0;
+
+	static void* WorkThreadProc( void* )
+	{
+		for( ;; )
+		{
+			pthread_mutex_lock( &_workLock );
+			while( !_workFirst )
+			{
+				pthread_cond_wait( &_workQueued, &_workLock );
+			}
+			WorkItem* item = _workFirst;
+			_workFirst = item->_next;
+			if( !_workFirst )
+			{
+				_workLast = 0;
+			}
+			pthread_mutex_unlock( &_workLock );
+			item->_proc( item->_param );
+			delete item;
+		}
+		return 0;
+	}
+
+	bool QueueWorkItem( void (*proc)( void* ), void* param )
+	{
+		WorkItem* item = new WorkItem;
+		item->_proc = proc;
+		item->_param = param;
+		item->_next = 0;
+		pthread_mutex_lock( &_workLock );
+		while( _workThreads < WORK_THREADS )
+		{
+			pthread_t thread;
+			if( pthread_create( &thread, 0, WorkThreadProc, 0 ) != 0 )
+			{
+				break;
+			}
+			pthread_detach( thread );
+			++_workThreads;
+		}
+		bool queued = _workThreads != 0;
+		if( queued )
+		{
+			if( _workLast )
+			{
+				_workLast->_next = item;
+			}
+			else
+			{
+				_workFirst = item;
+			}
+			_workLast = item;
+			pthread_cond_signal( &_workQueued );
+		}
+		pthread_mutex_unlock( &_workLock );
+		if( !queued )
+		{
+			delete item;
+		}
+		return queued;
+	}
+
+	void YieldThread()
+	{
+		sched_yield();
+	}
+
+	__int64 GetTicks()
+	{
+		timespec now;
+		clock_gettime( CLOCK_MONOTONIC, &now );
+		return (__int64) now.tv_sec * 1000000000 + now.tv_nsec;
+	}
+
+	__int64 GetTicksPerSecond()
+	{
+		return 1000000000;
+	}
+
+	int AtomicIncrement( volatile int* value ) { return __sync_fetch_and_add( value, 1 ); }
+	int AtomicDecrement( volatile int* value ) { return __sync_fetch_and_sub( value, 1 ); }
+	int AtomicExchange( volatile int* value, int exchange ) { return __sync_lock_test_and_set( value, exchange ); }
+	int AtomicCompareExchange( volatile int* value, int exchange, int comparand )
+	{
+		return __sync_val_compare_and_swap( value, comparand, exchange );
+	}
+	int AtomicExchangeAdd( volatile int* value, int addend ) { return __sync_fetch_and_add( value, addend ); }
+	char AtomicExchange8( volatile char* value, char exchange ) { return __sync_lock_test_and_set( value, exchange ); }
+	__int64 AtomicRead64( volatile __int64* value ) { return __sync_val_compare_and_swap( value, 0, 0 ); }
+	void AtomicWrite64( volatile __int64* value, __int64 newValue ) { __sync_lock_test_and_set( value, newValue ); }
+	void AtomicAdd64( volatile __int64* value, __int64 addend ) { __sync_fetch_and_add( value, addend ); }
+
+	void DBIndexLock::Initialize()
+	{
+		pthread_mutexattr_t attributes;
+		pthread_mutexattr_init( &attributes );
+		pthread_mutexattr_settype( &attributes, PTHREAD_MUTEX_RECURSIVE );
+		pthread_mutex_init( &_mutex, &attributes );
+		pthread_mutexattr_destroy( &attributes );
+	}
+
+	void DBIndexLock::Delete() { pthread_mutex_destroy( &_mutex ); }
+	void DBIndexLock::Enter() { pthread_mutex_lock( &_mutex ); }
+	void DBIndexLock::Leave() { pthread_mutex_unlock( &_mutex ); }
+
+	void DBIndexEvent::Create()
+	{
+		pthread_mutex_init( &_mutex, 0 );
+		pthread_cond_init( &_cond, 0 );
+		_signaled = false;
+	}
+
+	void DBIndexEvent::Close()
+	{
+		pthread_cond_destroy( &_cond );
+		pthread_mutex_destroy( &_mutex );
+	}
+
+	void DBIndexEvent::Set()
+	{
+		pthread_mutex_lock( &_mutex );
+		_signaled = true;
+		pthread_cond_signal( &_cond );
+		pthread_mutex_unlock( &_mutex );
+	}
+
+	void DBIndexEvent::Wait()
+	{
+		pthread_mutex_lock( &_mutex );
+		while( !_signaled )
+		{
+			pthread_cond_wait( &_cond, &_mutex );
+		}
+		_signaled = false;
+		pthread_mutex_unlock( &_mutex );
+	}
+
+#endif
+}
@@ -0,0 +1,106 @@
+﻿// SPDX-FileCopyrightText: 2003-2008 JetBrains s.r.o.
+//
+// SPDX-License-Identifier: GPL-2.0-only
+
+#ifndef _OMEA_DBINDEX_PLATFORM_H
+#define _OMEA_DBINDEX_PLATFORM_H
+
+///////////////////////////////////////////////////////////////////////////////
+// Operating system services used by the native part of DBIndex.
+// The btree engine is built either by MSVC for Windows, or by GCC for POSIX
+// systems, where it is used only by the native benchmark.
+// Files are identified by int handles (Win32 handles are 32-bit in the
+// process DBIndex is loaded into), and all reads and writes pass explicit
+// positions, because pages may be loaded or saved on other threads.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <stddef.h>
+#define __int64				long long
+#define __forceinline		inline __attribute__(( always_inline ))
+#endif
+
+namespace DBIndex
+{
+	// returns -1 if the file can't be opened, an existing file isn't truncated
+	int OpenIndexFile( const char* path );
+	void CloseIndexFile( int file );
+	// return number of bytes read or written
+	int ReadIndexFile( int file, void* buffer, int size, int position );
+	int WriteIndexFile( int file, const void* buffer, int size, int position );
+	int GetIndexFileLength( int file );
+	bool SetIndexFileLength( int file, int length );
+	// code of the last error of a system call on the calling thread
+	int GetLastSystemError();
+
+	// runs proc( param ) on a thread of the system (or process-wide) thread pool
+	bool QueueWorkItem( void (*proc)( void* ), void* param );
+	void YieldThread();
+
+	// high-resolution clock
+	__int64 GetTicks();
+	__int64 GetTicksPerSecond();
+
+	// 32-bit interlocked operations return the initial value
+	int AtomicIncrement( volatile int* value );
+	int AtomicDecrement( volatile int* value );
+	int AtomicExchange( volatile int* value, int exchange );
+	int AtomicCompareExchange( volatile int* value, int exchange, int comparand );
+	int AtomicExchangeAdd( volatile int* value, int addend );
+	char AtomicExchange8( volatile char* value, char exchange );
+	__int64 AtomicRead64( volatile __int64* value );
+	void AtomicWrite64( volatile __int64* value, __int64 newValue );
+	void AtomicAdd64( volatile __int64* value, __int64 addend );
+
+	///////////////////////////////////////////////////////////////////////////
+	// recursive lock, it is initialized explicitly so that static locks
+	// don't depend on order of static initialization
+	///////////////////////////////////////////////////////////////////////////
+
+	class DBIndexLock
+	{
+	public:
+
+		void Initialize();
+		void Delete();
+		void Enter();
+		void Leave();
+
+	private:
+
+#ifdef _WIN32
+		CRITICAL_SECTION	_cs;
+#else
+		pthread_mutex_t		_mutex;
+#endif
+	};
+
+	///////////////////////////////////////////////////////////////////////////
+	// auto-reset event
+	///////////////////////////////////////////////////////////////////////////
+
+	class DBIndexEvent
+	{
+	public:
+
+		void Create();
+		void Close();
+		void Set();
+		void Wait();
+
+	private:
+
+#ifdef _WIN32
+		HANDLE				_event;
+#else
+		pthread_mutex_t		_mutex;
+		pthread_cond_t		_cond;
+		bool				_signaled;
+#endif
+	};
+}
+
+#endif
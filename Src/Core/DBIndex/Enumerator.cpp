@@ -80,53 +80,50 @@ namespace DBIndex
 	GetAllKeysEnumerator::GetAllKeysEnumerator( OmniaMeaBTree ^bTree )
 	{
 		_bTree = bTree;
-		_btreeHeaderIterator = bTree->_btreeHeaderIterator;
+		_cursor = new BTreeCursor();
 		_current = gcnew KeyPair();
 		_current->_key = _bTree->_factoryKey;
-		_currentPageKeys = (const BTreeKeyBase**)
-			DBIndexHeapObject::operator new( MAX_KEYS_IN_PAGE * sizeof( const BTreeKeyBase* ) );
 		Reset();
 	}
 
 	Object ^GetAllKeysEnumerator::Current::get()
 	{
-		TranslateNativeKey2ManagedKey( _bTree->_keyType, _currentPageKeys[ _currentPageIndex ] , _current );
+		TranslateNativeKey2ManagedKey( _bTree->_keyType, _cursor->GetKeys()[ _currentPageIndex ] , _current );
 		return _current;
 	}
 
 	bool GetAllKeysEnumerator::MoveNext()
 	{
-		while( ++_currentPageIndex >= _currentPageCount )
+		try
 		{
-			if( _btreeHeaderIterator->Exhausted() )
+			while( ++_currentPageIndex >= _cursor->GetCount() )
 			{
-				return false;
+				if( !_cursor->NextPage() )
+				{
+					return false;
+				}
+				_currentPageIndex = -1;
 			}
-			BTreePageBase* page = _bTree->GetPageByOffset( _btreeHeaderIterator->GetCurrentOffset() );
-			_currentPageCount = (short) page->GetAllKeys( _currentPageKeys );
-			if( _currentPageCount > MAX_KEYS_IN_PAGE )
-			{
-				throw gcnew BadIndexesException( "BTree contains cycles. Possible memory corruption." );
-			}
-			_currentPageIndex = -1;
-			_btreeHeaderIterator->MoveNextPage();
+		}
+		catch( const BTreeIndexError& error )
+		{
+			throw OmniaMeaBTree::GetManagedError( error );
 		}
 		return true;
 	}
 
 	void GetAllKeysEnumerator::Reset()
 	{
-		_bTree->_btreeHeader->GetMinimumPage( *_btreeHeaderIterator );
+		_cursor->SeekAll( *( _bTree->_index ), false );
 		_currentPageIndex = -1;
-		_currentPageCount = 0;
 	}
 
 	GetAllKeysEnumerator::~GetAllKeysEnumerator()
 	{
-		if( _currentPageKeys )
+		if( _cursor )
 		{
-			DBIndexHeapObject::operator delete( _currentPageKeys );
-			_currentPageKeys = 0;
+			delete _cursor;
+			_cursor = 0;
 		}
 		else
 		{
@@ -139,11 +136,12 @@ namespace DBIndex
 	// SearchForRangeEnumerator implementation
 	///////////////////////////////////////////////////////////////////////////
 
+	// pooled enumerators are shared by btrees of different key types and page geometries,
+	// the cursor adapts its buffer on each seek
 	SearchForRangeEnumerator::SearchForRangeEnumerator()
 	{
 		_current = gcnew KeyPair();
-		_currentPageKeys = (const BTreeKeyBase**)
-			DBIndexHeapObject::operator new( MAX_KEYS_IN_PAGE * sizeof( const BTreeKeyBase*) );
+		_cursor = new BTreeCursor();
 	}
 
 	void SearchForRangeEnumerator::Init( OmniaMeaBTree ^bTree, IFixedLengthKey ^beginKey, IFixedLengthKey ^endKey )
@@ -151,41 +149,32 @@ namespace DBIndex
 		_bTree = bTree;
 		_beginKey = beginKey;
 		_endKey = endKey;
-		_btreeHeaderIterator = bTree->_btreeHeaderIterator;
 		_current->_key = _bTree->_factoryKey;
 		Reset();
 	}
 
 	Object ^SearchForRangeEnumerator::Current::get()
 	{
-		TranslateNativeKey2ManagedKey( _bTree->_keyType, _currentPageKeys[ _currentPageIndex ] , _current );
+		TranslateNativeKey2ManagedKey( _bTree->_keyType, _cursor->GetKeys()[ _currentPageIndex ] , _current );
 		return _current;
 	}
 
 	bool SearchForRangeEnumerator::MoveNext()
 	{
-		while( ++_currentPageIndex >= _currentPageCount )
+		try
 		{
-			if( _btreeHeaderIterator->Exhausted() )
-			{
-				return false;
-			}
-			const BTreeKeyBase& lastKey = *( _bTree->_lastKey );
-			BTreeKeyBase& headerKey = *( _bTree->_headerKey );
-			_btreeHeaderIterator->GetCurrentKey( headerKey );
-			if( _bTree->_keyComparer->Less( lastKey, headerKey ) )
-			{
-				return false;
-			}
-			BTreePageBase* page = _bTree->GetPageByOffset( _btreeHeaderIterator->GetCurrentOffset() );
-			_currentPageCount =
-				(short) page->SearchForRange( *( _bTree->_firstKey ), lastKey, _currentPageKeys );
-			if( _currentPageCount > MAX_KEYS_IN_PAGE )
+			while( ++_currentPageIndex >= _cursor->GetCount() )
 			{
-				throw gcnew BadIndexesException( "BTree contains cycles. Possible memory corruption." );
+				if( !_cursor->NextPage() )
+				{
+					return false;
+				}
+				_currentPageIndex = -1;
 			}
-			_currentPageIndex = -1;
-			_btreeHeaderIterator->MoveNextPage();
+		}
+		catch( const BTreeIndexError& error )
+		{
+			throw OmniaMeaBTree::GetManagedError( error );
 		}
 		return true;
 	}
@@ -193,9 +182,8 @@ namespace DBIndex
 	void SearchForRangeEnumerator::Reset()
 	{
 		_bTree->SetFirstAndLastKeys( _beginKey, _endKey );
-		_bTree->_btreeHeader->GetPage( *( _bTree->_firstKey ), *_btreeHeaderIterator );
+		_cursor->SeekRange( *( _bTree->_index ), *( _bTree->_firstKey ), *( _bTree->_lastKey ), false );
 		_currentPageIndex = -1;
-		_currentPageCount = 0;
 	}
 
 	SearchForRangeEnumerator::~SearchForRangeEnumerator()
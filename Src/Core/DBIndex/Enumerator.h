@@ -32,11 +32,9 @@ namespace DBIndex
 		GetAllKeysEnumerator( OmniaMeaBTree ^bTree );
 
 		OmniaMeaBTree^				_bTree;
-		BTreeHeaderIteratorBase*	_btreeHeaderIterator;
+		BTreeCursor*				_cursor;
 		KeyPair^					_current;
-		short						_currentPageIndex;
-		short						_currentPageCount;
-		const BTreeKeyBase**		_currentPageKeys;
+		int							_currentPageIndex;
 	};
 
 	private ref class GetAllKeysEnumerable : public IEnumerable
@@ -81,11 +79,9 @@ namespace DBIndex
 		OmniaMeaBTree^				_bTree;
 		IFixedLengthKey^			_beginKey;
 		IFixedLengthKey^			_endKey;
-		BTreeHeaderIteratorBase*	_btreeHeaderIterator;
+		BTreeCursor*				_cursor;
 		KeyPair^					_current;
-		short						_currentPageIndex;
-		short						_currentPageCount;
-		const BTreeKeyBase**		_currentPageKeys;
+		int							_currentPageIndex;
 	};
 
 	private ref class SearchForRangeEnumerable : public IEnumerable
@@ -8,6 +8,22 @@
 
 namespace DBIndex
 {
+	template< class Key > static BTreePageBase* NewGeometryPage( int geometry )
+	{
+		switch( geometry )
+		{
+			case default_Geometry: return new BTreePage< Key, DefaultPageGeometry >( 0, 0 );
+			case small_Geometry: return new BTreePage< Key, SmallPageGeometry >( 0, 0 );
+			case large_Geometry: return new BTreePage< Key, LargePageGeometry >( 0, 0 );
+		}
+		return 0;
+	}
+
+	template< class Key > static void CopyTypedKey( BTreeKeyBase& to, const BTreeKeyBase& from )
+	{
+		static_cast< BTreeKey< Key >& >( to ) = static_cast< const BTreeKey< Key >& >( from );
+	}
+
 	BTreeKeyBase* TypeFactory::NewKey( int type )
 	{
 		switch( type )
@@ -25,19 +41,19 @@ namespace DBIndex
 		return 0;
 	}
 
-	BTreePageBase* TypeFactory::NewPage( int type )
+	BTreePageBase* TypeFactory::NewPage( int type, int geometry )
 	{
 		switch( type )
 		{
-			case int_Key: return new BTreePage<int>( 0, 0 );
-			case int_int_Key: return new BTreePage< CompoundKey<int,int> >( 0, 0 );
-			case int_datetime_Key: return new BTreePage< CompoundKey<int,long> >( 0, 0 );
-			case int_int_int_Key: return new BTreePage< CompoundKeyWithValue<int,int,int> >( 0, 0 );
-			case int_int_datetime_Key: return new BTreePage< CompoundKeyWithValue<int,int,long> >( 0, 0 );
-			case int_datetime_int_Key: return new BTreePage< CompoundKeyWithValue<int,long,int> >( 0, 0 );
-			case long_Key: return new BTreePage<long>( 0, 0 );
-			case datetime_Key: return new BTreePage<long>( 0, 0 );
-			case double_Key: return new BTreePage<double>( 0, 0 );
+			case int_Key: return NewGeometryPage<int>( geometry );
+			case int_int_Key: return NewGeometryPage< CompoundKey<int,int> >( geometry );
+			case int_datetime_Key: return NewGeometryPage< CompoundKey<int,long> >( geometry );
+			case int_int_int_Key: return NewGeometryPage< CompoundKeyWithValue<int,int,int> >( geometry );
+			case int_int_datetime_Key: return NewGeometryPage< CompoundKeyWithValue<int,int,long> >( geometry );
+			case int_datetime_int_Key: return NewGeometryPage< CompoundKeyWithValue<int,long,int> >( geometry );
+			case long_Key: return NewGeometryPage<long>( geometry );
+			case datetime_Key: return NewGeometryPage<long>( geometry );
+			case double_Key: return NewGeometryPage<double>( geometry );
 		}
 		return 0;
 	}
@@ -117,4 +133,31 @@ namespace DBIndex
 	{
 		delete comparer;
 	}
+
+	void TypeFactory::CopyKey( int type, BTreeKeyBase& to, const BTreeKeyBase& from )
+	{
+		switch( type )
+		{
+			case int_Key: CopyTypedKey<int>( to, from ); break;
+			case int_int_Key: CopyTypedKey< CompoundKey<int,int> >( to, from ); break;
+			case int_datetime_Key: CopyTypedKey< CompoundKey<int,long> >( to, from ); break;
+			case int_int_int_Key: CopyTypedKey< CompoundKeyWithValue<int,int,int> >( to, from ); break;
+			case int_int_datetime_Key: CopyTypedKey< CompoundKeyWithValue<int,int,long> >( to, from ); break;
+			case int_datetime_int_Key: CopyTypedKey< CompoundKeyWithValue<int,long,int> >( to, from ); break;
+			case long_Key: CopyTypedKey<long>( to, from ); break;
+			case datetime_Key: CopyTypedKey<long>( to, from ); break;
+			case double_Key: CopyTypedKey<double>( to, from ); break;
+		}
+	}
+
+	int TypeFactory::GetPageCapacity( int geometry )
+	{
+		switch( geometry )
+		{
+			case default_Geometry: return DefaultPageGeometry::maxKeys;
+			case small_Geometry: return SmallPageGeometry::maxKeys;
+			case large_Geometry: return LargePageGeometry::maxKeys;
+		}
+		return 0;
+	}
 }
@@ -32,12 +32,18 @@ namespace DBIndex
 			int_datetime_int_Key
 	};
 
+	// page geometries, values are saved in btree files
+	enum {	default_Geometry,
+			small_Geometry,
+			large_Geometry
+	};
+
 	class TypeFactory
 	{
 	public:
 
 		static BTreeKeyBase*			NewKey( int type );
-		static BTreePageBase*			NewPage( int type );
+		static BTreePageBase*			NewPage( int type, int geometry = default_Geometry );
 		static BTreeHeaderBase*			NewHeader( int type );
 		static BTreeHeaderIteratorBase*	NewHeaderIterator( int type );
 		static IKeyComparer*			NewKeyComparer( int type );
@@ -47,6 +53,12 @@ namespace DBIndex
 		static void	DeleteHeader( BTreeHeaderBase* );
 		static void	DeleteHeaderIterator( BTreeHeaderIteratorBase* );
 		static void	DeleteKeyComparer( IKeyComparer* );
+
+		// assigns key data and offset, as BTreeKey::operator= does
+		static void	CopyKey( int type, BTreeKeyBase& to, const BTreeKeyBase& from );
+
+		// returns 0 for unknown geometry
+		static int	GetPageCapacity( int geometry );
 	};
 }
 
@@ -0,0 +1,442 @@
+﻿// SPDX-FileCopyrightText: 2003-2008 JetBrains s.r.o.
+//
+// SPDX-License-Identifier: GPL-2.0-only
+
+///////////////////////////////////////////////////////////////////////////////
+// Native benchmark of the DBIndex btree engine, it doesn't need the CLR.
+// For every key type of TypeFactory it runs sequential and random inserts,
+// point lookups, full and range scans, a mixed workload (70% lookups,
+// 20% inserts, 10% deletes), random deletes, existence checks with page
+// filters, compaction of the index after most of its keys are deleted
+// and reopening of the index, and reports
+// operations per second, page reads and writes, and p50/p99 latencies
+// taken from the btree's counters.
+//
+// Usage: DBIndexBenchmark [keys [cachePages [directory]]]
+//
+// On Windows it is built by DBIndexBenchmark.vcxproj, on POSIX systems with
+//   g++ -O2 -std=c++11 -I../DBIndex DBIndexBenchmark.cpp
+//       ../DBIndex/{BTreeIndex,BTreePagesCache,BTreeCounters,TypeFactory,DBIndexHeapObject,DBIndexPlatform}.cpp
+//       -lpthread -o DBIndexBenchmark
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "BTreeIndex.h"
+
+using namespace DBIndex;
+
+namespace
+{
+	struct KeyTypeInfo
+	{
+		int			_type;
+		const char*	_name;
+	};
+
+	const KeyTypeInfo keyTypes[] =
+	{
+		{ int_Key, "int" },
+		{ long_Key, "long" },
+		{ datetime_Key, "datetime" },
+		{ double_Key, "double" },
+		{ int_int_Key, "int_int" },
+		{ int_datetime_Key, "int_datetime" },
+		{ int_int_int_Key, "int_int_int" },
+		{ int_int_datetime_Key, "int_int_datetime" },
+		{ int_datetime_int_Key, "int_datetime_int" }
+	};
+
+	// compound keys get 16 second parts per first part
+	void SetKeyValue( int type, BTreeKeyBase* key, int value, int offset )
+	{
+		switch( type )
+		{
+			case int_Key:
+			{
+				static_cast< BTreeKey<int>* >( key )->SetKey( value );
+				break;
+			}
+			case long_Key:
+			case datetime_Key:
+			{
+				long theKey = value;
+				static_cast< BTreeKey<long>* >( key )->SetKey( theKey * 10000000 );
+				break;
+			}
+			case double_Key:
+			{
+				static_cast< BTreeKey<double>* >( key )->SetKey( value * 0.5 );
+				break;
+			}
+			case int_int_Key:
+			{
+				CompoundKey<int,int> theKey;
+				theKey._first = value >> 4;
+				theKey._second = value & 15;
+				static_cast< BTreeKey< CompoundKey<int,int> >* >( key )->SetKey( theKey );
+				break;
+			}
+			case int_datetime_Key:
+			{
+				CompoundKey<int,long> theKey;
+				theKey._first = value >> 4;
+				theKey._second = value & 15;
+				static_cast< BTreeKey< CompoundKey<int,long> >* >( key )->SetKey( theKey );
+				break;
+			}
+			case int_int_int_Key:
+			{
+				CompoundKeyWithValue<int,int,int> theKey;
+				theKey._first = value >> 4;
+				theKey._second = value & 15;
+				theKey.SetValue( value );
+				static_cast< BTreeKey< CompoundKeyWithValue<int,int,int> >* >( key )->SetKey( theKey );
+				break;
+			}
+			case int_int_datetime_Key:
+			{
+				CompoundKeyWithValue<int,int,long> theKey;
+				theKey._first = value >> 4;
+				theKey._second = value & 15;
+				theKey.SetValue( value );
+				static_cast< BTreeKey< CompoundKeyWithValue<int,int,long> >* >( key )->SetKey( theKey );
+				break;
+			}
+			case int_datetime_int_Key:
+			{
+				CompoundKeyWithValue<int,long,int> theKey;
+				theKey._first = value >> 4;
+				theKey._second = value & 15;
+				theKey.SetValue( value );
+				static_cast< BTreeKey< CompoundKeyWithValue<int,long,int> >* >( key )->SetKey( theKey );
+				break;
+			}
+		}
+		key->SetOffset( offset );
+	}
+
+	// deterministic, so runs on different machines are comparable
+	unsigned NextRandom( unsigned& seed )
+	{
+		seed = seed * 1103515245 + 12345;
+		return seed >> 8;
+	}
+
+	void Shuffle( std::vector< int >& values, unsigned seed )
+	{
+		for( int i = (int) values.size() - 1; i > 0; --i )
+		{
+			int j = (int) ( NextRandom( seed ) % (unsigned) ( i + 1 ) );
+			int t = values[ i ];
+			values[ i ] = values[ j ];
+			values[ j ] = t;
+		}
+	}
+
+	// upper bound in microseconds of the bucket holding the given share of timed operations
+	__int64 GetPercentile( BTreeCounters& counters, int operation, double share )
+	{
+		__int64 total = 0;
+		for( int i = 0; i < LATENCY_BUCKETS; ++i )
+		{
+			total += counters.GetLatencies( operation, i );
+		}
+		if( total == 0 )
+		{
+			return 0;
+		}
+		__int64 seen = 0;
+		for( int i = 0; i < LATENCY_BUCKETS; ++i )
+		{
+			seen += counters.GetLatencies( operation, i );
+			if( seen >= total * share )
+			{
+				return ( (__int64) 1 ) << i;
+			}
+		}
+		return ( (__int64) 1 ) << ( LATENCY_BUCKETS - 1 );
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	// one btree file and the keys the workloads are run with
+	///////////////////////////////////////////////////////////////////////////
+
+	class Benchmark
+	{
+	public:
+
+		Benchmark( const KeyTypeInfo& keyType, int keys, int cachePages, const char* path )
+			: _keyType( keyType ), _keys( keys ), _cachePages( cachePages ), _path( path ), _file( -1 ), _index( 0 )
+		{
+			_key = TypeFactory::NewKey( keyType._type );
+			_lastKey = TypeFactory::NewKey( keyType._type );
+		}
+		~Benchmark()
+		{
+			Close();
+			TypeFactory::DeleteKey( _key );
+			TypeFactory::DeleteKey( _lastKey );
+			remove( _path );
+		}
+
+		void Run()
+		{
+			std::vector< int > values( _keys );
+			for( int i = 0; i < _keys; ++i )
+			{
+				values[ i ] = i;
+			}
+
+			remove( _path );
+			Open();
+			Start();
+			for( int i = 0; i < _keys; ++i )
+			{
+				Insert( values[ i ] );
+			}
+			Report( "sequential insert", _keys, insert_Operation );
+
+			Shuffle( values, 1 );
+			_index->Clear();
+			Start();
+			for( int i = 0; i < _keys; ++i )
+			{
+				Insert( values[ i ] );
+			}
+			Report( "random insert", _keys, insert_Operation );
+
+			Shuffle( values, 2 );
+			int found = 0;
+			int lookups = ( _keys < 100000 ) ? _keys : 100000;
+			Start();
+			for( int i = 0; i < lookups; ++i )
+			{
+				Seek( values[ i ], values[ i ] );
+			}
+			Report( "point lookup", lookups, lookup_Operation );
+
+			Start();
+			_cursor.SeekAll( *_index, true );
+			found = Scan();
+			Report( "full scan", found, lookup_Operation );
+
+			// ranges of about a hundred keys
+			int ranges = ( _keys / 100 < 1000 ) ? _keys / 100 : 1000;
+			found = 0;
+			Start();
+			for( int i = 0; i < ranges; ++i )
+			{
+				int first = values[ i ] % ( _keys - 100 );
+				found += Seek( first, first + 99 );
+			}
+			Report( "range scan", found, lookup_Operation );
+
+			int operations = lookups;
+			int inserted = _keys;
+			int deleted = 0;
+			unsigned seed = 3;
+			Start();
+			for( int i = 0; i < operations; ++i )
+			{
+				unsigned choice = NextRandom( seed ) % 10;
+				if( choice < 7 )
+				{
+					int value = (int) ( NextRandom( seed ) % (unsigned) inserted );
+					Seek( value, value );
+				}
+				else if( choice < 9 )
+				{
+					Insert( inserted++ );
+				}
+				else
+				{
+					Delete( values[ deleted++ ] );
+				}
+			}
+			Report( "mixed 70/20/10", operations, lookup_Operation );
+
+			// three of four keys left by the mixed workload are deleted at random
+			Start();
+			int remaining = _keys - deleted;
+			for( int i = 0; i < remaining * 3 / 4; ++i )
+			{
+				Delete( values[ deleted++ ] );
+			}
+			Report( "random delete", remaining * 3 / 4, delete_Operation );
+
+			// every other checked key is one of the randomly deleted, so missing keys are
+			// spread over all pages
+			int checks = ( _keys - deleted < deleted ) ? _keys - deleted : deleted;
+			if( checks > lookups / 2 )
+			{
+				checks = lookups / 2;
+			}
+			_index->SetPageFilters( true );
+			found = 0;
+			Start();
+			for( int i = 0; i < checks * 2; ++i )
+			{
+				int value = ( i & 1 ) ? values[ deleted + i / 2 ] : values[ deleted - 1 - i / 2 ];
+				SetKeyValue( _keyType._type, _key, value, value );
+				found += _index->Contains( *_key, *_key ) ? 1 : 0;
+			}
+			Report( "existence check", checks * 2, lookup_Operation );
+			if( found != checks )
+			{
+				printf( "  %d keys found instead of %d\n", found, checks );
+			}
+			_index->SetPageFilters( false );
+
+			int fileLength = GetIndexFileLength( _file );
+			Start();
+			while( _index->Compact( 10 ) ) {}
+			Report( "compaction", (int) _index->GetCounters().Get( merges_Counter ), -1 );
+			printf( "  file shrunk from %d to %d bytes\n", fileLength, GetIndexFileLength( _file ) );
+
+			Start();
+			Close();
+			Open();
+			Report( "reopen", 1, -1 );
+			if( _index->GetCount() != inserted - deleted )
+			{
+				printf( "  count mismatch after reopen: %d instead of %d\n", _index->GetCount(), inserted - deleted );
+			}
+		}
+
+	private:
+
+		void Open()
+		{
+			_file = OpenIndexFile( _path );
+			if( _file == -1 )
+			{
+				throw BTreeIndexError( io_Error, "Failed to open benchmark file" );
+			}
+			_index = new BTreeIndex( _keyType._type, default_Geometry );
+			_index->GetPagesCache().SetSize( (unsigned) _cachePages );
+			if( _index->Open( _file ) > closed_Open )
+			{
+				throw BTreeIndexError( io_Error, "Failed to load BTree header" );
+			}
+		}
+
+		void Close()
+		{
+			if( _index )
+			{
+				_index->Flush();
+				_index->SaveHeader( _file );
+				delete _index;
+				_index = 0;
+			}
+			if( _file != -1 )
+			{
+				CloseIndexFile( _file );
+				_file = -1;
+			}
+		}
+
+		void Insert( int value )
+		{
+			SetKeyValue( _keyType._type, _key, value, value );
+			_index->Insert( *_key );
+		}
+
+		void Delete( int value )
+		{
+			SetKeyValue( _keyType._type, _key, value, value );
+			_index->Delete( *_key );
+		}
+
+		int Seek( int first, int last )
+		{
+			SetKeyValue( _keyType._type, _key, first, 0 );
+			SetKeyValue( _keyType._type, _lastKey, last, MAX_OFFSET );
+			_cursor.SeekRange( *_index, *_key, *_lastKey, true );
+			return Scan();
+		}
+
+		int Scan()
+		{
+			int found = 0;
+			while( _cursor.NextPage() )
+			{
+				found += _cursor.GetCount();
+			}
+			return found;
+		}
+
+		void Start()
+		{
+			if( _index )
+			{
+				_index->GetCounters().Reset();
+			}
+			_start = GetTicks();
+		}
+
+		void Report( const char* workload, int operations, int operation )
+		{
+			double seconds = (double) ( GetTicks() - _start ) / (double) GetTicksPerSecond();
+			BTreeCounters& counters = _index->GetCounters();
+			printf( "%-17s %-17s %10.0f ops/s %8d reads %8d writes",
+				_keyType._name, workload, ( seconds > 0 ) ? operations / seconds : 0.0,
+				(int) counters.Get( pageReads_Counter ), (int) counters.Get( pageWrites_Counter ) );
+			if( operation >= 0 )
+			{
+				printf( "   p50 <= %dus p99 <= %dus",
+					(int) GetPercentile( counters, operation, 0.5 ), (int) GetPercentile( counters, operation, 0.99 ) );
+			}
+			else
+			{
+				printf( "   %.3fms", seconds * 1000 );
+			}
+			printf( "\n" );
+		}
+
+		const KeyTypeInfo&	_keyType;
+		int					_keys;
+		int					_cachePages;
+		const char*			_path;
+		int					_file;
+		BTreeIndex*			_index;
+		BTreeCursor			_cursor;
+		BTreeKeyBase*		_key;
+		BTreeKeyBase*		_lastKey;
+		__int64				_start;
+	};
+}
+
+int main( int argc, char* argv[] )
+{
+	int keys = ( argc > 1 ) ? atoi( argv[ 1 ] ) : 200000;
+	int cachePages = ( argc > 2 ) ? atoi( argv[ 2 ] ) : 32;
+	const char* directory = ( argc > 3 ) ? argv[ 3 ] : ".";
+	if( keys < 1000 || cachePages < 2 )
+	{
+		printf( "Usage: DBIndexBenchmark [keys >= 1000 [cachePages >= 2 [directory]]]\n" );
+		return 1;
+	}
+	char path[ 1024 ];
+	sprintf( path, "%.1000s/DBIndexBenchmark.btree", directory );
+
+	DBIndexHeapObject::CreateHeap();
+	printf( "%d keys, %d cached pages\n", keys, cachePages );
+	for( unsigned i = 0; i < sizeof( keyTypes ) / sizeof( keyTypes[ 0 ] ); ++i )
+	{
+		try
+		{
+			Benchmark benchmark( keyTypes[ i ], keys, cachePages, path );
+			benchmark.Run();
+		}
+		catch( const BTreeIndexError& error )
+		{
+			printf( "%s: %s\n", keyTypes[ i ]._name, error.GetMessage() );
+			return 2;
+		}
+	}
+	return 0;
+}
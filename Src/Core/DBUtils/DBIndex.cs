@@ -21,9 +21,13 @@ namespace JetBrains.Omea.Database
         void SearchForRange( IntArrayList offsets, IComparable firstKey, IComparable secondKey );
         void SearchForRange( ArrayList offsets, IComparable firstKey, IComparable secondKey );
         IEnumerable SearchForRange( IComparable firstKey, IComparable secondKey );
+        void SearchForRange( KeyColumns columns, IComparable firstKey, IComparable secondKey );
+        bool ContainsEntry( IComparable key, int offset );
+        bool ContainsEntry( IComparable key );
 
         void GetAllOffsets( IntArrayList offsets );
         void GetAllOffsets( ArrayList offsets );
+        void GetAllOffsets( KeyColumns columns );
         IEnumerable GetAllKeys();
         int Count { get; }
         int AddIndexEntry( IComparable key, int offset );
@@ -39,10 +43,12 @@ namespace JetBrains.Omea.Database
         FixedLengthKey SearchKeySecond();
         FixedLengthKey SearchKeyValue();
 
-        void Defragment( bool idleMode );
+        // see IBTree.Compact()
+        bool Compact( int milliseconds );
 
         int LoadedPages { get; }
         int PageSize { get; }
+        BTreeStatistics Statistics { get; }
     }
 
     public class DBIndex : IDBIndex
@@ -66,6 +72,8 @@ namespace JetBrains.Omea.Database
 
         public static readonly int  _minimumCacheSize = 10;
         public static int           _cacheSizeMultiplier = 1;
+        // page filters make existence checks of missing entries cheap at the cost of memory
+        public static bool          _usePageFilters = false;
 
         internal DBIndex( ITableDesign tableDesign, string name, FixedLengthKey fixedFactory,
             FixedLengthKey fixedFactory1, FixedLengthKey fixedFactory2, FixedLengthKey fixedFactoryValue )
@@ -168,6 +176,7 @@ namespace JetBrains.Omea.Database
             {
                 _isOpen = true;
                 RefreshCacheSize();
+                _bTree.SetPageFilters( _usePageFilters );
                 return _bTree.Open();
             }
             return true;
@@ -219,6 +228,10 @@ namespace JetBrains.Omea.Database
         {
             _bTree.GetAllKeys( keys_offsets );
         }
+        public void GetAllOffsets( KeyColumns columns )
+        {
+            _bTree.GetAllKeys( columns );
+        }
         public IEnumerable GetAllKeys()
         {
             return _bTree.GetAllKeys();
@@ -236,6 +249,12 @@ namespace JetBrains.Omea.Database
             _searchEnd.Key = secondKey;
             _bTree.SearchForRange( _searchBegin, _searchEnd, keys_offsets );
         }
+        public void SearchForRange( KeyColumns columns, IComparable firstKey, IComparable secondKey )
+        {
+            _searchBegin.Key = firstKey;
+            _searchEnd.Key = secondKey;
+            _bTree.SearchForRange( _searchBegin, _searchEnd, columns );
+        }
 
         public IEnumerable SearchForRange( IComparable firstKey, IComparable secondKey )
         {
@@ -262,6 +281,17 @@ namespace JetBrains.Omea.Database
                 }
             }*/
         }
+        public bool ContainsEntry( IComparable key, int offset )
+        {
+            _searchBegin.Key = key;
+            return _bTree.ContainsKey( _searchBegin, offset );
+        }
+        public bool ContainsEntry( IComparable key )
+        {
+            _searchBegin.Key = key;
+            return _bTree.ContainsKey( _searchBegin );
+        }
+
         public void RemoveIndexEntry( IComparable key, int offset )
         {
             _searchBegin.Key = key;
@@ -275,33 +305,9 @@ namespace JetBrains.Omea.Database
             return 0;
         }
 
-        public void Defragment( bool idleMode )
+        public bool Compact( int milliseconds )
         {
-            IEnumerable keys = _bTree.GetAllKeys();
-            OmniaMeaBTree defragmented = new OmniaMeaBTree( _fullName + ".defrag", _fixedFactory );
-            defragmented.Open();
-            try
-            {
-                defragmented.Clear();
-                foreach( KeyPair pair in keys )
-                {
-                    if( idleMode && !Core.IsSystemIdle )
-                    {
-                        return;
-                    }
-                    defragmented.InsertKey( pair._key, pair._offset );
-                }
-            }
-            finally
-            {
-                defragmented.Close();
-            }
-            _bTree.Close();
-            File.Delete( _fullName );
-            File.Move( _fullName + ".defrag", _fullName );
-            _bTree = new OmniaMeaBTree( _fullName, _fixedFactory );
-            _isOpen = false;
-            Open();
+            return _bTree.Compact( milliseconds );
         }
 
         public int LoadedPages
@@ -313,5 +319,10 @@ namespace JetBrains.Omea.Database
         {
             get { return _bTree.GetPageSize(); }
         }
+
+        public BTreeStatistics Statistics
+        {
+            get { return _bTree.GetStatistics(); }
+        }
     }
 }
@@ -55,6 +55,7 @@ namespace JetBrains.Omea.Database
         ICountedResultSet CreateResultSetForRange( int firstColumnIndex, object firstKey, int secondColumnIndex, object beginKey, object endKey );
         ICountedResultSet CreateResultSet( int columnIndex );
         ICountedResultSet CreateResultSet( int columnIndex1, object key1, int columnIndex2, object key2, bool readOnly );
+        bool ContainsRecord( int columnIndex1, object key1, int columnIndex2, object key2, object value );
         ICountedResultSet EmptyResultSet{ get; }
         IRecord GetRecord( int offset );
         IRecord GetRecordByEqual( int columnIndex, object key );
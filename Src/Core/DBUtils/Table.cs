@@ -67,6 +67,9 @@ namespace JetBrains.Omea.Database
         private long _loadedRecordSize = 0, _savedRecordSize = 0;
         private bool _autoFlush = true;
 
+        // milliseconds an index is compacted for while the table is locked
+        private const int _indexCompactionSlice = 50;
+
         #endregion
 
         internal Table( Database database, TableStructure tblStructure )
@@ -147,6 +150,14 @@ namespace JetBrains.Omea.Database
             long loadedBytes = dbIndex.LoadedPages * dbIndex.PageSize;
             Trace.WriteLine( "    " + dbIndex.Name + ": loaded " + dbIndex.LoadedPages + " pages (" +
                 Utils.SizeToString( loadedBytes ) + ")" );
+            BTreeStatistics statistics = dbIndex.Statistics;
+            if( statistics != null )
+            {
+                foreach( string line in statistics.ToString().Split( '\n' ) )
+                {
+                    Trace.WriteLine( "        " + line.TrimEnd( '\r' ) );
+                }
+            }
             return loadedBytes;
         }
 
@@ -1230,6 +1241,38 @@ namespace JetBrains.Omea.Database
             }
         }
 
+        /// <summary>
+        /// Checks whether a record with the values exists, using the compound index with value
+        /// on the two columns. No records are read, so the value column must not be a string.
+        /// </summary>
+        public bool ContainsRecord( int columnIndex1, object key1, int columnIndex2, object key2, object value )
+        {
+            CompoundIndexWithValue compoundIndexWV =
+                _indexesCompoundMapWithValue[(columnIndex1 << 6)+columnIndex2] as CompoundIndexWithValue;
+            if ( compoundIndexWV == null || value is string )
+            {
+                throw new Exception( "No index" );
+            }
+            if ( !_canUpdate )
+            {
+                string strKey1 = key1 as string;
+                if ( strKey1 != null )
+                {
+                    key1 = DBHelper.GetHashCodeInLowerCase( strKey1 );
+                }
+                string strKey2 = key2 as string;
+                if ( strKey2 != null )
+                {
+                    key2 = DBHelper.GetHashCodeInLowerCase( strKey2 );
+                }
+            }
+            lock( this )
+            {
+                SetCompoundKey( _compoundAndValue, key1, key2, value );
+                return compoundIndexWV._dbIndex.ContainsEntry( _compoundAndValue );
+            }
+        }
+
         public ICountedResultSet CreateModifiableResultSet( int columnIndex, object key )
         {
             return CreateResultSet( columnIndex, key, false );
@@ -1810,14 +1853,22 @@ namespace JetBrains.Omea.Database
                         indexes.Add( compoundIndex._dbIndex );
                     }
                 }
+            }
 
-                foreach( IDBIndex dbIndex in indexes )
+            // indexes are compacted in slices, so the table is locked for a slice at a time
+            foreach( IDBIndex dbIndex in indexes )
+            {
+                bool compacting = true;
+                while( compacting )
                 {
                     if( idleMode && !Core.IsSystemIdle )
                     {
-                        break;
+                        return;
+                    }
+                    lock( this )
+                    {
+                        compacting = dbIndex.Compact( _indexCompactionSlice );
                     }
-                    dbIndex.Defragment( idleMode );
                 }
             }
         }
@@ -829,6 +829,311 @@ namespace JetBrains.Omea.Containers
         }
     }
 
+    /// <summary>
+    /// Performance counters of a BTree, in the order they are kept by the native implementation.
+    /// </summary>
+    public enum BTreeCounter
+    {
+        Lookups, Inserts, Deletes, Splits, Merges, PageReads, PageWrites, BytesRead, BytesWritten, Evictions, FilterSkips
+    }
+
+    /// <summary>
+    /// BTree operations which latencies are counted.
+    /// </summary>
+    public enum BTreeOperation
+    {
+        Lookup, Insert, Delete, PageRead, PageWrite
+    }
+
+    /// <summary>
+    /// Snapshot of performance counters and latency histograms of a BTree.
+    /// Latencies are counted in logarithmic buckets: bucket 0 holds operations faster than
+    /// a microsecond, bucket i holds operations taking from 2^(i-1) to 2^i microseconds,
+    /// the last bucket holds all slower operations.
+    /// </summary>
+    public class BTreeStatistics
+    {
+        public const int LatencyBuckets = 24;
+
+        private readonly long[] _counters;
+        private readonly long[,] _latencies;
+
+        public BTreeStatistics( long[] counters, long[,] latencies )
+        {
+            _counters = counters;
+            _latencies = latencies;
+        }
+
+        public long this[ BTreeCounter counter ]
+        {
+            get { return _counters[ (int) counter ]; }
+        }
+
+        public long GetLatencies( BTreeOperation operation, int bucket )
+        {
+            return _latencies[ (int) operation, bucket ];
+        }
+
+        public long GetTimedOperations( BTreeOperation operation )
+        {
+            long result = 0;
+            for( int i = 0; i < LatencyBuckets; ++i )
+            {
+                result += _latencies[ (int) operation, i ];
+            }
+            return result;
+        }
+
+        /// <summary>
+        /// Returns upper bound in microseconds of latencies of the bucket,
+        /// or -1 for the last bucket which is unbounded.
+        /// </summary>
+        public static long GetBucketBound( int bucket )
+        {
+            return ( bucket < LatencyBuckets - 1 ) ? 1L << bucket : -1;
+        }
+
+        /// <summary>
+        /// Returns the bucket within which the given fraction of operations is completed,
+        /// or -1 if the operation wasn't timed.
+        /// </summary>
+        public int GetPercentileBucket( BTreeOperation operation, double fraction )
+        {
+            long total = GetTimedOperations( operation );
+            if( total == 0 )
+            {
+                return -1;
+            }
+            long count = 0;
+            for( int i = 0; i < LatencyBuckets - 1; ++i )
+            {
+                count += _latencies[ (int) operation, i ];
+                if( count >= total * fraction )
+                {
+                    return i;
+                }
+            }
+            return LatencyBuckets - 1;
+        }
+
+        public override string ToString()
+        {
+            StringWriter writer = new StringWriter();
+            for( BTreeCounter counter = BTreeCounter.Lookups; counter <= BTreeCounter.FilterSkips; ++counter )
+            {
+                if( counter != BTreeCounter.Lookups )
+                {
+                    writer.Write( ", " );
+                }
+                writer.Write( counter + " " + this[ counter ] );
+            }
+            for( BTreeOperation operation = BTreeOperation.Lookup; operation <= BTreeOperation.PageWrite; ++operation )
+            {
+                long total = GetTimedOperations( operation );
+                if( total != 0 )
+                {
+                    writer.WriteLine();
+                    writer.Write( operation + ": " + total + " timed, 50% < " +
+                        BucketToString( GetPercentileBucket( operation, 0.5 ) ) + ", 99% < " +
+                        BucketToString( GetPercentileBucket( operation, 0.99 ) ) + ", max < " +
+                        BucketToString( GetPercentileBucket( operation, 1.0 ) ) );
+                }
+            }
+            return writer.ToString();
+        }
+
+        private static string BucketToString( int bucket )
+        {
+            long bound = GetBucketBound( bucket );
+            return ( bound < 0 ) ? "infinity" : bound + " us";
+        }
+    }
+
+    /// <summary>
+    /// Types of parts of keys kept in KeyColumns.
+    /// </summary>
+    public enum KeyPartType
+    {
+        None, Int, Long, Double
+    }
+
+    /// <summary>
+    /// Keys found by a query stored column-wise in parallel arrays, so that large results
+    /// don't allocate objects per key. Int parts of keys go to the Int columns, long parts
+    /// and ticks of DateTime parts go to the Long columns, double keys go to FirstDoubles.
+    /// Simple keys have only the first part, compound keys have the second part, and
+    /// compound keys with value have the value part as well. Columns of parts the keys
+    /// don't have are null or left as they are. Arrays are longer than Count, they grow
+    /// as needed and are reused if the same instance is passed to subsequent queries.
+    /// </summary>
+    public class KeyColumns
+    {
+        private const int _initialCapacity = 64;
+
+        private int _count;
+        private int _capacity;
+
+        public int[] Offsets;
+        public int[] FirstInts;
+        public long[] FirstLongs;
+        public double[] FirstDoubles;
+        public int[] SecondInts;
+        public long[] SecondLongs;
+        public int[] ValueInts;
+        public long[] ValueLongs;
+
+        public int Count
+        {
+            get { return _count; }
+        }
+
+        /// <summary>
+        /// Forgets keys, but keeps the arrays.
+        /// </summary>
+        public void Clear()
+        {
+            _count = 0;
+        }
+
+        /// <summary>
+        /// Makes room for count more keys in offsets and in the columns of the given part types,
+        /// returns index of the first of the keys. The keys are counted at once, so the caller
+        /// should fill all of them.
+        /// </summary>
+        public int Append( int count, KeyPartType first, KeyPartType second, KeyPartType value )
+        {
+            int start = _count;
+            int newCount = _count + count;
+            if( newCount > _capacity )
+            {
+                int capacity = ( _capacity == 0 ) ? _initialCapacity : _capacity;
+                while( capacity < newCount )
+                {
+                    capacity <<= 1;
+                }
+                _capacity = capacity;
+                Offsets = Grow( Offsets );
+                FirstInts = Grow( FirstInts );
+                FirstLongs = Grow( FirstLongs );
+                FirstDoubles = Grow( FirstDoubles );
+                SecondInts = Grow( SecondInts );
+                SecondLongs = Grow( SecondLongs );
+                ValueInts = Grow( ValueInts );
+                ValueLongs = Grow( ValueLongs );
+            }
+            if( Offsets == null )
+            {
+                Offsets = new int[ _capacity ];
+            }
+            PrepareColumn( first, ref FirstInts, ref FirstLongs, ref FirstDoubles );
+            double[] noDoubles = null;
+            PrepareColumn( second, ref SecondInts, ref SecondLongs, ref noDoubles );
+            PrepareColumn( value, ref ValueInts, ref ValueLongs, ref noDoubles );
+            _count = newCount;
+            return start;
+        }
+
+        /// <summary>
+        /// Appends a key of a KeyPair, used by implementations which don't fill columns in bulk.
+        /// </summary>
+        public void Add( KeyPair pair )
+        {
+            IComparable key = pair._key.Key;
+            Compound compound = key as Compound;
+            CompoundAndValue compoundAndValue = key as CompoundAndValue;
+            int index;
+            if( compound != null )
+            {
+                index = Append( 1, GetPartType( compound._key1 ), GetPartType( compound._key2 ), KeyPartType.None );
+                SetPart( compound._key1, index, FirstInts, FirstLongs, FirstDoubles );
+                SetPart( compound._key2, index, SecondInts, SecondLongs, null );
+            }
+            else if( compoundAndValue != null )
+            {
+                index = Append( 1, GetPartType( compoundAndValue._key1 ), GetPartType( compoundAndValue._key2 ),
+                    GetPartType( compoundAndValue._value ) );
+                SetPart( compoundAndValue._key1, index, FirstInts, FirstLongs, FirstDoubles );
+                SetPart( compoundAndValue._key2, index, SecondInts, SecondLongs, null );
+                SetPart( compoundAndValue._value, index, ValueInts, ValueLongs, null );
+            }
+            else
+            {
+                index = Append( 1, GetPartType( key ), KeyPartType.None, KeyPartType.None );
+                SetPart( key, index, FirstInts, FirstLongs, FirstDoubles );
+            }
+            Offsets[ index ] = pair._offset;
+        }
+
+        private T[] Grow<T>( T[] column )
+        {
+            if( column == null )
+            {
+                return null;
+            }
+            T[] result = new T[ _capacity ];
+            Array.Copy( column, result, _count );
+            return result;
+        }
+
+        private void PrepareColumn( KeyPartType type, ref int[] ints, ref long[] longs, ref double[] doubles )
+        {
+            switch( type )
+            {
+                case KeyPartType.Int:
+                    if( ints == null )
+                    {
+                        ints = new int[ _capacity ];
+                    }
+                    break;
+                case KeyPartType.Long:
+                    if( longs == null )
+                    {
+                        longs = new long[ _capacity ];
+                    }
+                    break;
+                case KeyPartType.Double:
+                    if( doubles == null )
+                    {
+                        doubles = new double[ _capacity ];
+                    }
+                    break;
+            }
+        }
+
+        private static KeyPartType GetPartType( IComparable part )
+        {
+            if( part is int )
+            {
+                return KeyPartType.Int;
+            }
+            if( part is double )
+            {
+                return KeyPartType.Double;
+            }
+            return KeyPartType.Long;
+        }
+
+        private static void SetPart( IComparable part, int index, int[] ints, long[] longs, double[] doubles )
+        {
+            if( part is int )
+            {
+                ints[ index ] = (int) part;
+            }
+            else if( part is double )
+            {
+                doubles[ index ] = (double) part;
+            }
+            else if( part is DateTime )
+            {
+                longs[ index ] = ((DateTime) part).Ticks;
+            }
+            else
+            {
+                longs[ index ] = Convert.ToInt64( part );
+            }
+        }
+    }
+
     /// <summary>
     /// interface to a BTree implementation
     /// is declared as abstract class in order to be able to define static flag
@@ -851,9 +1156,89 @@ namespace JetBrains.Omea.Containers
         public abstract void SearchForRange( IFixedLengthKey beginKey, IFixedLengthKey endKey, ArrayList keys_offsets );
         public abstract IEnumerable SearchForRange( IFixedLengthKey beginKey, IFixedLengthKey endKey );
 
+        /// <summary>
+        /// Appends keys in range or all keys to the columns. The default is to collect KeyPairs
+        /// and to copy them, implementations should fill columns without allocating per key.
+        /// </summary>
+        public virtual void SearchForRange( IFixedLengthKey beginKey, IFixedLengthKey endKey, KeyColumns columns )
+        {
+            ArrayList keys_offsets = new ArrayList();
+            SearchForRange( beginKey, endKey, keys_offsets );
+            foreach( KeyPair pair in keys_offsets )
+            {
+                columns.Add( pair );
+            }
+        }
+
+        public virtual void GetAllKeys( KeyColumns columns )
+        {
+            ArrayList keys_offsets = new ArrayList();
+            GetAllKeys( keys_offsets );
+            foreach( KeyPair pair in keys_offsets )
+            {
+                columns.Add( pair );
+            }
+        }
+
+        /// <summary>
+        /// Returns the number of keys in range without collecting them.
+        /// </summary>
+        public virtual int CountRange( IFixedLengthKey beginKey, IFixedLengthKey endKey )
+        {
+            IntArrayList offsets = new IntArrayList();
+            SearchForRange( beginKey, endKey, offsets );
+            return offsets.Count;
+        }
+
         public abstract void DeleteKey( IFixedLengthKey key, int offset );
         public abstract void InsertKey( IFixedLengthKey key, int offset );
 
+        /// <summary>
+        /// Checks whether the key with the offset is in the BTree.
+        /// </summary>
+        public virtual bool ContainsKey( IFixedLengthKey key, int offset )
+        {
+            IntArrayList offsets = new IntArrayList();
+            SearchForRange( key, key, offsets );
+            return offsets.IndexOf( offset ) >= 0;
+        }
+
+        /// <summary>
+        /// Checks whether the key is in the BTree with any offset.
+        /// </summary>
+        public virtual bool ContainsKey( IFixedLengthKey key )
+        {
+            return CountRange( key, key ) > 0;
+        }
+
+        /// <summary>
+        /// Enables in-memory filters of keys in pages, so that ContainsKey() mostly doesn't
+        /// read pages for missing keys. The default is to ignore the setting.
+        /// </summary>
+        public virtual void SetPageFilters( bool enabled )
+        {
+        }
+
+        /// <summary>
+        /// Deletes or inserts a batch of KeyPairs. Implementations may sort the batch
+        /// and apply it page by page, the default is to process keys one by one.
+        /// </summary>
+        public virtual void DeleteKeys( ArrayList keys_offsets )
+        {
+            foreach( KeyPair pair in keys_offsets )
+            {
+                DeleteKey( pair._key, pair._offset );
+            }
+        }
+
+        public virtual void InsertKeys( ArrayList keys_offsets )
+        {
+            foreach( KeyPair pair in keys_offsets )
+            {
+                InsertKey( pair._key, pair._offset );
+            }
+        }
+
         public abstract int MaxCount { get; }
         public abstract int Count { get; }
 
@@ -863,6 +1248,28 @@ namespace JetBrains.Omea.Containers
         public abstract int GetLoadedPages();
         public abstract int GetPageSize();
 
+        /// <summary>
+        /// Works for about the given time on a compaction pass merging underfull pages and
+        /// shrinking the file, returns false when the pass is completed. The btree may be
+        /// modified between calls. The default is not to compact.
+        /// </summary>
+        public virtual bool Compact( int milliseconds )
+        {
+            return false;
+        }
+
+        /// <summary>
+        /// Returns snapshot of performance counters, or null if the implementation doesn't keep them.
+        /// </summary>
+        public virtual BTreeStatistics GetStatistics()
+        {
+            return null;
+        }
+
+        public virtual void ResetStatistics()
+        {
+        }
+
         public static bool _bUseOldKeys = false;
     }
 
@@ -1269,6 +1269,530 @@ namespace OmniaMeaBaseTests
             }
         }
 
+        [Test]
+        public void BatchInsertingAndDeletingKeys()
+        {
+            const int keysCount = 30000;
+            TestKey keyFactory = new TestKey();
+            IBTree bTree = new /*BTree*/OmniaMeaBTree( _indexFileName, keyFactory );
+            using( bTree )
+            {
+                bTree.Open();
+                Random random = new Random( 17 );
+                ArrayList batch = new ArrayList();
+                for( int i = 0; i < keysCount; i++ )
+                {
+                    // every key value occurs twice with different offsets
+                    int key = ( i * 7919 ) % ( keysCount / 2 );
+                    batch.Add( new KeyPair( new TestKey( key ), i ) );
+                    if( batch.Count == 1000 || random.Next( 100 ) == 0 )
+                    {
+                        bTree.InsertKeys( batch );
+                        batch.Clear();
+                    }
+                }
+                bTree.InsertKeys( batch );
+                Assert.AreEqual( keysCount, bTree.Count );
+
+                ArrayList keys_offsets = new ArrayList();
+                bTree.GetAllKeys( keys_offsets );
+                Assert.AreEqual( keysCount, keys_offsets.Count );
+                for( int j = 1; j < keys_offsets.Count; ++j )
+                {
+                    KeyPair pair1 = (KeyPair) keys_offsets[ j - 1 ];
+                    KeyPair pair2 = (KeyPair) keys_offsets[ j ];
+                    Assert.IsTrue( pair1._key.CompareTo( pair2._key ) <= 0, "Invalid key order, j = " + j );
+                }
+
+                batch.Clear();
+                for( int i = 1; i < keysCount; i += 2 )
+                {
+                    batch.Add( new KeyPair( new TestKey( ( i * 7919 ) % ( keysCount / 2 ) ), i ) );
+                }
+                bTree.DeleteKeys( batch );
+                Assert.AreEqual( keysCount / 2, bTree.Count );
+
+                bTree.Close();
+                bTree.Open();
+                Assert.AreEqual( keysCount / 2, bTree.Count );
+                IntArrayList offsets = new IntArrayList();
+                for( int i = 0; i < keysCount; i += 101 )
+                {
+                    offsets.Clear();
+                    int key = ( i * 7919 ) % ( keysCount / 2 );
+                    bTree.SearchForRange( new TestKey( key ), new TestKey( key ), offsets );
+                    Assert.AreEqual( ( i & 1 ) == 0, FindOffset( offsets, i ), i.ToString() );
+                }
+                bTree.Close();
+            }
+        }
+
+        [Test]
+        public void CountingKeysInRange()
+        {
+            const int keysCount = 20000;
+            IBTree bTree = new /*BTree*/OmniaMeaBTree( _indexFileName, new TestKey() );
+            using( bTree )
+            {
+                bTree.Open();
+                for( int i = 0; i < keysCount; i++ )
+                {
+                    bTree.InsertKey( new TestKey( i % 1000 ), i );
+                }
+                for( int i = 0; i < keysCount; i += 3 )
+                {
+                    bTree.DeleteKey( new TestKey( i % 1000 ), i );
+                }
+                CheckCountRange( bTree );
+                bTree.Close();
+                bTree.Open();
+                CheckCountRange( bTree );
+                for( int i = 0; i < keysCount; i += 3 )
+                {
+                    bTree.InsertKey( new TestKey( i % 1000 ), i );
+                }
+                CheckCountRange( bTree );
+                Assert.AreEqual( keysCount, bTree.CountRange( new TestKey( 0 ), new TestKey( 999 ) ) );
+                bTree.Close();
+            }
+        }
+
+        private static void CheckCountRange( IBTree bTree )
+        {
+            IntArrayList offsets = new IntArrayList();
+            for( int first = -10; first < 1010; first += 97 )
+            {
+                for( int last = first; last < 1010; last += 211 )
+                {
+                    offsets.Clear();
+                    bTree.SearchForRange( new TestKey( first ), new TestKey( last ), offsets );
+                    Assert.AreEqual( offsets.Count, bTree.CountRange( new TestKey( first ), new TestKey( last ) ),
+                        first + ".." + last );
+                }
+            }
+        }
+
+        [Test]
+        public void SharedCacheMemory()
+        {
+            OmniaMeaBTree bTree1 = new OmniaMeaBTree( _indexFileName, new TestKey( 0 ) );
+            OmniaMeaBTree bTree2 = new OmniaMeaBTree( _indexFileName + "2", new TestKey( 0 ) );
+            bTree1.SetCacheSize( 2 );
+            bTree2.SetCacheSize( 8 );
+            using( bTree1 )
+            {
+                using( bTree2 )
+                {
+                    bTree1.Open();
+                    bTree2.Open();
+                    int pageSize = bTree1.GetPageSize();
+                    long cachedByOthers = OmniaMeaBTree.GetCachedMemory();
+                    long budget = cachedByOthers + 12 * pageSize;
+                    OmniaMeaBTree.SetSharedCacheMemory( budget );
+                    try
+                    {
+                        Assert.AreEqual( budget, OmniaMeaBTree.GetSharedCacheMemory() );
+                        for( int i = 0; i < 100000; i++ )
+                        {
+                            bTree1.InsertKey( new TestKey( i ), i );
+                            bTree2.InsertKey( new TestKey( 100000 - i ), i );
+                            Assert.IsTrue( OmniaMeaBTree.GetCachedMemory() <= budget );
+                        }
+                        Assert.AreEqual( 100000, bTree1.Count );
+                        Assert.AreEqual( 100000, bTree2.Count );
+                        IntArrayList offsets = new IntArrayList();
+                        for( int i = 0; i < 100000; i += 997 )
+                        {
+                            offsets.Clear();
+                            bTree1.SearchForRange( new TestKey( i ), new TestKey( i ), offsets );
+                            Assert.AreEqual( 1, offsets.Count );
+                            Assert.AreEqual( i, offsets[ 0 ] );
+                            offsets.Clear();
+                            bTree2.SearchForRange( new TestKey( 100000 - i ), new TestKey( 100000 - i ), offsets );
+                            Assert.AreEqual( 1, offsets.Count );
+                            Assert.AreEqual( i, offsets[ 0 ] );
+                        }
+                        // each cache keeps its two most recently used pages
+                        OmniaMeaBTree.SetSharedCacheMemory( 1 );
+                        Assert.IsTrue( OmniaMeaBTree.GetCachedMemory() <= cachedByOthers + 4 * pageSize );
+                        offsets.Clear();
+                        bTree1.GetAllKeys( offsets );
+                        Assert.AreEqual( 100000, offsets.Count );
+                        // budgets of 2 GB and more aren't truncated
+                        OmniaMeaBTree.SetSharedCacheMemory( 3L * 1024 * 1024 * 1024 );
+                        Assert.AreEqual( 3L * 1024 * 1024 * 1024, OmniaMeaBTree.GetSharedCacheMemory() );
+                    }
+                    finally
+                    {
+                        OmniaMeaBTree.SetSharedCacheMemory( 0 );
+                    }
+                    bTree1.Close();
+                    bTree2.Close();
+                }
+            }
+        }
+
+        [Test]
+        public void ReadingAheadScans()
+        {
+            const int keysCount = 100000;
+            int readAheadPages = OmniaMeaBTree.GetReadAheadPages();
+            OmniaMeaBTree bTree = new OmniaMeaBTree( _indexFileName, new TestKey( 0 ) );
+            using( bTree )
+            {
+                bTree.Open();
+                for( int i = 0; i < keysCount; i++ )
+                {
+                    bTree.InsertKey( new TestKey( i ), i );
+                }
+                bTree.Close();
+                try
+                {
+                    OmniaMeaBTree.SetReadAheadPages( 0 );
+                    bTree.Open();
+                    int loadedPages = bTree.GetLoadedPages();
+                    IntArrayList offsets = new IntArrayList();
+                    bTree.GetAllKeys( offsets );
+                    Assert.AreEqual( keysCount, offsets.Count );
+                    int loadedWithoutReadAhead = bTree.GetLoadedPages() - loadedPages;
+                    bTree.Close();
+
+                    OmniaMeaBTree.SetReadAheadPages( 8 );
+                    Assert.AreEqual( 8, OmniaMeaBTree.GetReadAheadPages() );
+                    bTree.Open();
+                    loadedPages = bTree.GetLoadedPages();
+                    offsets.Clear();
+                    bTree.GetAllKeys( offsets );
+                    Assert.AreEqual( keysCount, offsets.Count );
+                    for( int i = 0; i < keysCount; i++ )
+                    {
+                        Assert.AreEqual( i, offsets[ i ] );
+                    }
+                    Assert.IsTrue( bTree.GetLoadedPages() - loadedPages < loadedWithoutReadAhead );
+
+                    // enumerators read ahead too, pages read ahead are saved after modification
+                    int count = 0;
+                    foreach( KeyPair pair in bTree.SearchForRange( new TestKey( 1000 ), new TestKey( 60000 ) ) )
+                    {
+                        Assert.AreEqual( 1000 + count, pair._offset );
+                        ++count;
+                    }
+                    Assert.AreEqual( 59001, count );
+                    for( int i = 0; i < keysCount; i += 2 )
+                    {
+                        bTree.DeleteKey( new TestKey( i ), i );
+                    }
+                    count = 0;
+                    foreach( KeyPair pair in bTree.GetAllKeys() )
+                    {
+                        Assert.AreEqual( 2 * count + 1, pair._offset );
+                        ++count;
+                    }
+                    Assert.AreEqual( keysCount / 2, count );
+                    bTree.Close();
+                    bTree.Open();
+                    Assert.AreEqual( keysCount / 2, bTree.CountRange( new TestKey( 0 ), new TestKey( keysCount ) ) );
+                    bTree.Close();
+                }
+                finally
+                {
+                    OmniaMeaBTree.SetReadAheadPages( readAheadPages );
+                }
+            }
+        }
+
+        [Test]
+        public void PageGeometries()
+        {
+            const int keysCount = 50000;
+            int defaultMaxCount;
+            OmniaMeaBTree bTree = new OmniaMeaBTree( _indexFileName, new TestKey( 0 ) );
+            using( bTree )
+            {
+                defaultMaxCount = bTree.MaxCount;
+                Assert.AreEqual( OmniaMeaBTree.DefaultPages, bTree.GetPageGeometry() );
+            }
+            int[] geometries = new int[] { OmniaMeaBTree.SmallPages, OmniaMeaBTree.LargePages };
+            foreach( int geometry in geometries )
+            {
+                File.Delete( _indexFileName );
+                bTree = new OmniaMeaBTree( _indexFileName, new TestKey( 0 ), geometry );
+                using( bTree )
+                {
+                    Assert.AreEqual( geometry, bTree.GetPageGeometry() );
+                    if( geometry == OmniaMeaBTree.SmallPages )
+                    {
+                        Assert.IsTrue( bTree.MaxCount < defaultMaxCount );
+                    }
+                    else
+                    {
+                        Assert.IsTrue( bTree.MaxCount > defaultMaxCount );
+                    }
+                    bTree.Open();
+                    for( int i = 0; i < keysCount; i++ )
+                    {
+                        bTree.InsertKey( new TestKey( keysCount - i ), i );
+                    }
+                    for( int i = 0; i < keysCount; i += 3 )
+                    {
+                        bTree.DeleteKey( new TestKey( keysCount - i ), i );
+                    }
+                    bTree.Close();
+                }
+
+                // the file is reopened with the geometry it was created with
+                bTree = new OmniaMeaBTree( _indexFileName, new TestKey( 0 ) );
+                using( bTree )
+                {
+                    bTree.Open();
+                    Assert.AreEqual( geometry, bTree.GetPageGeometry() );
+                    IntArrayList offsets = new IntArrayList();
+                    bTree.GetAllKeys( offsets );
+                    Assert.AreEqual( keysCount - ( keysCount + 2 ) / 3, offsets.Count );
+                    int lastOffset = keysCount;
+                    foreach( int offset in offsets )
+                    {
+                        Assert.IsTrue( offset < lastOffset );
+                        Assert.IsTrue( offset % 3 != 0 );
+                        lastOffset = offset;
+                    }
+                    Assert.AreEqual( 1000, bTree.CountRange( new TestKey( 1 ), new TestKey( 1500 ) ) );
+                    bTree.Close();
+                }
+            }
+        }
+
+        [Test]
+        public void CollectingStatistics()
+        {
+            const int keysCount = 20000;
+            OmniaMeaBTree bTree = new OmniaMeaBTree( _indexFileName, new TestKey( 0 ) );
+            using( bTree )
+            {
+                bTree.Open();
+                Random random = new Random( 1 );
+                for( int i = 0; i < keysCount; i++ )
+                {
+                    bTree.InsertKey( new TestKey( random.Next() ), i );
+                }
+                bTree.DeleteKey( new TestKey( 0 ), 0 );
+                IntArrayList offsets = new IntArrayList();
+                bTree.GetAllKeys( offsets );
+                bTree.SearchForRange( new TestKey( 0 ), new TestKey( Int32.MaxValue / 2 ), offsets );
+                foreach( KeyPair pair in bTree.GetAllKeys() ) {}
+                bTree.Close();
+                bTree.Open();
+                bTree.GetAllKeys( offsets );
+
+                BTreeStatistics statistics = bTree.GetStatistics();
+                Assert.AreEqual( keysCount, statistics[ BTreeCounter.Inserts ] );
+                Assert.AreEqual( 1, statistics[ BTreeCounter.Deletes ] );
+                Assert.AreEqual( 4, statistics[ BTreeCounter.Lookups ] );
+                Assert.IsTrue( statistics[ BTreeCounter.Splits ] > 0 );
+                Assert.IsTrue( statistics[ BTreeCounter.PageWrites ] > statistics[ BTreeCounter.Splits ] );
+                Assert.IsTrue( statistics[ BTreeCounter.PageReads ] > 0 );
+                Assert.AreEqual( statistics[ BTreeCounter.PageReads ] * bTree.GetPageSize(), statistics[ BTreeCounter.BytesRead ] );
+                Assert.AreEqual( statistics[ BTreeCounter.PageWrites ] * bTree.GetPageSize(), statistics[ BTreeCounter.BytesWritten ] );
+
+                // enumerations are counted but not timed, all other operations are
+                Assert.AreEqual( keysCount, statistics.GetTimedOperations( BTreeOperation.Insert ) );
+                Assert.AreEqual( 1, statistics.GetTimedOperations( BTreeOperation.Delete ) );
+                Assert.AreEqual( 3, statistics.GetTimedOperations( BTreeOperation.Lookup ) );
+                Assert.AreEqual( statistics[ BTreeCounter.PageReads ], statistics.GetTimedOperations( BTreeOperation.PageRead ) );
+                Assert.AreEqual( statistics[ BTreeCounter.PageWrites ], statistics.GetTimedOperations( BTreeOperation.PageWrite ) );
+                int median = statistics.GetPercentileBucket( BTreeOperation.Insert, 0.5 );
+                Assert.IsTrue( median >= 0 && median <= statistics.GetPercentileBucket( BTreeOperation.Insert, 1.0 ) );
+                Assert.IsTrue( statistics.ToString().IndexOf( "Insert: " + keysCount + " timed" ) >= 0 );
+
+                bTree.ResetStatistics();
+                statistics = bTree.GetStatistics();
+                Assert.AreEqual( 0, statistics[ BTreeCounter.Inserts ] );
+                Assert.AreEqual( 0, statistics.GetTimedOperations( BTreeOperation.PageRead ) );
+                Assert.AreEqual( -1, statistics.GetPercentileBucket( BTreeOperation.Insert, 0.5 ) );
+                bTree.Close();
+            }
+        }
+
+        [Test]
+        public void SearchingForRangeInColumns()
+        {
+            const int keysCount = 20000;
+            IBTree bTree = new /*BTree*/OmniaMeaBTree( _indexFileName, new TestKey() );
+            using( bTree )
+            {
+                bTree.Open();
+                for( int i = 0; i < keysCount; i++ )
+                {
+                    bTree.InsertKey( new TestKey( i % 1000 ), i );
+                }
+                KeyColumns columns = new KeyColumns();
+                ArrayList keys_offsets = new ArrayList();
+                for( int first = -10; first < 1010; first += 211 )
+                {
+                    int last = first + 150;
+                    columns.Clear();
+                    keys_offsets.Clear();
+                    bTree.SearchForRange( new TestKey( first ), new TestKey( last ), columns );
+                    bTree.SearchForRange( new TestKey( first ), new TestKey( last ), keys_offsets );
+                    CheckColumns( keys_offsets, columns );
+                    Assert.IsNull( columns.SecondInts );
+                }
+
+                // columns are appended to
+                columns.Clear();
+                keys_offsets.Clear();
+                bTree.GetAllKeys( columns );
+                bTree.SearchForRange( new TestKey( 100 ), new TestKey( 100 ), columns );
+                bTree.GetAllKeys( keys_offsets );
+                bTree.SearchForRange( new TestKey( 100 ), new TestKey( 100 ), keys_offsets );
+                Assert.AreEqual( keysCount + keysCount / 1000, columns.Count );
+                CheckColumns( keys_offsets, columns );
+                bTree.Close();
+            }
+        }
+
+        private static void CheckColumns( ArrayList keys_offsets, KeyColumns columns )
+        {
+            Assert.AreEqual( keys_offsets.Count, columns.Count );
+            for( int i = 0; i < columns.Count; ++i )
+            {
+                KeyPair pair = (KeyPair) keys_offsets[ i ];
+                Assert.AreEqual( pair._offset, columns.Offsets[ i ] );
+                Assert.AreEqual( (int) pair._key.Key, columns.FirstInts[ i ] );
+            }
+        }
+
+        [Test]
+        public void CompactingPages()
+        {
+            const int keysCount = 20000;
+            OmniaMeaBTree bTree = new OmniaMeaBTree( _indexFileName, new TestKey() );
+            using( bTree )
+            {
+                bTree.Open();
+                for( int i = 0; i < keysCount; i++ )
+                {
+                    bTree.InsertKey( new TestKey( i ), i );
+                }
+                for( int i = 0; i < keysCount; i++ )
+                {
+                    if( i % 8 != 0 )
+                    {
+                        bTree.DeleteKey( new TestKey( i ), i );
+                    }
+                }
+                bTree.Close();
+                long length = new FileInfo( _indexFileName ).Length;
+                bTree.Open();
+
+                // a call makes at least one step, and the btree may be modified between calls
+                int steps = 0;
+                while( bTree.Compact( 0 ) )
+                {
+                    if( ++steps == 10 )
+                    {
+                        bTree.InsertKey( new TestKey( keysCount ), keysCount );
+                    }
+                }
+                Assert.IsTrue( steps > 10 );
+                Assert.IsTrue( bTree.GetStatistics()[ BTreeCounter.Merges ] > 0 );
+                Assert.AreEqual( keysCount / 8 + 1, bTree.Count );
+                bTree.Close();
+                Assert.IsTrue( new FileInfo( _indexFileName ).Length < length / 2 );
+
+                bTree.Open();
+                Assert.AreEqual( keysCount / 8 + 1, bTree.Count );
+                IntArrayList offsets = new IntArrayList();
+                bTree.GetAllKeys( offsets );
+                Assert.AreEqual( keysCount / 8 + 1, offsets.Count );
+                for( int i = 0; i < keysCount / 8; i++ )
+                {
+                    Assert.AreEqual( i * 8, offsets[ i ] );
+                }
+                Assert.AreEqual( keysCount, offsets[ keysCount / 8 ] );
+                for( int i = 0; i < keysCount; i++ )
+                {
+                    if( i % 8 != 0 )
+                    {
+                        bTree.InsertKey( new TestKey( i ), i );
+                    }
+                }
+                offsets.Clear();
+                bTree.GetAllKeys( offsets );
+                Assert.AreEqual( keysCount + 1, offsets.Count );
+                bTree.Close();
+            }
+        }
+
+        [Test]
+        public void CheckingKeysWithPageFilters()
+        {
+            const int keysCount = 20000;
+            OmniaMeaBTree bTree = new OmniaMeaBTree( _indexFileName, new TestKey() );
+            using( bTree )
+            {
+                bTree.SetPageFilters( true );
+                bTree.Open();
+                Random random = new Random( 1 );
+                int[] keys = new int[ keysCount ];
+                for( int i = 0; i < keysCount; i++ )
+                {
+                    keys[ i ] = random.Next();
+                    bTree.InsertKey( new TestKey( keys[ i ] ), i );
+                }
+                for( int i = 0; i < keysCount; i += 2 )
+                {
+                    bTree.DeleteKey( new TestKey( keys[ i ] ), i );
+                }
+                CheckContainedKeys( bTree, keys );
+                Assert.IsTrue( bTree.GetStatistics()[ BTreeCounter.FilterSkips ] > keysCount * 9 / 10 );
+
+                // filters aren't saved, they are built as pages are used
+                bTree.Close();
+                bTree.Open();
+                bTree.ResetStatistics();
+                CheckContainedKeys( bTree, keys );
+                Assert.IsTrue( bTree.GetStatistics()[ BTreeCounter.FilterSkips ] > keysCount * 9 / 10 );
+
+                bTree.SetPageFilters( false );
+                bTree.ResetStatistics();
+                CheckContainedKeys( bTree, keys );
+                Assert.AreEqual( 0, bTree.GetStatistics()[ BTreeCounter.FilterSkips ] );
+
+                // a key with offsets on several pages is found by any offset
+                bTree.SetPageFilters( true );
+                for( int i = 0; i < keysCount; i++ )
+                {
+                    bTree.InsertKey( new TestKey( -1 ), i );
+                }
+                for( int i = 0; i < keysCount - 1; i++ )
+                {
+                    bTree.DeleteKey( new TestKey( -1 ), i );
+                }
+                Assert.IsTrue( bTree.ContainsKey( new TestKey( -1 ) ) );
+                Assert.IsFalse( bTree.ContainsKey( new TestKey( -1 ), 0 ) );
+                bTree.DeleteKey( new TestKey( -1 ), keysCount - 1 );
+                Assert.IsFalse( bTree.ContainsKey( new TestKey( -1 ) ) );
+                bTree.Close();
+            }
+        }
+
+        // keys with even indexes are deleted, no key is inserted with an offset greater than the count of keys,
+        // inserted keys aren't negative
+        private static void CheckContainedKeys( IBTree bTree, int[] keys )
+        {
+            for( int i = 0; i < keys.Length; i++ )
+            {
+                Assert.AreEqual( i % 2 != 0, bTree.ContainsKey( new TestKey( keys[ i ] ), i ) );
+                Assert.IsFalse( bTree.ContainsKey( new TestKey( keys[ i ] ), i + keys.Length ) );
+                if( i % 2 != 0 )
+                {
+                    Assert.IsTrue( bTree.ContainsKey( new TestKey( keys[ i ] ) ) );
+                }
+                Assert.IsFalse( bTree.ContainsKey( new TestKey( -2 - keys[ i ] ) ) );
+            }
+        }
+
         [Test, Ignore( "This is stress test" )]
         public void SingleThreadedStress()
         {
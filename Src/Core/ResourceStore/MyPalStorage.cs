@@ -2163,17 +2163,8 @@ namespace JetBrains.Omea.ResourceStore
 
         public bool LinkExists( int resID, int resID2, int type )
         {
-            using( IResultSet rs = _links.CreateResultSet( 0, IntInternalizer.Intern( resID ), 2, IntInternalizer.Intern( type ), true ) )
-            {
-                foreach( IRecord rec in rs )
-                {
-                    if ( rec.GetIntValue( 1 ) == resID2 )
-                    {
-                        return true;
-                    }
-                }
-            }
-            return false;
+            return _links.ContainsRecord(
+                0, IntInternalizer.Intern( resID ), 2, IntInternalizer.Intern( type ), IntInternalizer.Intern( resID2 ) );
         }
 
         /**
@@ -50,8 +50,7 @@ wvGetATRD_PLCF (ATRD ** atrd, U32 ** pos, U32 * noatrd, U32 offset, U32 len,
 		return (1);
 	    }
 	  wvStream_goto (fd, offset);
-	  for (i = 0; i < *noatrd + 1; i++)
-	      (*pos)[i] = read_32ubit (fd);
+	  read_32ubits (fd, *pos, *noatrd + 1);
 	  for (i = 0; i < *noatrd; i++)
 	      wvGetATRD (&((*atrd)[i]), fd);
       }
@@ -54,10 +54,7 @@ wvGetBKD_PLCF (BKD ** bkd, U32 ** pos, U32 * nobkd, U32 offset, U32 len,
 		return (1);
 	    }
 	  wvStream_goto (fd, offset);
-	  for (i = 0; i < *nobkd + 1; i++)
-	    {
-		(*pos)[i] = read_32ubit (fd);
-	    }
+	  read_32ubits (fd, *pos, *nobkd + 1);
 	  for (i = 0; i < *nobkd; i++)
 	    {
 		wvGetBKD (&((*bkd)[i]), fd);
@@ -49,8 +49,7 @@ wvGetBKL_PLCF (BKL ** bkl, U32 ** pos, U32 * nobkl, U32 bkloffset, U32 bkllen, U
 		return (1);
 	    }
       wvStream_goto (fd, bkloffset);
-	  for (i = 0; i <= *nobkl; i++)
-	      (*pos)[i] = read_32ubit (fd);
+	  read_32ubits (fd, *pos, *nobkl + 1);
 
       /* now we have to reconstruct the bkl table; we have to get the bkf records,
          and then search them to find one that matches the index we are processing
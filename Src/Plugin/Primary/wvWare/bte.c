@@ -69,11 +69,7 @@ wvGetBTE_PLCF6 (BTE ** bte, U32 ** pos, U32 * nobte, U32 offset, U32 len,
 		return (1);
 	    }
 	  wvStream_goto (fd, offset);
-	  for (i = 0; i <= *nobte; i++)
-	    {
-		(*pos)[i] = read_32ubit (fd);
-		wvTrace (("pos is %x\n", (*pos)[i]));
-	    }
+	  read_32ubits (fd, *pos, *nobte + 1);
 	  for (i = 0; i < *nobte; i++)
 	    {
 		wvInitBTE (&((*bte)[i]));
@@ -117,8 +113,7 @@ wvGetBTE_PLCF (BTE ** bte, U32 ** pos, U32 * nobte, U32 offset, U32 len,
 		return (1);
 	    }
 	  wvStream_goto (fd, offset);
-	  for (i = 0; i <= *nobte; i++)
-	      (*pos)[i] = read_32ubit (fd);
+	  read_32ubits (fd, *pos, *nobte + 1);
 	  for (i = 0; i < *nobte; i++)
 	      wvGetBTE (&((*bte)[i]), fd);
       }
@@ -134,19 +129,28 @@ wvCopyBTE (BTE * dest, BTE * src)
 int
 wvGetBTE_FromFC (BTE * bte, U32 currentfc, BTE * list, U32 * fcs, int nobte)
 {
-    int i = 0;
-    while (i < nobte)
+    int lo = 0, hi = nobte, mid;
+
+    if (nobte <= 0)
+	return (1);
+
+    /* the fcs are in ascending order, find the last one <= currentfc */
+    while (hi - lo > 1)
       {
-	  if ((currentfc >= wvNormFC (fcs[i], NULL))
-	      && (currentfc < wvNormFC (fcs[i + 1], NULL)))
-	    {
-		wvTrace (("valid\n"));
-		wvCopyBTE (bte, &list[i]);
-		return (0);
-	    }
-	  i++;
+	  mid = lo + (hi - lo) / 2;
+	  if (wvNormFC (fcs[mid], NULL) <= currentfc)
+	      lo = mid;
+	  else
+	      hi = mid;
+      }
+    if ((currentfc >= wvNormFC (fcs[lo], NULL))
+	&& (currentfc < wvNormFC (fcs[lo + 1], NULL)))
+      {
+	  wvTrace (("valid\n"));
+	  wvCopyBTE (bte, &list[lo]);
+	  return (0);
       }
-    wvCopyBTE (bte, &list[i - 1]);
+    wvCopyBTE (bte, &list[nobte - 1]);
     return (0);
     /*
        return(1);
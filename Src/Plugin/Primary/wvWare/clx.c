@@ -254,16 +254,25 @@ wvQuerySamePiece (U32 fcTest, CLX * clx, U32 piece)
 U32
 wvGetPieceFromCP (U32 currentcp, CLX * clx)
 {
-    U32 i = 0;
-    while (i < clx->nopcd)
+    U32 lo = 0, hi = clx->nopcd, mid;
+
+    if (clx->nopcd == 0)
+	return (0xffffffffL);
+
+    /* the piece cps are in ascending order, find the last one <= currentcp */
+    while (hi - lo > 1)
       {
-	  wvTrace (
-		   ("i %d: currentcp is %d, clx->pos[i] is %d, clx->pos[i+1] is %d\n",
-		    i, currentcp, clx->pos[i], clx->pos[i + 1]));
-	  if ((currentcp >= clx->pos[i]) && (currentcp < clx->pos[i + 1]))
-	      return (i);
-	  i++;
+	  mid = lo + (hi - lo) / 2;
+	  if (clx->pos[mid] <= currentcp)
+	      lo = mid;
+	  else
+	      hi = mid;
       }
+    wvTrace (
+	     ("lo %d: currentcp is %d, clx->pos[lo] is %d, clx->pos[lo+1] is %d\n",
+	      lo, currentcp, clx->pos[lo], clx->pos[lo + 1]));
+    if ((currentcp >= clx->pos[lo]) && (currentcp < clx->pos[lo + 1]))
+	return (lo);
     wvTrace (("cp was not in any piece ! \n", currentcp));
     return (0xffffffffL);
 }
@@ -296,26 +305,22 @@ U32
 wvConvertCPToFC (U32 currentcp, CLX * clx)
 {
     U32 currentfc = 0xffffffffL;
-    U32 i = 0;
+    U32 i;
     int flag;
 
-    while (i < clx->nopcd)
+    i = wvGetPieceFromCP (currentcp, clx);
+    if (i != 0xffffffffL)
       {
-	  if ((currentcp >= clx->pos[i]) && (currentcp < clx->pos[i + 1]))
-	    {
-		currentfc = wvNormFC (clx->pcd[i].fc, &flag);
-		if (flag)
-		    currentfc += (currentcp - clx->pos[i]);
-		else
-		    currentfc += ((currentcp - clx->pos[i]) * 2);
-		break;
-	    }
-	  i++;
+	  currentfc = wvNormFC (clx->pcd[i].fc, &flag);
+	  if (flag)
+	      currentfc += (currentcp - clx->pos[i]);
+	  else
+	      currentfc += ((currentcp - clx->pos[i]) * 2);
       }
 
     if (currentfc == 0xffffffffL)
       {
-	  i--;
+	  i = clx->nopcd - 1;
 	  currentfc = wvNormFC (clx->pcd[i].fc, &flag);
 	  if (flag)
 	      currentfc += (currentcp - clx->pos[i]);
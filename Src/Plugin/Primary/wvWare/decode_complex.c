@@ -868,6 +868,8 @@ encoded into the first 22 bytes.
 
     wvReleasePAPX_FKP (&para_fkp);
     wvReleaseCHPX_FKP (&char_fkp);
+    external_wvReleasePAPX_FKP ();
+    external_wvReleaseCHPX_FKP ();
 
     wvHandleDocument (ps, DOCEND);
     wvFree (posSedx);
@@ -536,8 +536,10 @@ wvDecodeSimple (wvParseStruct * ps, subdocument whichdoc)
     wvFree (posAtrd);
     wvFree (atrd);
 
-    internal_wvReleasePAPX_FKP (&para_fkp);
-    internal_wvReleaseCHPX_FKP (&char_fkp);
+    wvReleasePAPX_FKP (&para_fkp);
+    wvReleaseCHPX_FKP (&char_fkp);
+    external_wvReleasePAPX_FKP ();
+    external_wvReleaseCHPX_FKP ();
     wvHandleDocument (ps, DOCEND);
     wvFree (posSedx);
     wvFree (sed);
@@ -545,13 +547,6 @@ wvDecodeSimple (wvParseStruct * ps, subdocument whichdoc)
     wvFree(posBKD);
     wvFree(ftxbx);
     wvFree(txbxTxt); 
-#if defined(WIN32)
-   wvReleasePAPX_FKP (&para_fkp);
-   wvReleaseCHPX_FKP (&char_fkp);   
-
-   external_wvReleasePAPX_FKP ();
-   external_wvReleaseCHPX_FKP();
-#endif
 
 
     wvFree (ps->liststartnos);
@@ -0,0 +1,336 @@
+#include <stdlib.h>
+#include <stdio.h>
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "wv.h"
+#include "wvinternal.h"
+
+/*
+the character properties that decide which characters come out of a plain
+text conversion: special characters and what they refer to, hidden text,
+and the language and font that pick the codepage of 8 bit text. Everything
+else in a CHPX is skipped unread.
+*/
+static int
+wvIsPlainTextSprm (U16 sprm)
+{
+    switch (sprm)
+      {
+      case sprmCFSpec:
+      case sprmCFVanish:
+      case sprmCFObj:
+      case sprmCFOle2:
+      case sprmCFData:
+      case sprmCPicLocation:
+      case sprmCSymbol:
+      case sprmCIstd:
+      case sprmCFtc:
+      case sprmCRgFtc0:
+      case sprmCLid:
+      case sprmCRgLid0:
+      case sprmCRgLid1:
+	  return (1);
+      }
+    return (0);
+}
+
+/*
+like wvAssembleSimpleCHP, but starting from the style of the paragraph
+given by istd alone and applying only the sprms that wvIsPlainTextSprm
+wants. Word 6 and 7 sprms have no self describing length, so those are
+all applied as before.
+*/
+static void
+wvAssemblePlainCHP (wvVersion ver, CHP * achp, U16 istd, U32 fc,
+		    CHPX_FKP * fkp, STSH * stsh, PAP * apap)
+{
+    CHPX *chpx;
+    UPXF upxf;
+    U16 i, sprm, tistd;
+    U8 *pointer;
+
+    wvInitCHPFromIstd (achp, istd, stsh);
+    achp->istd = istdNil;
+    tistd = istdNil;
+
+  apply_chpx:
+    chpx =
+	&(fkp->grpchpx[wvGetIndexFCInFKP_PAPX ((PAPX_FKP *) fkp, fc) - 1]);
+    if (chpx->cbGrpprl > 0)
+      {
+	  if (ver == WORD8)
+	    {
+		i = 0;
+		while (i + 2 < chpx->cbGrpprl)
+		  {
+		      sprm = bread_16ubit (chpx->grpprl + i, &i);
+		      pointer = chpx->grpprl + i;
+		      /* none of the sprms we apply touch the PAP */
+		      if (wvIsPlainTextSprm (sprm))
+			  wvApplySprmFromBucket (ver, sprm, apap, achp, NULL,
+						 stsh, pointer, &i, NULL);
+		      else
+			  wvEatSprm (sprm, pointer, &i);
+		  }
+	    }
+	  else
+	    {
+		upxf.cbUPX = chpx->cbGrpprl;
+		upxf.upx.chpx.grpprl = chpx->grpprl;
+		wvAddCHPXFromBucket6 (achp, &upxf, stsh);
+	    }
+      }
+
+    if (achp->istd != tistd)
+      {
+	  /* a character style, start again from it */
+	  tistd = achp->istd;
+	  wvInitCHPFromIstd (achp, achp->istd, stsh);
+	  goto apply_chpx;
+      }
+}
+
+/*
+A text only walk over the piece table for callers that want the words of a
+document and nothing else, such as an indexer.
+
+wvDecodeSimple and wvDecodeComplex assemble the full PAP, CHP and SEP of
+every paragraph, run and section (tabs, borders, lists, table rows, the
+lookahead nextpap and all the sprms in the piece table) before a single
+character reaches the handlers. Here the paragraph FKPs only give the
+bounds of each paragraph and its style, the character FKPs give the runs
+and the few character properties wvIsPlainTextSprm lists, and sections
+keep their default properties.
+
+Paragraphs and sections are still reported to the element handler, so the
+config decides what goes between them, but with a PAP and SEP that only
+have the istd filled in. Character runs and comments are not reported.
+Hidden text and pictures are dropped, fields and other special characters
+go to the special character handler as usual.
+*/
+void
+wvDecodePlainText (wvParseStruct * ps)
+{
+    PAPX_FKP para_fkp;
+    CHPX_FKP char_fkp;
+    PAP apap;
+    CHP achp;
+    SEP sep;
+    U32 piececount, i, j = 0, inc;
+    U32 beginfc, endfc;
+    U32 stream_size;
+    U32 begincp, endcp;
+    int ichartype;
+    U8 chartype;
+    U16 eachchar;
+    U16 istd = istdNil;
+    U32 para_fcFirst = 0xffffffffL, para_fcLim = 0xffffffffL;
+    U32 char_fcFirst = 0xffffffffL, char_fcLim = 0xffffffffL;
+    BTE *btePapx = NULL, *bteChpx = NULL;
+    U32 *posPapx = NULL, *posChpx = NULL;
+    U32 para_intervals, char_intervals, section_intervals;
+    U32 section = 0;
+    int para_pendingclose = 0, section_pendingclose = 0;
+    int char_stale = 1;
+    SED *sed;
+    U32 *posSedx;
+    wvVersion ver;
+
+    external_wvReleasePAPX_FKP ();
+    external_wvReleaseCHPX_FKP ();
+
+    ver = wvQuerySupported (&ps->fib, NULL);
+
+    wvGetCLX (ver, &ps->clx, ps->fib.fcClx, (U32) ps->fib.lcbClx,
+	      (U8) ps->fib.fExtChar, ps->tablefd);
+    /* for word 6 and just in case */
+    if (ps->clx.nopcd == 0)
+	wvBuildCLXForSimple6 (&ps->clx, &ps->fib);
+
+    /* the style sheet gives the base character properties of each paragraph */
+    wvGetSTSH (&ps->stsh, ps->fib.fcStshf, ps->fib.lcbStshf, ps->tablefd);
+    wvGetDOP (ver, &ps->dop, ps->fib.fcDop, ps->fib.lcbDop, ps->tablefd);
+
+    /* the fonts pick the codepage before word 8, and name the symbol fonts */
+    if ((ver == WORD6)
+	|| (ver == WORD7))
+      {
+	  wvGetFFN_STTBF6 (&ps->fonts, ps->fib.fcSttbfffn,
+			   ps->fib.lcbSttbfffn, ps->tablefd);
+	  wvGetSTTBF6 (&ps->anSttbfAssoc, ps->fib.fcSttbfAssoc,
+		       ps->fib.lcbSttbfAssoc, ps->tablefd);
+	  wvGetSTTBF6 (&ps->Sttbfbkmk, ps->fib.fcSttbfbkmk,
+		       ps->fib.lcbSttbfbkmk, ps->tablefd);
+	  wvGetBTE_PLCF6 (&btePapx, &posPapx, &para_intervals,
+			  ps->fib.fcPlcfbtePapx, ps->fib.lcbPlcfbtePapx,
+			  ps->tablefd);
+	  wvGetBTE_PLCF6 (&bteChpx, &posChpx, &char_intervals,
+			  ps->fib.fcPlcfbteChpx, ps->fib.lcbPlcfbteChpx,
+			  ps->tablefd);
+      }
+    else
+      {
+	  wvGetFFN_STTBF (&ps->fonts, ps->fib.fcSttbfffn, ps->fib.lcbSttbfffn,
+			  ps->tablefd);
+	  wvGetSTTBF (&ps->anSttbfAssoc, ps->fib.fcSttbfAssoc,
+		      ps->fib.lcbSttbfAssoc, ps->tablefd);
+	  wvGetSTTBF (&ps->Sttbfbkmk, ps->fib.fcSttbfbkmk,
+		      ps->fib.lcbSttbfbkmk, ps->tablefd);
+	  wvGetBTE_PLCF (&btePapx, &posPapx, &para_intervals,
+			 ps->fib.fcPlcfbtePapx, ps->fib.lcbPlcfbtePapx,
+			 ps->tablefd);
+	  wvGetBTE_PLCF (&bteChpx, &posChpx, &char_intervals,
+			 ps->fib.fcPlcfbteChpx, ps->fib.lcbPlcfbteChpx,
+			 ps->tablefd);
+      }
+
+    wvGetSED_PLCF (&sed, &posSedx, &section_intervals, ps->fib.fcPlcfsed,
+		   ps->fib.lcbPlcfsed, ps->tablefd);
+
+    wvInitPAPX_FKP (&para_fkp);
+    wvInitCHPX_FKP (&char_fkp);
+    wvInitPAP (&apap);
+    wvInitSEP (&sep);
+    wvInitCHP (&achp);
+
+    if (wvHandleDocument (ps, DOCBEGIN))
+	goto finish_processing;
+
+    stream_size = wvStream_size (ps->mainfd);
+
+    /*for each piece */
+    for (piececount = 0; piececount < ps->clx.nopcd; piececount++)
+      {
+	  ichartype =
+	      wvGetPieceBoundsFC (&beginfc, &endfc, &ps->clx, piececount);
+	  if (ichartype == -1)
+	      break;
+	  chartype = (U8) ichartype;
+	  inc = wvIncFC (chartype);
+	  if (beginfc > stream_size || endfc > stream_size)
+	    {
+		wvError (("Piece Bounds out of range!, its a disaster\n"));
+		continue;
+	    }
+	  wvStream_goto (ps->mainfd, beginfc);
+	  if (wvGetPieceBoundsCP (&begincp, &endcp, &ps->clx, piececount) ==
+	      -1)
+	      break;
+
+	  for (i = begincp, j = beginfc; i < endcp; i++, j += inc)
+	    {
+		ps->currentcp = i;
+
+		if (section_intervals > 0 && section + 1 < section_intervals
+		    && i >= posSedx[section + 1])
+		  {
+		      if (section_pendingclose)
+			  wvHandleElement (ps, SECTIONEND, (void *) &sep, 0);
+		      section_pendingclose = 0;
+		      while (section + 1 < section_intervals
+			     && i >= posSedx[section + 1])
+			  section++;
+		  }
+		if (!section_pendingclose)
+		  {
+		      wvHandleElement (ps, SECTIONBEGIN, (void *) &sep, 0);
+		      section_pendingclose = 1;
+		  }
+
+		/* the paragraph FKP entry of this fc, for its style */
+		if (j < para_fcFirst || j >= para_fcLim)
+		  {
+		      wvReleasePAPX_FKP (&para_fkp);
+		      if (wvGetSimpleParaBounds
+			  (ver, &para_fkp, &para_fcFirst, &para_fcLim, j,
+			   btePapx, posPapx, para_intervals, ps->mainfd))
+			{
+			    /* no paragraph information, end them at the marks */
+			    para_fcFirst = j;
+			    para_fcLim = 0xffffffffL;
+			    istd = istdNil;
+			}
+		      else
+			  istd =
+			      para_fkp.grppapx[wvGetIndexFCInFKP_PAPX
+					       (&para_fkp, para_fcLim) - 1].istd;
+		      if (istd != apap.istd)
+			  char_stale = 1;
+		      apap.istd = istd;
+		  }
+
+		if (!para_pendingclose)
+		  {
+		      wvHandleElement (ps, PARABEGIN, (void *) &apap, 0);
+		      para_pendingclose = 1;
+		  }
+
+		/* the character FKP entry of this fc */
+		if (char_stale || j < char_fcFirst || j >= char_fcLim)
+		  {
+		      wvReleaseCHPX_FKP (&char_fkp);
+		      if (wvGetSimpleCharBounds
+			  (ver, &char_fkp, &char_fcFirst, &char_fcLim, i,
+			   &ps->clx, bteChpx, posChpx, char_intervals,
+			   ps->mainfd))
+			{
+			    char_fcFirst = j;
+			    char_fcLim = j + inc;
+			    wvInitCHPFromIstd (&achp, istd, &ps->stsh);
+			}
+		      else
+			  wvAssemblePlainCHP (ver, &achp, istd, char_fcLim,
+					      &char_fkp, &ps->stsh, &apap);
+		      char_stale = 0;
+		  }
+
+		eachchar = wvGetChar (ps->mainfd, chartype);
+
+		if (achp.fSpec)
+		  {
+		      /* pictures and drawn objects have no text */
+		      if (eachchar != 0x01 && eachchar != 0x08)
+			  wvOutputTextChar (eachchar, chartype, ps, &achp);
+		  }
+		else if (!achp.fVanish)
+		    wvOutputTextChar (eachchar, chartype, ps, &achp);
+
+		if ((j + inc == para_fcLim)
+		    || ((para_fcLim == 0xffffffffL)
+			&& ((eachchar == 0x0d) || (eachchar == 0x07))))
+		  {
+		      wvHandleElement (ps, PARAEND, (void *) &apap, 0);
+		      para_pendingclose = 0;
+		  }
+	    }
+      }
+
+  finish_processing:
+    if (para_pendingclose)
+	wvHandleElement (ps, PARAEND, (void *) &apap, 0);
+
+    if (section_pendingclose)
+	wvHandleElement (ps, SECTIONEND, (void *) &sep, 0);
+
+    wvReleasePAPX_FKP (&para_fkp);
+    wvReleaseCHPX_FKP (&char_fkp);
+    external_wvReleasePAPX_FKP ();
+    external_wvReleaseCHPX_FKP ();
+
+    wvHandleDocument (ps, DOCEND);
+
+    wvFree (posSedx);
+    wvFree (sed);
+    wvFree (btePapx);
+    wvFree (posPapx);
+    wvFree (bteChpx);
+    wvFree (posChpx);
+    wvReleaseSTTBF (&ps->anSttbfAssoc);
+    wvReleaseSTTBF (&ps->Sttbfbkmk);
+    wvReleaseCLX (&ps->clx);
+    wvReleaseFFN_STTBF (&ps->fonts);
+    wvReleaseSTSH (&ps->stsh);
+    wvOLEFree (ps);
+    tokenTreeFreeAll ();
+}
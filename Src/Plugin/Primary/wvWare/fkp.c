@@ -8,28 +8,106 @@
 
 #include "wvinternal.h"
 
-static PAPX_FKP wvPAPX_FKP_previous;
-static U32 wvPAPX_pn_previous = 0;
-static CHPX_FKP wvCHPX_FKP_previous;
-static U32 wvCHPX_pn_previous = 0;
+/*
+The decoded FKP pages, most recently used first. wvGetPAPX_FKP and
+wvGetCHPX_FKP hand out shallow copies of these, so a page stays valid
+until WV_FKP_CACHE other pages of its kind have been read after it, or
+until the external_wvRelease functions empty the cache at the end of a
+document. Complex documents hop between the pages of neighbouring pieces
+while looking for paragraph and run bounds, which thrashed the single
+previous page this used to keep.
+*/
+#define WV_FKP_CACHE 16
+
+typedef struct _PAPX_FKP_slot {
+    wvStream *fd;
+    U32 pn;
+    PAPX_FKP fkp;
+} PAPX_FKP_slot;
+
+typedef struct _CHPX_FKP_slot {
+    wvStream *fd;
+    U32 pn;
+    CHPX_FKP fkp;
+} CHPX_FKP_slot;
+
+static PAPX_FKP_slot wvPAPX_FKP_cache[WV_FKP_CACHE];
+static int wvPAPX_FKP_cached = 0;
+static CHPX_FKP_slot wvCHPX_FKP_cache[WV_FKP_CACHE];
+static int wvCHPX_FKP_cached = 0;
 
 
 void
 external_wvReleasePAPX_FKP (void)
 {
-        if (wvPAPX_pn_previous != 0)
-        {
-                wvPAPX_pn_previous = 0;
-        }
+    while (wvPAPX_FKP_cached > 0)
+	internal_wvReleasePAPX_FKP (&wvPAPX_FKP_cache[--wvPAPX_FKP_cached].
+				    fkp);
 }
 
 void
 external_wvReleaseCHPX_FKP (void)
 {
-        if (wvCHPX_pn_previous != 0)
-        {
-                wvCHPX_pn_previous = 0;
-        }
+    while (wvCHPX_FKP_cached > 0)
+	internal_wvReleaseCHPX_FKP (&wvCHPX_FKP_cache[--wvCHPX_FKP_cached].
+				    fkp);
+}
+
+/*
+look for page pn of fd in the cache, moving it to the front if it is
+there. Otherwise make room at the front for it, dropping the least
+recently used page if the cache is full, and return 0.
+*/
+static int
+wvLookupPAPX_FKP (PAPX_FKP * fkp, U32 pn, wvStream * fd)
+{
+    PAPX_FKP_slot slot;
+    int i;
+
+    for (i = 0; i < wvPAPX_FKP_cached; i++)
+	if (wvPAPX_FKP_cache[i].pn == pn && wvPAPX_FKP_cache[i].fd == fd)
+	    break;
+    if (i < wvPAPX_FKP_cached)
+      {
+	  slot = wvPAPX_FKP_cache[i];
+	  memmove (&wvPAPX_FKP_cache[1], &wvPAPX_FKP_cache[0],
+		   i * sizeof (PAPX_FKP_slot));
+	  wvPAPX_FKP_cache[0] = slot;
+	  memcpy (fkp, &slot.fkp, sizeof (PAPX_FKP));
+	  return (1);
+      }
+    if (wvPAPX_FKP_cached == WV_FKP_CACHE)
+	internal_wvReleasePAPX_FKP (&wvPAPX_FKP_cache[--wvPAPX_FKP_cached].
+				    fkp);
+    memmove (&wvPAPX_FKP_cache[1], &wvPAPX_FKP_cache[0],
+	     wvPAPX_FKP_cached * sizeof (PAPX_FKP_slot));
+    return (0);
+}
+
+static int
+wvLookupCHPX_FKP (CHPX_FKP * fkp, U32 pn, wvStream * fd)
+{
+    CHPX_FKP_slot slot;
+    int i;
+
+    for (i = 0; i < wvCHPX_FKP_cached; i++)
+	if (wvCHPX_FKP_cache[i].pn == pn && wvCHPX_FKP_cache[i].fd == fd)
+	    break;
+    if (i < wvCHPX_FKP_cached)
+      {
+	  slot = wvCHPX_FKP_cache[i];
+	  memmove (&wvCHPX_FKP_cache[1], &wvCHPX_FKP_cache[0],
+		   i * sizeof (CHPX_FKP_slot));
+	  wvCHPX_FKP_cache[0] = slot;
+	  memcpy (fkp, &slot.fkp, sizeof (CHPX_FKP));
+	  return (1);
+      }
+    if (wvCHPX_FKP_cached == WV_FKP_CACHE)
+	internal_wvReleaseCHPX_FKP (&wvCHPX_FKP_cache[--wvCHPX_FKP_cached].
+				    fkp);
+    memmove (&wvCHPX_FKP_cache[1], &wvCHPX_FKP_cache[0],
+	     wvCHPX_FKP_cached * sizeof (CHPX_FKP_slot));
+    return (0);
 }
 
 void
@@ -87,12 +165,8 @@ wvGetPAPX_FKP (wvVersion ver, PAPX_FKP * fkp, U32 pn, wvStream * fd)
 
     /* brian.ewins@bt.com */
     /* there seem to be a lot of repeat calls... */
-    /* pn=0 is safe because thats the index block, not a PAPX_FKP */
-    if (pn != 0 && pn == wvPAPX_pn_previous)
-      {
-	  memcpy (fkp, &wvPAPX_FKP_previous, sizeof (PAPX_FKP));
-	  return;
-      }
+    if (wvLookupPAPX_FKP (fkp, pn, fd))
+	return;
 
     wvTrace (
 	     ("seeking to %x to get crun\n",
@@ -133,10 +207,10 @@ wvGetPAPX_FKP (wvVersion ver, PAPX_FKP * fkp, U32 pn, wvStream * fd)
 		wvGetPAPX (ver, &(fkp->grppapx[i]), page, &pos);
 	    }
       }
-    if (wvPAPX_pn_previous != 0)
-	internal_wvReleasePAPX_FKP (&wvPAPX_FKP_previous);
-    memcpy (&wvPAPX_FKP_previous, fkp, sizeof (PAPX_FKP));
-    wvPAPX_pn_previous = pn;
+    wvPAPX_FKP_cache[0].fd = fd;
+    wvPAPX_FKP_cache[0].pn = pn;
+    memcpy (&wvPAPX_FKP_cache[0].fkp, fkp, sizeof (PAPX_FKP));
+    wvPAPX_FKP_cached++;
 }
 
 /*
@@ -299,12 +373,8 @@ wvGetCHPX_FKP (wvVersion ver, CHPX_FKP * fkp, U32 pn, wvStream * fd)
 
     /* brian.ewins@bt.com */
     /* there seem to be a lot of repeat calls... */
-    /* pn=0 is safe because thats the index block, not a CHPX_FKP */
-    if (pn != 0 && pn == wvCHPX_pn_previous)
-      {
-	  memcpy (fkp, &wvCHPX_FKP_previous, sizeof (CHPX_FKP));
-	  return;
-      }
+    if (wvLookupCHPX_FKP (fkp, pn, fd))
+	return;
     wvStream_goto (fd, pn * WV_PAGESIZE);
     /*bytes_read= */ wvStream_read (page, WV_PAGESIZE, 1, fd);
     fkp->crun = (U8) page[WV_PAGESIZE - 1];
@@ -340,10 +410,10 @@ wvGetCHPX_FKP (wvVersion ver, CHPX_FKP * fkp, U32 pn, wvStream * fd)
 		wvGetCHPX (ver, &(fkp->grpchpx[i]), page, &pos);
 	    }
       }
-    if (wvCHPX_pn_previous != 0)
-	internal_wvReleaseCHPX_FKP (&wvCHPX_FKP_previous);
-    memcpy (&wvCHPX_FKP_previous, fkp, sizeof (CHPX_FKP));
-    wvCHPX_pn_previous = pn;
+    wvCHPX_FKP_cache[0].fd = fd;
+    wvCHPX_FKP_cache[0].pn = pn;
+    memcpy (&wvCHPX_FKP_cache[0].fkp, fkp, sizeof (CHPX_FKP));
+    wvCHPX_FKP_cached++;
 }
 
 void
@@ -279,8 +279,7 @@ wvGetFLD_PLCF (FLD ** fld, U32 ** pos, U32 * nofld, U32 offset, U32 len,
 		return (1);
 	    }
 	  wvStream_goto (fd, offset);
-	  for (i = 0; i <= *nofld; i++)
-	      (*pos)[i] = read_32ubit (fd);
+	  read_32ubits (fd, *pos, *nofld + 1);
 	  for (i = 0; i < *nofld; i++)
 	      wvGetFLD (&((*fld)[i]), fd);
       }
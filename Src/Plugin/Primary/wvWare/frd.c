@@ -44,8 +44,7 @@ wvGetFRD_PLCF (FRD ** frd, U32 ** pos, U32 * nofrd, U32 offset, U32 len,
 		return (1);
 	    }
 	  wvStream_goto (fd, offset);
-	  for (i = 0; i <= *nofrd; i++)
-	      (*pos)[i] = read_32ubit (fd);
+	  read_32ubits (fd, *pos, *nofrd + 1);
 	  for (i = 0; i < *nofrd; i++)
 	      wvGetFRD (&((*frd)[i]), fd);
       }
@@ -86,8 +86,7 @@ wvGetFSPA_PLCF (FSPA ** fspa, U32 ** pos, U32 * nofspa, U32 offset, U32 len,
 		return (1);
 	    }
 	  wvStream_goto (fd, offset);
-	  for (i = 0; i <= *nofspa; i++)
-	      (*pos)[i] = read_32ubit (fd);
+	  read_32ubits (fd, *pos, *nofspa + 1);
 	  for (i = 0; i < *nofspa; i++)
 	      wvGetFSPA (&((*fspa)[i]), fd);
       }
@@ -62,8 +62,7 @@ wvGetFTXBXS_PLCF (FTXBXS ** ftxbxs, U32 ** pos, U32 * noftxbxs, U32 offset,
 		return (1);
 	    }
 	  wvStream_goto (fd, offset);
-	  for (i = 0; i < *noftxbxs + 1; i++)
-	      (*pos)[i] = read_32ubit (fd);
+	  read_32ubits (fd, *pos, *noftxbxs + 1);
 	  for (i = 0; i < *noftxbxs; i++)
 	      wvGetFTXBXS (&((*ftxbxs)[i]), fd);
       }
@@ -36,8 +36,7 @@ wvGetEmpty_PLCF (U32 ** cps, U32 * nocps, U32 offset, U32 len, wvStream * fd)
 		return (1);
 	    }
 	  wvStream_goto (fd, offset);
-	  for (i = 0; i < *nocps; i++)
-	      (*cps)[i] = read_32ubit (fd);
+	  read_32ubits (fd, *cps, *nocps);
       }
     return (0);
 }
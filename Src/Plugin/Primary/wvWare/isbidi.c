@@ -488,17 +488,12 @@ int wvIsBidiDocumentSimple(wvParseStruct * ps, subdocument whichdoc)
 	}
 
  simple_return:
-    internal_wvReleasePAPX_FKP (&para_fkp);
-    internal_wvReleaseCHPX_FKP (&char_fkp);
+    wvReleasePAPX_FKP (&para_fkp);
+    wvReleaseCHPX_FKP (&char_fkp);
+    external_wvReleasePAPX_FKP ();
+    external_wvReleaseCHPX_FKP ();
     wvFree (posSedx);
     wvFree (sed);
-#if defined(WIN32)
-	wvReleasePAPX_FKP (&para_fkp);
-	wvReleaseCHPX_FKP (&char_fkp);   
-
-	external_wvReleasePAPX_FKP ();
-	external_wvReleaseCHPX_FKP();
-#endif
 
     wvFree (btePapx);
     wvFree (posPapx);
@@ -110,6 +110,16 @@
  */
 
 
+#define MAX_CACHED_BLOCKS  32
+#define READ_AHEAD_BLOCKS   8	/* At most MAX_CACHED_BLOCKS / 4 */
+
+typedef struct {
+	guint32  blk;
+	gboolean dirty;
+	int      usage;	/* Used since the CLOCK hand last passed */
+	guint8   *data;
+} BBBlkAttr;
+
 /**
  * Structure describing an OLE file
  **/
@@ -128,9 +138,12 @@ struct _MsOle {
 	GArray           *sbf;     /* The small block file */
 	guint32           num_pps; /* Count of number of property sets */
 	GList            *pps;     /* Property Storage -> struct _PPS, always 1 valid entry or NULL */
-/* if memory mapped */
-	GPtrArray        *bbattr;  /* Pointers to block structures */
-/* end if memory mapped */
+/* if not memory mapped */
+	GPtrArray        *bbattr;  /* Pointers to block structures, indexed by block */
+	BBBlkAttr        *cache[MAX_CACHED_BLOCKS]; /* The blocks holding data */
+	guint32           cache_used;
+	guint32           cache_hand; /* CLOCK hand into cache */
+/* end if not memory mapped */
 };
 
 #define BLOCK_COUNT(f) (((f)->length + BB_BLOCK_SIZE - 1) / BB_BLOCK_SIZE)
@@ -387,15 +400,6 @@ struct _PPS {
 #define GET_SB_W_PTR(f,b) (BB_W_PTR(f, g_array_index ((f)->sbf, BLP, (b)/(BB_BLOCK_SIZE/SB_BLOCK_SIZE))) \
 			   + (((b)%(BB_BLOCK_SIZE/SB_BLOCK_SIZE))*SB_BLOCK_SIZE))
 
-#define MAX_CACHED_BLOCKS  32
-
-typedef struct {
-	guint32  blk;
-	gboolean dirty;
-	int      usage;
-	guint8   *data;
-} BBBlkAttr;
-
 static BBBlkAttr *
 bb_blk_attr_new (guint32 blk)
 {
@@ -427,12 +431,80 @@ write_cache_block (MsOle *f, BBBlkAttr *attr)
 	attr->dirty = FALSE;
 }
 
+/*
+ * Gives @attr a data buffer in the cache, taking it from the first block
+ * the CLOCK hand finds unused since its last pass once the cache is full.
+ */
+static void
+cache_block (MsOle *f, BBBlkAttr *attr)
+{
+	BBBlkAttr *victim;
+
+	g_assert (!attr->data);
+
+	if (f->cache_used < MAX_CACHED_BLOCKS) {
+		attr->data = g_new (guint8, BB_BLOCK_SIZE);
+		f->cache[f->cache_used++] = attr;
+		return;
+	}
+
+	for (;;) {
+		victim = f->cache[f->cache_hand];
+		if (!victim->usage)
+			break;
+		victim->usage = 0;
+		f->cache_hand = (f->cache_hand + 1) % MAX_CACHED_BLOCKS;
+	}
+	g_assert (victim->data);
+#if OLE_DEBUG > 2
+	g_print ("Replacing cache block %d with %d\n", victim->blk, attr->blk);
+#endif
+	if (victim->dirty)
+		write_cache_block (f, victim);
+	attr->data   = victim->data;
+	victim->data = 0;
+	f->cache[f->cache_hand] = attr;
+	f->cache_hand = (f->cache_hand + 1) % MAX_CACHED_BLOCKS;
+}
+
+/*
+ * Reads the @count uncached blocks from @b on with one read.
+ */
+static void
+read_blocks (MsOle *f, BLP b, guint32 count)
+{
+	guint8 buf[READ_AHEAD_BLOCKS * BB_BLOCK_SIZE];
+	BBBlkAttr *attr;
+	size_t offset, len;
+	guint32 i;
+
+	g_assert (count > 0 && count <= READ_AHEAD_BLOCKS);
+	g_assert (b + count <= f->bbattr->len);
+
+	offset = (b+1)*BB_BLOCK_SIZE;
+	f->syswrap->lseek (f->file_des, offset, SEEK_SET, f->syswrap->closure);
+	len = (f->syswrap->read) (f->file_des, buf, count * BB_BLOCK_SIZE,
+				  f->syswrap->closure);
+	if (len == (size_t)-1)
+		len = 0;
+	if (len < count * BB_BLOCK_SIZE)
+		memset (buf + len, 0, count * BB_BLOCK_SIZE - len);
+
+	for (i = 0; i < count; i++) {
+		attr = g_ptr_array_index (f->bbattr, b + i);
+		g_assert (attr->blk == b + i);
+		cache_block (f, attr);
+		memcpy (attr->data, buf + i * BB_BLOCK_SIZE, BB_BLOCK_SIZE);
+		attr->dirty = FALSE;
+		/* Only the block asked for counts as used */
+		attr->usage = (i == 0);
+	}
+}
+
 static guint8 *
 get_block_ptr (MsOle *f, BLP b, gboolean forwrite)
 {
-	BBBlkAttr *attr, *tmp, *min;
-	size_t offset;
-	guint32 i, blks;
+	BBBlkAttr *attr;
 
 	g_assert (f);
 	g_assert (b < f->bbattr->len);
@@ -442,53 +514,43 @@ get_block_ptr (MsOle *f, BLP b, gboolean forwrite)
 	g_assert (attr);
 	g_assert (attr->blk == b);
 
-	if (attr->data) {
-		attr->usage++;
-		if (forwrite)
-			attr->dirty = TRUE;
-		return attr->data;
-	}
-
-	/* LRU strategy */
-	min  = NULL;
-	blks = 0;
-	for (i = 0;i<f->bbattr->len;i++) {
-		tmp = g_ptr_array_index (f->bbattr, i);
-		if (tmp->data) {
-			blks++;
-			if (!min)
-				min = tmp;
-		        else if (tmp->usage < min->usage)
-				min = tmp;
-		}
-		tmp->usage = (guint32)(tmp->usage*0.707);
-	}
-	if (blks < MAX_CACHED_BLOCKS)
-		min = 0;
-
-	g_assert (!attr->data);
-	if (min) {
-		g_assert (min->data);
-#if OLE_DEBUG > 2
-		g_print ("Replacing cache block %d with %d\n", min->blk, b);
-#endif
-		if (min->dirty)
-			write_cache_block (f, min);
-		attr->data  = min->data;
-		min->data   = 0;
-		min->usage  = 0;
-	} else
-		attr->data = g_new (guint8, BB_BLOCK_SIZE);
+	if (!attr->data)
+		read_blocks (f, b, 1);
 
-	offset = (b+1)*BB_BLOCK_SIZE;
-	f->syswrap->lseek (f->file_des, offset, SEEK_SET, f->syswrap->closure);
-	(f->syswrap->read) (f->file_des, attr->data, BB_BLOCK_SIZE, f->syswrap->closure);
 	attr->usage = 1;
-	attr->dirty = forwrite;
-
+	if (forwrite)
+		attr->dirty = TRUE;
 	return attr->data;
 }
 
+/*
+ * Before reading block @idx of the big block @chain, reads it together
+ * with the following chain blocks that lie right after it in the file.
+ */
+static void
+read_ahead (MsOle *f, GArray *chain, guint32 idx)
+{
+	BLP     first, b;
+	guint32 count = 1;
+
+	if (f->ole_mmap || idx >= chain->len)
+		return;
+
+	first = ms_array_index (chain, BLP, idx);
+	if (first >= f->bbattr->len ||
+	    ((BBBlkAttr *) g_ptr_array_index (f->bbattr, first))->data)
+		return;
+
+	while (count < READ_AHEAD_BLOCKS && idx + count < chain->len) {
+		b = ms_array_index (chain, BLP, idx + count);
+		if (b != first + count || b >= f->bbattr->len ||
+		    ((BBBlkAttr *) g_ptr_array_index (f->bbattr, b))->data)
+			break;
+		count++;
+	}
+	read_blocks (f, first, count);
+}
+
 
 /* This is a list of big blocks which contain a flat description of all blocks
    in the file. Effectively inside these blocks is a FAT of chains of other BBs,
@@ -2272,6 +2334,7 @@ ms_ole_read_ptr_bb (MsOleStream *s, MsOlePos length)
 		blockidx++;
 	}
 	/* Straight map, simply return a pointer */
+	read_ahead (s->file, s->blocks, s->position/BB_BLOCK_SIZE);
 	ans = BB_R_PTR (s->file, ms_array_index (s->blocks, BLP,
 						 s->position/BB_BLOCK_SIZE))
 		+ s->position % BB_BLOCK_SIZE;
@@ -2293,6 +2356,7 @@ ms_ole_read_ptr_sb (MsOleStream *s, MsOlePos length)
 {
 	int blklen;
 	guint8 *ans;
+	BLP block;
 	guint32 len  = length;
 	int blockidx = s->position / SB_BLOCK_SIZE;
 
@@ -2318,8 +2382,9 @@ ms_ole_read_ptr_sb (MsOleStream *s, MsOlePos length)
 		blockidx++;
 	}
 	/* Straight map, simply return a pointer */
-	ans = GET_SB_R_PTR (s->file, ms_array_index (s->blocks, BLP,
-						     s->position/SB_BLOCK_SIZE))
+	block = ms_array_index (s->blocks, BLP, s->position/SB_BLOCK_SIZE);
+	read_ahead (s->file, s->file->sbf, block/(BB_BLOCK_SIZE/SB_BLOCK_SIZE));
+	ans = GET_SB_R_PTR (s->file, block)
 		+ s->position % SB_BLOCK_SIZE;
 	ms_ole_lseek (s, length, MsOleSeekCur);
 
@@ -2367,6 +2432,7 @@ ms_ole_read_copy_bb (MsOleStream *s, guint8 *ptr, MsOlePos length)
 		}
 		g_assert (blkidx < (int) s->blocks->len);
 		block = ms_array_index (s->blocks, BLP, blkidx);
+		read_ahead (s->file, s->blocks, blkidx);
 		src = BB_R_PTR (s->file, block) + offset;
 
 		memcpy (ptr, src, cpylen);
@@ -2422,6 +2488,8 @@ ms_ole_read_copy_sb (MsOleStream *s, guint8 *ptr, MsOlePos length)
 		}
 		g_assert (blkidx < (int) s->blocks->len);
 		block = ms_array_index (s->blocks, BLP, blkidx);
+		read_ahead (s->file, s->file->sbf,
+			    block/(BB_BLOCK_SIZE/SB_BLOCK_SIZE));
 		src = GET_SB_R_PTR (s->file, block) + offset;
 
 		memcpy (ptr, src, cpylen);
@@ -144,8 +144,7 @@ wvGetLSTF_PLCF (LSTF ** lstf, U32 ** pos, U32 * nolstf, U32 offset, U32 len,
 		return (1);
 	    }
 	  wvStream_goto (fd, offset);
-	  for (i = 0; i <= *nolstf; i++)
-	      (*pos)[i] = read_32ubit (fd);
+	  read_32ubits (fd, *pos, *nolstf + 1);
 	  for (i = 0; i < *nolstf; i++)
 	      wvGetLSTF (&((*lstf)[i]), fd);
       }
@@ -77,11 +77,7 @@ wvGetPCD_PLCF (PCD ** pcd, U32 ** pos, U32 * nopcd, U32 offset, U32 len,
 		return (1);
 	    }
 	  wvStream_goto (fd, offset);
-	  for (i = 0; i <= *nopcd; i++)
-	    {
-		(*pos)[i] = read_32ubit (fd);
-		wvTrace (("pcd pos is %x\n", (*pos)[i]));
-	    }
+	  read_32ubits (fd, *pos, *nopcd + 1);
 	  for (i = 0; i < *nopcd; i++)
 	    {
 		wvGetPCD (&((*pcd)[i]), fd);
@@ -42,8 +42,7 @@ wvGetPLCF (void ** plcf, U32 offset, U32 len, wvStream * fd)
 		i32 = len / 4;
 		i8  = len % 4;
 		
-		for (i = 0; i < i32; i++)
-			((U32*)(*plcf))[i] = read_32ubit (fd);
+		read_32ubits (fd, (U32*)(*plcf), i32);
 
 		for (i = i32*4; i < i32*4 + i8; i++)
 			((U8*)(*plcf))[i] = read_8ubit (fd);
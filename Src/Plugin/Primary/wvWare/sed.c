@@ -48,8 +48,7 @@ wvGetSED_PLCF (SED ** item, U32 ** pos, U32 * noitem, U32 offset, U32 len,
 		return (1);
 	    }
 	  wvStream_goto (fd, offset);
-	  for (i = 0; i <= *noitem; i++)
-	      (*pos)[i] = read_32ubit (fd);
+	  read_32ubits (fd, *pos, *noitem + 1);
 	  for (i = 0; i < *noitem; i++)
 	      wvGetSED (&((*item)[i]), fd);
       }
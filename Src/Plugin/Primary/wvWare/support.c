@@ -134,6 +134,9 @@ wvStream_create (wvStream ** in, wvStreamKind kind, wvInternalStream inner)
     *in = (wvStream *) wvMalloc (sizeof (wvStream));
     (*in)->kind = kind;
     (*in)->stream = inner;
+    (*in)->buf = NULL;
+    (*in)->start = (*in)->pos = (*in)->end = NULL;
+    (*in)->lim = 0;
     listEntry = wvMalloc (sizeof (wvStream_list));
     listEntry->stream = (*in);
     listEntry->next = streams;
@@ -161,109 +164,237 @@ static size_t memorystream_read(MemoryStream *stream, void *buf, size_t count)
   return ret;
 }
 
-U32
-read_32ubit (wvStream * in)
+/* Forgets the buffer, for when the inner stream is about to be moved anyway */
+static void
+wvStream_drop (wvStream * in)
 {
-    U32 ret;
-#if defined(WORDS_BIGENDIAN) || !defined(MATCHED_TYPE)
-    U16 temp1, temp2;
-    temp1 = read_16ubit (in);
-    temp2 = read_16ubit (in);
-    ret = temp2;
-    ret = ret << 16;
-    ret += temp1;
-#else
+    in->start = in->pos = in->end = NULL;
+}
+
+/* Moves the inner stream back to where the wvStream is and forgets the
+ * buffer, for when the inner stream is about to be used directly */
+static void
+wvStream_unbuffer (wvStream * in)
+{
+    long unread;
+
+    if (in->start == NULL)
+	return;
+    unread = (long) (in->end - in->pos);
+    wvStream_drop (in);
+    if (unread == 0)
+	return;
+
     if (in->kind == LIBOLE_STREAM)
+	in->stream.libole_stream->lseek (in->stream.libole_stream, -unread,
+					 MsOleSeekCur);
+    else if (in->kind == FILE_STREAM)
+	fseek (in->stream.file_stream, -unread, SEEK_CUR);
+    else
+	in->stream.memory_stream->current -= unread;
+}
+
+/* Refills the used up buffer, returns the number of bytes now in it */
+static size_t
+wvStream_fill (wvStream * in)
+{
+    size_t got = 0;
+
+    wvStream_unbuffer (in);
+
+    if (in->kind == MEMORY_STREAM)
       {
-	  in->stream.libole_stream->read_copy (in->stream.libole_stream,
-					       (guint8 *) & ret, 4);
+	  MemoryStream *inner = in->stream.memory_stream;
+	  if (inner->current >= inner->size)
+	      return 0;
+	  got = inner->size - inner->current;
+	  in->start = (U8 *) inner->mem + inner->current;
+	  in->pos = in->start;
+	  in->end = in->start + got;
+	  in->lim = inner->size;
+	  inner->current = inner->size;
+	  return got;
       }
-    else if (in->kind == FILE_STREAM)
+
+    if (in->buf == NULL)
+	in->buf = (U8 *) wvMalloc (WV_STREAM_BUFSIZE);
+
+    if (in->kind == LIBOLE_STREAM)
       {
-	  fread (&ret, sizeof (U8), 4, in->stream.file_stream);
+	  MsOleStream *inner = in->stream.libole_stream;
+	  MsOlePos at = inner->tell (inner);
+
+	  /* read_copy reads nothing at all if asked for too much */
+	  if (at < inner->size)
+	      got = inner->size - at;
+	  if (got > WV_STREAM_BUFSIZE)
+	      got = WV_STREAM_BUFSIZE;
+	  if (got && !inner->read_copy (inner, in->buf, got))
+	    {
+		inner->lseek (inner, at, MsOleSeekSet);
+		got = 0;
+	    }
+	  in->lim = at + got;
       }
     else
       {
-	memorystream_read(in->stream.memory_stream, &ret, 4);
+	  long at = ftell (in->stream.file_stream);
+	  got = fread (in->buf, 1, WV_STREAM_BUFSIZE, in->stream.file_stream);
+	  in->lim = at + got;
       }
-#endif
+
+    if (got == 0)
+	return 0;
+    in->start = in->pos = in->buf;
+    in->end = in->buf + got;
+    return got;
+}
+
+/* read_8ubit () and friends are macros doing the common case of the
+ * bytes being in the buffer, these are called for the rest.
+ */
+U32
+(read_32ubit) (wvStream * in)
+{
+    U16 temp1, temp2;
+    U32 ret;
+    temp1 = read_16ubit (in);
+    temp2 = read_16ubit (in);
+    ret = temp2;
+    ret = ret << 16;
+    ret += temp1;
     return (ret);
 }
 
 U16
-read_16ubit (wvStream * in)
+(read_16ubit) (wvStream * in)
 {
-    U16 ret;
-#if defined(WORDS_BIGENDIAN) || !defined(MATCHED_TYPE)
     U8 temp1, temp2;
+    U16 ret;
     temp1 = read_8ubit (in);
     temp2 = read_8ubit (in);
     ret = temp2;
     ret = ret << 8;
     ret += temp1;
-#else
-    if (in->kind == LIBOLE_STREAM)
-      {
-	  in->stream.libole_stream->read_copy (in->stream.libole_stream,
-					       (guint8 *) & ret, 2);
-      }
-    else if (in->kind == FILE_STREAM)
-      {
-	  fread (&ret, sizeof (U8), 2, in->stream.file_stream);
-      }
-    else
-      {
-	memorystream_read(in->stream.memory_stream, &ret, 2);
-      }
-
-
-#endif
     return (ret);
 }
 
 U8
-read_8ubit (wvStream * in)
+(read_8ubit) (wvStream * in)
 {
-    if (in->kind == LIBOLE_STREAM)
-      {
-	  U8 ret;
-	  in->stream.libole_stream->read_copy (in->stream.libole_stream,
-					       (guint8 *) & ret, 1);
-	  return (ret);
-      }
-    else if (in->kind == FILE_STREAM)
+    if (in->pos < in->end || wvStream_fill (in))
+	return (*in->pos++);
+    /* past the end, answer what the inner streams always did */
+    if (in->kind == FILE_STREAM)
+	return ((U8) EOF);
+    return (0);
+}
+
+void
+read_32ubits (wvStream * in, U32 * out, U32 count)
+{
+    U32 i, n;
+    U8 *p;
+
+    while (count > 0)
       {
-	  return (getc (in->stream.file_stream));
+	  n = (U32) (in->end - in->pos) / 4;
+	  if (n == 0)
+	    {
+		*out++ = (read_32ubit) (in);
+		count--;
+		continue;
+	    }
+	  if (n > count)
+	      n = count;
+	  p = in->pos;
+	  for (i = 0; i < n; i++, p += 4)
+	      out[i] = (U32) p[0] | ((U32) p[1] << 8) |
+		  ((U32) p[2] << 16) | ((U32) p[3] << 24);
+	  in->pos = p;
+	  out += n;
+	  count -= n;
       }
-    else
+}
+
+void
+read_16ubits (wvStream * in, U16 * out, U32 count)
+{
+    U32 i, n;
+    U8 *p;
+
+    while (count > 0)
       {
-	  U8 ret;
-	  memorystream_read(in->stream.memory_stream, &ret, 1);
-	  return ret;
+	  n = (U32) (in->end - in->pos) / 2;
+	  if (n == 0)
+	    {
+		*out++ = (read_16ubit) (in);
+		count--;
+		continue;
+	    }
+	  if (n > count)
+	      n = count;
+	  p = in->pos;
+	  for (i = 0; i < n; i++, p += 2)
+	      out[i] = (U16) (p[0] | (p[1] << 8));
+	  in->pos = p;
+	  out += n;
+	  count -= n;
       }
 }
 
 U32
 wvStream_read (void *ptr, size_t size, size_t nmemb, wvStream * in)
 {
-    if (in->kind == LIBOLE_STREAM)
-      {
-	  return ((U32) in->stream.libole_stream->
-		  read_copy (in->stream.libole_stream, ptr, size * nmemb));
+    U8 *dst = (U8 *) ptr;
+    size_t len = size * nmemb, total = 0, got;
+
+    while (total < len)
+      {
+	  if (in->pos == in->end)
+	    {
+		if (len - total >= WV_STREAM_BUFSIZE)
+		  {
+		      /* too big to be worth buffering */
+		      wvStream_unbuffer (in);
+		      if (in->kind == LIBOLE_STREAM)
+			  got = in->stream.libole_stream->
+			      read_copy (in->stream.libole_stream, dst + total,
+					 len - total) ? len - total : 0;
+		      else if (in->kind == FILE_STREAM)
+			  got = fread (dst + total, 1, len - total,
+				       in->stream.file_stream);
+		      else
+			  got = memorystream_read (in->stream.memory_stream,
+						   dst + total, len - total);
+		      total += got;
+		      break;
+		  }
+		if (!wvStream_fill (in))
+		    break;
+	    }
+	  got = in->end - in->pos;
+	  if (got > len - total)
+	      got = len - total;
+	  memcpy (dst + total, in->pos, got);
+	  in->pos += got;
+	  total += got;
       }
+    if (total < len)
+	memset (dst + total, 0, len - total);
+
+    /* answer as the inner stream's own read would have */
+    if (in->kind == LIBOLE_STREAM)
+	return (total == len);
     else if (in->kind == FILE_STREAM)
-      {
-	  return (fread (ptr, size, nmemb, in->stream.file_stream));
-      }
-    else
-      {
-	return memorystream_read(in->stream.memory_stream, ptr, size * nmemb);
-      }
+	return (size ? total / size : 0);
+    return (total);
 }
 
 void
 wvStream_rewind (wvStream * in)
 {
+    wvStream_drop (in);
     if (in->kind == LIBOLE_STREAM)
       {
 	  in->stream.libole_stream->lseek (in->stream.libole_stream, 0,
@@ -282,6 +413,17 @@ wvStream_rewind (wvStream * in)
 U32
 wvStream_goto (wvStream * in, long position)
 {
+    /* still in the buffer ? */
+    if (in->start != NULL && position >= 0 && (U32) position <= in->lim
+	&& in->lim - (U32) position <= (U32) (in->end - in->start))
+      {
+	  in->pos = in->end - (in->lim - (U32) position);
+	  if (in->kind == FILE_STREAM)
+	      return (0);
+	  return ((U32) position);
+      }
+
+    wvStream_drop (in);
     if (in->kind == LIBOLE_STREAM)
       {
 	  return ((U32) in->stream.libole_stream->
@@ -301,6 +443,9 @@ wvStream_goto (wvStream * in, long position)
 U32
 wvStream_offset (wvStream * in, long offset)
 {
+    if (in->start != NULL)
+	return (wvStream_goto (in, (long) wvStream_tell (in) + offset));
+
     if (in->kind == LIBOLE_STREAM)
       {
 	  return ((U32) in->stream.libole_stream->
@@ -320,6 +465,7 @@ wvStream_offset (wvStream * in, long offset)
 U32
 wvStream_offset_from_end (wvStream * in, long offset)
 {
+    wvStream_drop (in);
     if (in->kind == LIBOLE_STREAM)
       {
 	  return ((U32) in->stream.libole_stream->
@@ -340,6 +486,9 @@ wvStream_offset_from_end (wvStream * in, long offset)
 U32
 wvStream_tell (wvStream * in)
 {
+    if (in->start != NULL)
+	return (in->lim - (U32) (in->end - in->pos));
+
     if (in->kind == LIBOLE_STREAM)
       {
 	  return ((U32) in->stream.libole_stream->
@@ -374,6 +523,7 @@ wvStream_close (wvStream * in)
     if ( !in )
       return 0;
 
+    wvFree (in->buf);
     if (in->kind == LIBOLE_STREAM)
       {
 	  U32 ret = (U32) ms_ole_stream_close (&in->stream.libole_stream);
@@ -528,6 +678,7 @@ write_32ubit (wvStream * in, U32 out)
     guint32 cpy = (guint32) TO_LE_32 (out);
     int nwr = 0;
 
+    wvStream_unbuffer (in);
     if (in->kind == LIBOLE_STREAM)
       {
 	  nwr =
@@ -555,6 +706,7 @@ write_16ubit (wvStream * in, U16 out)
     guint16 cpy = (guint16) TO_LE_16 (out);
     int nwr = 0;
 
+    wvStream_unbuffer (in);
     if (in->kind == LIBOLE_STREAM)
       {
 	  nwr =
@@ -583,6 +735,7 @@ write_8ubit (wvStream * in, U8 out)
     int nwr = 0;
     wvTrace (("About to write 16-bit value"));
 
+    wvStream_unbuffer (in);
     if (in->kind == LIBOLE_STREAM)
       {
 	  nwr =
@@ -606,6 +759,7 @@ int
 wvStream_write (void *ptr, size_t size, size_t nmemb, wvStream * in)
 {
     int nwr = 0;
+    wvStream_unbuffer (in);
     if (in->kind == LIBOLE_STREAM)
       {
 	  nwr =
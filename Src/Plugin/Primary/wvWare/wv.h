@@ -35,11 +35,23 @@ extern "C" {
 	MemoryStream *memory_stream;
     } wvInternalStream;
 
+/* Reads go through a buffer: the bytes from pos to end are read from the
+ * inner stream but not yet handed out, and lim is the offset of the inner
+ * stream at end. A memory stream's buffer is its own memory. When start is
+ * NULL nothing is buffered and the inner stream is where the wvStream is.
+ */
     typedef struct {
 	wvStreamKind kind;
 	wvInternalStream stream;
+	unsigned char *buf;	/* allocated on the first read, NULL for memory */
+	unsigned char *start;	/* first valid byte of the buffer */
+	unsigned char *pos;
+	unsigned char *end;
+	unsigned long lim;
     } wvStream;
 
+#define WV_STREAM_BUFSIZE 4096
+
 
 #ifndef PATH_MAX
 #define PATH_MAX 1024		/*seems a reasonable figure */
@@ -2586,9 +2598,31 @@ that indicates their length.
     void tokenTreeFreeAll (void);
 
 
+/* a config template compiled by wvParseConfig, so that expanding it
+   does not need an XML parser */
+    typedef struct _wvTmplOp {
+	int token;		/* TT_ token of an element, or -1 for text */
+	int len;		/* length of text */
+	char *text;
+    } wvTmplOp;
+
+    typedef struct _wvTemplate {
+	char *src;		/* the template text it was compiled from */
+	int len;
+	U32 hash;
+	int noop;
+	int maxop;
+	wvTmplOp *op;
+	int broken;		/* the text is not well formed XML */
+	struct _wvTemplate *next;	/* next in the hash chain */
+    } wvTemplate;
+
+#define WV_TMPL_HASH 256
+
     typedef struct _wvEle {
 	int nostr;
 	char **str;
+	wvTemplate **tmpl;	/* str compiled, filled in by wvParseConfig */
     } wvEle;
 
 
@@ -2603,6 +2637,7 @@ that indicates their length.
 	U32 currentlen;
 	FILE *fp;
 	const char *path;
+	wvTemplate *tmplhash[WV_TMPL_HASH];	/* all compiled templates */
     } state_data;
 
 
@@ -2949,6 +2984,7 @@ returns the same as wvOLEDecode with the addition that
     U16 wvHandleCodePage (U16 eachchar, U16 lid);
 
     void wvDecodeComplex (wvParseStruct * ps);
+    void wvDecodePlainText (wvParseStruct * ps);
     int wvGetComplexParaBounds (wvVersion ver, PAPX_FKP * fkp, U32 * fcFirst,
 				U32 * fcLim, U32 currentfc, CLX * clx,
 				BTE * bte, U32 * pos, int nobte, U32 piece,
@@ -2968,6 +3004,7 @@ returns the same as wvOLEDecode with the addition that
 
 
     int wvText (wvParseStruct * ps);
+    int wvPlainText (wvParseStruct * ps);
     int wvHtml (wvParseStruct * ps);
 
 #ifdef DEBUG
@@ -4430,6 +4467,26 @@ Property       PID            Type            Default        Description
     U16 read_16ubit (wvStream * in);
     U8 read_8ubit (wvStream * in);
 
+/* Fast paths of the above for bytes already in the stream's buffer,
+ * in may be evaluated more than once */
+#define read_8ubit(in) \
+	((in)->pos < (in)->end ? *(in)->pos++ : (read_8ubit) (in))
+#define read_16ubit(in) \
+	((in)->end - (in)->pos >= 2 ? \
+	 ((in)->pos += 2, \
+	  (U16) ((in)->pos[-2] | ((in)->pos[-1] << 8))) : \
+	 (read_16ubit) (in))
+#define read_32ubit(in) \
+	((in)->end - (in)->pos >= 4 ? \
+	 ((in)->pos += 4, \
+	  (U32) (in)->pos[-4] | ((U32) (in)->pos[-3] << 8) | \
+	  ((U32) (in)->pos[-2] << 16) | ((U32) (in)->pos[-1] << 24)) : \
+	 (read_32ubit) (in))
+
+/* Read count little endian values into out */
+    void read_32ubits (wvStream * in, U32 * out, U32 count);
+    void read_16ubits (wvStream * in, U16 * out, U32 count);
+
     U32 sread_32ubit (const U8 * in);
     U16 sread_16ubit (const U8 * in);
     U8 sread_8ubit (const U8 * in);
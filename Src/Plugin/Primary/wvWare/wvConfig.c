@@ -23,6 +23,9 @@
 extern int (*wvConvertUnicodeToEntity) (U16 char16);
 extern int strcasecmp (const char *s1, const char *s2);
 
+static void wvFreeTemplate (wvTemplate * t);
+static void wvCompileConfig (state_data * sd);
+
 #define HANDLE_B_PARA_ELE(a,b,c,d) \
 if ( (((PAP*)(mydata->props))->b == d) && (c == 0) ) \
 	{ \
@@ -102,7 +105,10 @@ wvInitStateData (state_data * data)
       {
 	  data->elements[i].nostr = 0;
 	  data->elements[i].str = NULL;
+	  data->elements[i].tmpl = NULL;
       }
+    for (i = 0; i < WV_TMPL_HASH; i++)
+	data->tmplhash[i] = NULL;
 }
 
 void
@@ -133,15 +139,25 @@ wvReleaseStateData (state_data * data)
 	  for (k = 0; k < data->elements[i].nostr; k++)
 	      wvFree (data->elements[i].str[k]);
 	  wvFree (data->elements[i].str);
+	  wvFree (data->elements[i].tmpl);
+      }
+    for (i = 0; i < WV_TMPL_HASH; i++)
+      {
+	  while (data->tmplhash[i])
+	    {
+		wvTemplate *t = data->tmplhash[i];
+		data->tmplhash[i] = t->next;
+		wvFreeTemplate (t);
+	    }
       }
 }
 
 
+/* expands one element of a template, the token was looked up when the
+   template was compiled */
 static void
-exstartElement (void *userData, const char *name, const char **atts)
+exstartToken (expand_data * mydata, unsigned int token_type)
 {
-    unsigned int token_type;
-    expand_data *mydata = (expand_data *) userData;
     char *text, *str;
     static int bold, italic, strike, outline, smallcaps, caps, vanish,
 	shadow, lowercase, emboss, imprint, dstrike, iss, kul, color, fontstr,
@@ -159,11 +175,6 @@ exstartElement (void *userData, const char *name, const char **atts)
     */
     PAP *pap;
 
- /*   printf("exstart: %s \n",name);*/
-
-/*  tokenIndex = s_mapNameToToken ((const char *) name);
-    token_type = s_Tokens[tokenIndex].m_type;
- */ token_type = wvMapNameToTokenType ((const char *) name);
     switch (token_type)
       {
       case TT_TITLE:
@@ -3348,40 +3359,6 @@ endElement (void *userData, const XML_Char *name)
     wvTrace (("ele ended\n"));
 }
 
-static void
-exendElement (void *userData, const char *name)
-{
-    /*
-       expand_data *mydata = (expand_data *)userData;
-     */
-    unsigned int token_type;
-
-/*  tokenIndex = s_mapNameToToken ((const char *) name);
-    token_type = s_Tokens[tokenIndex].m_type;
- */ token_type = wvMapNameToTokenType ((const char *) name);
-    switch (token_type)
-      {
-      case TT_TITLE:
-      case TT_CHARSET:
-      case TT_COLSPAN:
-      case TT_ROWSPAN:
-      case TT_CELLBGCOLOR:
-      case TT_PARABGCOLOR:
-      case TT_PARAFGCOLOR:
-      case TT_TABLERELWIDTH:
-      case TT_no_rows:
-      case TT_no_cols:
-      case TT_CELLRELWIDTH:
-      case TT_CELLRELPAGEWIDTH:
-      case TT_VERSION:
-      case TT_FILENAME:
-	  break;
-      default:
-	  break;
-      }
-    wvTrace (("ele ended\n"));
-}
-
 static void
 charData (void *userData, const XML_Char * s, int len)
 {
@@ -3430,11 +3407,10 @@ charData (void *userData, const XML_Char * s, int len)
 }
 
 static void
-excharData (void *userData, const XML_Char * s, int len)
+excharData (expand_data * mydata, const char *s, int len)
 {
     int i;
 
-    expand_data *mydata = (expand_data *) userData;
     if (len > 0)
 	mydata->retstring =
 	    (char *) realloc (mydata->retstring, len + mydata->currentlen + 1);
@@ -3502,6 +3478,8 @@ wvParseConfig (state_data * myhandle)
         ctxt->sax = NULL;
         xmlFreeParserCtxt (ctxt);
 
+	if (ret == 0)
+		wvCompileConfig (myhandle);
 	return ret;
 }
 #else
@@ -3544,6 +3522,7 @@ wvParseConfig (state_data * myhandle)
 #ifdef DEBUG
     wvListStateData (myhandle);
 #endif
+    wvCompileConfig (myhandle);
 
     return 0;
 }
@@ -3558,77 +3537,237 @@ wvInitExpandData (expand_data * data)
     data->currentlen = 0;
 }
 
-#ifdef HAVE_LIBXML2
-int
-wvExpand (expand_data * myhandle, char *buf, int len)
+static void
+wvTmplAddOp (wvTemplate * t, int token, const char *text, int len)
 {
-	int ret = 0;
+    wvTmplOp *op;
 
+    /* the parser may hand over text in pieces, keep it in one op */
+    if ((token < 0) && (t->noop > 0) && (t->op[t->noop - 1].token < 0))
+      {
+	  op = &t->op[t->noop - 1];
+	  op->text = (char *) realloc (op->text, op->len + len + 1);
+	  memcpy (op->text + op->len, text, len);
+	  op->len += len;
+	  op->text[op->len] = '\0';
+	  return;
+      }
+    if (t->noop == t->maxop)
+      {
+	  t->maxop = t->maxop ? t->maxop * 2 : 8;
+	  t->op = (wvTmplOp *) realloc (t->op, t->maxop * sizeof (wvTmplOp));
+      }
+    op = &t->op[t->noop++];
+    op->token = token;
+    op->len = len;
+    op->text = NULL;
+    if (token < 0)
+      {
+	  op->text = (char *) wvMalloc (len + 1);
+	  memcpy (op->text, text, len);
+	  op->text[len] = '\0';
+      }
+}
+
+static void
+ctstartElement (void *userData, const XML_Char * name, const XML_Char ** atts)
+{
+    wvTmplAddOp ((wvTemplate *) userData,
+		 (int) wvMapNameToTokenType ((const char *) name), NULL, 0);
+}
+
+static void
+ctcharData (void *userData, const XML_Char * s, int len)
+{
+    if (len > 0)
+	wvTmplAddOp ((wvTemplate *) userData, -1, (const char *) s, len);
+}
+
+#ifdef HAVE_LIBXML2
+static void
+wvParseTemplate (wvTemplate * t)
+{
 	xmlSAXHandler hdl;
 	xmlParserCtxtPtr ctxt;
 
 	memset(&hdl, 0, sizeof(hdl));
 
 	hdl.getEntity = _getEntity;
-	hdl.startElement = exstartElement;
-	hdl.endElement = exendElement;
-	hdl.characters = excharData;
+	hdl.startElement = ctstartElement;
+	hdl.characters = ctcharData;
 
-	ctxt = xmlCreateMemoryParserCtxt ((const char *) buf, len);
+	ctxt = xmlCreateMemoryParserCtxt ((const char *) t->src, t->len);
 	if (ctxt == NULL)
 	{
-		/* by this point we haven't allocated anything so we can just return right here */
-		return 1;
+		t->broken = 1;
+		return;
 	}
 	ctxt->sax = &hdl;
-	ctxt->userData = (void *) myhandle;
-
-	wvInitExpandData (myhandle);
+	ctxt->userData = (void *) t;
 
 	xmlParseDocument (ctxt);
 
-        if (!ctxt->wellFormed) ret = 1;
+        if (!ctxt->wellFormed) t->broken = 1;
 
         ctxt->sax = NULL;
         xmlFreeParserCtxt (ctxt);
-
-	return ret;
 }
 #else
-int
-wvExpand (expand_data * myhandle, char *buf, int len)
+static void
+wvParseTemplate (wvTemplate * t)
 {
     XML_Parser parser = XML_ParserCreate (NULL);
 
-    wvTrace (("expanding string %s\n", buf));
-
-    XML_SetUserData (parser, myhandle);
-    XML_SetElementHandler (parser, exstartElement, exendElement);
-    XML_SetCharacterDataHandler (parser, excharData);
-    wvInitExpandData (myhandle);
+    XML_SetUserData (parser, t);
+    XML_SetElementHandler (parser, ctstartElement, NULL);
+    XML_SetCharacterDataHandler (parser, ctcharData);
 
-    if (!XML_Parse (parser, buf, len, 1))
+    if (!XML_Parse (parser, t->src, t->len, 1))
       {
 	  wvError (("%s at line %d\n",
 		    XML_ErrorString (XML_GetErrorCode (parser)),
 		    XML_GetCurrentLineNumber (parser)));
-	  return 1;
+	  t->broken = 1;
       }
 
     XML_ParserFree (parser);
-
-    return 0;
 }
 #endif
 
+static U32
+wvHashTemplate (const char *buf, int len)
+{
+    U32 hash = 0;
+    int i;
+
+    for (i = 0; i < len; i++)
+	hash = hash * 31 + (U8) buf[i];
+    return hash;
+}
+
+/*
+turns the XML text of a template into the list of elements and text it
+consists of, the elements are looked up in the token table here once
+instead of on every expansion
+*/
+static wvTemplate *
+wvCompileTemplate (const char *buf, int len)
+{
+    wvTemplate *t = (wvTemplate *) wvMalloc (sizeof (wvTemplate));
+
+    t->src = (char *) wvMalloc (len + 1);
+    memcpy (t->src, buf, len);
+    t->src[len] = '\0';
+    wvTrace (("compiling template %s\n", t->src));
+    t->len = len;
+    t->hash = wvHashTemplate (buf, len);
+    wvParseTemplate (t);
+    return t;
+}
+
+static void
+wvFreeTemplate (wvTemplate * t)
+{
+    int i;
+
+    for (i = 0; i < t->noop; i++)
+	wvFree (t->op[i].text);
+    wvFree (t->op);
+    wvFree (t->src);
+    wvFree (t);
+}
+
+/* finds the compiled form of a template, compiling it the first time */
+static wvTemplate *
+wvLookupTemplate (state_data * sd, const char *buf, int len)
+{
+    U32 hash = wvHashTemplate (buf, len);
+    wvTemplate **head = &sd->tmplhash[hash % WV_TMPL_HASH];
+    wvTemplate *t;
+
+    for (t = *head; t != NULL; t = t->next)
+	if ((t->hash == hash) && (t->len == len)
+	    && (memcmp (t->src, buf, len) == 0))
+	    return t;
+    t = wvCompileTemplate (buf, len);
+    t->next = *head;
+    *head = t;
+    return t;
+}
+
+static void
+wvCompileConfig (state_data * sd)
+{
+    int i, j;
+
+    for (i = 0; i < TokenTableSize; i++)
+      {
+	  wvEle *ele = &sd->elements[i];
+
+	  if (ele->str == NULL)
+	      continue;
+	  wvFree (ele->tmpl);
+	  ele->tmpl =
+	      (wvTemplate **) wvMalloc (sizeof (wvTemplate *) * ele->nostr);
+	  for (j = 0; j < ele->nostr; j++)
+	      if (ele->str[j])
+		  ele->tmpl[j] =
+		      wvLookupTemplate (sd, ele->str[j], strlen (ele->str[j]));
+      }
+}
+
+static int
+wvRunTemplate (expand_data * myhandle, wvTemplate * t)
+{
+    int i;
+
+    wvInitExpandData (myhandle);
+    for (i = 0; i < t->noop; i++)
+      {
+	  if (t->op[i].token < 0)
+	      excharData (myhandle, t->op[i].text, t->op[i].len);
+	  else
+	      exstartToken (myhandle, (unsigned int) t->op[i].token);
+      }
+    return t->broken;
+}
+
+int
+wvExpand (expand_data * myhandle, char *buf, int len)
+{
+    wvTemplate *t;
+    int ret;
+
+    wvTrace (("expanding string %s\n", buf));
+
+    if (myhandle->sd != NULL)
+	return wvRunTemplate (myhandle,
+			      wvLookupTemplate (myhandle->sd, buf, len));
+
+    t = wvCompileTemplate (buf, len);
+    ret = wvRunTemplate (myhandle, t);
+    wvFreeTemplate (t);
+    return ret;
+}
+
+/* expands the which'th template of a config element */
+static int
+wvExpandEle (expand_data * data, int token, int which)
+{
+    wvEle *ele = &data->sd->elements[token];
+
+    if (ele->tmpl && ele->tmpl[which])
+	return wvRunTemplate (data, ele->tmpl[which]);
+    return wvExpand (data, ele->str[which], strlen (ele->str[which]));
+}
+
 void
 wvSetEntityConverter (expand_data * data)
 {
     if ((data->sd) && (data->sd->elements[TT_CHARENTITY].str)
 	&& (data->sd->elements[TT_CHARENTITY].str[0]))
       {
-	  wvExpand (data, data->sd->elements[TT_CHARENTITY].str[0],
-		    strlen (data->sd->elements[TT_CHARENTITY].str[0]));
+	  wvExpandEle (data, TT_CHARENTITY, 0);
 	  if (data->retstring)
 	    {
 		if (!(strcasecmp (data->retstring, "HTML")))
@@ -3651,8 +3790,7 @@ wvBeginDocument (expand_data * data)
     if ((data->sd != NULL) && (data->sd->elements[TT_DOCUMENT].str[0] != NULL))
       {
 	  wvTrace (("doc begin is %s", data->sd->elements[TT_DOCUMENT].str[0]));
-	  wvExpand (data, data->sd->elements[TT_DOCUMENT].str[0],
-		    strlen (data->sd->elements[TT_DOCUMENT].str[0]));
+	  wvExpandEle (data, TT_DOCUMENT, 0);
 	  if (data->retstring)
 	    {
 		wvTrace (("doc begin is now %s", data->retstring));
@@ -3676,8 +3814,7 @@ wvEndDocument (expand_data * data)
 
     if ((data->sd != NULL) && (data->sd->elements[TT_DOCUMENT].str[1] != NULL))
       {
-	  wvExpand (data, data->sd->elements[TT_DOCUMENT].str[1],
-		    strlen (data->sd->elements[TT_DOCUMENT].str[1]));
+	  wvExpandEle (data, TT_DOCUMENT, 1);
 	  if (data->retstring)
 	    {
 		wvTrace (("doc end is now %s", data->retstring));
@@ -3697,8 +3834,7 @@ wvBeginSection (expand_data * data)
 	&& (data->sd->elements[TT_SECTION].str != NULL)
 	&& (data->sd->elements[TT_SECTION].str[0] != NULL))
       {
-	  wvExpand (data, data->sd->elements[TT_SECTION].str[0],
-		    strlen (data->sd->elements[TT_SECTION].str[0]));
+	  wvExpandEle (data, TT_SECTION, 0);
 	  if (data->retstring)
 	    {
 		wvTrace (("para begin is now %s", data->retstring));
@@ -3715,8 +3851,7 @@ wvEndSection (expand_data * data)
 	&& (data->sd->elements[TT_SECTION].str != NULL)
 	&& (data->sd->elements[TT_SECTION].str[1] != NULL))
       {
-	  wvExpand (data, data->sd->elements[TT_SECTION].str[1],
-		    strlen (data->sd->elements[TT_SECTION].str[1]));
+	  wvExpandEle (data, TT_SECTION, 1);
 	  if (data->retstring)
 	    {
 		wvTrace (("para end is now %s", data->retstring));
@@ -3735,8 +3870,7 @@ wvBeginComment (expand_data * data)
 	  if ((data->sd != NULL) && (data->sd->elements[TT_COMMENT].str)
 	      && (data->sd->elements[TT_COMMENT].str[0] != NULL))
 	    {
-		wvExpand (data, data->sd->elements[TT_COMMENT].str[0],
-			  strlen (data->sd->elements[TT_COMMENT].str[0]));
+		wvExpandEle (data, TT_COMMENT, 0);
 		if (data->retstring)
 		  {
 		      printf ("%s", data->retstring);
@@ -3753,8 +3887,7 @@ wvEndComment (expand_data * data)
 	&& (data->sd->elements[TT_COMMENT].str[1] != NULL))
       {
 	  wvTrace (("comment ending\n"));
-	  wvExpand (data, data->sd->elements[TT_COMMENT].str[1],
-		    strlen (data->sd->elements[TT_COMMENT].str[1]));
+	  wvExpandEle (data, TT_COMMENT, 1);
 	  if (data->retstring)
 	    {
 		wvTrace (("comment end is now %s", data->retstring));
@@ -3778,8 +3911,7 @@ wvBeginPara (expand_data * data)
 	  if ((data->sd != NULL) && (data->sd->elements[TT_PARA].str)
 	      && (data->sd->elements[TT_PARA].str[0] != NULL))
 	    {
-		wvExpand (data, data->sd->elements[TT_PARA].str[0],
-			  strlen (data->sd->elements[TT_PARA].str[0]));
+		wvExpandEle (data, TT_PARA, 0);
 		if (data->retstring)
 		  {
 		      printf ("%s", data->retstring);
@@ -3798,8 +3930,7 @@ wvEndPara (expand_data * data)
     if ((data->sd != NULL) && (data->sd->elements[TT_PARA].str)
 	&& (data->sd->elements[TT_PARA].str[1] != NULL))
       {
-	  wvExpand (data, data->sd->elements[TT_PARA].str[1],
-		    strlen (data->sd->elements[TT_PARA].str[1]));
+	  wvExpandEle (data, TT_PARA, 1);
 	  if (data->retstring)
 	    {
 		wvTrace (("para end is now %s", data->retstring));
@@ -3877,8 +4008,7 @@ wvBeginCharProp (expand_data * data, PAP * apap)
 	&& (data->sd->elements[TT_CHAR].str)
 	&& (data->sd->elements[TT_CHAR].str[0] != NULL))
       {
-	  wvExpand (data, data->sd->elements[TT_CHAR].str[0],
-		    strlen (data->sd->elements[TT_CHAR].str[0]));
+	  wvExpandEle (data, TT_CHAR, 0);
 	  if (data->retstring)
 	    {
 		wvTrace (("char begin is now %s", data->retstring));
@@ -3895,8 +4025,7 @@ wvEndCharProp (expand_data * data)
     if ((data->sd != NULL) && (data->sd->elements[TT_CHAR].str)
 	&& (data->sd->elements[TT_CHAR].str[1] != NULL))
       {
-	  wvExpand (data, data->sd->elements[TT_CHAR].str[1],
-		    strlen (data->sd->elements[TT_CHAR].str[1]));
+	  wvExpandEle (data, TT_CHAR, 1);
 	  if (data->retstring)
 	    {
 		wvTrace (("char end is now %s", data->retstring));
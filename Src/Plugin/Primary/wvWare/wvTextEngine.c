@@ -14,3 +14,13 @@ wvText (wvParseStruct * ps)
 	wvDecodeSimple (ps, Dmain);
     return (0);
 }
+
+/* the text alone, see wvDecodePlainText */
+int
+wvPlainText (wvParseStruct * ps)
+{
+    if (wvQuerySupported (&ps->fib, NULL) < WORD6)
+	return (wvText (ps));
+    wvDecodePlainText (ps);
+    return (0);
+}
@@ -60,6 +60,9 @@ extern char *xml_slash;
 /* flag for disabling graphics */
 int   no_graphics = 0;
 
+/* flag for -t / --text, the text alone through wvPlainText */
+int   plain_text = 0;
+
 int myelehandler (wvParseStruct * ps, wvTag tag, void *props, int dirty);
 int mydochandler (wvParseStruct * ps, wvTag tag);
 int myCharProc (wvParseStruct * ps, U16 eachchar, U8 chartype, U16 lid);
@@ -287,6 +290,7 @@ do_help (void)
     printf ("  -s --suppress=fmt\t\tDon't convert fmt to eps\n");
     printf ("  -X --xml\t\t\tXML ouput\n");
     printf ("  -1 --nographics\t\tno 0x01 graphics output\n");
+    printf ("  -t --text\t\t\tText only, skipping formatting and graphics\n");
     printf ("  -v --version\t\t\tPrint wvWare's version number\n");
     printf ("  -? --help\t\t\tPrint this help message\n");
     printf
@@ -330,6 +334,7 @@ main (int argc, char **argv)
 	{"help", 0, 0, '?'},
 	{"xml", 0, 0, 'X'},
 	{"nographics", 0, 0, '1'},
+	{"text", 0, 0, 't'},
 	{0, 0, 0, 0}
     };
 
@@ -341,7 +346,7 @@ main (int argc, char **argv)
 
     while (1)
       {
-	  c = getopt_long (argc, argv, "?lvc:x:p:d:b:a:s:X1", long_options, &index);
+	  c = getopt_long (argc, argv, "?lvc:x:p:d:b:a:s:X1t", long_options, &index);
 	  if (c == -1)
 	      break;
 	  switch (c)
@@ -402,6 +407,10 @@ main (int argc, char **argv)
 	    case '1':
 		no_graphics = 1;
 		break;
+
+	    case 't':
+		plain_text = 1;
+		break;
 		
 	    default:
 		do_help ();
@@ -514,7 +523,10 @@ main (int argc, char **argv)
       {
 	  expandhandle.sd = &myhandle;
 	  ps.userData = &expandhandle;
-	  ret = wvHtml (&ps);
+	  if (plain_text)
+	      ret = wvPlainText (&ps);
+	  else
+	      ret = wvHtml (&ps);
       }
     wvReleaseStateData (&myhandle);
 
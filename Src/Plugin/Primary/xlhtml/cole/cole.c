@@ -25,6 +25,7 @@
 
 #include "internal.h"
 #include <stdlib.h>
+#include <string.h>
 
 
 
@@ -114,8 +115,55 @@ cole_perror (const char *s, COLERRNO colerrno)
  *
  * Returns: a filesystem in success, or NULL in other case.
  */
+static COLEFS *__cole_mount (COLESRC *src, COLERRNO *colerrno);
 COLEFS *
 cole_mount (char *filename, COLERRNO *colerrno)
+{
+	COLESRC src;
+	COLEFS * ret;
+
+	src.file = fopen (filename, "rb");
+	if (src.file == NULL) {
+		if (colerrno != NULL) *colerrno = COLE_EOPENFILE;
+		return NULL;
+	}
+	src.mem = NULL;
+	src.memsize = 0;
+
+	ret = __cole_mount (&src, colerrno);
+	if (ret == NULL)
+		fclose (src.file);
+	return ret;
+}
+
+
+/**
+ * cole_mount_buffer:
+ * @buffer: the filesystem in memory.
+ * @size: size of @buffer in bytes.
+ * @colerrno: error value (COLE_EMEMORY, COLE_ENOFILESYSTEM,
+ * 			   COLE_EINVALIDFILESYSTEM, COLE_EUNKNOWN).
+ *
+ * Mounts the filesystem which is in @buffer. The buffer is not copied,
+ * it must be kept until the filesystem is umounted.
+ *
+ * Returns: a filesystem in success, or NULL in other case.
+ */
+COLEFS *
+cole_mount_buffer (const U8 *buffer, U32 size, COLERRNO *colerrno)
+{
+	COLESRC src;
+
+	src.file = NULL;
+	src.mem = buffer;
+	src.memsize = size;
+
+	return __cole_mount (&src, colerrno);
+}
+
+
+static COLEFS *
+__cole_mount (COLESRC *src, COLERRNO *colerrno)
 {
 	COLEFS * ret;
 
@@ -124,10 +172,12 @@ cole_mount (char *filename, COLERRNO *colerrno)
 		if (colerrno != NULL) *colerrno = COLE_EMEMORY;
 		return NULL;
 	}
+	ret->src = *src;
 
-	switch (__OLEdecode (filename, &ret->tree, &ret->root, &ret->BDepot,
-				&ret->SDepot, &ret->sbfile, &ret->sbfilename,
-				&ret->file, 0)) {
+	switch (__OLEdecode (&ret->src, &ret->tree, &ret->root, &ret->BDepot,
+				&ret->BDepotSize, &ret->SDepot,
+				&ret->SDepotSize, &ret->sbdata, &ret->sbsize,
+				0)) {
 	case 0:
 		/* success */
 		break;
@@ -135,11 +185,6 @@ cole_mount (char *filename, COLERRNO *colerrno)
 		if (colerrno != NULL) *colerrno = COLE_EMEMORY;
 		free (ret);
 		return NULL;
-	case 7:
-	case 4:
-		if (colerrno != NULL) *colerrno = COLE_EOPENFILE;
-		free (ret);
-		return NULL;
 	case 8:
 	case 9:
 		if (colerrno != NULL) *colerrno = COLE_ENOFILESYSTEM;
@@ -162,7 +207,7 @@ cole_mount (char *filename, COLERRNO *colerrno)
 /**
  * cole_umount:
  * @colefilesystem: filesystem to umount.
- * @colerrno: error value (COLE_ECLOSEFILE, COLE_EREMOVE).
+ * @colerrno: error value (COLE_ECLOSEFILE).
  *
  * Umounts the filesystem @colefilesystem.
  *
@@ -176,27 +221,16 @@ cole_umount (COLEFS *colefilesystem, COLERRNO *colerrno)
 	ret = 0;
 	free (colefilesystem->BDepot);
 	free (colefilesystem->tree);
-	if (fclose (colefilesystem->file) && !ret) {
+	if (colefilesystem->src.file != NULL
+	    && fclose (colefilesystem->src.file) && !ret) {
 		if (colerrno != NULL) *colerrno = COLE_ECLOSEFILE;
 		ret = 1;
 	}
-	if (colefilesystem->SDepot != NULL) {
+	/* may no exist SDepot and sbdata because there are not small files */
+	if (colefilesystem->SDepot != NULL)
 		free (colefilesystem->SDepot);
-		/* may no exist SDepot because there are not small files */
-		/* assert (colefilesystem->sbfile != NULL); */
-		/* assert (colefilesystem->sbfilename != NULL); */
-		if (fclose (colefilesystem->sbfile) && !ret) {
-			if (colerrno != NULL) *colerrno = COLE_ECLOSEFILE;
-			ret = 1;
-		}
-#if defined(__WIN32__) || (__BORLANDC__)
-		if (remove (colefilesystem->sbfilename) && !ret) {
-			if (colerrno != NULL) *colerrno = COLE_EREMOVE;
-			ret = 1;
-		}
-#endif
-		free (colefilesystem->sbfilename);
-	}
+	if (colefilesystem->sbdata != NULL)
+		free (colefilesystem->sbdata);
 	free (colefilesystem);
 
 	return ret;
@@ -625,11 +659,11 @@ _cole_fopen_action (COLEDIRENT *cde, void *_info)
 /**
  * cole_fopen_direntry:
  * @coledirentry: directory entry to be opened as file.
- * @colerrno: error value (COLE_EISNOTFILE, COLE_EMEMORY, COLE_ETMPNAM,
- * 			   COLE_EOPENFILE, COLE_EINVALIDFILESYSTEM, COLE_EREAD,
- * 			   COLE_EWRITE, COLE_EUNKNOWN).
+ * @colerrno: error value (COLE_EISNOTFILE, COLE_EMEMORY,
+ * 			   COLE_EINVALIDFILESYSTEM, COLE_EUNKNOWN).
  *
  * Opens a directory entry as file.
+ * The file is not extracted: it's read directly from the filesystem.
  *
  * Returns: a file in success, or NULL in other case.
  */
@@ -637,6 +671,8 @@ COLEFILE *
 cole_fopen_direntry (COLEDIRENT *coledirentry, COLERRNO *colerrno)
 {
 	COLEFILE *ret;
+	COLEFS *fs;
+	U32 size;
 
 	if (!cole_direntry_isfile (coledirentry)) {
 		if (colerrno != NULL) *colerrno = COLE_EISNOTFILE;
@@ -648,50 +684,46 @@ cole_fopen_direntry (COLEDIRENT *coledirentry, COLERRNO *colerrno)
 		if (colerrno != NULL) *colerrno = COLE_EMEMORY;
 		return NULL;
 	}
-	ret->fs = coledirentry->dir->fs;
+	fs = ret->fs = coledirentry->dir->fs;
 	ret->entry = coledirentry->entry;
-	switch (__cole_extract_file (&ret->file, &ret->filename,
-				ret->fs->tree[ ret->entry ].size,
-				ret->fs->tree[ ret->entry ].start,
-				ret->fs->BDepot, ret->fs->SDepot,
-				ret->fs->sbfile, ret->fs->file)) {
-	case 0:
-		/* success */
-		break;
-	case 1:
-		if (colerrno != NULL) *colerrno = COLE_EMEMORY;
-		free (ret);
-		return NULL;
-	case 2:
-		if (colerrno != NULL) *colerrno = COLE_ETMPNAM;
-		free (ret);
-		return NULL;
-	case 3:
-		if (colerrno != NULL) *colerrno = COLE_EOPENFILE;
-		free (ret);
-		return NULL;
-	case 4:
-		if (colerrno != NULL) *colerrno = COLE_EINVALIDFILESYSTEM;
-		free (ret);
-		return NULL;
-	case 5:
-		if (colerrno != NULL) *colerrno = COLE_EREAD;
-		free (ret);
-		return NULL;
-	case 6:
-		if (colerrno != NULL) *colerrno = COLE_EWRITE;
-		free (ret);
-		return NULL;
-	default:
-		if (colerrno != NULL) *colerrno = COLE_EUNKNOWN;
-		free (ret);
-		return NULL;
+	size = fs->tree[ ret->entry ].size;
+	if (size >= 0x1000) {
+		/* read from big block depot */
+		ret->blocksize = 0x0200;
+		if (__cole_chain_blocks (&ret->blocks, &ret->nblocks, size,
+					 fs->tree[ ret->entry ].start,
+					 ret->blocksize, fs->BDepot,
+					 fs->BDepotSize, 0xfffffffaUL)) {
+			if (colerrno != NULL) *colerrno = COLE_EMEMORY;
+			free (ret);
+			return NULL;
+		}
+	} else {
+		/* read from small block file */
+		ret->blocksize = 0x40;
+		if (size != 0 && fs->sbdata == NULL) {
+			if (colerrno != NULL)
+				*colerrno = COLE_EINVALIDFILESYSTEM;
+			free (ret);
+			return NULL;
+		}
+		if (__cole_chain_blocks (&ret->blocks, &ret->nblocks, size,
+					 fs->tree[ ret->entry ].start,
+					 ret->blocksize, fs->SDepot,
+					 fs->SDepotSize, fs->sbsize / 0x40)) {
+			if (colerrno != NULL) *colerrno = COLE_EMEMORY;
+			free (ret);
+			return NULL;
+		}
 	}
 	/* because the original fopen(3) leaves the file pointer
 	   in the beginning */
-	rewind (ret->file);
 	ret->pos = 0;
-	ret->filesize = ret->fs->tree[ ret->entry ].size;
+	ret->cached = 0xffffffffUL;
+	/* if the block chain is broken, the file ends where the chain ends */
+	ret->filesize = ret->nblocks * ret->blocksize;
+	if (ret->filesize > size)
+		ret->filesize = size;
 
 	return ret;
 }
@@ -700,7 +732,7 @@ cole_fopen_direntry (COLEDIRENT *coledirentry, COLERRNO *colerrno)
 /**
  * cole_fclose:
  * @colefile: file to be closed.
- * @colerrno: error value (COLE_ECLOSEFILE, CLOSE_EREMOVE).
+ * @colerrno: error value. Currently this call always success.
  *
  * Closes the file @colefile.
  *
@@ -709,21 +741,21 @@ cole_fopen_direntry (COLEDIRENT *coledirentry, COLERRNO *colerrno)
 int
 cole_fclose (COLEFILE *colefile, COLERRNO *colerrno)
 {
-	int ret;
-
-	ret = 0;
-	if (fclose (colefile->file) && !ret) {
-		if (colerrno != NULL) *colerrno = COLE_ECLOSEFILE;
-		ret = 1;
-	}
-	if (remove (colefile->filename) && !ret) {
-		if (colerrno != NULL) *colerrno = COLE_EREMOVE;
-		ret = 1;
-	}
-	free (colefile->filename);
+	free (colefile->blocks);
 	free (colefile);
 
-	return ret;
+	return 0;
+}
+
+
+/* Reads @count consecutive big blocks, starting at block @block, from the
+   filesystem @fs in @ptr. Blocks past the end of a truncated file are read
+   as zeros. Returns zero in success, no zero in other case. */
+static int
+__cole_read_big_blocks (COLEFS *fs, U32 block, U32 count, U8 *ptr)
+{
+	return __cole_src_read (&fs->src, (block + 1) * 0x0200, ptr,
+				count * 0x0200);
 }
 
 
@@ -732,10 +764,13 @@ cole_fclose (COLEFILE *colefile, COLERRNO *colerrno)
  * @colefile: file to be read.
  * @ptr: memory location where the bytes will be stored.
  * @size: how many bytes will be read.
- * @colerrno: error value (COLE_EOF, COLE_EREAD, COLE_ESEEK).
+ * @colerrno: error value (COLE_EREAD).
  *
  * Reads @size bytes from @colefile and store them in the location given
  * by @ptr. If not success, the file position indicator is not changed.
+ * Small streams are read from the small block file in memory; big streams
+ * are read from the filesystem, a run of consecutive blocks at a time, and
+ * the last partially read block is kept in a cache.
  *
  * Returns: in sucess the number of bytes actually readed (maximum @size)
  * 	    or zero in other case.
@@ -743,38 +778,65 @@ cole_fclose (COLEFILE *colefile, COLERRNO *colerrno)
 size_t
 cole_fread (COLEFILE *colefile, void *ptr, size_t size, COLERRNO *colerrno)
 {
-	size_t bytes_read, bytes_to_read;
-	size_t tbytes;
+	U8 *dest;
+	U32 pos, left, block, offset, n, run;
 
 	/* Check to see if going past end... */
-	if ((colefile->pos + size) > colefile->filesize)
-		tbytes = colefile->filesize - colefile->pos;
-	else
-		tbytes = size;
-	if (tbytes <= 0)
+	if (colefile->pos >= colefile->filesize)
 		return 0;
-	bytes_to_read = (size_t)tbytes;
-	bytes_read = fread (ptr, 1, bytes_to_read, colefile->file);
-	/* assert (size && (colefile->pos + bytes_read > colefile->pos)); */
-	colefile->pos += (unsigned long)bytes_read;
-	/* assert (!feof (colefile->file)
-		   && ftell (colefile->file) == colefile->pos); */
-	if (bytes_read != size) {
-		/* Linux man page says that fread returns a `short item count
-		   (or zero)' when an error of end of file ocurrs. A short count
-		   OR zero? We are hopping that fread always returns zero. */
-		if (feof (colefile->file)) {
-			if (colerrno != NULL) *colerrno = COLE_EOF;
-			return 0;
-		} else if (ferror (colefile->file)) {
-			if (colerrno != NULL) *colerrno = COLE_EREAD;
-			return 0;
+	if (size > colefile->filesize - colefile->pos)
+		left = colefile->filesize - colefile->pos;
+	else
+		left = (U32)size;
+
+	dest = (U8 *)ptr;
+	pos = colefile->pos;
+	while (left > 0) {
+		block = pos / colefile->blocksize;
+		offset = pos % colefile->blocksize;
+		n = colefile->blocksize - offset;
+		if (n > left)
+			n = left;
+		if (colefile->blocksize == 0x40) {
+			/* __cole_chain_blocks checked it's inside sbdata */
+			memcpy (dest, colefile->fs->sbdata
+				+ colefile->blocks[block] * 0x40 + offset, n);
+		} else if (offset == 0 && n == 0x0200) {
+			/* whole blocks: read them directly in @ptr */
+			for (run = 1; (run + 1) * 0x0200 <= left
+			     && colefile->blocks[block + run]
+				== colefile->blocks[block] + run; run++)
+				;
+			n = run * 0x0200;
+			if (__cole_read_big_blocks (colefile->fs,
+						    colefile->blocks[block],
+						    run, dest)) {
+				if (colerrno != NULL) *colerrno = COLE_EREAD;
+				return 0;
+			}
+		} else {
+			if (colefile->cached != block) {
+				if (__cole_read_big_blocks (colefile->fs,
+						colefile->blocks[block], 1,
+						colefile->cache)) {
+					colefile->cached = 0xffffffffUL;
+					if (colerrno != NULL)
+						*colerrno = COLE_EREAD;
+					return 0;
+				}
+				colefile->cached = block;
+			}
+			memcpy (dest, colefile->cache + offset, n);
 		}
+		dest += n;
+		pos += n;
+		left -= n;
 	}
-	/* assert (size != 0 && bytes_read != 0); */
 	/* assert (bytes_read <= size); */
+	size = pos - colefile->pos;
+	colefile->pos = pos;
 
-	return bytes_read;
+	return size;
 }
 
 
@@ -905,8 +967,6 @@ cole_fsize (COLEFILE *colefile)
 int
 cole_feof (COLEFILE *colefile)
 {
-	/* assert ((colefile->pos == colefile->fs->tree[ colefile->entry ].size)
-	        && feof (colefile->file)); */
 	return (colefile->pos == colefile->filesize);
 }
 
@@ -149,6 +149,8 @@ typedef		void (COLE_LOCATE_ACTION_FUNC)	(COLEDIRENT *coledirentry,
  * ***********/
 COLEFS *	cole_mount		(char *filename,
 					COLERRNO *colerrno);
+COLEFS *	cole_mount_buffer	(const U8 *buffer, U32 size,
+					COLERRNO *colerrno);
 int		cole_umount		(COLEFS *colefilesystem,
 					COLERRNO *colerrno);
 int		cole_print_tree		(COLEFS *colefilesystem,
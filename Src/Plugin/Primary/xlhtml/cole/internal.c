@@ -25,123 +25,65 @@
 #include <string.h>
 //#include <unistd.h>
 
-#include "../xlhtml/version.h"
-
 #include "internal.h"
 
-int __opened_files_count;
-char *__opened_files[256];
-
-extern char *tmpdir;
-
-#define MIN(a,b) ((a)<(b) ? (a) : (b))
-
-void __remove_all_files(void)
+int
+__cole_chain_blocks (U32 **blocks, U32 *nblocks, U32 size, U32 pps_start,
+		     U16 BlockSize, U8 *Depot, U32 DepotSize, U32 maxblock)
 {
-    int i;
-    for(i = 0; i < __opened_files_count; ++i)
-    {
-        if(NULL != __opened_files[i])
-        {
-            remove(__opened_files[i]);
-            free(__opened_files[i]);
-        }
-    }
-    __opened_files_count = 0;
-}
-
+	U32 n, max;
+	U32 *ret;
+
+	/* streams are served straight from the filesystem (big blocks)
+	   or from the in-memory small block file (small blocks), so here
+	   we only need to know where each block of the stream is */
+	max = size / BlockSize + (size % BlockSize ? 1 : 0);
+	ret = (U32 *)malloc ((max ? max : 1) * sizeof (U32));
+	*blocks = ret;
+	*nblocks = 0;
+	if (ret == NULL)
+		return 1;
+
+	for (n = 0; n < max; n++) {
+		/* a broken chain ends the stream, as when it was extracted
+		   to a temporal file */
+		if (pps_start >= maxblock)
+			break;
+		ret[n] = pps_start;
+		if (pps_start >= DepotSize / 4) {
+			n++;
+			break;
+		}
+		pps_start = fil_sreadU32 (Depot + (pps_start * 4));
+	}
+	*nblocks = n;
 
-char *__cole_generate_tmp_name()
-{
-    char prefix[64];
-    char *filename;
-    if( tmpdir )
-    {
-        putenv("TMP=");
-    }
-    sprintf(prefix,"cole-%s-0x%08x.", VERSION, getpid());
-    filename = tempnam( tmpdir, prefix );
-    if(NULL == filename)
-        return NULL;
-    __opened_files[__opened_files_count++] = strdup(filename);
-    atexit(__remove_all_files);
-    return filename;
+	return 0;
 }
 
+
 int
-__cole_extract_file (FILE **file, char **filename, U32 size, U32 pps_start,
-		    U8 *BDepot, U8 *SDepot, FILE *sbfile, FILE *inputfile)
+__cole_src_read (COLESRC *src, U32 pos, U8 *ptr, U32 size)
 {
-	/* FIXME rewrite this cleaner */
-
-	U16 BlockSize, Offset;
-	U8 *Depot;
-	FILE *infile;
-	long FilePos;
-	size_t bytes_to_copy;
-	U8 Block[0x0200];
-
-	FILE *ret;
-
-    if (NULL == (*filename = __cole_generate_tmp_name())) {
-        return 2;
-    }
-	ret = fopen (*filename, "w+b");
-	*file = ret;
-	if (ret == NULL) {
-		free (*filename);
-		return 3;
-	}
-
-	if (size >= 0x1000) {
-		/* read from big block depot */
-		Offset = 1;
-		BlockSize = 0x0200;
-		infile = inputfile;
-		Depot = BDepot;
-	} else {
-		/* read from small block file */
-		Offset = 0;
-		BlockSize = 0x40;
-		infile = sbfile;
-		Depot = SDepot;
-	}
-	while (pps_start != 0xfffffffeUL /*&& pps_start != 0xffffffffUL &&
-		pps_start != 0xfffffffdUL*/) {
-		FilePos = (long)((pps_start + Offset) * BlockSize);
-		if (FilePos < 0) {
-			fclose (*file);
-			remove (*filename);
-			free (*filename);
-			return 4;
+	size_t bytes_read;
+
+	if (src->file == NULL) {
+		bytes_read = 0;
+		if (pos < src->memsize) {
+			bytes_read = src->memsize - pos;
+			if (bytes_read > size)
+				bytes_read = size;
+			memcpy (ptr, src->mem + pos, bytes_read);
 		}
-		bytes_to_copy = MIN ((U32)BlockSize, size);
-		if (fseek (infile, FilePos, SEEK_SET)) {
-			fclose (*file);
-			remove (*filename);
-			free (*filename);
-			return 4;
-		}
-		fread (Block, bytes_to_copy, 1, infile);
-		if (ferror (infile)) {
-			fclose (*file);
-			remove (*filename);
-			free (*filename);
-			return 5;
-		}
-		fwrite (Block, bytes_to_copy, 1, *file);
-		if (ferror (*file)) {
-			fclose (*file);
-			remove (*filename);
-			free (*filename);
-			return 6;
-		}
-		pps_start = fil_sreadU32 (Depot + (pps_start * 4));
-		size -= MIN ((U32)BlockSize, size);
-		if (size == 0)
-			break;
+	} else {
+		if (fseek (src->file, (long)pos, SEEK_SET))
+			return 1;
+		bytes_read = fread (ptr, 1, size, src->file);
+		if (bytes_read != size && ferror (src->file))
+			return 1;
 	}
+	if (bytes_read != size)
+		memset (ptr + bytes_read, 0, size - bytes_read);
 
 	return 0;
 }
-
@@ -65,30 +65,52 @@ struct pps_block
 typedef struct pps_block pps_entry;
 
 
+/* Where a filesystem is read from: a file, or a buffer in memory */
+struct _COLESRC {
+	FILE *file;			/* the filesystem file, or NULL */
+	const U8 *mem;			/* the filesystem, if file is NULL */
+	U32 memsize;
+};
+typedef struct _COLESRC COLESRC;
+
+/*
+   Read from a filesystem source.
+   Input: COLESRC *src = Where to read from.
+   .      U32 pos      = Offset in the filesystem.
+   .      U8 *ptr      = Where the bytes will be stored.
+   .      U32 size     = How many bytes to read. Bytes past the end of a
+   .                     truncated filesystem are read as zeros.
+   Output: 0 = Sucess.
+   .       1 = Error reading the file.
+ */
+int __cole_src_read (COLESRC *src, U32 pos, U8 *ptr, U32 size);
+
 /*
    Create a OLE stream tree from a file.
-   Input: char *Olefilename        = File to be decoded (ie. .xsl, .doc, .ppt).
+   Input: COLESRC *src             = File to be decoded (ie. .xsl, .doc, .ppt).
    .      pps_entry ** stream_list = The stream tree.
    .      U32 * root               = The number of root dir in stream_list.
-   .      U8 **_BDepot, U8 **_SDepot, FILE **_sbfile, char **_sbfilename,
-   .      FILE **_input,
+   .      U8 **_BDepot, U32 *_BDepotSize, U8 **_SDepot, U32 *_SDepotSize,
+   .      U8 **_sbdata, U32 *_sbsize,
    .                               = Exposes internals, read only.
+   .                                 The small block file is read in memory
+   .                                 (*_sbdata), so no temporal files are
+   .                                 created.
    .      U16 max_level            = The maximum level on stream tree in which
    .                                 streams will be actually extracted
    .                                 to a file. 0 (zero) means extract all.
    Output: 0 = Sucess.
-   .       4 = Couldn't open OLEfilename file (can use perror).
    .       8 = OLEfilename file seems to contain plain text, not OLE file.
    .       9 = OLEfilename is a binary file, but it have not OLEfile format.
    .       5 = Error reading from file, means OLEfilename file has a faulty
    .           OLE file format (UPDATE: not always).
    .       6 = Error removing temporal files.  <-- this is never returned now
-   .       7 = Error creating temporal files, can use perror.
+   .       7 = Error creating temporal files.  <-- this is never returned now
    .       10 = Error allocating memory, there's no more memory.
  */
-int __OLEdecode (char *OLEfilename, pps_entry ** stream_list, U32 * root,
-		 U8 **_BDepot, U8 **_SDepot, FILE **_sbfile, char **_sbfilename,
-		 FILE **_input, U16 max_level);
+int __OLEdecode (COLESRC *src, pps_entry ** stream_list, U32 * root,
+		 U8 **_BDepot, U32 *_BDepotSize, U8 **_SDepot, U32 *_SDepotSize,
+		 U8 **_sbdata, U32 *_sbsize, U16 max_level);
 
 
 
@@ -100,10 +122,12 @@ struct _COLEFS {
 	pps_entry *tree;
 	U32 root;			/* entry root, root pps_entry */
 	U8 *BDepot;
+	U32 BDepotSize;			/* size of BDepot in bytes */
 	U8 *SDepot;
-	FILE *sbfile;
-	char *sbfilename;
-	FILE *file;			/* actual file (the filesystem) */
+	U32 SDepotSize;			/* size of SDepot in bytes */
+	U8 *sbdata;			/* small block file, read in memory */
+	U32 sbsize;			/* size of sbdata in bytes */
+	COLESRC src;			/* actual file (the filesystem) */
 };
 struct _COLEDIRENT {
 	/* This structure is for internal use only, not for the public API */
@@ -119,21 +143,36 @@ struct _COLEDIR {
 struct _COLEFILE {
 	/* This structure is for internal use only, not for the public API */
 	U32 entry;
-	FILE *file;			/* actual extracted file */
-	char *filename;		/* actual extracted file's name */
-	U32 filesize;			/* actual extracted file size */
+	U32 *blocks;			/* block chain of the stream */
+	U32 nblocks;			/* number of blocks in the chain */
+	U16 blocksize;			/* 0x200 (big blocks) or 0x40 (small) */
+	U32 cached;			/* index in blocks of block in cache,
+					   0xffffffffUL if cache is empty */
+	U8 cache[0x0200];		/* last big block read */
+	U32 filesize;			/* stream size */
 	struct _COLEFS *fs;		/* father */
 	U32 pos;			/* file pointer position */
 };
-int __cole_extract_file (FILE **file, char **filename, U32 size,
-			 U32 pps_start, U8 *BDepot, U8 *SDepot, FILE *sbfile,
-			 FILE *inputfile);
+/*
+   Follow the block chain of a stream.
+   Input: U32 **blocks    = Where the chain will be stored (malloc'ed).
+   .      U32 *nblocks    = Where the number of blocks will be stored. It may
+   .                        be less than needed if the chain is broken.
+   .      U32 size        = Size of the stream.
+   .      U32 pps_start   = First block of the stream.
+   .      U16 BlockSize   = 0x200 for big blocks, 0x40 for small blocks.
+   .      U8 *Depot, U32 DepotSize = BDepot or SDepot, and its size.
+   .      U32 maxblock    = Blocks greater or equal than this are invalid.
+   Output: 0 = Sucess.
+   .       1 = Error allocating memory.
+ */
+int __cole_chain_blocks (U32 **blocks, U32 *nblocks, U32 size,
+			 U32 pps_start, U16 BlockSize, U8 *Depot,
+			 U32 DepotSize, U32 maxblock);
 #define _COLE_TYPE_DIR 1
 #define _COLE_TYPE_FILE 2
 #define _COLE_TYPE_ROOT 5
 
-char *__cole_generate_tmp_name();
-
 #ifdef __cplusplus
 }
 #endif
@@ -7,131 +7,96 @@
 
 
 
-extern void do_cr(void);
-extern int  center_tables;
-extern int  first_sheet;
-extern int  last_sheet;
-extern uni_string  default_font;
-extern void trim_sheet_edges(unsigned int);
-extern int  next_ws_title;
-extern void update_default_font(unsigned int);
-extern void OutputString(uni_string * );
-extern int  default_fontsize;
-extern char *default_alignment; 
-extern int  aggressive;
-extern char *lastUpdated; 
-extern int  file_version;
-extern int  NoFormat;
-extern int  notAccurate;
-extern int  formula_warnings;
-extern int  disclamers;
-extern int  NoHeaders;
-extern int  NotImplemented;
-extern int  Unsupported;
-extern int  MaxWorksheetsExceeded;
-extern int  MaxRowExceeded;
-extern int  MaxColExceeded;
-extern int  MaxStringsExceeded;
-extern int  MaxFontsExceeded;
-extern int  MaxPalExceeded;
-extern int  MaxXFExceeded;
-extern int  MaxFormatsExceeded;
-extern char colorTab[MAX_COLORS];
-extern char *default_text_color;
-extern char *default_background_color;
-extern char *default_image;
-extern char filename[256];
-extern int  UnicodeStrings;
-extern int  CodePage; 
-extern char *title;
-extern void update_default_alignment(unsigned int, int);
-extern void output_cell( cell *, int); 
-extern uni_string author;
+extern void do_cr(xlhtml_ctx *);
+extern void trim_sheet_edges(xlhtml_ctx *, unsigned int);
+extern void update_default_font(xlhtml_ctx *, unsigned int);
+extern void OutputString(xlhtml_ctx *, uni_string * );
+extern void update_default_alignment(xlhtml_ctx *, unsigned int, int);
+extern void output_cell(xlhtml_ctx *, cell *, int); 
+extern row_entry *ws_get_row(work_sheet *, U32);
+extern cell *row_next_cell(row_entry *, U16, U16 *);
 extern int null_string(U8 *);
-extern int Csv;
-work_sheet **ws_array;
-font_attr **font_array;
-xf_attr **xf_array;
 
 extern int IsCellNumeric(cell *);
-extern int IsCellSafe(cell *);
+extern int IsCellSafe(xlhtml_ctx *, cell *);
 extern int IsCellFormula(cell *);
-extern void output_formatted_data(uni_string *, U16, int, int);
-extern void SetupExtraction(void);
+extern void output_formatted_data(xlhtml_ctx *, uni_string *, U16, int, int);
+extern void SetupExtraction(xlhtml_ctx *);
 
 
-void OutputPartialTableAscii(void)
+void OutputPartialTableAscii(xlhtml_ctx *xl)
 {
     int i, j, k;
 
-    SetupExtraction();
+    SetupExtraction(xl);
 
     /* Here's where we dump the Html Page out */
-    for (i=first_sheet; i<=last_sheet; i++) /* For each worksheet */
+    for (i=xl->first_sheet; i<=xl->last_sheet; i++) /* For each worksheet */
     {
-        if (ws_array[i] == 0)
+        if (xl->ws_array[i] == 0)
             continue;
-        if ((ws_array[i]->biggest_row == -1)||(ws_array[i]->biggest_col == -1))
-            continue;
-        if (ws_array[i]->c_array == 0)
+        if ((xl->ws_array[i]->biggest_row == -1)||(xl->ws_array[i]->biggest_col == -1))
             continue;
 
         /* Now dump the table */
-        for (j=ws_array[i]->first_row; j<=ws_array[i]->biggest_row; j++)
+        for (j=xl->ws_array[i]->first_row; j<=xl->ws_array[i]->biggest_row; j++)
         {
-            for (k=ws_array[i]->first_col; k<=ws_array[i]->biggest_col; k++)
+            row_entry *re = ws_get_row(xl->ws_array[i], j);
+            U16 ci = 0;
+
+            for (k=xl->ws_array[i]->first_col; k<=xl->ws_array[i]->biggest_col; k++)
             {
                 int safe, numeric=0;
-                cell *c = ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k]; /* This stuff happens for each cell... */
+                cell *c = row_next_cell(re, (U16)k, &ci); /* This stuff happens for each cell... */
 
                 if (c)
                 {
                     numeric = IsCellNumeric(c);
-                    if (!numeric && Csv)
-                        printf("\"");
-                    safe = IsCellSafe(c);
+                    if (!numeric && xl->Csv)
+                        xl_printf(xl, "\"");
+                    safe = IsCellSafe(xl, c);
 
                     if (c->ustr.str)
                     {
                         if (safe)
-                            output_formatted_data(&(c->ustr), xf_array[c->xfmt]->fmt_idx, numeric, IsCellFormula(c));
+                            output_formatted_data(xl, &(c->ustr), xl->xf_array[c->xfmt]->fmt_idx, numeric, IsCellFormula(c));
                         else
-                            OutputString(&(c->ustr));
+                            OutputString(xl, &(c->ustr));
                     }
-                    else if (!Csv)
-                        printf(" ");    /* Empty cell... */
+                    else if (!xl->Csv)
+                        xl_printf(xl, " ");    /* Empty cell... */
                 }
                 else
                 {       /* Empty cell... */
-                    if (!Csv)
-                        printf(" ");
+                    if (!xl->Csv)
+                        xl_printf(xl, " ");
                     else
-                        printf("\"");
+                        xl_printf(xl, "\"");
                 }
-                if (ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k])  /* Honor Column spanning ? */
+                if (c)  /* Honor Column spanning ? */
                 {
-                    if (ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k]->colspan != 0)
-                        k += ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k]->colspan-1;
+                    if (c->colspan != 0)
+                        k += c->colspan-1;
                 }
-                if (!numeric && Csv)
-                    printf("\"");
+                if (!numeric && xl->Csv)
+                    xl_printf(xl, "\"");
 
-                if (Csv && (k < ws_array[i]->biggest_col))
+                if (xl->Csv && (k < xl->ws_array[i]->biggest_col))
                 {   /* big cheat here: quoting everything! */
-                    putchar(',');   /* Csv Cell Separator */
+                    xl_putc(xl, ',');   /* Csv Cell Separator */
                 }
                 else
                 {
-                    if (( !Csv )&&( k != ws_array[i]->biggest_col ))
-                        putchar('\t');  /* Ascii Cell Separator */
+                    if (( !xl->Csv )&&( k != xl->ws_array[i]->biggest_col ))
+                        xl_putc(xl, '\t');  /* Ascii Cell Separator */
                 }
             }
-            if (Csv)
-                printf("\r\n");
+            if (xl->Csv)
+                xl_printf(xl, "\r\n");
             else
-                putchar(0x0A);      /* Row Separator */
+                xl_putc(xl, 0x0A);      /* Row Separator */
         }
-        if (!Csv)
-            printf("\n\n");         /* End of Table 2 LF-CR */
+        if (!xl->Csv)
+            xl_printf(xl, "\n\n");         /* End of Table 2 LF-CR */
     }
 }
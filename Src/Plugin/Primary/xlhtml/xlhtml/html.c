@@ -5,163 +5,131 @@
 
 
 
-extern void do_cr(void);
-extern int  center_tables;
-extern int  first_sheet;
-extern int  last_sheet;
-extern uni_string  default_font;
-extern void trim_sheet_edges(unsigned int);
-extern int  next_ws_title;
-extern void SetupExtraction(void);
-extern void update_default_font(unsigned int);
-extern void OutputString(uni_string * );
-extern int  default_fontsize;
-extern char *default_alignment; 
-extern int  aggressive;
-extern char *lastUpdated; 
-extern int  file_version;
-extern int  NoFormat;
-extern int  notAccurate;
-extern int  formula_warnings;
-extern int  disclaimers;
-extern int  NoHeaders;
-extern int  NotImplemented;
-extern int  Unsupported;
-extern int  MaxWorksheetsExceeded;
-extern int  MaxRowExceeded;
-extern int  MaxColExceeded;
-extern int  MaxStringsExceeded;
-extern int  MaxFontsExceeded;
-extern int  MaxPalExceeded;
-extern int  MaxXFExceeded;
-extern int  MaxFormatsExceeded;
-extern char colorTab[MAX_COLORS][8];
-extern char *default_text_color;
-extern char *default_background_color;
-extern char *default_image;
-extern char filename[256];
-extern int  UnicodeStrings;
-extern int  CodePage; 
-extern char *title;
-extern void update_default_alignment(unsigned int, int);
-extern void output_cell( cell *, int); 
-extern uni_string author;
+extern void do_cr(xlhtml_ctx *);
+extern void trim_sheet_edges(xlhtml_ctx *, unsigned int);
+extern void SetupExtraction(xlhtml_ctx *);
+extern void update_default_font(xlhtml_ctx *, unsigned int);
+extern void OutputString(xlhtml_ctx *, uni_string * );
+extern const char colorTab[MAX_COLORS][8];
+extern void update_default_alignment(xlhtml_ctx *, unsigned int, int);
+extern void output_cell(xlhtml_ctx *, cell *, int); 
+extern row_entry *ws_get_row(work_sheet *, U32);
+extern cell *row_next_cell(row_entry *, U16, U16 *);
 extern int null_string(U8 *);
-extern unsigned int next_font;
-extern int tooold;
-work_sheet **ws_array;
-font_attr **font_array;
 
 
-void output_header(void);
-void output_footer(void);
+void output_header(xlhtml_ctx *);
+void output_footer(xlhtml_ctx *);
 
-void OutputTableHTML(void)
+void OutputTableHTML(xlhtml_ctx *xl)
 {
     int i, j, k;
 
-    output_header();
-    if(tooold)
+    output_header(xl);
+    if(xl->tooold)
     {
-        printf("<H2>This file was saved in very old version of Excel. Some information can not be extracted.</H2>\n");
+        xl_printf(xl, "<H2>This file was saved in very old version of Excel. Some information can not be extracted.</H2>\n");
     }
-    if (center_tables)
+    if (xl->center_tables)
     {
-        printf("<CENTER>");
-        do_cr();
+        xl_printf(xl, "<CENTER>");
+        do_cr(xl);
     }
 
-    SetupExtraction();
+    SetupExtraction(xl);
 
     /* Here's where we dump the Html Page out */
-    for (i=first_sheet; i<=last_sheet; i++) /* For each worksheet */
+    for (i=xl->first_sheet; i<=xl->last_sheet; i++) /* For each worksheet */
     {
-        update_default_font(i);
-        if (ws_array[i] == 0)
+        update_default_font(xl, i);
+        if (xl->ws_array[i] == 0)
             continue;
-        if ((ws_array[i]->biggest_row == -1)||(ws_array[i]->biggest_col == -1))
+        if ((xl->ws_array[i]->biggest_row == -1)||(xl->ws_array[i]->biggest_col == -1))
             continue;
-        if (ws_array[i]->c_array == 0)
-            continue;
-        trim_sheet_edges(i);
+        trim_sheet_edges(xl, i);
 
         /* Print its name */
-        if (next_ws_title > 0)
+        if (xl->next_ws_title > 0)
         {
-            if (ws_array[i]->ws_title.str)
+            if (xl->ws_array[i]->ws_title.str)
             {
-                printf("<H1><CENTER>");
-                OutputString(&ws_array[i]->ws_title);
-                printf("</CENTER></H1><br>");
-                do_cr();
+                xl_printf(xl, "<H1><CENTER>");
+                OutputString(xl, &xl->ws_array[i]->ws_title);
+                xl_printf(xl, "</CENTER></H1><br>");
+                do_cr(xl);
             }
             else
             {
-                printf("<H1><CENTER>(Unknown Page)</CENTER></H1><br>");
-                do_cr();
+                xl_printf(xl, "<H1><CENTER>(Unknown Page)</CENTER></H1><br>");
+                do_cr(xl);
             }
         }
 
         /* Now dump the table */
-        printf("<FONT FACE=\"");
-        OutputString(&default_font);
-        if (default_fontsize != 3)
-            printf("\" SIZE=\"%d", default_fontsize);
-        printf("\">");
-        do_cr();
-		printf("<TABLE cellspacing=\"0\" cellpadding=\"0\">");
-        do_cr();
-        for (j=ws_array[i]->first_row; j<=ws_array[i]->biggest_row; j++)
+        xl_printf(xl, "<FONT FACE=\"");
+        OutputString(xl, &xl->default_font);
+        if (xl->default_fontsize != 3)
+            xl_printf(xl, "\" SIZE=\"%d", xl->default_fontsize);
+        xl_printf(xl, "\">");
+        do_cr(xl);
+		xl_printf(xl, "<TABLE cellspacing=\"0\" cellpadding=\"0\">");
+        do_cr(xl);
+        for (j=xl->ws_array[i]->first_row; j<=xl->ws_array[i]->biggest_row; j++)
         {
-            update_default_alignment(i, j);
-            printf("<TR");
-            if (null_string((U8 *)default_alignment))
-                printf(">");
+            row_entry *re = ws_get_row(xl->ws_array[i], j);
+            U16 ci = 0;
+
+            update_default_alignment(xl, i, j);
+            xl_printf(xl, "<TR");
+            if (null_string((U8 *)xl->default_alignment))
+                xl_printf(xl, ">");
             else
             {
-                if (strcmp(default_alignment, "left") != 0)
-                    printf(" ALIGN=\"%s\"", default_alignment);
-                if (!aggressive)
-                    printf(" VALIGN=\"bottom\">\n");
+                if (strcmp(xl->default_alignment, "left") != 0)
+                    xl_printf(xl, " ALIGN=\"%s\"", xl->default_alignment);
+                if (!xl->aggressive)
+                    xl_printf(xl, " VALIGN=\"bottom\">\n");
                 else
-                    printf(">");
+                    xl_printf(xl, ">");
             }
-            for (k=ws_array[i]->first_col; k<=ws_array[i]->biggest_col; k++)
+            for (k=xl->ws_array[i]->first_col; k<=xl->ws_array[i]->biggest_col; k++)
             {
-                output_cell(ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k],0); /* This stuff happens for each cell... */
-                if (ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k])
+                cell *c = row_next_cell(re, (U16)k, &ci);
+
+                output_cell(xl, c,0); /* This stuff happens for each cell... */
+                if (c)
                 {
-                    if (ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k]->colspan != 0)
-                         k += ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k]->colspan-1;
+                    if (c->colspan != 0)
+                         k += c->colspan-1;
                 }
             }
 
-            if (!aggressive)
-                printf("</TR>\n");
+            if (!xl->aggressive)
+                xl_printf(xl, "</TR>\n");
         }
-        printf("</table></FONT><HR>");
-        do_cr();
+        xl_printf(xl, "</table></FONT><HR>");
+        do_cr(xl);
     }
 
-    if (center_tables)
+    if (xl->center_tables)
     {
-        printf("</CENTER>");
-        do_cr();
+        xl_printf(xl, "</CENTER>");
+        do_cr(xl);
     }
 
     /* Print the author's name in itallics... */
-    if (author.str)
+    if (xl->author.str)
     {
-        printf("<FONT SIZE=-1><I>Spreadsheet's Author:&nbsp;");
-        OutputString(&author);
-        printf("</I></FONT><br>");
-        do_cr();
+        xl_printf(xl, "<FONT SIZE=-1><I>Spreadsheet's Author:&nbsp;");
+        OutputString(xl, &xl->author);
+        xl_printf(xl, "</I></FONT><br>");
+        do_cr(xl);
     }
 
     /* Print when & how the file was last updated. */
-    printf("<FONT SIZE=-1><I>Last Updated ");
-    if (lastUpdated)
-        printf("%s&nbsp; ", lastUpdated);
+    xl_printf(xl, "<FONT SIZE=-1><I>Last Updated ");
+    if (xl->lastUpdated)
+        xl_printf(xl, "%s&nbsp; ", xl->lastUpdated);
 	/*
     switch (file_version)
     {
@@ -176,222 +144,222 @@ void OutputTableHTML(void)
             break;
     }
 	*/
-    printf("</I></FONT><br>");
-    do_cr();
+    xl_printf(xl, "</I></FONT><br>");
+    do_cr(xl);
 
     /* Next print Disclaimers... */
-    if (NoFormat && disclaimers)
+    if (xl->NoFormat && xl->disclaimers)
     {
-        printf("<br>* This cell's format is not supported.<br>");
-        do_cr();
+        xl_printf(xl, "<br>* This cell's format is not supported.<br>");
+        do_cr(xl);
     }
-    if ((notAccurate)&&(formula_warnings)&&(disclaimers))
+    if ((xl->notAccurate)&&(xl->formula_warnings)&&(xl->disclaimers))
     {
-        printf("<br>** This cell's data may not be accurate.<br>");
-        do_cr();
+        xl_printf(xl, "<br>** This cell's data may not be accurate.<br>");
+        do_cr(xl);
     }
-    if (NotImplemented && disclaimers)
+    if (xl->NotImplemented && xl->disclaimers)
     {
-        printf("<br>*** This cell's data type will be supported in the future.<br>");
-        do_cr();
+        xl_printf(xl, "<br>*** This cell's data type will be supported in the future.<br>");
+        do_cr(xl);
     }
-    if (Unsupported && disclaimers)
+    if (xl->Unsupported && xl->disclaimers)
     {
-        printf("<br>**** This cell's type is unsupported.<br>");
-        do_cr();
+        xl_printf(xl, "<br>**** This cell's type is unsupported.<br>");
+        do_cr(xl);
     }
 
     /* Now out exceeded capacity warnings... */
-    if (MaxWorksheetsExceeded || MaxRowExceeded || MaxColExceeded || MaxStringsExceeded ||
-        MaxFontsExceeded || MaxPalExceeded || MaxXFExceeded || MaxFormatsExceeded )
-        printf("<FONT COLOR=\"%s\">", colorTab[0x0A]);
-    if (MaxWorksheetsExceeded)
+    if (xl->MaxWorksheetsExceeded || xl->MaxRowExceeded || xl->MaxColExceeded || xl->MaxStringsExceeded ||
+        xl->MaxFontsExceeded || xl->MaxPalExceeded || xl->MaxXFExceeded || xl->MaxFormatsExceeded )
+        xl_printf(xl, "<FONT COLOR=\"%s\">", colorTab[0x0A]);
+    if (xl->MaxWorksheetsExceeded)
     {
-        printf("The Maximum Number of Worksheets was exceeded. Conversion failed.<br>");
-        do_cr();
+        xl_printf(xl, "The Maximum Number of Worksheets was exceeded. Conversion failed.<br>");
+        do_cr(xl);
     }
-    if (MaxRowExceeded)
+    if (xl->MaxRowExceeded)
     {
-        printf("The Maximum Number of Rows was exceeded. Conversion failed.<br>");
-        do_cr();
+        xl_printf(xl, "The Maximum Number of Rows was exceeded. Conversion failed.<br>");
+        do_cr(xl);
     }
-    if (MaxColExceeded)
+    if (xl->MaxColExceeded)
     {
-        printf("The Maximum Number of Columns was exceeded. Conversion failed.<br>");
-        do_cr();
+        xl_printf(xl, "The Maximum Number of Columns was exceeded. Conversion failed.<br>");
+        do_cr(xl);
     }
-    if (MaxStringsExceeded)
+    if (xl->MaxStringsExceeded)
     {
-        printf("The Maximum Number of Strings was exceeded. Conversion failed.<br>");
-        do_cr();
+        xl_printf(xl, "The Maximum Number of Strings was exceeded. Conversion failed.<br>");
+        do_cr(xl);
     }
-    if (MaxFontsExceeded)
+    if (xl->MaxFontsExceeded)
     {
-        printf("The Maximum Number of Fonts was exceeded. Conversion failed.<br>");
-        do_cr();
+        xl_printf(xl, "The Maximum Number of Fonts was exceeded. Conversion failed.<br>");
+        do_cr(xl);
     }
-    if (MaxPalExceeded)
+    if (xl->MaxPalExceeded)
     {
-        printf("The Maximum Number of Color Palettes was exceeded. Conversion failed.<br>");
-        do_cr();
+        xl_printf(xl, "The Maximum Number of Color Palettes was exceeded. Conversion failed.<br>");
+        do_cr(xl);
     }
-    if (MaxXFExceeded)
+    if (xl->MaxXFExceeded)
     {
-        printf("The Maximum Number of Extended Formats was exceeded. Conversion failed.<br>");
-        do_cr();
+        xl_printf(xl, "The Maximum Number of Extended Formats was exceeded. Conversion failed.<br>");
+        do_cr(xl);
     }
-    if (MaxFormatsExceeded)
+    if (xl->MaxFormatsExceeded)
     {
-        printf("The Maximum Number of Formats was exceeded. Conversion failed.<br>");
-        do_cr();
+        xl_printf(xl, "The Maximum Number of Formats was exceeded. Conversion failed.<br>");
+        do_cr(xl);
     }
-    if (MaxWorksheetsExceeded || MaxRowExceeded || MaxColExceeded || MaxStringsExceeded ||
-        MaxFontsExceeded || MaxPalExceeded || MaxXFExceeded || MaxFormatsExceeded )
-        printf("</FONT>");
+    if (xl->MaxWorksheetsExceeded || xl->MaxRowExceeded || xl->MaxColExceeded || xl->MaxStringsExceeded ||
+        xl->MaxFontsExceeded || xl->MaxPalExceeded || xl->MaxXFExceeded || xl->MaxFormatsExceeded )
+        xl_printf(xl, "</FONT>");
 
-    do_cr();
+    do_cr(xl);
 
     /* Output Tail */
-    output_footer();
+    output_footer(xl);
 }
 
-void output_header(void)
+void output_header(xlhtml_ctx *xl)
 {   /* Ouput Header */
-    if (NoHeaders)
+    if (xl->NoHeaders)
         return;
-    if (!aggressive)
+    if (!xl->aggressive)
     {
-        printf("<!DOCTYPE HTML PUBLIC \"-//W3C//DTD HTML Transitional//EN\"");
-        do_cr();
-        printf("\"http://www.w3.org/TR/REC-html40/loose.dtd\">");
-        do_cr();
+        xl_printf(xl, "<!DOCTYPE HTML PUBLIC \"-//W3C//DTD HTML Transitional//EN\"");
+        do_cr(xl);
+        xl_printf(xl, "\"http://www.w3.org/TR/REC-html40/loose.dtd\">");
+        do_cr(xl);
     }
-    printf("<HTML><HEAD>");
-    do_cr();
-    printf("<meta http-equiv=\"Content-Type\" content=\"text/html; charset=");
-    if ((UnicodeStrings <= 1)&&CodePage&&(CodePage != 1252))
-        printf("windows-%d\">", CodePage);
+    xl_printf(xl, "<HTML><HEAD>");
+    do_cr(xl);
+    xl_printf(xl, "<meta http-equiv=\"Content-Type\" content=\"text/html; charset=");
+    if ((xl->UnicodeStrings <= 1)&&xl->CodePage&&(xl->CodePage != 1252))
+        xl_printf(xl, "windows-%d\">", xl->CodePage);
     else
     {
-        switch (UnicodeStrings)
+        switch (xl->UnicodeStrings)
         {
             case 0:
-                printf("iso-8859-1\">");        /* Latin-1 */
+                xl_printf(xl, "iso-8859-1\">");        /* Latin-1 */
                 break;
             case 1:
-                printf("windows-1252\">");  /* Microsoft */
+                xl_printf(xl, "windows-1252\">");  /* Microsoft */
                 break;
             default:
-                printf("utf-8\">");         /* Unicode */
+                xl_printf(xl, "utf-8\">");         /* Unicode */
                 break;
         }
     }
-    do_cr();
+    do_cr(xl);
 
-    if (!aggressive)
+    if (!xl->aggressive)
     {
-        printf("<meta name=\"GENERATOR\" content=\"xlhtml\">");
-        do_cr();
+        xl_printf(xl, "<meta name=\"GENERATOR\" content=\"xlhtml\">");
+        do_cr(xl);
     }
-    printf("<TITLE>");
-    if (title)
-        printf("%s", title);
+    xl_printf(xl, "<TITLE>");
+    if (xl->title)
+        xl_printf(xl, "%s", xl->title);
     else
-        printf("%s", filename);
-    printf("</TITLE>");
-    do_cr();
-	printf("<style type=\"text/css\"><!-- table { border-collapse: collapse; } td { border: 1px solid gray;  padding: 4px; } --> </style>");
-    do_cr();
-    printf("</HEAD>");
-    do_cr();
-    do_cr();
-    printf("<BODY TEXT=\"#%s\" BGCOLOR=\"#%s\"",
-                default_text_color, default_background_color);
-    if (default_image)
-        printf("BACKGROUND=\"%s\"", default_image);
-    printf("><br>");
-    do_cr();
+        xl_printf(xl, "%s", xl->filename);
+    xl_printf(xl, "</TITLE>");
+    do_cr(xl);
+	xl_printf(xl, "<style type=\"text/css\"><!-- table { border-collapse: collapse; } td { border: 1px solid gray;  padding: 4px; } --> </style>");
+    do_cr(xl);
+    xl_printf(xl, "</HEAD>");
+    do_cr(xl);
+    do_cr(xl);
+    xl_printf(xl, "<BODY TEXT=\"#%s\" BGCOLOR=\"#%s\"",
+                xl->default_text_color, xl->default_background_color);
+    if (xl->default_image)
+        xl_printf(xl, "BACKGROUND=\"%s\"", xl->default_image);
+    xl_printf(xl, "><br>");
+    do_cr(xl);
 }
 
-void output_footer(void)
+void output_footer(xlhtml_ctx *xl)
 {
-    if (NoHeaders)
+    if (xl->NoHeaders)
         return;
-    printf("</BODY></HTML>");
-    do_cr();
-    fflush(stdout);
+    xl_printf(xl, "</BODY></HTML>");
+    do_cr(xl);
+    xl_flush(xl);
 }
 
-void output_start_html_attr(html_attr *h, unsigned int fnt_idx, int do_underlines)
+void output_start_html_attr(xlhtml_ctx *xl, html_attr *h, unsigned int fnt_idx, int do_underlines)
 {
-    if (fnt_idx < next_font)
+    if (fnt_idx < xl->next_font)
     {
-        if (((font_array[fnt_idx]->underline&0x0023) > 0)&&(do_underlines))
+        if (((xl->font_array[fnt_idx]->underline&0x0023) > 0)&&(do_underlines))
         {
-            printf("<U>");
+            xl_printf(xl, "<U>");
             h->uflag = 1;
         }
-        if (font_array[fnt_idx]->bold >= 0x02BC)
+        if (xl->font_array[fnt_idx]->bold >= 0x02BC)
         {
             h->bflag = 1;
-            printf("<B>");
+            xl_printf(xl, "<B>");
         }
-        if (font_array[fnt_idx]->attr & 0x0002)
+        if (xl->font_array[fnt_idx]->attr & 0x0002)
         {
             h->iflag = 1;
-            printf("<I>");
+            xl_printf(xl, "<I>");
         }
-        if (font_array[fnt_idx]->attr & 0x0008)
+        if (xl->font_array[fnt_idx]->attr & 0x0008)
         {
             h->sflag = 1;
-            printf("<S>");
+            xl_printf(xl, "<S>");
         }
-        if ((font_array[fnt_idx]->super & 0x0003) == 0x0001)
+        if ((xl->font_array[fnt_idx]->super & 0x0003) == 0x0001)
         {
             h->spflag = 1;
-            printf("<SUP>");
+            xl_printf(xl, "<SUP>");
         }
-        else if ((font_array[fnt_idx]->super & 0x0003) == 0x0002)
+        else if ((xl->font_array[fnt_idx]->super & 0x0003) == 0x0002)
         {
             h->sbflag = 1;
-            printf("<SUB>");
+            xl_printf(xl, "<SUB>");
         }
     }
 }
 
-void output_end_html_attr(html_attr *h)
+void output_end_html_attr(xlhtml_ctx *xl, html_attr *h)
 {
     if (h->sbflag)
     {
-        printf("</SUB>");
+        xl_printf(xl, "</SUB>");
         h->sbflag = 0;
     }
     else if (h->spflag)
     {
-        printf("</SUP>");
+        xl_printf(xl, "</SUP>");
         h->spflag = 0;
     }
     if (h->sflag)
     {
-        printf("</S>");
+        xl_printf(xl, "</S>");
         h->sflag = 0;
     }
     if (h->iflag)
     {
-        printf("</I>");
+        xl_printf(xl, "</I>");
         h->iflag = 0;
     }
     if (h->bflag)
     {
-        printf("</B>");
+        xl_printf(xl, "</B>");
         h->bflag = 0;
     }
     if (h->uflag)
     {
         if (h->uflag == 1)
-            printf("</U>");
+            xl_printf(xl, "</U>");
         else
-            printf("</A>");
+            xl_printf(xl, "</A>");
         h->uflag = 0;
     }
 }
@@ -0,0 +1,71 @@
+/*! \file libxlhtml.h
+    \brief xlhtml as a library
+
+   A context holds everything one conversion needs, so several threads
+   can convert workbooks at the same time as long as each uses its own
+   context. A context can be reused for any number of workbooks:
+
+   \code
+   xlhtml_ctx *xl = xlhtml_new();
+   xlhtml_option(xl, "-nd");
+   if (xlhtml_open_file(xl, "book.xls") == 0)
+       xlhtml_convert(xl, my_sink, my_data);
+   xlhtml_reset(xl);
+   ...
+   xlhtml_free(xl);
+   \endcode
+*/
+#ifndef LIBXLHTML_H
+#define LIBXLHTML_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct xlhtml_ctx xlhtml_ctx;
+
+/*! Receives the output of xlhtml_convert() a block at a time */
+typedef void (*xlhtml_sink)(void *user, const char *data, size_t len);
+
+/* Return values, the same as the exit codes of the xlhtml program */
+#define XLHTML_OK		0
+#define XLHTML_EUSAGE	1	/*!< Unknown option or bad option value */
+#define XLHTML_EMOUNT	-2	/*!< The OLE container is broken */
+#define XLHTML_EUMOUNT	-3	/*!< The OLE container could not be closed */
+#define XLHTML_EMEMORY	-4	/*!< Out of memory */
+#define XLHTML_EOPEN	-20	/*!< The file could not be opened */
+#define XLHTML_ENOSOURCE	-21	/*!< Nothing was opened */
+
+/*! returns a context with the default options, or 0 if out of memory */
+xlhtml_ctx *xlhtml_new(void);
+
+/*! Sets one command line option, such as "-asc" or "-xp:2".
+    Options stay in effect until the context is freed.
+    \retval XLHTML_OK or XLHTML_EUSAGE */
+int xlhtml_option(xlhtml_ctx *xl, const char *arg);
+
+/*! Selects the workbook file the next conversion reads */
+int xlhtml_open_file(xlhtml_ctx *xl, const char *path);
+
+/*! Selects a workbook already in memory. buf is not copied and must stay
+    valid until xlhtml_reset(). name is used where the output shows the
+    file name and may be 0. */
+int xlhtml_open_buffer(xlhtml_ctx *xl, const unsigned char *buf, size_t len,
+                       const char *name);
+
+/*! Converts the opened workbook, handing the output to sink.
+    \retval XLHTML_OK or an error value */
+int xlhtml_convert(xlhtml_ctx *xl, xlhtml_sink sink, void *user);
+
+/*! Forgets the opened workbook, keeping the options */
+void xlhtml_reset(xlhtml_ctx *xl);
+
+void xlhtml_free(xlhtml_ctx *xl);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,100 @@
+/*! \file main.c
+    \brief The xlhtml program, converts one file to stdout with libxlhtml.h
+*/
+/*
+   Copyright 2002  Charles N Wyble  <jackshck@yahoo.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published  by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
+ */
+
+#include "xlhtml.h"
+
+#ifdef _MSC_VER
+#define WIN32_LEAN_AND_MEAN
+#define STRICT
+#include <windows.h>
+#endif
+
+/* These functions are in support.c */
+extern void print_version(void);
+extern void display_usage(void);
+
+static void write_stdout(void *user, const char *data, size_t len)
+{
+    fwrite(data, 1, len, stdout);
+}
+
+int main (int argc, char **argv)
+{
+    int i, ret;
+    char *filename;
+    xlhtml_ctx *xl;
+
+#ifndef _DEBUG
+	__try {
+#endif
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Incorrect usage. Try xlhtml --help for more information\n");
+        exit(-1);
+    }
+    xl = xlhtml_new();
+    if (xl == 0)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(XLHTML_EMEMORY);
+    }
+
+    filename = argv[argc-1];
+    for (i=1; i<(argc-1); i++)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+            print_version();
+        else if (strcmp(argv[i], "-l") == 0 || strcmp(argv[i], "-lowprio") == 0)
+        {
+#ifdef _MSC_VER
+            SetPriorityClass( GetCurrentProcess(), BELOW_NORMAL_PRIORITY_CLASS );
+            SetThreadPriority( GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL );
+#endif
+        }
+        else if (xlhtml_option(xl, argv[i]) != XLHTML_OK)
+            display_usage();
+    }
+    if (strcmp(filename, "-v") == 0)
+        print_version();
+    if (strcmp(filename, "--version") == 0)
+        print_version();
+    if (strcmp(filename, "--help") == 0)
+        display_usage();
+    if (strcmp(filename, "-?") == 0)
+        display_usage();
+
+    umask(GLOBAL_UMASK);
+
+    xlhtml_open_file(xl, filename);
+    ret = xlhtml_convert(xl, write_stdout, 0);
+    fflush(stdout);
+    xlhtml_free(xl);
+
+#ifndef _DEBUG
+    } __except( 1 /* EXCEPTION_EXECUTE_HANDLER */ )
+    {
+        return 999;
+    }
+#endif
+
+    return ret;
+}
@@ -4,7 +4,7 @@
 #include <stdio.h>
 #include "version.h"
 #include <time.h>
-#include "../cole/cole.h"
+#include "xlhtml.h"
 #include <stdlib.h>
 
 void print_version(void)
@@ -31,6 +31,7 @@ fprintf(stderr, "\nxlhtml  converts excel files (.xls) to Html.\n"
     "\t-fw: Suppress formula warnings\n"
     "\t-nd: Suppress all disclamers\n"
     "\t-m:  No encoding for multibyte\n"
+    "\t-st: Stream cell text as it is read, no table is built\n"
     "\t-nc: No Colors - black & white\n"
     "\t-nh: No Html Headers\n"
     "\t-tc: Set default text color - default black\n"
@@ -42,11 +43,10 @@ fprintf(stderr, "\nxlhtml  converts excel files (.xls) to Html.\n"
     exit (1);
 }
 
-void do_cr(void)
+void do_cr(xlhtml_ctx *xl)
 {
-    extern int aggressive;
-    if (!aggressive)
-        putchar('\n');
+    if (!xl->aggressive)
+        xl_putc(xl, '\n');
 }
 
 U16 getShort(U8 *ptr)
@@ -141,12 +141,10 @@ void FracToTime(U8 *cnum, int *hr, int *minut, int *sec, int *msec)
 }
 
 
-void NumToDate(long num, int *year, int *month, int *day)
+void NumToDate(xlhtml_ctx *xl, long num, int *year, int *month, int *day)
 {
     const int ldays[]={31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
     const int ndays[]={31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-    
-    extern int DatesR1904;
 
     int t, i, y = 0;
 
@@ -156,7 +154,7 @@ void NumToDate(long num, int *year, int *month, int *day)
 
     *year = y;
     t = num;
-    if (DatesR1904)
+    if (xl->DatesR1904)
         *year += 4;     /* Adjust for McIntosh... */
     if ((*year%4) == 0)
     {   /* Leap Year */
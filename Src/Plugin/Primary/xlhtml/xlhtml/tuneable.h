@@ -2,6 +2,6 @@
 #define XFORMATS_INCR		64		/*!< Increments to allocate extended formats */
 #define FONTS_INCR	 	32 		/*!< Increments to allocate fonts */
 #define WORKSHEETS_INCR		4		/*!< Increments to allocate worksheet pages */
-#define COLS_INCR		(U16)24 	/*!< Increments to allocate Columns per Worksheet page */
-#define ROWS_INCR 		(U32)128	/*!< Increments to allocate Rows per Worksheet page */
+#define COLS_INCR		(U16)8 		/*!< Initial cells allocated per Worksheet row */
+#define ROWS_INCR 		(U32)64		/*!< Initial rows allocated per Worksheet page */
 #define STRINGS_INCR 		256UL		/*!< Increments to allocate the string array - */
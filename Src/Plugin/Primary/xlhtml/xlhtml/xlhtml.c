@@ -31,10 +31,11 @@
 #define WIN32_LEAN_AND_MEAN
 #define STRICT
 #include <windows.h>
+#define vsnprintf _vsnprintf
 #endif
+#include <stdarg.h>
 
 #define MAXPATH 1024
-#define MAX_ARRAY_MEM (64*1024*1024)
 
 static char SectionName[2][12] =    /* The section of the Excel Stream where the workbooks are kept */
 {
@@ -43,9 +44,7 @@ static char SectionName[2][12] =    /* The section of the Excel Stream where the
 };
 
 
-int numCustomColors = 0;
-U8 **customColors = 0;
-char colorTab[MAX_COLORS][8] =
+const char colorTab[MAX_COLORS][8] =
 {
     "000000",   /* FIXME: Need to find these first 8 colors! */
     "FFFFFF",
@@ -114,8 +113,6 @@ char colorTab[MAX_COLORS][8] =
     "FFFFFF"    /* 0x40 */
 };
 
-int DatesR1904 = 0; /*!< Flag that the dates are based on McIntosh Dates system */
-
 /* FIXME: Support major languages here...not just English */
 const char month_abbr[12][5] = {    "Jan", "Feb", "Mar", "Apr", "May", "June",
                     "July", "Aug", "Sep", "Oct", "Nov", "Dec" };
@@ -126,343 +123,305 @@ const char month_abbr[12][5] = {    "Jan", "Feb", "Mar", "Apr", "May", "June",
 /* These functions are in support.c */
 extern void print_version(void);
 extern void display_usage(void);
-extern void do_cr(void);
-extern void OutputTableHTML(void);
+extern void do_cr(xlhtml_ctx *);
+extern void OutputTableHTML(xlhtml_ctx *);
 extern S32 getLong(U8 *);
 extern U16 getShort(U8 *);
 extern void getDouble(U8 *, F64 *);
 extern int null_string(U8 *);
 extern void FracToTime(U8 *, int *, int *, int *, int *);
-extern void NumToDate(long, int *, int *, int *);
+extern void NumToDate(xlhtml_ctx *, long, int *, int *, int *);
 extern void RKtoDouble(S32, F64 *);
 
 /* This function is in xml.c */
-extern void OutputTableXML(void);
+extern void OutputTableXML(xlhtml_ctx *);
 
 /* This function is in ascii.c */
-void OutputPartialTableAscii(void);
+void OutputPartialTableAscii(xlhtml_ctx *);
 
 /* These functions are in html.c */
-extern void output_start_html_attr(html_attr *h, unsigned int, int);
-extern void output_end_html_attr(html_attr *h);
-extern void output_footer(void);
-extern void output_header(void);
+extern void output_start_html_attr(xlhtml_ctx *, html_attr *h, unsigned int, int);
+extern void output_end_html_attr(xlhtml_ctx *, html_attr *h);
+extern void output_footer(xlhtml_ctx *);
+extern void output_header(xlhtml_ctx *);
 
 COLE_LOCATE_ACTION_FUNC scan_file;
-void scan_raw_file( FILE *f );
-void main_line_processor(U16, U16, U32, U16, U8);
-void SetupExtraction(void);
+
+/*! Source of the raw BIFF stream, either an OLE stream or a plain file */
+typedef size_t (*biff_read_func)(void *src, U8 *buf, size_t len);
+
+typedef struct      /*!< A bare BIFF stream in memory */
+{
+    const U8 *buf;
+    U32 len;
+    U32 pos;
+}mem_source;
+
+void main_line_processor(xlhtml_ctx *, U16, U16, U16);
+void SetupExtraction(xlhtml_ctx *);
 void decodeBoolErr(U16, U16, char *);
 int IsCellNumeric(cell *);
-int IsCellSafe(cell *);
+int IsCellSafe(xlhtml_ctx *, cell *);
 int IsCellFormula(cell *);
-void output_cell(cell *, int);
-void output_formatted_data(uni_string *, U16, int, int);
-void PrintFloatComma(char *, int, F64);
-void print_as_fraction(F64, int);
-void trim_sheet_edges(unsigned int);
-void update_default_font(unsigned int);
-void incr_f_cnt(uni_string *);
-int get_default_font(void);
-void update_default_alignment(unsigned int, int);
-void OutputString(uni_string *);
-void OutputCharCorrected(U8);
+void output_cell(xlhtml_ctx *, cell *, int);
+void output_formatted_data(xlhtml_ctx *, uni_string *, U16, int, int);
+void PrintFloatComma(xlhtml_ctx *, char *, int, F64);
+void print_as_fraction(xlhtml_ctx *, F64, int);
+void trim_sheet_edges(xlhtml_ctx *, unsigned int);
+void update_default_font(xlhtml_ctx *, unsigned int);
+void incr_f_cnt(xlhtml_ctx *, uni_string *);
+int get_default_font(xlhtml_ctx *);
+void update_default_alignment(xlhtml_ctx *, unsigned int, int);
+void OutputString(xlhtml_ctx *, uni_string *);
+void OutputCharCorrected(xlhtml_ctx *, U8);
 void update_crun_info(U16 *loc, U16 *fnt_idx, U16 crun_cnt, U8 *fmt_run);
-void put_utf8(U16);
-void print_utf8(U16);
+void put_utf8(xlhtml_ctx *, U16);
+void print_utf8(xlhtml_ctx *, U16);
 void uni_string_clear(uni_string *);
 int uni_string_comp(uni_string *, uni_string *);
 void html_flag_init(html_attr *h);
-void output_start_font_attribute(html_attr *h, U16 fnt_idx);
+void output_start_font_attribute(xlhtml_ctx *, html_attr *h, U16 fnt_idx);
 
 /* The array update functions */
-int ws_init(int);
-int add_more_worksheet_ptrs(void);
-int resize_c_array(work_sheet *, U32, U16);
-void add_wb_array(U16, U16, U16, U16, U8, U8 *, U16, U16, U8 *);
-void update_cell_xf(U16, U16, U16);
-void update_cell_hyperlink(U16 r, U16 c, U8 *hyperlink, int len, U16 type);
-void add_str_array(U8, U8 *, U16, U8 *, U8);
-void add_font(U16, U16, U16, U16, U16, U8, U16, U8 *, U16);
-void add_ws_title(U16, U8 *, U16);
-void add_xf_array(U16 fnt_idx, U16 fmt_idx, U16 gen, U16 align,
+int ws_init(xlhtml_ctx *, int);
+int add_more_worksheet_ptrs(xlhtml_ctx *);
+cell **ws_add_cell(xlhtml_ctx *, work_sheet *, U32, U16);
+cell *ws_get_cell(work_sheet *, U32, U16);
+row_entry *ws_get_row(work_sheet *, U32);
+cell *row_next_cell(row_entry *, U16, U16 *);
+void ws_free_cells(work_sheet *);
+void add_wb_array(xlhtml_ctx *, U16, U16, U16, U16, U8, U8 *, U16, U16, U8 *);
+void stream_cell(xlhtml_ctx *, U16, U16, U16, U8, U8 *, U16);
+void stream_end(xlhtml_ctx *);
+void update_cell_xf(xlhtml_ctx *, U16, U16, U16);
+void update_cell_hyperlink(xlhtml_ctx *, U16 r, U16 c, U8 *hyperlink, int len, U16 type);
+void add_str_array(xlhtml_ctx *, U8, U8 *, U16, U8 *, U8);
+void add_font(xlhtml_ctx *, U16, U16, U16, U16, U16, U8, U16, U8 *, U16);
+void add_ws_title(xlhtml_ctx *, U16, U8 *, U16);
+void add_xf_array(xlhtml_ctx *, U16 fnt_idx, U16 fmt_idx, U16 gen, U16 align,
 U16 indent, U16 b_style, U16 b_l_color, U32  b_t_color, U16 cell_color);
 
 
-/* Global data */
-char *tmpdir = NULL;
-
-char filename[256];
-int file_version = 0;
-U32 next_string=0;
-unsigned int next_font=0, next_ws_title=0, next_xf=0;
-U8 working_buffer[WBUFF_SIZE];
-unsigned int bufidx, buflast;   /*!< Needed for working buffer */
-U8 grbit=0;         /*!< Needed by the SST Opcode FC */
-U16 crun=0, cch=0;               /*!< Needed by the SST Opcode FC */
-U32 extrst=0;           /*!< Needed by the SST Opcode FC */
-U16 nonascii = 0;       /*!< Needed by the SST Opcode FC */
-int sheet_count=-2;     /*!< Number of worksheets found */
-U16 last_opcode = -1;       /*!< Used for the continue command */
-unsigned int cont_grbit=0, cont_str_array=0;
-uni_string default_font;        /*!< Font for table */
-int default_fontsize = 3;   /*!< Default font size for table */
-char *default_alignment = 0;    /*!< Alignment for table */
-int first_sheet = 0;        /*!< First worksheet to display */
-int last_sheet = WORKSHEETS_INCR-1; /*!< The last worksheet to display */
-S16 xp=0, xr1=-1, xr2=-1, xc1=-1, xc2=-1; /*!< Extraction info... */
-int currency_symbol = '$';      /*!< What to use for currency */
-U16 str_formula_row = 0;        /*!< Data holders for string formulas */
-U16 str_formula_col = 0;         /*!< Data holders for string formulas */
-U16 str_formula_format = 0; /*!< Data holders for string formulas */
-
-/* Limits */
-unsigned int max_fonts = FONTS_INCR;
-unsigned int max_xformats = XFORMATS_INCR;
-unsigned long max_strings = STRINGS_INCR;
-unsigned int max_worksheets = WORKSHEETS_INCR;
-
-
-/* Global arrays */
-xf_attr **xf_array;
-work_sheet **ws_array;
-uni_string **str_array;
-font_attr **font_array;
-fnt_cnt *f_cnt;
-int fnt_size_cnt[7];        /*!< Html has only 7 sizes... */
-uni_string author;
-char *title = 0;
-char *lastUpdated = 0;
-
-/* Command Line flags */
-int use_colors = 1;     /*!< Whether or not to use colors in output */
-int aggressive = 0;     /*!< Aggressive html optimization */
-int formula_warnings = 1;   /*!< Whether or not to suppress formula warnings */
-int disclaimers        = 1;   /*!< Whether or not to suppress all other disclaimers */
-int center_tables = 0;      /*!< Whether or not to center justify tables or leave it left */
-int trim_edges = 0;     /*!< Whether or not to trim the edges of columns or rows */
-char *default_text_color = "000000";
-char *default_background_color="FFFFFF";
-char *default_image=NULL;   /*!< Point to background image */
-int Ascii = 0;          /*!< Whether or not to out ascii instaed of html */
-int Csv = 0;            /*!< Whether or not to out csv instaed of html */
-int OutputXML = 0;      /*!< Output as xml */
-int DumpPage = 0;       /*!< Dump page count & max cols & rows */
-int Xtract = 0;         /*!< Extract a range on a page. */
-int MultiByte = 0;      /*!< Output as multibyte */
-int NoHeaders = 0;      /*!< Dont output html header */
-
-
-/* Some Global Flags */
-int notAccurate = 0;    /*!< Flag used to indicate that stale data was used */
-int NoFormat = 0;   /*!< Flag used to indicated unimplemented format */
-int NotImplemented = 0; /*!< Flag to print unimplemented cell type message */
-int Unsupported = 0;    /*!< Flag to print unsupported cell type message */
-int MaxPalExceeded = 0;
-int MaxXFExceeded = 0;
-int MaxFormatsExceeded = 0;
-int MaxColExceeded = 0;
-int MaxRowExceeded = 0;
-int MaxWorksheetsExceeded = 0;
-int MaxStringsExceeded = 0;
-int MaxFontsExceeded = 0;
-int UnicodeStrings = 0; /*!< 0==ASCII, 1==windows-1252, 2==uft-8 */
-int CodePage = 0;           /*!< Micosoft CodePage as specified in the Excel file. */
-int tooold = 0;
-
-
-
-
-int main (int argc, char **argv)
-{
-    int i, f_ptr = 0;
-    U16 k;
-    U32 j;
-    COLEFS * cfs;
-    COLERRNO colerrno;
+static int doc_init(xlhtml_ctx *);
+static void doc_free(xlhtml_ctx *);
+static void scan_raw_file(xlhtml_ctx *, biff_read_func, void *);
+static size_t read_raw_file(void *, U8 *, size_t);
+static size_t read_mem(void *, U8 *, size_t);
 
-#ifndef _DEBUG
-	__try {
-#endif
 
-    if (argc < 2)
+/*! returns a context with the default options, or 0 if out of memory */
+xlhtml_ctx *xlhtml_new(void)
+{
+    xlhtml_ctx *xl = (xlhtml_ctx *)calloc(1, sizeof(xlhtml_ctx));
+
+    if (xl == 0)
+        return 0;
+    xl->use_colors = 1;
+    xl->formula_warnings = 1;
+    xl->disclaimers = 1;
+    strcpy(xl->default_text_color, "000000");
+    strcpy(xl->default_background_color, "FFFFFF");
+    xl->xr1 = xl->xr2 = xl->xc1 = xl->xc2 = -1;
+    return xl;
+}
+
+void xlhtml_free(xlhtml_ctx *xl)
+{
+    if (xl == 0)
+        return;
+    xlhtml_reset(xl);
+    if (xl->default_image)
+        free(xl->default_image);
+    free(xl);
+}
+
+/*! Sets one command line option.
+    \retval XLHTML_OK or XLHTML_EUSAGE */
+int xlhtml_option(xlhtml_ctx *xl, const char *arg)
+{
+    if (strcmp(arg, "-nc") == 0)
+        xl->use_colors = 0;
+    else if(strcmp(arg, "-xml") == 0 )
+        xl->OutputXML = 1;
+    else if (strcmp(arg, "-asc") == 0)
+        xl->Ascii = 1;
+    else if (strcmp(arg, "--ascii") == 0)
+        xl->Ascii = 1;
+    else if (strcmp(arg, "-csv") == 0)
     {
-        fprintf(stderr, "Incorrect usage. Try xlhtml --help for more information\n"); 
-        exit(-1);
+        xl->Ascii = 1;
+        xl->Csv = 1;
     }
-    else
+    else if (strcmp(arg, "-a") == 0)
+        xl->aggressive = 1;
+    else if (strcmp(arg, "-fw") == 0)
+        xl->formula_warnings = 0;
+    else if (strcmp(arg, "-nd") == 0)
+        xl->disclaimers = 0;
+    else if (strcmp(arg, "-c") == 0)
+        xl->center_tables = 1;
+    else if (strcmp(arg, "-dp") == 0)
+        xl->DumpPage = 1;
+    else if (strcmp(arg, "-st") == 0)
+        xl->StreamText = 1;
+    else if (strcmp(arg, "-m") == 0)
+        xl->MultiByte = 1;
+    else if (strncmp(arg, "-tc", 3) == 0)
+    {
+        if (strlen(&arg[3]) != 6)
+            return XLHTML_EUSAGE;
+        strcpy(xl->default_text_color, &arg[3]);
+    }
+    else if (strncmp(arg, "-bc", 3) == 0)
     {
-        strncpy(filename, argv[argc-1], 252);
-        filename[252] = 0;
-        for (i=1; i<(argc-1); i++)
+        if (strlen(&arg[3]) != 6)
+            return XLHTML_EUSAGE;
+        strcpy(xl->default_background_color, &arg[3]);
+    }
+    else if (strncmp(arg, "-bi", 3) == 0)
+    {
+        if (xl->default_image)
+            free(xl->default_image);
+        xl->default_image = strdup(&arg[3]);
+        xl->use_colors = 0;
+    }
+    else if (strncmp(arg, "-te", 3) == 0)
+        xl->trim_edges = 1;
+    else if(strcmp(arg, "-nh") == 0 )
+        xl->NoHeaders = 1;
+    else if (strncmp(arg, "-xc:", 4) == 0)
+    {
+        int d1, d2;
+        if (sscanf(arg + 4, "%d-%d", &d1, &d2) != 2)
         {
-            if (strcmp(argv[i], "-nc") == 0)
-                use_colors = 0;
-            else if(strcmp(argv[i], "-xml") == 0 )
-                OutputXML = 1;
-            else if (strcmp(argv[i], "-asc") == 0)
-                Ascii = 1;
-            else if (strcmp(argv[i], "--ascii") == 0)
-                Ascii = 1;
-            else if (strcmp(argv[i], "-csv") == 0)
-            {
-                Ascii = 1;
-                Csv = 1;
-            
-            }
-            else if (strcmp(argv[i], "-a") == 0)
-                aggressive = 1;
-            else if (strcmp(argv[i], "-fw") == 0)
-                formula_warnings = 0;
-            else if (strcmp(argv[i], "-nd") == 0)
-                disclaimers = 0;
-            else if (strcmp(argv[i], "-c") == 0)
-                center_tables = 1;
-            else if (strcmp(argv[i], "-dp") == 0)
-                DumpPage = 1;
-            else if (strcmp(argv[i], "-m") == 0)
-                MultiByte = 1;
-            else if (strncmp(argv[i], "-tc", 3) == 0)
-            {
-                default_text_color = &argv[i][3];
-                if (strlen(default_text_color) != 6)
-                    display_usage();
-            }
-            else if (strncmp(argv[i], "-bc", 3) == 0)
-            {
-                default_background_color = &argv[i][3];
-                if (strlen(default_background_color) != 6)
-                    display_usage();
-            }
-            else if (strncmp(argv[i], "-bi", 3) == 0)
-            {
-                default_image = &argv[i][3];
-                use_colors = 0;
-            }
-            else if (strncmp(argv[i], "-te", 3) == 0)
-                trim_edges = 1;
-            else if (strcmp(argv[i], "-v") == 0)
-                print_version();
-            else if (strcmp(argv[i], "-l") == 0 || strcmp(argv[i], "-lowprio"))
-            {
-#ifdef _MSC_VER
-                SetPriorityClass( GetCurrentProcess(), BELOW_NORMAL_PRIORITY_CLASS );
-                SetThreadPriority( GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL );
-#endif
-            }
-            else if(strcmp(argv[i], "-nh") == 0 )
-                NoHeaders = 1;
-            else if (strncmp(argv[i], "-xc:", 4) == 0)
-            {
-                int d1, d2;
-                if (sscanf(argv[i] + 4, "%d-%d", &d1, &d2) != 2)
-                {
-                    fprintf(stderr, "column range %s not valid, expected -xc:FIRST-LAST\n", argv[i] + 4);
-                    display_usage();
-                }
-                xc1 = (S16)d1;
-                xc2 = (S16)d2;
-                Xtract = 1;
-                if (xc1 > xc2)
-                {
-                    fprintf(stderr, "last column must be >= the first\n");
-                    exit(1);
-                }
-            }
-            else if (strncmp(argv[i], "-xp:", 4) == 0)
-            {
-                Xtract = 1;
-                xp = (S16)atoi(&(argv[i][4]));
-                if (xp < 0)
-                {
-                    fprintf(stderr, "Negative numbers are illegal.\n");
-                    exit(1);
-                }
-            }
-            else if (strncmp(argv[i], "-xr:", 4) == 0)
-            {
-                char *ptr, *buf;
-                Xtract = 1;
-                buf = strdup(argv[i]);
-                ptr = strrchr(buf, '-');
-                xr2 = (S16)atoi(ptr+1);
-                *ptr = 0;
-                ptr = strchr(buf, ':');
-                xr1 = (S16)atoi(ptr+1);
-                free(buf);
-                if (xr1 > xr2)
-                {
-                    fprintf(stderr, "row's 2nd digit must be >= the first\n");
-                    exit(1);
-                }
-            }
-            else if (strncmp(argv[i], "-tmp", 4) == 0)
-            {
-                tmpdir = &argv[i][4];
-                if (strlen(tmpdir) < 0)
-                    display_usage();
-            }
-            else
-                display_usage();
+            fprintf(stderr, "column range %s not valid, expected -xc:FIRST-LAST\n", arg + 4);
+            return XLHTML_EUSAGE;
         }
-        if (strcmp(filename, "-v") == 0)
+        if (d1 > d2)
         {
-            print_version();
+            fprintf(stderr, "last column must be >= the first\n");
+            return XLHTML_EUSAGE;
         }
-        if (strcmp(filename, "--version") == 0)
+        xl->xc1 = (S16)d1;
+        xl->xc2 = (S16)d2;
+        xl->Xtract = 1;
+    }
+    else if (strncmp(arg, "-xp:", 4) == 0)
+    {
+        S16 xp = (S16)atoi(&(arg[4]));
+        if (xp < 0)
         {
-            print_version();
+            fprintf(stderr, "Negative numbers are illegal.\n");
+            return XLHTML_EUSAGE;
         }
-
-        if (strcmp(filename, "--help") == 0)
-            display_usage();
-        if (strcmp(filename, "-?") == 0)
-            display_usage();
+        xl->xp = xp;
+        xl->Xtract = 1;
     }
-    if (Ascii)
-    {   /* Disable it if DumpPage or Xtract isn't used... */
-        if (!(DumpPage||Xtract))
-            Ascii = 0;
+    else if (strncmp(arg, "-xr:", 4) == 0)
+    {
+        int d1, d2;
+        if ((sscanf(arg + 4, "%d-%d", &d1, &d2) != 2)||(d1 > d2))
+        {
+            fprintf(stderr, "row's 2nd digit must be >= the first\n");
+            return XLHTML_EUSAGE;
+        }
+        xl->xr1 = (S16)d1;
+        xl->xr2 = (S16)d2;
+        xl->Xtract = 1;
     }
-    if (Xtract)
-        trim_edges = 0;     /* No trimming when extracting... */
-    if (OutputXML)
-        aggressive = 0;
+    else if (strncmp(arg, "-tmp", 4) == 0)
+        ;   /* unused since cole stopped writing temp files */
+    else
+        return XLHTML_EUSAGE;
+    return XLHTML_OK;
+}
 
-    /* Init arrays... */
-    ws_array = (work_sheet **)malloc(max_worksheets * sizeof(work_sheet *));
-    for (i=0; i<(int)max_worksheets; i++)
-        ws_array[i] = 0;
+/*! Selects the workbook file the next conversion reads */
+int xlhtml_open_file(xlhtml_ctx *xl, const char *path)
+{
+    xlhtml_reset(xl);
+    strncpy(xl->filename, path, 252);
+    xl->filename[252] = 0;
+    return XLHTML_OK;
+}
 
-    str_array = (uni_string **)malloc(max_strings*sizeof(uni_string *));
-    for (i=0; i<(int)max_strings; i++)
-        str_array[i] = 0;
+/*! Selects a workbook in memory, buf must stay valid until xlhtml_reset */
+int xlhtml_open_buffer(xlhtml_ctx *xl, const unsigned char *buf, size_t len,
+                       const char *name)
+{
+    xlhtml_reset(xl);
+    xl->mem = buf;
+    xl->mem_len = (U32)len;
+    if (name)
+    {
+        strncpy(xl->filename, name, 252);
+        xl->filename[252] = 0;
+    }
+    return XLHTML_OK;
+}
 
-    font_array = (font_attr **)malloc(max_fonts * sizeof(font_attr *));
-    f_cnt = (fnt_cnt *)malloc(max_fonts * sizeof(fnt_cnt));
-    for (i=0; i<(int)max_fonts; i++)
-    {   /* I assume these won't fail since we are just starting up... */
-        font_array[i] = 0;
-        f_cnt[i].name = 0;
+/*! Forgets the opened workbook, keeping the options */
+void xlhtml_reset(xlhtml_ctx *xl)
+{
+    xl->filename[0] = 0;
+    xl->mem = 0;
+    xl->mem_len = 0;
+}
+
+/*! Converts the opened workbook, handing the output to sink.
+    \retval XLHTML_OK or an error value */
+int xlhtml_convert(xlhtml_ctx *xl, xlhtml_sink sink, void *user)
+{
+    int f_ptr = 0, ret = XLHTML_OK;
+    /* These change while converting, the options are put back afterwards */
+    int use_colors = xl->use_colors, trim_edges = xl->trim_edges;
+    int aggressive = xl->aggressive, Ascii = xl->Ascii, Csv = xl->Csv;
+    int DumpPage = xl->DumpPage, Xtract = xl->Xtract;
+    S16 xr1 = xl->xr1, xr2 = xl->xr2, xc1 = xl->xc1, xc2 = xl->xc2;
+    COLEFS * cfs;
+    COLERRNO colerrno;
+
+    if ((xl->mem == 0)&&(xl->filename[0] == 0))
+        return XLHTML_ENOSOURCE;
+    if (doc_init(xl))
+    {
+        doc_free(xl);
+        return XLHTML_EMEMORY;
+    }
+    if (xl->Ascii)
+    {   /* Disable it if DumpPage or Xtract isn't used... */
+        if (!(xl->DumpPage||xl->Xtract))
+            xl->Ascii = 0;
     }
-    xf_array = (xf_attr **)malloc(max_xformats * sizeof(xf_attr *));
-    for (i=0; i<(int)max_xformats; i++)
-        xf_array[i] = 0;
+    if (xl->StreamText)
+    {   /* Plain text, nothing is kept for a later table */
+        xl->Ascii = 1;
+        xl->Csv = 0;
+        xl->DumpPage = 0;
+        xl->Xtract = 0;
+    }
+    if (xl->Xtract)
+        xl->trim_edges = 0;     /* No trimming when extracting... */
+    if (xl->OutputXML)
+        xl->aggressive = 0;
 
-    uni_string_clear(&author);
-    uni_string_clear(&default_font);
-    umask(GLOBAL_UMASK);
+    xl->sink = sink;
+    xl->sink_user = user;
+    xl->out_len = 0;
 
     /* If successful, this calls scan_file to extract the work book... */
-    cfs = cole_mount(filename, &colerrno);
+    if (xl->mem)
+        cfs = cole_mount_buffer(xl->mem, xl->mem_len, &colerrno);
+    else
+        cfs = cole_mount(xl->filename, &colerrno);
     if (cfs == NULL && colerrno != COLE_ENOFILESYSTEM && colerrno != COLE_EINVALIDFILESYSTEM)
     {
         cole_perror (NULL, colerrno);
-        exit(-2);
+        ret = XLHTML_EMOUNT;
     }
-    if( cfs != NULL )
+    else if( cfs != NULL )
     {
-        while (cole_locate_filename (cfs, SectionName[f_ptr], NULL, scan_file, &colerrno))
+        while (cole_locate_filename (cfs, SectionName[f_ptr], xl, scan_file, &colerrno))
         {
             if (f_ptr)
             {   /* Two strikes...we're out! */
@@ -478,202 +437,684 @@ int main (int argc, char **argv)
         if (cole_umount (cfs, &colerrno))
         {
             cole_perror (PRGNAME, colerrno);
-            exit(-3);
+            ret = XLHTML_EUMOUNT;
         }
     }
+    else if (xl->mem)
+    {   /* Try a bare BIFF stream */
+        mem_source m;
+
+        m.buf = xl->mem;
+        m.len = xl->mem_len;
+        m.pos = 0;
+        scan_raw_file(xl, read_mem, &m);
+    }
     else
     {
         // Try simple file
-        FILE *f = fopen( filename, "rb" );
+        FILE *f = fopen( xl->filename, "rb" );
         if( f == NULL )
         {
-            perror (NULL, errno);
-            exit(-20);
+            perror (xl->filename);
+            ret = XLHTML_EOPEN;
+        }
+        else
+        {
+            scan_raw_file(xl, read_raw_file, f);
+            fclose(f);
         }
-        scan_raw_file( f); 
     }
 
-    for (i=0; i<max_strings; i++)
+    xl_flush(xl);
+    xl->sink = 0;
+    doc_free(xl);
+    xl->use_colors = use_colors;
+    xl->trim_edges = trim_edges;
+    xl->aggressive = aggressive;
+    xl->Ascii = Ascii;
+    xl->Csv = Csv;
+    xl->DumpPage = DumpPage;
+    xl->Xtract = Xtract;
+    xl->xr1 = xr1;
+    xl->xr2 = xr2;
+    xl->xc1 = xc1;
+    xl->xc2 = xc2;
+    return ret;
+}
+
+/*! Sets up everything read from a workbook.
+    \retval 0 OK, 1 out of memory */
+static int doc_init(xlhtml_ctx *xl)
+{
+    int i;
+
+    xl->file_version = 0;
+    xl->next_string = 0;
+    xl->next_font = 0;
+    xl->next_ws_title = 0;
+    xl->next_xf = 0;
+    xl->sheet_count = -2;
+    xl->default_fontsize = 3;
+    xl->default_alignment = 0;
+    xl->first_sheet = 0;
+    xl->last_sheet = WORKSHEETS_INCR-1;
+    xl->currency_symbol = '$';
+    xl->str_formula_row = 0;
+    xl->str_formula_col = 0;
+    xl->str_formula_format = 0;
+    xl->hard_max_rows = HARD_MAX_ROWS_97;
+    xl->DatesR1904 = 0;
+    xl->numCustomColors = 0;
+    xl->customColors = 0;
+    xl->stream_sheet = -1;
+    xl->stream_row = 0;
+    memset(xl->fnt_size_cnt, 0, sizeof(xl->fnt_size_cnt));
+    xl->title = 0;
+    xl->lastUpdated = 0;
+    xl->notAccurate = 0;
+    xl->NoFormat = 0;
+    xl->NotImplemented = 0;
+    xl->Unsupported = 0;
+    xl->MaxPalExceeded = 0;
+    xl->MaxXFExceeded = 0;
+    xl->MaxFormatsExceeded = 0;
+    xl->MaxColExceeded = 0;
+    xl->MaxRowExceeded = 0;
+    xl->MaxWorksheetsExceeded = 0;
+    xl->MaxStringsExceeded = 0;
+    xl->MaxFontsExceeded = 0;
+    xl->UnicodeStrings = 0;
+    xl->CodePage = 0;
+    xl->tooold = 0;
+    uni_string_clear(&xl->author);
+    uni_string_clear(&xl->default_font);
+
+    /* Init arrays... */
+    xl->max_fonts = FONTS_INCR;
+    xl->max_xformats = XFORMATS_INCR;
+    xl->max_strings = STRINGS_INCR;
+    xl->max_worksheets = WORKSHEETS_INCR;
+    xl->ws_array = (work_sheet **)calloc(xl->max_worksheets, sizeof(work_sheet *));
+    xl->str_array = (uni_string **)calloc(xl->max_strings, sizeof(uni_string *));
+    xl->font_array = (font_attr **)calloc(xl->max_fonts, sizeof(font_attr *));
+    xl->f_cnt = (fnt_cnt *)malloc(xl->max_fonts * sizeof(fnt_cnt));
+    xl->xf_array = (xf_attr **)calloc(xl->max_xformats, sizeof(xf_attr *));
+    if ((xl->ws_array == 0)||(xl->str_array == 0)||(xl->font_array == 0)
+        ||(xl->f_cnt == 0)||(xl->xf_array == 0))
+        return 1;
+    for (i=0; i<(int)xl->max_fonts; i++)
+        xl->f_cnt[i].name = 0;
+    return 0;
+}
+
+/*! Frees everything read from a workbook */
+static void doc_free(xlhtml_ctx *xl)
+{
+    int i;
+
+    if (xl->str_array)
     {
-        if (str_array[i])
+        for (i=0; i<(int)xl->max_strings; i++)
         {
-            if (str_array[i]->str)
-                free(str_array[i]->str);
-            free(str_array[i]);
+            if (xl->str_array[i])
+            {
+                if (xl->str_array[i]->str)
+                    free(xl->str_array[i]->str);
+                if (xl->str_array[i]->fmt_run)
+                    free(xl->str_array[i]->fmt_run);
+                free(xl->str_array[i]);
+            }
         }
-    }   
+        free(xl->str_array);
+        xl->str_array = 0;
+    }
 
-    for (i=0; i<(int)max_fonts; i++)
+    if (xl->font_array)
     {
-        if (font_array[i])
+        for (i=0; i<(int)xl->max_fonts; i++)
         {
-            if (font_array[i]->name.str)
-                free(font_array[i]->name.str);
-            free(font_array[i]);
-            if (f_cnt[i].name)
+            if (xl->font_array[i])
+            {
+                if (xl->font_array[i]->name.str)
+                    free(xl->font_array[i]->name.str);
+                free(xl->font_array[i]);
+            }
+            if ((xl->f_cnt)&&(xl->f_cnt[i].name))
             {
-                if (f_cnt[i].name->str)
-                    free(f_cnt[i].name->str);
-                free(f_cnt[i].name);
+                if (xl->f_cnt[i].name->str)
+                    free(xl->f_cnt[i].name->str);
+                free(xl->f_cnt[i].name);
             }
         }
+        free(xl->font_array);
+        xl->font_array = 0;
     }
-    
-    
-    for (i=0; i<(int)max_worksheets; i++)
+    if (xl->f_cnt)
     {
-        if (ws_array[i])
+        free(xl->f_cnt);
+        xl->f_cnt = 0;
+    }
+
+    if (xl->ws_array)
+    {
+        for (i=0; i<(int)xl->max_worksheets; i++)
         {
-            if (ws_array[i]->ws_title.str)
-                free(ws_array[i]->ws_title.str);
-            if (ws_array[i]->c_array)
+            if (xl->ws_array[i])
             {
-                for (j=0; j<ws_array[i]->max_rows; j++)
-                {
-                    for (k=0; k<ws_array[i]->max_cols; k++)
-                    {
-                        if (ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k])
-                        {
-                            if (ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k]->ustr.str)
-                                free(ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k]->ustr.str);
-                            if (ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k]->ustr.fmt_run)
-                                free(ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k]->ustr.fmt_run);
-                            if (ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k]->h_link.str)
-                                free(ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k]->h_link.str);
-                            free(ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k]);
-                        }
-                    }
-                }
-                free(ws_array[i]->c_array);
+                if (xl->ws_array[i]->ws_title.str)
+                    free(xl->ws_array[i]->ws_title.str);
+                ws_free_cells(xl->ws_array[i]);
+                free(xl->ws_array[i]);
             }
-            free(ws_array[i]);
         }
+        free(xl->ws_array);
+        xl->ws_array = 0;
     }
-    
 
-    for (i=0; i<(int)max_xformats; i++)
+    if (xl->xf_array)
     {
-        if (xf_array[i])
-            free(xf_array[i]);
+        for (i=0; i<(int)xl->max_xformats; i++)
+        {
+            if (xl->xf_array[i])
+                free(xl->xf_array[i]);
+        }
+        free(xl->xf_array);
+        xl->xf_array = 0;
     }
 
-    if (numCustomColors)
+    if (xl->numCustomColors)
     {
-        for (i=0; i<numCustomColors; i++)
-            free(customColors[i]);
-        free(customColors);
-    }
-
-    if (default_font.str)
-        free(default_font.str);
-    if (author.str)
-        free(author.str);
-    if (title)
-        free(title);
-    if (lastUpdated)
-        free(lastUpdated);
-    
-#ifndef _DEBUG
-    } __except( 1 /* EXCEPTION_EXECUTE_HANDLER */ ) 
-    { 
-        return 999; 
+        for (i=0; i<xl->numCustomColors; i++)
+            free(xl->customColors[i]);
+        free(xl->customColors);
+        xl->numCustomColors = 0;
     }
-#endif
 
-    return 0;
+    if (xl->default_font.str)
+        free(xl->default_font.str);
+    if (xl->author.str)
+        free(xl->author.str);
+    if (xl->title)
+        free(xl->title);
+    if (xl->lastUpdated)
+        free(xl->lastUpdated);
+    uni_string_clear(&xl->default_font);
+    uni_string_clear(&xl->author);
+    xl->title = 0;
+    xl->lastUpdated = 0;
 }
 
-typedef struct _oneReadData {
-    U32 count;
-    U16 length;
-    U16 target;
-    U16 opcode;
-    U16 version;
-    U8  buf[16];
-} oneReadData_t;
+/*! Hands the buffered output to the sink */
+void xl_flush(xlhtml_ctx *xl)
+{
+    if ((xl->out_len)&&(xl->sink))
+        xl->sink(xl->sink_user, (const char *)xl->out, xl->out_len);
+    xl->out_len = 0;
+}
 
-int processOneRead( oneReadData_t *rd )
+static void xl_write(xlhtml_ctx *xl, const char *data, U32 len)
 {
-    if (rd->count > 3)
-        main_line_processor(rd->opcode, rd->version, rd->count-4, rd->target, rd->buf[0]);
-    else if (rd->count == 0)
-    {   /* Init everything */
-        rd->length = 0;
-        rd->opcode = (U16)rd->buf[0];
-        rd->target = 80;    /* ficticious number */
-    }
-    else if (rd->count == 1)
-        rd->version = (U16)rd->buf[0];
-    else if (rd->count == 2)
-        rd->length = (U16)rd->buf[0];
-    else if (rd->count == 3)
+    if (xl->out_len + len > OUT_SIZE)
     {
-        rd->length |= (U16)(rd->buf[0]<<8);
-        rd->target = rd->length;
+        xl_flush(xl);
+        if (len > OUT_SIZE)
+        {
+            if (xl->sink)
+                xl->sink(xl->sink_user, data, len);
+            return;
+        }
     }
+    memcpy(xl->out + xl->out_len, data, len);
+    xl->out_len += len;
+}
 
-    if (rd->count == (U32)(rd->target+3))
-        rd->count = 0;
-    else
-        rd->count++;
-    if (MaxColExceeded || MaxRowExceeded || MaxWorksheetsExceeded)
-        return 0;  /* We're outta memory and therefore...done */
-    return 1;
+void xl_putc(xlhtml_ctx *xl, int c)
+{
+    if (xl->out_len == OUT_SIZE)
+        xl_flush(xl);
+    xl->out[xl->out_len++] = (U8)c;
 }
 
+/*! printf to the context's sink */
+void xl_printf(xlhtml_ctx *xl, const char *fmt, ...)
+{
+    char buf[512];
+    char *p = buf;
+    int size = sizeof(buf), n;
+    va_list ap;
 
-void dumpResults()
+    for (;;)
+    {
+        va_start(ap, fmt);
+        n = vsnprintf(p, size, fmt, ap);
+        va_end(ap);
+        if ((n >= 0)&&(n < size))
+            break;
+        /* Too long, _vsnprintf just says so without the size */
+        size = (n >= 0) ? n + 1 : size * 2;
+        if (p != buf)
+            free(p);
+        p = (char *)malloc(size);
+        if (p == 0)
+            return;
+    }
+    xl_write(xl, p, (U32)n);
+    if (p != buf)
+        free(p);
+}
+
+void dumpResults(xlhtml_ctx *xl)
 {
-    if (Ascii)
+    if (xl->StreamText)
+    {   /* The cells went out as they were parsed */
+        stream_end(xl);
+        return;
+    }
+    if (xl->Ascii)
     {
-        if (DumpPage)
+        if (xl->DumpPage)
         {   /* Output the XLS Parameters */
             int i;
-            printf("There are %d pages total.\n", sheet_count+1);
-            for (i=0; i<=sheet_count; i++)
+            xl_printf(xl, "There are %d pages total.\n", xl->sheet_count+1);
+            for (i=0; i<=xl->sheet_count; i++)
             {
-                printf("Page:%d Name:%s MaxRow:%ld MaxCol:%d\n", i,
-                    ws_array[i]->ws_title.str ? (char *)ws_array[i]->ws_title.str : "(Unknown Page)",
-                    ws_array[i]->biggest_row, ws_array[i]->biggest_col);
+                xl_printf(xl, "Page:%d Name:%s MaxRow:%ld MaxCol:%d\n", i,
+                    xl->ws_array[i]->ws_title.str ? (char *)xl->ws_array[i]->ws_title.str : "(Unknown Page)",
+                    xl->ws_array[i]->biggest_row, xl->ws_array[i]->biggest_col);
             }
         }
-        else if (Xtract)
-            OutputPartialTableAscii();
+        else if (xl->Xtract)
+            OutputPartialTableAscii(xl);
     }
     else
     {
-        if (DumpPage)
+        if (xl->DumpPage)
         {   /* Output the XLS Parameters */
             int i;
-            output_header();
-            printf("<p>There are %d pages total.</p>\n", sheet_count+1);
-            for (i=0; i<=sheet_count; i++)
+            output_header(xl);
+            xl_printf(xl, "<p>There are %d pages total.</p>\n", xl->sheet_count+1);
+            for (i=0; i<=xl->sheet_count; i++)
             {
-                printf("<p>Page:%d Name:%s MaxRow:%ld MaxCol:%d</p>\n", i,
-                    ws_array[i]->ws_title.str ? (char *)ws_array[i]->ws_title.str : "(Unknown Page)",
-                    ws_array[i]->biggest_row, ws_array[i]->biggest_col);
+                xl_printf(xl, "<p>Page:%d Name:%s MaxRow:%ld MaxCol:%d</p>\n", i,
+                    xl->ws_array[i]->ws_title.str ? (char *)xl->ws_array[i]->ws_title.str : "(Unknown Page)",
+                    xl->ws_array[i]->biggest_row, xl->ws_array[i]->biggest_col);
             }
         
-            output_footer();
+            output_footer(xl);
         }
         else
         {
-            if( OutputXML )
-                OutputTableXML();
+            if( xl->OutputXML )
+                OutputTableXML(xl);
             else
-                OutputTableHTML();
+                OutputTableHTML(xl);
         }
     }
 }
 
+
+static size_t read_cole_stream(void *src, U8 *buf, size_t len)
+{
+    COLERRNO err;
+    return cole_fread((COLEFILE *)src, buf, len, &err);
+}
+
+static size_t read_raw_file(void *src, U8 *buf, size_t len)
+{
+    return fread(buf, 1, len, (FILE *)src);
+}
+
+static size_t read_mem(void *src, U8 *buf, size_t len)
+{
+    mem_source *m = (mem_source *)src;
+
+    if (len > m->len - m->pos)
+        len = m->len - m->pos;
+    memcpy(buf, m->buf + m->pos, len);
+    m->pos += (U32)len;
+    return len;
+}
+
+/*! Reads len bytes of record body into buf, or throws them away if buf is 0.
+    returns the number of bytes consumed */
+static U32 read_record_body(biff_read_func rd, void *src, U8 *buf, U32 len)
+{
+    U8 junk[512];
+    U32 done = 0;
+
+    if (buf)
+        return (U32)rd(src, buf, len);
+    while (done < len)
+    {
+        size_t n = len - done;
+        if (n > sizeof(junk))
+            n = sizeof(junk);
+        n = rd(src, junk, n);
+        if (n == 0)
+            break;
+        done += (U32)n;
+    }
+    return done;
+}
+
+#define SST_HEADER  0   /*!< cch, grbit and the optional run & ext counts */
+#define SST_CHARS   1   /*!< The characters of the string */
+#define SST_RUNS    2   /*!< The formatting runs */
+#define SST_EXT     3   /*!< Far East phonetic data - skipped */
+
+/*! State of the string being decoded. Strings can be split over CONTINUE
+    records, so this lives across record boundaries. */
+typedef struct
+{
+    int phase;
+    U8 hdr[9];          /*!< String header as read */
+    U16 hdr_len;        /*!< Bytes of the header read so far */
+    U16 hdr_need;       /*!< Size of the header once grbit is known */
+    U16 cch;            /*!< Characters in the string */
+    U16 chars_left;     /*!< Characters not yet read */
+    U16 crun;           /*!< Formatting runs */
+    U32 left;           /*!< Run or ext bytes not yet read */
+    U8 wide;            /*!< Characters in the current segment are 16 bit */
+    U8 str_wide;        /*!< Characters in str are stored 16 bit */
+    U8 half;            /*!< Low byte of a 16 bit character already stored */
+    U8 nonascii;        /*!< Set if an 8 bit character is > 127 */
+    U8 *str;            /*!< Characters followed by the formatting runs */
+    U32 len;            /*!< Bytes used in str */
+    U32 size;           /*!< Bytes allocated for str */
+}sst_string;
+
+/*! Adds the finished string to the string table. */
+static void sst_add_string(xlhtml_ctx *xl, sst_string *st)
+{
+    U8 uni;
+
+    if (st->cch == 0)
+    {   /* special case for empty strings */
+        add_str_array(xl, 0, (U8 *)0, 0, 0, 0);
+        return;
+    }
+    if (st->str_wide)
+    {
+        uni = 2;
+        xl->UnicodeStrings = 2;
+    }
+    else
+        uni = st->nonascii;
+    st->str[st->len + (st->crun*4)] = 0;
+    if (st->crun)
+        add_str_array(xl, uni, st->str, (U16)st->len, st->str + st->len, (U8)st->crun);
+    else
+        add_str_array(xl, uni, st->str, (U16)st->len, 0, 0);
+    if (uni > xl->UnicodeStrings)   /* Try to "upgrade" charset */
+        xl->UnicodeStrings = uni;
+}
+
+/*! Moves on from a phase that has nothing left to read. */
+static void sst_next_phase(xlhtml_ctx *xl, sst_string *st)
+{
+    if ((st->phase == SST_CHARS)&&(st->chars_left == 0))
+    {
+        st->phase = SST_RUNS;
+        st->left = st->crun * 4;
+    }
+    if ((st->phase == SST_RUNS)&&(st->left == 0))
+    {
+        st->phase = SST_EXT;
+        if (st->hdr[2] & 0x04)
+            st->left = getLong(&st->hdr[(st->hdr[2] & 0x08) ? 5 : 3]);
+    }
+    if ((st->phase == SST_EXT)&&(st->left == 0))
+    {
+        sst_add_string(xl, st);
+        st->phase = SST_HEADER;
+        st->hdr_len = 0;
+        st->hdr_need = 3;
+    }
+}
+
+/*! Decodes one segment of the SST, either the SST record body or a CONTINUE.
+    returns 1 if out of memory */
+static int sst_segment(xlhtml_ctx *xl, sst_string *st, U8 *data, U32 n, int cont)
+{
+    U32 i = 0;
+
+    /* A string whose characters span records restates its width */
+    if (cont && (st->phase == SST_CHARS)&&(st->chars_left)&&(n))
+    {
+        st->wide = (U8)(data[i++] & 0x01);
+        if (st->wide && !st->str_wide)
+        {   /* ASCII -> unicode, widen what we already have */
+            U32 j = st->len;
+            while (j--)
+            {
+                st->str[(j<<1)] = st->str[j];
+                st->str[(j<<1)+1] = 0;
+            }
+            st->len <<= 1;
+            st->str_wide = 1;
+        }
+    }
+
+    while (i < n)
+    {
+        switch (st->phase)
+        {
+            case SST_HEADER:
+                st->hdr[st->hdr_len++] = data[i++];
+                if (st->hdr_len == 3)
+                {
+                    if (st->hdr[2] & 0x08)
+                        st->hdr_need += 2;
+                    if (st->hdr[2] & 0x04)
+                        st->hdr_need += 4;
+                }
+                if (st->hdr_len == st->hdr_need)
+                {
+                    U32 need;
+
+                    st->cch = getShort(&st->hdr[0]);
+                    st->chars_left = st->cch;
+                    st->crun = (U16)((st->hdr[2] & 0x08) ? getShort(&st->hdr[3]) : 0);
+                    st->wide = (U8)(st->hdr[2] & 0x01);
+                    st->str_wide = st->wide;
+                    st->half = 0;
+                    st->nonascii = 0;
+                    st->len = 0;
+
+                    need = (st->cch << 1) + (st->crun*4) + 1;
+                    if (need > st->size)
+                    {
+                        U8 *p = (U8 *)realloc(st->str, need);
+                        if (p == 0)
+                            return 1;
+                        st->str = p;
+                        st->size = need;
+                    }
+                    st->phase = SST_CHARS;
+                    sst_next_phase(xl, st);
+                }
+                break;
+            case SST_CHARS:
+                if (st->wide)
+                {
+                    U32 cnt = (n - i) >> 1;
+
+                    if (st->half)
+                    {
+                        st->str[st->len++] = data[i++];
+                        st->half = 0;
+                        st->chars_left--;
+                    }
+                    else if (cnt == 0)
+                    {   /* Odd byte at the end of the record */
+                        st->str[st->len++] = data[i++];
+                        st->half = 1;
+                    }
+                    else
+                    {
+                        if (cnt > st->chars_left)
+                            cnt = st->chars_left;
+                        memcpy(&st->str[st->len], &data[i], cnt << 1);
+                        st->len += cnt << 1;
+                        i += cnt << 1;
+                        st->chars_left = (U16)(st->chars_left - cnt);
+                    }
+                }
+                else
+                {
+                    U32 cnt = n - i;
+
+                    if (cnt > st->chars_left)
+                        cnt = st->chars_left;
+                    st->chars_left = (U16)(st->chars_left - cnt);
+                    while (cnt--)
+                    {
+                        U8 c = data[i++];
+                        if (c > 127)
+                            st->nonascii = 1;
+                        st->str[st->len++] = c;
+                        if (st->str_wide)   /* unicode -> ASCII */
+                            st->str[st->len++] = 0;
+                    }
+                }
+                sst_next_phase(xl, st);
+                break;
+            case SST_RUNS:
+            case SST_EXT:
+                {
+                    U32 cnt = n - i;
+
+                    if (cnt > st->left)
+                        cnt = st->left;
+                    if (st->phase == SST_RUNS)
+                        memcpy(&st->str[st->len + (st->crun*4) - st->left], &data[i], cnt);
+                    i += cnt;
+                    st->left -= cnt;
+                }
+                sst_next_phase(xl, st);
+                break;
+        }
+    }
+    return 0;
+}
+
+/*!******************************************************************
+*   Reads the SST and the CONTINUE records that follow it, decoding
+*   each segment as it arrives so the whole table never has to be
+*   assembled.
+*   \param rd   the stream reader
+*   \param len  the size of the SST record body
+*   \param hdr  receives the header of the record after the SST
+*   returns 1 if hdr holds a record header, 0 at end of stream
+********************************************************************/
+static int process_sst(xlhtml_ctx *xl, biff_read_func rd, void *src, U32 len, U8 *hdr)
+{
+    sst_string st;
+    U32 skip = 8;       /* Skip the 1st 8 locations they are bs */
+    int cont = 0;
+    int ok = 1;
+
+    memset(&st, 0, sizeof(st));
+    st.hdr_need = 3;
+    for (;;)
+    {
+        while (len)
+        {   /* Records are read in working buffer sized pieces */
+            U32 want = (len < WBUFF_SIZE) ? len : WBUFF_SIZE;
+            U32 n = read_record_body(rd, src, xl->working_buffer, want);
+
+            if (ok && (n > skip))
+                ok = !sst_segment(xl, &st, &xl->working_buffer[skip], n - skip, cont);
+            skip = (n < skip) ? skip - n : 0;
+            cont = 0;
+            len -= n;
+            if (n < want)
+            {
+                free(st.str);
+                return 0;
+            }
+        }
+        if ((rd(src, hdr, 4) != 4))
+            break;
+        if (hdr[0] != 0x3C) /* continue command */
+        {
+            free(st.str);
+            return 1;
+        }
+        len = getShort(&hdr[2]);
+        cont = 1;
+    }
+    free(st.str);
+    return 0;
+}
+
+/*!******************************************************************
+*   Reads the workbook stream a record at a time. Each record is read
+*   whole, along with any CONTINUE records that extend it, and handed
+*   to main_line_processor in working_buffer.
+********************************************************************/
+static void process_stream(xlhtml_ctx *xl, biff_read_func rd, void *src)
+{
+    U8 hdr[4];
+    U32 dirty = WBUFF_SIZE;
+    int more;
+
+    more = (rd(src, hdr, 4) == 4);
+    while (more)
+    {
+        U16 opcode = hdr[0];
+        U16 version = hdr[1];
+        U32 len = getShort(&hdr[2]);
+        U32 total = 0;
+        int too_big = 0;
+
+        if ((opcode == 0xFC)&&(version != 0x10))
+        {
+            more = process_sst(xl, rd, src, len, hdr);
+            dirty = WBUFF_SIZE;
+            continue;
+        }
+
+        /* Everything past the record must read as zero */
+        memset(xl->working_buffer, 0, dirty);
+        for (;;)
+        {
+            U32 n;
+
+            if (too_big || (total + len >= WBUFF_SIZE))
+            {   /* Abort processing if too big. */
+                too_big = 1;
+                n = read_record_body(rd, src, 0, len);
+            }
+            else
+            {
+                n = read_record_body(rd, src, &xl->working_buffer[total], len);
+                total += n;
+            }
+            if (n < len)
+                return; /* Truncated record */
+            more = (rd(src, hdr, 4) == 4);
+            if (!more || (hdr[0] != 0x3C))
+                break;
+            len = getShort(&hdr[2]);
+        }
+        dirty = total + 1;
+
+        /* Stray CONTINUEs have nothing to attach to, and there is
+           no chart processing for now. */
+        if ((opcode != 0x3C)&&(version != 0x10)&&(total)&&(!too_big))
+            main_line_processor(xl, opcode, version, (U16)total);
+        if (xl->MaxColExceeded || xl->MaxRowExceeded || xl->MaxWorksheetsExceeded)
+            break;  /* We're outta memory and therefore...done */
+    }
+}
+
 void scan_file(COLEDIRENT *cde, void *_info)
 {
-    oneReadData_t rd;
+    xlhtml_ctx *xl = (xlhtml_ctx *)_info;
     COLEFILE *cf;
     COLERRNO err;
 
-    memset( &rd, 0, sizeof(rd) );
-
     cf = cole_fopen_direntry(cde, &err);
     if (cf == 0)
     {   /* error abort processing */
@@ -682,97 +1123,85 @@ void scan_file(COLEDIRENT *cde, void *_info)
     }
 
     /* Read & process the file... */
-    while (cole_fread(cf, rd.buf, 1, &err))
-    {
-        if( ! processOneRead( &rd ) )
-            break;
-    }
+    process_stream(xl, read_cole_stream, cf);
     cole_fclose(cf, &err);
 
-    dumpResults();
+    dumpResults(xl);
 }
 
-void scan_raw_file( FILE *f )
+static void scan_raw_file(xlhtml_ctx *xl, biff_read_func rd, void *src)
 {
-    oneReadData_t rd;
-    memset( &rd, 0, sizeof(rd) );
-
     /* Read & process the file... */
-    while (fread(rd.buf, 1, 1, f))
-    {
-        if( ! processOneRead( &rd ) )
-            break;
-    }
-    fclose(f);
-    dumpResults();
+    process_stream(xl, rd, src);
+    dumpResults(xl);
 }
 
-void SetupExtraction(void)
+void SetupExtraction(xlhtml_ctx *xl)
 {
-    if (Xtract)
+    if (xl->Xtract)
     {   /* Revise the page settings... */
 /*      printf("-%d %d %d %d %d<br>\n", xp, xr1, xr2, xc1, xc2); */
-        if ((xp >= first_sheet)&&(xp <= last_sheet)&&(xp <= sheet_count))
+        if ((xl->xp >= xl->first_sheet)&&(xl->xp <= xl->last_sheet)&&(xl->xp <= xl->sheet_count))
         {
-            first_sheet = xp;
-            last_sheet = xp;
-            if (xr1 < 0)
+            xl->first_sheet = xl->xp;
+            xl->last_sheet = xl->xp;
+            if (xl->xr1 < 0)
             {
-                xr1 = (S16)ws_array[xp]->first_row;
-                xr2 = (S16)ws_array[xp]->biggest_row;
+                xl->xr1 = (S16)xl->ws_array[xl->xp]->first_row;
+                xl->xr2 = (S16)xl->ws_array[xl->xp]->biggest_row;
             }
-            else if ((xr1 >= ws_array[xp]->first_row)&&(xr1 <= ws_array[xp]->biggest_row)
-                &&(xr2 >= ws_array[xp]->first_row)&&(xr2 <= ws_array[xp]->biggest_row))
+            else if ((xl->xr1 >= xl->ws_array[xl->xp]->first_row)&&(xl->xr1 <= xl->ws_array[xl->xp]->biggest_row)
+                &&(xl->xr2 >= xl->ws_array[xl->xp]->first_row)&&(xl->xr2 <= xl->ws_array[xl->xp]->biggest_row))
             {
-                ws_array[xp]->first_row = xr1;
-                ws_array[xp]->biggest_row = xr2;
+                xl->ws_array[xl->xp]->first_row = xl->xr1;
+                xl->ws_array[xl->xp]->biggest_row = xl->xr2;
 
-                if (xc1 < 0)
+                if (xl->xc1 < 0)
                 {
-                    xc1 = ws_array[xp]->first_col;
-                    xc2 = ws_array[xp]->biggest_col;
+                    xl->xc1 = xl->ws_array[xl->xp]->first_col;
+                    xl->xc2 = xl->ws_array[xl->xp]->biggest_col;
                 }
-                else if((xc1 >= ws_array[xp]->first_col)&&(xc1 <= ws_array[xp]->biggest_col)
-                    &&(xc2 >= ws_array[xp]->first_col)&&(xc2 <= ws_array[xp]->biggest_col))
+                else if((xl->xc1 >= xl->ws_array[xl->xp]->first_col)&&(xl->xc1 <= xl->ws_array[xl->xp]->biggest_col)
+                    &&(xl->xc2 >= xl->ws_array[xl->xp]->first_col)&&(xl->xc2 <= xl->ws_array[xl->xp]->biggest_col))
                 {
-                    ws_array[xp]->first_col = xc1;
-                    ws_array[xp]->biggest_col = xc2;
+                    xl->ws_array[xl->xp]->first_col = xl->xc1;
+                    xl->ws_array[xl->xp]->biggest_col = xl->xc2;
                 }
                 else
                 {
-                    if (Ascii)
+                    if (xl->Ascii)
                         fprintf(stderr, "Error - Col not in range during extraction"
-                            " (%d or %d not in [%d..%d])\n", xc1, xc2, ws_array[xp]->first_col, ws_array[xp]->biggest_col);
+                            " (%d or %d not in [%d..%d])\n", xl->xc1, xl->xc2, xl->ws_array[xl->xp]->first_col, xl->ws_array[xl->xp]->biggest_col);
                     else
                     {
-                        printf("Error - Col not in range during extraction.\n");
+                        xl_printf(xl, "Error - Col not in range during extraction.\n");
                         
-                        output_footer();
+                        output_footer(xl);
                     }
                     return;
                 }
             }
             else
             {
-                if (Ascii)
+                if (xl->Ascii)
                     fprintf(stderr, "Error - Row not in range during extraction"
-                        " (%d or %d not in [%ld..%ld])\n", xr1, xr2, ws_array[xp]->first_row, ws_array[xp]->biggest_row);
+                        " (%d or %d not in [%ld..%ld])\n", xl->xr1, xl->xr2, xl->ws_array[xl->xp]->first_row, xl->ws_array[xl->xp]->biggest_row);
                 else
                 {
-                    printf("Error - Row not in range during extraction.");
-                    output_footer();
+                    xl_printf(xl, "Error - Row not in range during extraction.");
+                    output_footer(xl);
                 }
                 return;
             }
         }
         else
         {
-            if (Ascii)
+            if (xl->Ascii)
                 fprintf(stderr, "Error - Page not in range during extraction.");
             else
             {
-                printf("Error - Page not in range during extraction.");
-                output_footer();
+                xl_printf(xl, "Error - Page not in range during extraction.");
+                output_footer(xl);
             }
             return;
         }
@@ -781,474 +1210,268 @@ void SetupExtraction(void)
 
 
 /*!******************************************************************
-*   \param count    the absolute count in the record
-*   \param last the size of the record
-*   \param bufidx   the index into the working buffer
-*   \param buflast  the expected length of the working buffer
+*   \param opcode   the low byte of the record type
+*   \param version  the high byte of the record type
+*   \param last the size of the record, which is in working_buffer
 ********************************************************************/
-void main_line_processor(U16 opcode, U16 version, U32 count, U16 last, U8 data)
+void main_line_processor(xlhtml_ctx *xl, U16 opcode, U16 version, U16 last)
 {
-    U16 cont_opcode = 0;
-    
-    /* If first pass, reset stuff. */
-    if (count == 0)
-    {
-        if (opcode != 0x3C) /* continue command */
-/*      {
-            printf("\n* * * * * * CONTINUE * * * * * * * * *\n\n");
-        }
-        else */
-        {   /* Normal path... */
-            last_opcode = opcode;
-            bufidx = 0;
-            buflast = 0;
-            cont_str_array = 0;
-            memset(working_buffer, 0, WBUFF_SIZE);
-        }
-    }
-    if (opcode == 0x3C)
-    {
-        opcode = last_opcode;
-        cont_opcode = 1;
-    }
-
-    /* Abort processing if too big. Next opcode will reset everything. */
-    if (bufidx >= WBUFF_SIZE)
-    {
-        /*printf("OC:%02X C:%04X I:%04X BL:%04X cch:%04X gr:%04X\n", opcode, count, bufidx, buflast, cch, grbit); */
-        /*abort(); */
-        return;
-    }
-
-    /* no chart processing for now. */
-    if (version == 0x0010)
-        return;
-
     switch (opcode)
     {
         case 0x09:  /* BOF */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
             {
-                if (file_version == 0)
+                if (xl->file_version == 0)
                 {   /* File version info can be gathered here...
                      *    4 = Excel version 4
                      * 1280 = Excel version 5
                      * 0500 = Excel 95
                      * 1536 = Excel 97 */
                     if (version == 8)
-                        file_version = getShort(&working_buffer[0]);
+                        xl->file_version = getShort(&xl->working_buffer[0]);
                     else
-                        file_version = version;
-                    if (file_version < 0x0500)
+                        xl->file_version = version;
+                    if (xl->file_version < 0x0500)
                     {
-                        tooold = 1;
+                        xl->tooold = 1;
                     }
-                    if (file_version == EXCEL95)
+                    if (xl->file_version == EXCEL95)
                     {
-                        use_colors = 0;
-                        HARD_MAX_ROWS = HARD_MAX_ROWS_95;
+                        xl->use_colors = 0;
+                        xl->hard_max_rows = HARD_MAX_ROWS_95;
                     }
 /*                  printf("Biff:%X\n", file_version); */
                 }
-                sheet_count++;
-                if (sheet_count >= (int)max_worksheets)
-                    add_more_worksheet_ptrs();
+                xl->sheet_count++;
+                if (xl->sheet_count >= (int)xl->max_worksheets)
+                    add_more_worksheet_ptrs(xl);
             }
             break;
         case 0x01:  /* Blank */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
             {
                 U16 r, c, f;
 
-                r = getShort(&working_buffer[0]);
-                c = getShort(&working_buffer[2]);
+                r = getShort(&xl->working_buffer[0]);
+                c = getShort(&xl->working_buffer[2]);
                 if (version == 2)
-                    f = getShort(&working_buffer[4]);
+                    f = getShort(&xl->working_buffer[4]);
                 else
                     f = 0;
-                add_wb_array(r, c, f, opcode, (U16)0, (U8 *)0, 0, (U16)0, 0);
+                add_wb_array(xl, r, c, f, opcode, (U16)0, (U8 *)0, 0, (U16)0, 0);
             }
             break;
         case 0x02:  /* Integer */
-            working_buffer[bufidx++] = data;        
-            if (bufidx == last)
             {
                 U16 r, c, i, f;
                 char temp[32];
 
-                r = getShort(&working_buffer[0]);
-                c = getShort(&working_buffer[2]);
+                r = getShort(&xl->working_buffer[0]);
+                c = getShort(&xl->working_buffer[2]);
                 if (version == 2)
                 {
-                    f = getShort(&working_buffer[4]);
-                    i = getShort(&working_buffer[7]);
+                    f = getShort(&xl->working_buffer[4]);
+                    i = getShort(&xl->working_buffer[7]);
                     sprintf(temp, "%d", i);
                 }
                 else
                 {
                     f = 0;
-                    Unsupported++;
-					strcpy(temp, disclaimers ? (OutputXML ? "<Unsupported/>INT" : "****INT") : "??INT??");
+                    xl->Unsupported++;
+					strcpy(temp, xl->disclaimers ? (xl->OutputXML ? "<Unsupported/>INT" : "****INT") : "??INT??");
                 }
-                add_wb_array(r, c, f, opcode, (U16)0, (U8 *)temp, (U16)strlen(temp), 0, NULL);
+                add_wb_array(xl, r, c, f, opcode, (U16)0, (U8 *)temp, (U16)strlen(temp), 0, NULL);
             }       
             break;
         case 0x03:  /* Number - Float */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
             {
                 U16 r, c, f;
                 F64 d;
                 char temp[64];
 
-                r = getShort(&working_buffer[0]);
-                c = getShort(&working_buffer[2]);
+                r = getShort(&xl->working_buffer[0]);
+                c = getShort(&xl->working_buffer[2]);
                 if (version == 2)
                 {
-                    f = getShort(&working_buffer[4]);
-                    getDouble(&working_buffer[6], &d);
+                    f = getShort(&xl->working_buffer[4]);
+                    getDouble(&xl->working_buffer[6], &d);
                     sprintf(temp, "%.15g", d);
                 }
                 else
                 {   /* Who knows what the future looks like */
                     f = 0;
-                    Unsupported = 1;
-					sprintf(temp, disclaimers ? "****FPv:%d" : "??FLOAT??", version);
+                    xl->Unsupported = 1;
+					sprintf(temp, xl->disclaimers ? "****FPv:%d" : "??FLOAT??", version);
                 }
-                add_wb_array(r, c, f, opcode, (U16)0, (U8 *)temp, (U16)strlen(temp), 0, 0);
+                add_wb_array(xl, r, c, f, opcode, (U16)0, (U8 *)temp, (U16)strlen(temp), 0, 0);
             }
             break;
         case 0xD6:  /* RString */
-            working_buffer[bufidx++] = data;        
-            if ((bufidx == 8)&&(buflast == 0))
-                buflast = 8 + getShort(&working_buffer[6]);
-            if (buflast)
+            if (last >= 8)
             {
-                if (bufidx == buflast)
+                if ((U32)(8 + getShort(&xl->working_buffer[6])) <= last)
                 {
                     U16 r, c, l, f;
 
-                    r = getShort(&working_buffer[0]);
-                    c = getShort(&working_buffer[2]);
-                    f = getShort(&working_buffer[4]);
-                    l = getShort(&working_buffer[6]);
-                    working_buffer[8+l] = 0;
+                    r = getShort(&xl->working_buffer[0]);
+                    c = getShort(&xl->working_buffer[2]);
+                    f = getShort(&xl->working_buffer[4]);
+                    l = getShort(&xl->working_buffer[6]);
+                    xl->working_buffer[8+l] = 0;
 
-                    add_wb_array(r, c, f, opcode, (U16)0, &working_buffer[8],
-                            (U16)strlen((char *)&working_buffer[8]), 0, 0);
+                    add_wb_array(xl, r, c, f, opcode, (U16)0, &xl->working_buffer[8],
+                            (U16)strlen((char *)&xl->working_buffer[8]), 0, 0);
                 }
             }
             break;
         case 0x04:  /* Label - UNI */
-            working_buffer[bufidx++] = data;
-            if (file_version == EXCEL95)
+            if (xl->file_version == EXCEL95)
             {
-                if (bufidx == last)
-                {
-                    U16 r, c, f;
+                U16 r, c, f;
 
-                    r = getShort(&working_buffer[0]);
-                    c = getShort(&working_buffer[2]);
-                    f = getShort(&working_buffer[4]);
-                    working_buffer[bufidx] = 0;
+                r = getShort(&xl->working_buffer[0]);
+                c = getShort(&xl->working_buffer[2]);
+                f = getShort(&xl->working_buffer[4]);
+                xl->working_buffer[last] = 0;
 
-                    add_wb_array(r, c, f, opcode, (U16)0, &working_buffer[8],
-                            (U16)strlen((char *)&working_buffer[8]), 0, 0);
-                }
-            }
-            else if (file_version == EXCEL97)
-            {    /* Remember, bufidx is 1 more than it should be */
-                if ((bufidx == 8)&&(buflast == 0))
-                {   /* buflast = working_buffer[7]; */
-                    cch = getShort(&working_buffer[6]);
-                    buflast = cch + 9;
-                }
-                if (bufidx == 9)
-                {
-                    if (working_buffer[8] == 1)
-                        buflast = (cch << 1) + 9;
-                }
-                if (buflast)
-                {
-                    if (bufidx == buflast)
-                    {
-                        U16 r, c, f;
-                        U16 len;
-
-                        r = getShort(&working_buffer[0]);
-                        c = getShort(&working_buffer[2]);
-                        if (version == 2)
-                            f = getShort(&working_buffer[4]);
-                        else    /* Unknown version */
-                            f = 0;
-                        working_buffer[bufidx] = 0;
-
-                        len = (U16)strlen((char *)&working_buffer[8]);
-                        if (working_buffer[8] == 1)
-                        {
-                            UnicodeStrings = 2;
-                            add_wb_array(r, c, f, opcode, (U16)2, &working_buffer[9], (U16)(cch << 1), 0, 0);
-                        }
-                        else
-                            add_wb_array(r, c, f, opcode, (U16)0, &working_buffer[8], len, 0, 0);
-                    }
-                }
+                add_wb_array(xl, r, c, f, opcode, (U16)0, &xl->working_buffer[8],
+                        (U16)strlen((char *)&xl->working_buffer[8]), 0, 0);
             }
-            break;
-        case 0x05:  /* Boolerr */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
+            else if ((xl->file_version == EXCEL97)&&(last >= 9))
             {
-                U16 r, c, f;
-                char temp[16];
+                U16 cch = getShort(&xl->working_buffer[6]);
+                U32 buflast;
 
-                r = getShort(&working_buffer[0]);
-                c = getShort(&working_buffer[2]);
-                if (version == 2)
-                {
-                    f = getShort(&working_buffer[4]);
-                    decodeBoolErr(working_buffer[6], working_buffer[7], temp);
-                    add_wb_array(r, c, f, opcode, (U16)0, (U8 *)temp, (U16)strlen(temp), 0, 0);
-                }
+                if (xl->working_buffer[8] == 1)
+                    buflast = (cch << 1) + 9;
                 else
+                    buflast = cch + 9;
+                if (buflast <= last)
                 {
-                    f = 0;
-                    Unsupported = 1;
-					strcpy(temp, disclaimers ? "****Bool" : "??BOOL??");
-                    add_wb_array(r, c, f, opcode, (U16)0, (U8 *)temp, (U16)strlen(temp), 0, 0);
-                }
-            }
-            break;
-            /************
-            *   This function has 2 entry points. 1 is the mainline FC opcode.
-            *   In this event there are several bytes that setup the type of
-            *   strings that will follow. Then there is the continue entry
-            *   point which is immediate - e.g location 0.
-            *************/
-        case 0xFC:  /* Packed String Array A.K.A. SST Shared String Table...UNI */
-            if ((count > 7)||(cont_opcode == 1)) /* Skip the 1st 8 locations they are bs */
-            {
-/*              if ((count == 0)&&(data == 0)&&(buflast))   */
-                if ((count == 0)&&(cont_opcode == 1)&&(buflast))
-                {
-/*                  printf("Adjusting...\n"); */
-/*                  printf("I:%04X BL:%04X\n", bufidx, buflast); */
-                    cont_str_array = 1;
-                    cont_grbit = data;
-                    return;
-                }
-
-                working_buffer[bufidx] = data;
-                bufidx++;
-
-                if((cont_str_array)&&(grbit & 0x01)&& !(cont_grbit & 0x01))
-                {   /* ASCII -> unicode */
-                    working_buffer[bufidx] = 0;
-                    bufidx++;
-                }
+                    U16 r, c, f;
+                    U16 len;
 
-                if (buflast == 0)   /* Header processor */
-                {
-                    if (bufidx == 0x03)  /* After 3 locations we have length */
-                    {                   /* and type of chars... */
-                        cch = getShort(&working_buffer[0]);
-                        grbit = working_buffer[2];
+                    r = getShort(&xl->working_buffer[0]);
+                    c = getShort(&xl->working_buffer[2]);
+                    if (version == 2)
+                        f = getShort(&xl->working_buffer[4]);
+                    else    /* Unknown version */
+                        f = 0;
+                    xl->working_buffer[buflast] = 0;
 
-                        if (grbit < 0x04)   /* Normal run */
-                        {
-                            nonascii = 0;
-                            bufidx = 0;
-                            crun = 0;
-                            extrst = 0;
-                            buflast = cch << (grbit & 0x01);
-
-                            /* special case for empty strings */
-                            if (!cch && !buflast)
-                                add_str_array(0, (U8 *)0, 0, 0, 0);
-                            else
-                                memset(working_buffer, 0, WBUFF_SIZE);
-                        }
-                    }
-                    else if (bufidx == 0x05)
-                    {
-                        if ((grbit & 0x0C) == 0x08) /* Rich string only */
-                        {
-                            nonascii = 0;
-                            bufidx = 0;
-                            crun = getShort(&working_buffer[3]);
-                            extrst = 0;
-                            buflast = (cch << (grbit & 0x01)) + (crun*4);
-/*                          printf("rtbuflast:%X cch%X grbit:%X extrst:%X crun:%X last:%X\n",
-                                        buflast, cch, grbit, extrst, crun, last);
-                            printf("%02X %02X %02X %02X %02X %02X\n",
-                            working_buffer[0], working_buffer[1], working_buffer[2],
-                            working_buffer[3], working_buffer[4], working_buffer[5]); */
-                            memset(working_buffer, 0, WBUFF_SIZE);
-                        }
-                    }
-                    else if (bufidx == 0x07)
+                    len = (U16)strlen((char *)&xl->working_buffer[8]);
+                    if (xl->working_buffer[8] == 1)
                     {
-                        if ((grbit & 0x0C) == 0x04) /* Extended string only */
-                        {
-                            nonascii = 0;
-                            bufidx = 0;
-                            crun = 0;
-                            extrst = getLong(&working_buffer[3]);
-                            buflast = (cch << (grbit & 0x01)) + extrst;
-/*                          printf("esbuflast:%X cch%X grbit:%X extrst:%X last:%X\n",
-                                        buflast, cch, grbit, extrst, last);
-                            printf("%02X %02X %02X %02X %02X %02X\n",
-                            working_buffer[0], working_buffer[1], working_buffer[2],
-                            working_buffer[3], working_buffer[4], working_buffer[5]); */
-                            memset(working_buffer, 0, WBUFF_SIZE);
-                        }
-                    }
-                    else if (bufidx == 0x09)
-                    {
-                        if ((grbit & 0x0C) == 0x0C)
-                        {
-                            /* Rich String + Extended String **/
-                            nonascii = 0;
-                            bufidx = 0;
-                            crun = getShort(&working_buffer[3]);
-                            extrst = getLong(&working_buffer[5]);
-                            buflast = (cch << (grbit & 0x01)) + extrst + (crun*4);
-/*                          printf("xrtbuflast:%X cch%X grbit:%X extrst:%X crun:%X last:%X\n",
-                                        buflast, cch, grbit, extrst, crun, last);
-                            printf("%02X %02X %02X %02X %02X %02X\n",
-                            working_buffer[0], working_buffer[1], working_buffer[2],
-                            working_buffer[3], working_buffer[4], working_buffer[5]); */
-                            memset(working_buffer, 0, WBUFF_SIZE);
-                        }
+                        xl->UnicodeStrings = 2;
+                        add_wb_array(xl, r, c, f, opcode, (U16)2, &xl->working_buffer[9], (U16)(cch << 1), 0, 0);
                     }
-/*                  printf("*%02X ", data); */
+                    else
+                        add_wb_array(xl, r, c, f, opcode, (U16)0, &xl->working_buffer[8], len, 0, 0);
+                }
+            }
+            break;
+        case 0x05:  /* Boolerr */
+            {
+                U16 r, c, f;
+                char temp[16];
+
+                r = getShort(&xl->working_buffer[0]);
+                c = getShort(&xl->working_buffer[2]);
+                if (version == 2)
+                {
+                    f = getShort(&xl->working_buffer[4]);
+                    decodeBoolErr(xl->working_buffer[6], xl->working_buffer[7], temp);
+                    add_wb_array(xl, r, c, f, opcode, (U16)0, (U8 *)temp, (U16)strlen(temp), 0, 0);
                 }
-                else    /* payload processor */
+                else
                 {
-/*                  if (cont_opcode == 1)
-                        printf(" %02X", data); */
-                    if (data > 127)
-                        nonascii = 1;
-                    if (bufidx == buflast)
-                    {
-                        U8 uni;
-                        U16 len = (U16)(cch << (grbit & 0x01));
-/*                      int i;  */
-
-                        if (grbit & 01)
-                        {
-                            uni = 2;
-                            UnicodeStrings = 2;
-                        }
-                        else
-                            uni = nonascii;
-                        working_buffer[bufidx] = 0;
-/*                          fprintf(stderr,":buflast-"); */
-/*                                                  { int i; */
-/*                          for (i=0; i<buflast; i++) */
-/*                                                    putchar(working_buffer[i]); */
-/*                          fprintf(stderr,"\nNext String:%d\n", next_string); */
-/*                                                  } */
-
-                        if (crun)
-                            add_str_array(uni, working_buffer, len, working_buffer+len, crun);
-                        else
-                            add_str_array(uni, working_buffer, len, 0, 0);
-                        if (uni > UnicodeStrings)   /* Try to "upgrade" charset */
-                            UnicodeStrings = uni;
-                        bufidx = 0;
-                        buflast = 0;
-                        cch = 0;
-                        cont_str_array = 0;
-                        memset(working_buffer, 0, WBUFF_SIZE);
-                    }
+                    f = 0;
+                    xl->Unsupported = 1;
+					strcpy(temp, xl->disclaimers ? "****Bool" : "??BOOL??");
+                    add_wb_array(xl, r, c, f, opcode, (U16)0, (U8 *)temp, (U16)strlen(temp), 0, 0);
                 }
             }
             break;
+        case 0xFC:  /* Packed String Array A.K.A. SST Shared String Table...UNI */
+            /* Parsed a segment at a time by process_sst() as it is read */
+            break;
         case 0xFD:  /* String Array Index A.K.A. LABELSST */
-            working_buffer[count] = data;
-            if (count == (last - 1))
             {
                 U32 i;
                 U16 r, c, f;
 
                 /* This is byte reversed... */
-                r = getShort(&working_buffer[0]);
-                c = getShort(&working_buffer[2]);
-                f = getShort(&working_buffer[4]);
-                i = getLong(&working_buffer[6]);
-                if (i < next_string)
+                r = getShort(&xl->working_buffer[0]);
+                c = getShort(&xl->working_buffer[2]);
+                f = getShort(&xl->working_buffer[4]);
+                i = getLong(&xl->working_buffer[6]);
+                if (i < xl->next_string)
                 {
 /*                  printf("String used:%d\n", (int)i); */
-                    if (str_array[i])
+                    if (xl->str_array[i])
                     {
-                        if (str_array[i]->str)
-                            add_wb_array(
+                        if (xl->str_array[i]->str)
+                            add_wb_array(xl, 
                                 r, c, f, opcode,
-                                str_array[i]->uni, str_array[i]->str,
-                                str_array[i]->len, str_array[i]->crun_cnt, str_array[i]->fmt_run);
+                                xl->str_array[i]->uni, xl->str_array[i]->str,
+                                xl->str_array[i]->len, xl->str_array[i]->crun_cnt, xl->str_array[i]->fmt_run);
                     }
                     else    /* Error, so just set it empty */
                     {
-                        if( disclaimers )
+                        if( xl->disclaimers )
                         {
-                            add_wb_array( r, c, f, opcode,
+                            add_wb_array(xl, r, c, f, opcode,
                                     (U16)0, (U8 *)"String Table Error", 18, 0, 0);
                         }
                     }
                 }
                 else
-                    MaxStringsExceeded = 1;
+                    xl->MaxStringsExceeded = 1;
             }
             break;
         case 0x31:  /* Font */
-            working_buffer[bufidx++] = data;
-            if (bufidx > 14) /* Address 14 has length in unicode chars */
+            if (last > 14) /* Address 14 has length in unicode chars */
             {
-                if ((file_version == EXCEL95)&&(bufidx == last))
+                if (xl->file_version == EXCEL95)
                 {   /* Microsoft doesn't stick to their documentation. Excel 97 is supposed
                        to be 0x0231...but its not. Have to use file_version to separate them. */
-                    unsigned int i;
+                    unsigned int i, buflast;
                     U16 size, attr, c_idx, b, su;
                     U8 u;
 
-                    size = getShort(&working_buffer[0]);
-                    attr = getShort(&working_buffer[2]);
-                    c_idx = getShort(&working_buffer[4]);
-                    b = getShort(&working_buffer[6]);
-                    su = getShort(&working_buffer[8]);
-                    u = working_buffer[10];
-                    buflast = working_buffer[14];
+                    size = getShort(&xl->working_buffer[0]);
+                    attr = getShort(&xl->working_buffer[2]);
+                    c_idx = getShort(&xl->working_buffer[4]);
+                    b = getShort(&xl->working_buffer[6]);
+                    su = getShort(&xl->working_buffer[8]);
+                    u = xl->working_buffer[10];
+                    buflast = xl->working_buffer[14];
                     for (i=0; i<buflast; i++)
-                        working_buffer[i] = working_buffer[i+15];
+                        xl->working_buffer[i] = xl->working_buffer[i+15];
 
-                    working_buffer[buflast] = 0;
+                    xl->working_buffer[buflast] = 0;
 /*                  printf("S:%04X A:%04X C:%04X B:%04X SU:%04X U:%02X\n",
                             size, attr,c_idx,b,su,u);
                     printf("f:%s\n", working_buffer); */
-                    add_font(size, attr, c_idx, b, su, u, 0, &working_buffer[0], 0);
+                    add_font(xl, size, attr, c_idx, b, su, u, 0, &xl->working_buffer[0], 0);
                 }
-                else if ((file_version == EXCEL97)&&(bufidx == last))
+                else if (xl->file_version == EXCEL97)
                 {   /* Microsoft doesn't stick to their documentation. Excel 97 is supposed
                        to be 0x0231...but its not. Have to use file_version to separate them. */
-                    unsigned int i;
+                    unsigned int i, buflast;
                     U16 len;
                     U16 size, attr, c_idx, b, su;
                     U8 u, uni=0;
 
-                    size = getShort(&working_buffer[0]);
-                    attr = getShort(&working_buffer[2]);
-                    c_idx = getShort(&working_buffer[4]);
-                    b = getShort(&working_buffer[6]);
-                    su = getShort(&working_buffer[8]);
-                    u = working_buffer[10];
-                    buflast = working_buffer[14];
+                    size = getShort(&xl->working_buffer[0]);
+                    attr = getShort(&xl->working_buffer[2]);
+                    c_idx = getShort(&xl->working_buffer[4]);
+                    b = getShort(&xl->working_buffer[6]);
+                    su = getShort(&xl->working_buffer[8]);
+                    u = xl->working_buffer[10];
+                    buflast = xl->working_buffer[14];
 
                     for (i=0; buflast > 2 && i<(buflast-2); i++)
                     {   /* This looks at the 2nd byte to see if its unicode... */
-                        if (working_buffer[(i<<1)+17] != 0)
+                        if (xl->working_buffer[(i<<1)+17] != 0)
                             uni = 2;
                     }
 
@@ -1261,25 +1484,25 @@ void main_line_processor(U16 opcode, U16 version, U32 count, U16 last, U8 data)
                     {   
                         for (i=0; i<len; i++)
                         {
-                            working_buffer[i] = working_buffer[(i<<1)+16];
-                            if ((working_buffer[i] > 0x0080U) && (uni == 0))
+                            xl->working_buffer[i] = xl->working_buffer[(i<<1)+16];
+                            if ((xl->working_buffer[i] > 0x0080U) && (uni == 0))
                                 uni = 1;
                         }
                     }
                     else
                     {
                         for (i=0; i<len; i++)
-                            working_buffer[i] = working_buffer[i+16];
+                            xl->working_buffer[i] = xl->working_buffer[i+16];
                     }
 
-                    working_buffer[len] = 0;
+                    xl->working_buffer[len] = 0;
 
 /*                  printf("S:%04X A:%04X C:%04X B:%04X SU:%04X U:%02X\n",
                             size, attr,c_idx,b,su,u);
                     printf("BL:%d L:%d Uni:%d\n", buflast, len, uni);
                     printf("%X %X %X %X\n", working_buffer[15], working_buffer[16], working_buffer[17], working_buffer[18]);
                     printf("f:%s\n", working_buffer); */
-                    add_font(size, attr, c_idx, b, su, u, uni, &working_buffer[0], len);
+                    add_font(xl, size, attr, c_idx, b, su, u, uni, &xl->working_buffer[0], len);
                 }
             }
             break;
@@ -1288,55 +1511,51 @@ void main_line_processor(U16 opcode, U16 version, U32 count, U16 last, U8 data)
         case 0x15:  /* Footer */
             break;
         case 0x06:  /* Formula */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
             {
                 U16 r, c, f;
                 U8 calc_val[64];
 
-                r = getShort(&working_buffer[0]);
-                c = getShort(&working_buffer[2]);
-                f = getShort(&working_buffer[4]);
-                if ((working_buffer[12] == 0xFF)&&(working_buffer[13] == 0xFF))
+                r = getShort(&xl->working_buffer[0]);
+                c = getShort(&xl->working_buffer[2]);
+                f = getShort(&xl->working_buffer[4]);
+                if ((xl->working_buffer[12] == 0xFF)&&(xl->working_buffer[13] == 0xFF))
                 {   /* Formula evaluates to Bool, Err, or String */
-                    if (working_buffer[6] == 1)             /* Boolean */
+                    if (xl->working_buffer[6] == 1)             /* Boolean */
                     {
-                        decodeBoolErr(working_buffer[8], 0, (char *)calc_val);
+                        decodeBoolErr(xl->working_buffer[8], 0, (char *)calc_val);
                         opcode = 0x0105;
                     }
-                    else if (working_buffer[6] == 2)            /* Err */
+                    else if (xl->working_buffer[6] == 2)            /* Err */
                     {
-                        decodeBoolErr(working_buffer[8], 1, (char *)calc_val);
+                        decodeBoolErr(xl->working_buffer[8], 1, (char *)calc_val);
                         opcode = 0x0105;
                     }
                     else
                     {                           /* String UNI */
-                        str_formula_row = r;
-                        str_formula_col = c;
-                        str_formula_format = f;
+                        xl->str_formula_row = r;
+                        xl->str_formula_col = c;
+                        xl->str_formula_format = f;
                         break;
                     }
                 }
                 else
                 {   /* Otherwise...this is a number */
                     F64 n;
-                    getDouble(&working_buffer[6], &n);
+                    getDouble(&xl->working_buffer[6], &n);
                     sprintf((char *)calc_val, "%.15g", n);
                     opcode = 0x0103;    /* To fix up OutputCellFormatted... */
                 }
-                add_wb_array(r, c, f, opcode, (U16)0, calc_val, (U16)strlen((char *)calc_val), 0, 0);
+                add_wb_array(xl, r, c, f, opcode, (U16)0, calc_val, (U16)strlen((char *)calc_val), 0, 0);
             }
             break;
         case 0x07:  /* String Formula Results */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
             {
                 U8 *str;
                 U8 uni = 0;
-                U16 len = getShort(&working_buffer[0]);
+                U16 len = getShort(&xl->working_buffer[0]);
                 if (len > (last-3))
                     len = (U16)(last-3);
-                if (file_version == EXCEL97)
+                if (xl->file_version == EXCEL97)
                 {
                     /* Check for unicode. Terminate the buffer at 2x len
                         since unicode is 2bytes per char. Then see if
@@ -1344,66 +1563,65 @@ void main_line_processor(U16 opcode, U16 version, U32 count, U16 last, U8 data)
                         western chararcter sets. */
                     int t = len << 1;
                     if ((t+3) < WBUFF_SIZE)
-                        working_buffer[t+3] = 0;
+                        xl->working_buffer[t+3] = 0;
                     else
-                        working_buffer[len+3] = 0;
+                        xl->working_buffer[len+3] = 0;
                     if ((len+3) < last)
                     {
                         uni = 2;
                         len = (U16)t;
                     }
-                    str = &working_buffer[3];
+                    str = &xl->working_buffer[3];
                 }
-                else if (file_version == EXCEL95)
+                else if (xl->file_version == EXCEL95)
                 {
-                    str = &working_buffer[2];
-                    working_buffer[len+2] = 0;
+                    str = &xl->working_buffer[2];
+                    xl->working_buffer[len+2] = 0;
                 }
                 else
                 {
-                    if (OutputXML)
+                    if (xl->OutputXML)
                         str = (U8*)"<NotImplemented/>String Formula";
                     else
-						str = (U8*)(disclaimers ? "***String Formula" : "String Formula");
+						str = (U8*)(xl->disclaimers ? "***String Formula" : "String Formula");
                     len = (U16)strlen((char*)str);
-                    NotImplemented++;
+                    xl->NotImplemented++;
                 }
-                add_wb_array(str_formula_row, str_formula_col, str_formula_format, opcode, uni, str, len, 0, 0);
+                add_wb_array(xl, xl->str_formula_row, xl->str_formula_col, xl->str_formula_format, opcode, uni, str, len, 0, 0);
             }
             break;
         case 0x5C:  /* Author's name A.K.A. WRITEACCESS */
-            working_buffer[bufidx++] = data;
-            if ((bufidx == last)&&(author.str == 0))
+            if (xl->author.str == 0)
             {
-                if (file_version == EXCEL97)
+                if (xl->file_version == EXCEL97)
                 {
-                    author.len = getShort(&working_buffer[0]);
-                    if ((int)working_buffer[2] & 0x01)
+                    xl->author.len = getShort(&xl->working_buffer[0]);
+                    if ((int)xl->working_buffer[2] & 0x01)
                     {
-                        author.len *= (U16)2;
-                        author.uni = 2;
+                        xl->author.len *= (U16)2;
+                        xl->author.uni = 2;
                     }
                     else
-                        author.uni = 0;
-                    if (author.len > (last-2))
-                        author.len = (U16)(last-2);
-                    author.str = (U8 *)malloc(author.len+1);
-                    if (author.str)
+                        xl->author.uni = 0;
+                    if (xl->author.len > (last-2))
+                        xl->author.len = (U16)(last-2);
+                    xl->author.str = (U8 *)malloc(xl->author.len+1);
+                    if (xl->author.str)
                     {
-                        memcpy(author.str, &working_buffer[3], author.len);
-                        author.str[author.len] = 0;
+                        memcpy(xl->author.str, &xl->working_buffer[3], xl->author.len);
+                        xl->author.str[xl->author.len] = 0;
                     }
                 }
-                else if (file_version == EXCEL95)
+                else if (xl->file_version == EXCEL95)
                 {
-                    author.len = working_buffer[0];
-                    author.str = (U8 *)malloc(author.len+1);
-                    if (author.str)
+                    xl->author.len = xl->working_buffer[0];
+                    xl->author.str = (U8 *)malloc(xl->author.len+1);
+                    if (xl->author.str)
                     {
-                        memcpy(author.str, &working_buffer[1], author.len);
-                        author.str[author.len] = 0;
+                        memcpy(xl->author.str, &xl->working_buffer[1], xl->author.len);
+                        xl->author.str[xl->author.len] = 0;
                     }
-                    author.uni = 0;
+                    xl->author.uni = 0;
                 }
             }
             break;
@@ -1411,118 +1629,73 @@ void main_line_processor(U16 opcode, U16 version, U32 count, U16 last, U8 data)
             /* There's actually some other interesting things
                here that we're not collecting. For now, we'll
                Just get the dimensions of the sheet. */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
             {
                 /* question...what is the actual limit?
                     This can go as high as 64K. Is this really OK? */
                 U16 i, r, fc, lc, d, xf;
-                r = getShort(&working_buffer[0]);
-                fc = getShort(&working_buffer[2]);
-                lc = (U16)(getShort(&working_buffer[4]) - (U16)1);
-                d = getShort(&working_buffer[12]);
-                xf = getShort(&working_buffer[14]);
-
-                if (ws_array[sheet_count] == 0)
-                    if (ws_init(sheet_count))
+                r = getShort(&xl->working_buffer[0]);
+                fc = getShort(&xl->working_buffer[2]);
+                lc = (U16)(getShort(&xl->working_buffer[4]) - (U16)1);
+                d = getShort(&xl->working_buffer[12]);
+                xf = getShort(&xl->working_buffer[14]);
+
+                if (xl->ws_array[xl->sheet_count] == 0)
+                    if (ws_init(xl, xl->sheet_count))
                         return;
 
-                if (r > ws_array[sheet_count]->biggest_row)
-                {
-                    if (r < ws_array[sheet_count]->max_rows)
-                        ws_array[sheet_count]->biggest_row = r;
-                    else
-                    {   /* Resize the array... */
-                        if (MaxRowExceeded == 0)
-                        {
-                            int diff = (r/ROWS_INCR) + 1;
-                            if(resize_c_array(ws_array[sheet_count], ROWS_INCR*diff, 0))
-                            {
-                                ws_array[sheet_count]->biggest_row = ws_array[sheet_count]->max_rows - 1;
-                                MaxRowExceeded = 1;
-                                return;
-                            }
-                            else
-                                ws_array[sheet_count]->biggest_row = r;
-                        }
-                        else
-                            return;
-                    }
-                }
+                if ((r > xl->ws_array[xl->sheet_count]->biggest_row)&&(r <= xl->hard_max_rows))
+                    xl->ws_array[xl->sheet_count]->biggest_row = r;
 
-                if (lc > ws_array[sheet_count]->biggest_col)
-                {
-                    if (lc < ws_array[sheet_count]->max_cols)
-                        ws_array[sheet_count]->biggest_col = lc;
-                    else
-                    {   /* Resize array... */
-                        if (MaxColExceeded == 0)
-                        {
-                            int diff = (lc/COLS_INCR) + 1;
-                            if (resize_c_array(ws_array[sheet_count], 0, (U16)(COLS_INCR*diff)))
-                            {
-                                ws_array[sheet_count]->biggest_col = (S16)(ws_array[sheet_count]->max_cols - 1);
-                                MaxColExceeded = 1;
-                                lc = ws_array[sheet_count]->max_cols;
-                            }
-                            else
-                                ws_array[sheet_count]->biggest_col = lc;
-                        }
-                        else
-                            lc = ws_array[sheet_count]->max_cols;
-                    }
-                }
-                if ((fc < ws_array[sheet_count]->max_cols)&&(d & 0x0080))   /* fGhostDirty flag */
+                if (lc > HARD_MAX_COLS)     /* Empty row, no columns in use */
+                    return;
+                if (lc > xl->ws_array[xl->sheet_count]->biggest_col)
+                    xl->ws_array[xl->sheet_count]->biggest_col = lc;
+                if (d & 0x0080)     /* fGhostDirty flag */
                 {
                     for (i=fc; i<lc; i++)
                     {   /* Set the default attr... */
-                        update_cell_xf(r, i, xf);
+                        update_cell_xf(xl, r, i, xf);
                     }
                 }
             }
             break;
         case 0x22:  /* 1904 Flag - MacIntosh Dates or PC Dates */
-            working_buffer[bufidx++] = data;
-            if (bufidx == 2)
-                DatesR1904 = getShort(&working_buffer[0]);
+            if (last >= 2)
+                xl->DatesR1904 = getShort(&xl->working_buffer[0]);
             break;
         case 0x085: /* BoundSheet */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
             {   /* This is based on Office 97 info... */
-                if ((working_buffer[4] & 0x0F) == 0)
+                if ((xl->working_buffer[4] & 0x0F) == 0)
                 {   /* Worksheet as opposed to chart, etc */
                     U16 len;
                     U8 uni=0;
-                    if (file_version == EXCEL97)
+                    if (xl->file_version == EXCEL97)
                     {
-                        len = (U16)working_buffer[6];       /* FIXME: Check this !!! Was GetShort */
-                        if (working_buffer[7] & 0x01)
+                        len = (U16)xl->working_buffer[6];       /* FIXME: Check this !!! Was GetShort */
+                        if (xl->working_buffer[7] & 0x01)
                         {
                             uni = 2;
                             len = (U16)(len<<1);
                         }
                         if (len != 0)
                         {
-                            working_buffer[8 + len + 1] = 0;
-                            add_ws_title(uni, &working_buffer[8], len);
+                            xl->working_buffer[8 + len + 1] = 0;
+                            add_ws_title(xl, uni, &xl->working_buffer[8], len);
                         }
                     }
                     else
                     {
-                        len = working_buffer[6];
+                        len = xl->working_buffer[6];
                         if (len != 0)
                         {
-                            working_buffer[7 + len + 1] = 0;
-                            add_ws_title(uni, &working_buffer[7], len);
+                            xl->working_buffer[7 + len + 1] = 0;
+                            add_ws_title(xl, uni, &xl->working_buffer[7], len);
                         }
                     }
                 }
             }
             break;
         case 0x7E:  /* RK Number */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
             {   /* This is based on Office 97 info... */
                 U16 r, c, f;
                 U32 t;
@@ -1530,10 +1703,10 @@ void main_line_processor(U16 opcode, U16 version, U32 count, U16 last, U8 data)
                 F64 d;
                 char temp[64];
 
-                r = getShort(&working_buffer[0]);
-                c = getShort(&working_buffer[2]);
-                f = getShort(&working_buffer[4]);
-                n = getLong(&working_buffer[6]);
+                r = getShort(&xl->working_buffer[0]);
+                c = getShort(&xl->working_buffer[2]);
+                f = getShort(&xl->working_buffer[4]);
+                n = getLong(&xl->working_buffer[6]);
                 t = n & 0x03;
                 n2 = n>>2;
                 switch (t)
@@ -1554,13 +1727,11 @@ void main_line_processor(U16 opcode, U16 version, U32 count, U16 last, U8 data)
                         sprintf(temp, "%.15g", d / 100.0 );
                         break;
                 }
-                add_wb_array(r, c, f, opcode, (U16)0, (U8 *)temp, (U16)strlen(temp), 0, 0);
+                add_wb_array(xl, r, c, f, opcode, (U16)0, (U8 *)temp, (U16)strlen(temp), 0, 0);
             }
             break;
         case 0xBC:      /* Shared Formula's */
-/*          working_buffer[bufidx++] = data;
-            if (bufidx == last)
-            {
+/*          {
                 int fr, lr, fc, lc, i, j;
                 fr = getShort(&working_buffer[0]);
                 lr = getShort(&working_buffer[2]);
@@ -1575,31 +1746,27 @@ void main_line_processor(U16 opcode, U16 version, U32 count, U16 last, U8 data)
             }   */
             break;
         case 0x21:      /* Arrays */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
             {
                 U16 fr, lr, fc, lc, i, j;
-                fr = getShort(&working_buffer[0]);
-                lr = getShort(&working_buffer[2]);
-                fc = working_buffer[4];
-                lc = working_buffer[5];
+                fr = getShort(&xl->working_buffer[0]);
+                lr = getShort(&xl->working_buffer[2]);
+                fc = xl->working_buffer[4];
+                lc = xl->working_buffer[5];
                 for (i=fr; i<=lr; i++)
                 {
                     for (j=fc; j<=lc; j++)
-						add_wb_array(i, j, (U16)0, opcode, 0, (U8 *)(disclaimers ? "***Array" : "Array"), 8, 0, 0);
+						add_wb_array(xl, i, j, (U16)0, opcode, 0, (U8 *)(xl->disclaimers ? "***Array" : "Array"), 8, 0, 0);
                 }
-                NotImplemented = 1;
+                xl->NotImplemented = 1;
             }
             break;
         case 0xBD:      /* MULRK */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
             {
                 U16 r, fc, lc;
                 int i;
-                r = getShort(&working_buffer[0]);
-                fc = getShort(&working_buffer[2]);
-                lc = getShort(&working_buffer[last-2]);
+                r = getShort(&xl->working_buffer[0]);
+                fc = getShort(&xl->working_buffer[2]);
+                lc = getShort(&xl->working_buffer[last-2]);
                 for (i=0; i<=(lc-fc); i++)
                 {
                     U32 t;
@@ -1608,8 +1775,8 @@ void main_line_processor(U16 opcode, U16 version, U32 count, U16 last, U8 data)
                     F64 d;
                     char temp[64];
 
-                    f = getShort(&working_buffer[4+(i*6)]);
-                    n = getLong(&working_buffer[6+(i*6)]);
+                    f = getShort(&xl->working_buffer[4+(i*6)]);
+                    n = getLong(&xl->working_buffer[6+(i*6)]);
                     t = n & 0x03;
                     n2 = n>>2;
                     switch (t)
@@ -1631,55 +1798,49 @@ void main_line_processor(U16 opcode, U16 version, U32 count, U16 last, U8 data)
                             break;
                     }
 /*                  printf("%08X %02X %s  %d  %d\n", n2, t, temp, r, fc+i); */
-                    add_wb_array(r, fc+i, f, opcode, (U16)0, (U8 *)temp, (U16)strlen(temp), 0, 0);
+                    add_wb_array(xl, r, fc+i, f, opcode, (U16)0, (U8 *)temp, (U16)strlen(temp), 0, 0);
                 }
             }
             break;
         case 0xBE:      /* MULBLANK */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
             {
                 U16 r, fc, lc, j, f;
-                r = getShort(&working_buffer[0]);
-                fc = getShort(&working_buffer[2]);
-                lc = getShort(&working_buffer[last-2]);
+                r = getShort(&xl->working_buffer[0]);
+                fc = getShort(&xl->working_buffer[2]);
+                lc = getShort(&xl->working_buffer[last-2]);
                 for (j=0; j<=(lc-fc); j++)
                 {   /* This just stores format strings... */
-                    f = getShort(&working_buffer[4+(j*2)]);
-                    add_wb_array(r, fc+j, f, opcode, (U16)0, (U8 *)0, (U16)0, 0, 0);
+                    f = getShort(&xl->working_buffer[4+(j*2)]);
+                    add_wb_array(xl, r, fc+j, f, opcode, (U16)0, (U8 *)0, (U16)0, 0, 0);
                 }
             }
             break;
         case 0x18:      /* Name UNI */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
             {
                 char *ptr;
-                working_buffer[bufidx] = 0;
-                ptr = (char *)strstr((char *)&working_buffer[15], "LastUpdate");
+                xl->working_buffer[last] = 0;
+                ptr = (char *)strstr((char *)&xl->working_buffer[15], "LastUpdate");
                 if (ptr)
                 {
                     ptr += 13;
-                    lastUpdated = (char *)malloc(strlen(ptr)+1);
-                    if (lastUpdated)
-                        strcpy(lastUpdated, ptr);
+                    xl->lastUpdated = (char *)malloc(strlen(ptr)+1);
+                    if (xl->lastUpdated)
+                        strcpy(xl->lastUpdated, ptr);
                 }
                 else
                 {
-                    ptr = (char *)strstr((char *)&working_buffer[15], "Title");
+                    ptr = (char *)strstr((char *)&xl->working_buffer[15], "Title");
                     if (ptr)
                     {
                         ptr += 8;
-                        title = (char *)malloc(strlen(ptr)+1);
-                        if (title)
-                            strcpy(title, ptr);
+                        xl->title = (char *)malloc(strlen(ptr)+1);
+                        if (xl->title)
+                            strcpy(xl->title, ptr);
                     }
                 }
             }
             break;
         case 0xE0:      /* Extended format */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
             {
                 U16 fnt_idx;
                 U16 fmt_idx;
@@ -1691,100 +1852,93 @@ void main_line_processor(U16 opcode, U16 version, U32 count, U16 last, U8 data)
                 U32  b_t_color;
                 U16 cell_color;
 
-                fnt_idx = getShort(&working_buffer[0]);
-                fmt_idx = getShort(&working_buffer[2]);
-                gen = getShort(&working_buffer[4]);
-                align  = getShort(&working_buffer[6]);
-                indent  = getShort(&working_buffer[8]);
-                b_style  = getShort(&working_buffer[10]);
-                if (file_version == EXCEL95)
+                fnt_idx = getShort(&xl->working_buffer[0]);
+                fmt_idx = getShort(&xl->working_buffer[2]);
+                gen = getShort(&xl->working_buffer[4]);
+                align  = getShort(&xl->working_buffer[6]);
+                indent  = getShort(&xl->working_buffer[8]);
+                b_style  = getShort(&xl->working_buffer[10]);
+                if (xl->file_version == EXCEL95)
                 {
                     b_l_color  = 0;
                     b_t_color = 0;
-                    cell_color  = (U16)(getShort(&working_buffer[12]) & (U16)0x1FFF);
+                    cell_color  = (U16)(getShort(&xl->working_buffer[12]) & (U16)0x1FFF);
                 }
                 else    /* Excel 97 + */
                 {
-                    b_l_color  = getShort(&working_buffer[12]);
-                    b_t_color = getLong(&working_buffer[14]);
-                    cell_color  = getShort(&working_buffer[18]);
+                    b_l_color  = getShort(&xl->working_buffer[12]);
+                    b_t_color = getLong(&xl->working_buffer[14]);
+                    cell_color  = getShort(&xl->working_buffer[18]);
                 }
 
                 /* printf("XF:%02X FG:%02X BG:%02X\n", next_xf, cell_color&0x007F, (cell_color&0x1F80)>>7); */
                 /* printf("XF:%02X M:%02X b_t:%04X<br>\n", next_xf, indent, b_t_color); */
-                add_xf_array(fnt_idx, fmt_idx, gen, align, indent, b_style,
+                add_xf_array(xl, fnt_idx, fmt_idx, gen, align, indent, b_style,
                     b_l_color, b_t_color, cell_color);
             }
             break;
         case 0xE5:      /* CELL MERGE INSTRUCTIONS */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
             {
                 U16 num, fr, lr, fc, lc, i, j, k;
-                if (ws_array[sheet_count] == 0)
+                if (xl->ws_array[xl->sheet_count] == 0)
                 {
-                    if (ws_init(sheet_count))
+                    if (ws_init(xl, xl->sheet_count))
                         return;
                 }
-                ws_array[sheet_count]->spanned = 1;
-                num = getShort(&working_buffer[0]);
-                if (ws_array[sheet_count]->c_array == 0)
-                    return;
+                xl->ws_array[xl->sheet_count]->spanned = 1;
+                num = getShort(&xl->working_buffer[0]);
 
                 for (i=0; i<num; i++)
                 {
                     cell *c;
-                    fr = getShort(&working_buffer[2+(i*8)]);
-                    lr = getShort(&working_buffer[4+(i*8)]);
-                    fc = getShort(&working_buffer[6+(i*8)]);
-                    lc = getShort(&working_buffer[8+(i*8)]);
-                    if (sheet_count < (int)max_worksheets)
+                    fr = getShort(&xl->working_buffer[2+(i*8)]);
+                    lr = getShort(&xl->working_buffer[4+(i*8)]);
+                    fc = getShort(&xl->working_buffer[6+(i*8)]);
+                    lc = getShort(&xl->working_buffer[8+(i*8)]);
+                    if (xl->sheet_count < (int)xl->max_worksheets)
                     {
-                        if (ws_array[sheet_count] == 0)
+                        if (xl->ws_array[xl->sheet_count] == 0)
                         {
-                            if (ws_init(sheet_count))
+                            if (ws_init(xl, xl->sheet_count))
                                 return;
                         }
-                        if (ws_array[sheet_count]->c_array)
-                        {
-                            if(ws_array[sheet_count]->biggest_row < 0 || ws_array[sheet_count]->biggest_row < fr)
-                                ws_array[sheet_count]->biggest_row = fr;
-                            if(ws_array[sheet_count]->biggest_row < 0 || ws_array[sheet_count]->biggest_row < lr)
-                                ws_array[sheet_count]->biggest_row = lr;
-                            if ((fr > lr)||(fr > ws_array[sheet_count]->biggest_row)||(lr > ws_array[sheet_count]->biggest_row))
-                                lr = (U16)ws_array[sheet_count]->biggest_row;
-
-                            if(ws_array[sheet_count]->biggest_col < 0 || ws_array[sheet_count]->biggest_col < fc)
-                                ws_array[sheet_count]->biggest_col = fc;
-                            if(ws_array[sheet_count]->biggest_col < 0 || ws_array[sheet_count]->biggest_col < lc)
-                                ws_array[sheet_count]->biggest_col = lc;
-                            if ((fc > lc)||(fc > ws_array[sheet_count]->biggest_col)||(lc > ws_array[sheet_count]->biggest_col))
-                                lc = ws_array[sheet_count]->biggest_col;
-
-                            for(j=fr; j<=lr; j++)
-                            {   /* For each row */
-                                for(k=fc; k<=lc; k++)
-                                {   /* for each column */
-                                    c = ws_array[sheet_count]->c_array[(j*ws_array[sheet_count]->max_cols)+k];
-                                    if (c != 0)
-                                    {
-                                        c->spanned = 1;
-                                        c->rowspan = 0;
-                                        if (k == fc)
-                                            c->colspan = (U16)((lc-fc)+1);
-                                        else
-                                            c->colspan = 0;
-                                    }
-/*                                  else
-                                    {   / Need to create one...
-                                        printf("Bad One at:%d %d %d<br>\n", sheet_count, j, k);
-                                    } */
+                        if(xl->ws_array[xl->sheet_count]->biggest_row < 0 || xl->ws_array[xl->sheet_count]->biggest_row < fr)
+                            xl->ws_array[xl->sheet_count]->biggest_row = fr;
+                        if(xl->ws_array[xl->sheet_count]->biggest_row < 0 || xl->ws_array[xl->sheet_count]->biggest_row < lr)
+                            xl->ws_array[xl->sheet_count]->biggest_row = lr;
+                        if ((fr > lr)||(fr > xl->ws_array[xl->sheet_count]->biggest_row)||(lr > xl->ws_array[xl->sheet_count]->biggest_row))
+                            lr = (U16)xl->ws_array[xl->sheet_count]->biggest_row;
+
+                        if(xl->ws_array[xl->sheet_count]->biggest_col < 0 || xl->ws_array[xl->sheet_count]->biggest_col < fc)
+                            xl->ws_array[xl->sheet_count]->biggest_col = fc;
+                        if(xl->ws_array[xl->sheet_count]->biggest_col < 0 || xl->ws_array[xl->sheet_count]->biggest_col < lc)
+                            xl->ws_array[xl->sheet_count]->biggest_col = lc;
+                        if ((fc > lc)||(fc > xl->ws_array[xl->sheet_count]->biggest_col)||(lc > xl->ws_array[xl->sheet_count]->biggest_col))
+                            lc = xl->ws_array[xl->sheet_count]->biggest_col;
+
+                        for(j=fr; j<=lr; j++)
+                        {   /* For each row */
+                            for(k=fc; k<=lc; k++)
+                            {   /* for each column */
+                                c = ws_get_cell(xl->ws_array[xl->sheet_count], j, k);
+                                if (c != 0)
+                                {
+                                    c->spanned = 1;
+                                    c->rowspan = 0;
+                                    if (k == fc)
+                                        c->colspan = (U16)((lc-fc)+1);
+                                    else
+                                        c->colspan = 0;
                                 }
+/*                              else
+                                {   / Need to create one...
+                                    printf("Bad One at:%d %d %d<br>\n", sheet_count, j, k);
+                                } */
                             }
                         }
                         /* Now reset the first one... */
 /*                      printf("s:%d fr:%d fc:%d lr:%d lc:%d<br>\n", sheet_count, fr, fc, lr, lc); */
-                        c = ws_array[sheet_count]->c_array[(fr*ws_array[sheet_count]->max_cols)+fc];
+                        c = ws_get_cell(xl->ws_array[xl->sheet_count], fr, fc);
                         if (c != 0)
                         {
                             c->spanned = 0;
@@ -1800,68 +1954,62 @@ void main_line_processor(U16 opcode, U16 version, U32 count, U16 last, U8 data)
             }
             break;
         case 0xB8:  /* Hyperlink */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
             {   /* This is based on Office 97 info... */
                 U16 r, c, uni_type, off;
                 U32 len;
 
-                r = getShort(&working_buffer[0]);
-                c = getShort(&working_buffer[4]);
-                if (working_buffer[32] == 0xE0)
+                r = getShort(&xl->working_buffer[0]);
+                c = getShort(&xl->working_buffer[4]);
+                if (xl->working_buffer[32] == 0xE0)
                 {   /* Unicode format */
-                    len = getLong(&working_buffer[48]);
+                    len = getLong(&xl->working_buffer[48]);
                     off = 52;
                     uni_type = 2;
                 }
                 else
                 {   /* Ascii format */
-                    len = getLong(&working_buffer[50]);
+                    len = getLong(&xl->working_buffer[50]);
                     off = 54;
                     uni_type = 0;
                 }
-                if (len > (U32)(bufidx - off))
+                if (len > (U32)(last - off))
                 {   /* correct misidentified links */
                     if (uni_type == 0)
                     {
                         off = 36;
                         uni_type = 2;
-                        len = getLong(&working_buffer[32]) * 2;
+                        len = getLong(&xl->working_buffer[32]) * 2;
                     }
                     else
-                        len = bufidx - off; /* safety measure to make sure it doen't blow up */
+                        len = last - off; /* safety measure to make sure it doen't blow up */
                 }
-                update_cell_hyperlink(r, c, &working_buffer[off], len, uni_type);
+                update_cell_hyperlink(xl, r, c, &xl->working_buffer[off], len, uni_type);
             }
             break;
         case 0x92:  /* Color Palette */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
             {   /* This is based on Office 97 info... */
                 int i;
                 U8 red, green, blue;
-                U16 cnt = getShort(&working_buffer[0]);
-                numCustomColors = cnt;
-                customColors = (U8 **)calloc(cnt+1,  sizeof(char *));
+                U16 cnt = getShort(&xl->working_buffer[0]);
+                xl->numCustomColors = cnt;
+                xl->customColors = (U8 **)calloc(cnt+1,  sizeof(char *));
                 for (i=0; i<cnt; i++)
                 {
                     char color_string[8];
-                    red = (unsigned char)working_buffer[(4*i)+2];
-                    green = (unsigned char)working_buffer[(4*i)+3];
-                    blue = (unsigned char)working_buffer[(4*i)+4];
+                    red = (unsigned char)xl->working_buffer[(4*i)+2];
+                    green = (unsigned char)xl->working_buffer[(4*i)+3];
+                    blue = (unsigned char)xl->working_buffer[(4*i)+4];
                     /* printf("%02X%02X%02X\n", (int)red, (int)green, (int)blue); */
                     sprintf(color_string, "%02X%02X%02X", (int)red, (int)green, (int)blue);
-                    customColors[i] = (U8 *)strdup(color_string);
+                    xl->customColors[i] = (U8 *)strdup(color_string);
                 }
             }
             break;
         case 0x42:  /* CodePage */
-            working_buffer[bufidx++] = data;
-            if (bufidx == last)
             {
-                CodePage = getShort(&working_buffer[0]);
-                if (CodePage == 1200)
-                    CodePage = 0;   /* Unicode inside, old behavior is OK */
+                xl->CodePage = getShort(&xl->working_buffer[0]);
+                if (xl->CodePage == 1200)
+                    xl->CodePage = 0;   /* Unicode inside, old behavior is OK */
             }
             break;
         default:
@@ -1875,30 +2023,23 @@ void main_line_processor(U16 opcode, U16 version, U32 count, U16 last, U8 data)
 
 
 /*! returns 1 on error, 0 on success */
-int ws_init(int i)
+int ws_init(xlhtml_ctx *xl, int i)
 {
-    U32 j;
-    U16 k;
-    if (i >= (int)max_worksheets)
+    if (i >= (int)xl->max_worksheets)
         return 1;
 
-    ws_array[i] = (work_sheet *)malloc(sizeof(work_sheet));
-    if (ws_array[i])
-    {
-        ws_array[i]->spanned = 0;
-        ws_array[i]->first_row = 0;
-        ws_array[i]->biggest_row = -1;
-        ws_array[i]->max_rows = ROWS_INCR;
-        ws_array[i]->first_col = 0;
-        ws_array[i]->biggest_col = -1;
-        ws_array[i]->max_cols = COLS_INCR;
-        uni_string_clear(&ws_array[i]->ws_title);
-        ws_array[i]->c_array = (cell **)malloc(ROWS_INCR*COLS_INCR*sizeof(cell *));
-        if (ws_array[i]->c_array == 0)
-            return 1;
-        for (j=0; j<ROWS_INCR; j++)
-            for (k=0; k<COLS_INCR; k++)
-                ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k] = 0;
+    xl->ws_array[i] = (work_sheet *)malloc(sizeof(work_sheet));
+    if (xl->ws_array[i])
+    {
+        xl->ws_array[i]->spanned = 0;
+        xl->ws_array[i]->first_row = 0;
+        xl->ws_array[i]->biggest_row = -1;
+        xl->ws_array[i]->first_col = 0;
+        xl->ws_array[i]->biggest_col = -1;
+        uni_string_clear(&xl->ws_array[i]->ws_title);
+        xl->ws_array[i]->rows = 0;      /* Allocated when the first cell arrives */
+        xl->ws_array[i]->row_cnt = 0;
+        xl->ws_array[i]->row_size = 0;
     }
     else
         return 1;
@@ -1906,390 +2047,515 @@ int ws_init(int i)
     return 0;
 }
 
-/*! returns 1 on error, 0 on success */
-int add_more_worksheet_ptrs(void)
+/*! Finds the index of row r, or where it would go.
+    returns 1 if the row is there, 0 if not */
+static int ws_find_row(work_sheet *ws, U32 r, U32 *idx)
 {
-    work_sheet **tws_array;
-    int pages;
+    U32 lo = 0, hi = ws->row_cnt;
 
-    if (MaxWorksheetsExceeded)
-        return 1;
+    /* Biff stores cells in row order, so check the end first */
+    if ((hi == 0)||(ws->rows[hi-1].row < r))
+    {
+        *idx = hi;
+        return 0;
+    }
+    while (lo < hi)
+    {
+        U32 mid = (lo + hi) >> 1;
+        if (ws->rows[mid].row < r)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *idx = lo;
+    return (ws->rows[lo].row == r);
+}
 
-    if (sheet_count > (int)max_worksheets)
-        pages = (((sheet_count - max_worksheets)/WORKSHEETS_INCR) + 1) * WORKSHEETS_INCR;
-    else
-        pages = WORKSHEETS_INCR;
-    tws_array = (work_sheet **)realloc(ws_array,
-                (max_worksheets + pages) * sizeof(work_sheet *));
+/*! Finds the index of column c in the row, or where it would go.
+    returns 1 if the cell is there, 0 if not */
+static int row_find_col(row_entry *re, U16 c, U16 *idx)
+{
+    U16 lo = 0, hi = re->cnt;
 
-    if (tws_array == NULL)
+    if ((hi == 0)||(re->cols[hi-1].col < c))
     {
-        MaxWorksheetsExceeded = 1;
-        return 1;
+        *idx = hi;
+        return 0;
+    }
+    while (lo < hi)
+    {
+        U16 mid = (U16)((lo + hi) >> 1);
+        if (re->cols[mid].col < c)
+            lo = (U16)(mid + 1);
+        else
+            hi = mid;
+    }
+    *idx = lo;
+    return (re->cols[lo].col == c);
+}
+
+/*! returns the populated cells of row r, or 0 if it has none */
+row_entry *ws_get_row(work_sheet *ws, U32 r)
+{
+    U32 i;
+
+    if ((ws == 0)||(ws_find_row(ws, r, &i) == 0))
+        return 0;
+    return &ws->rows[i];
+}
+
+/*! returns the cell at r, c or 0 if it is empty */
+cell *ws_get_cell(work_sheet *ws, U32 r, U16 c)
+{
+    row_entry *re = ws_get_row(ws, r);
+    U16 i;
+
+    if ((re == 0)||(row_find_col(re, c, &i) == 0))
+        return 0;
+    return re->cols[i].c;
+}
+
+/*! Walks a row in column order. *idx starts at 0 and is advanced past
+    the columns before c, so calls must be made with ascending c.
+    returns the cell at column c or 0 if it is empty */
+cell *row_next_cell(row_entry *re, U16 c, U16 *idx)
+{
+    if (re == 0)
+        return 0;
+    while ((*idx < re->cnt)&&(re->cols[*idx].col < c))
+        (*idx)++;
+    if ((*idx < re->cnt)&&(re->cols[*idx].col == c))
+        return re->cols[*idx].c;
+    return 0;
+}
+
+/*! returns 1 if r, c is inside the part of the sheet being output */
+static int ws_in_view(work_sheet *ws, U32 r, U16 c)
+{
+    return ((r >= ws->first_row)&&((S32)r <= ws->biggest_row)&&
+            (c >= ws->first_col)&&((S16)c <= ws->biggest_col));
+}
+
+/*! Finds the slot for the cell at r, c creating it if needed. The slot holds
+    0 if the cell is new. It is only good until the next cell is added.
+    returns 0 if out of memory */
+cell **ws_add_cell(xlhtml_ctx *xl, work_sheet *ws, U32 r, U16 c)
+{
+    row_entry *re;
+    U32 ri;
+    U16 ci;
+
+    if (ws_find_row(ws, r, &ri) == 0)
+    {   /* New row... */
+        if (xl->MaxRowExceeded)
+            return 0;
+        if (ws->row_cnt == ws->row_size)
+        {
+            U32 size = ws->row_size ? ws->row_size << 1 : ROWS_INCR;
+            row_entry *trows = (row_entry *)realloc(ws->rows, size * sizeof(row_entry));
+            if (trows == 0)
+            {
+                xl->MaxRowExceeded = 1;
+                return 0;
+            }
+            ws->rows = trows;
+            ws->row_size = size;
+        }
+        if (ri < ws->row_cnt)
+            memmove(&ws->rows[ri+1], &ws->rows[ri], (ws->row_cnt - ri) * sizeof(row_entry));
+        ws->row_cnt++;
+        re = &ws->rows[ri];
+        re->row = r;
+        re->cnt = 0;
+        re->size = 0;
+        re->cols = 0;
     }
     else
-    {   /* Next init the array... */
-        unsigned int i;
+        re = &ws->rows[ri];
+
+    if (row_find_col(re, c, &ci) == 0)
+    {   /* New cell... */
+        if (xl->MaxColExceeded)
+            return 0;
+        if (re->cnt == re->size)
+        {
+            U16 size = re->size ? (U16)(re->size << 1) : COLS_INCR;
+            col_entry *tcols;
 
-        ws_array = tws_array;
+            if (size > HARD_MAX_COLS + 1)
+                size = HARD_MAX_COLS + 1;
+            tcols = (col_entry *)realloc(re->cols, size * sizeof(col_entry));
+            if (tcols == 0)
+            {
+                xl->MaxColExceeded = 1;
+                return 0;
+            }
+            re->cols = tcols;
+            re->size = size;
+        }
+        if (ci < re->cnt)
+            memmove(&re->cols[ci+1], &re->cols[ci], (re->cnt - ci) * sizeof(col_entry));
+        re->cnt++;
+        re->cols[ci].col = c;
+        re->cols[ci].c = 0;
+    }
+    return &re->cols[ci].c;
+}
 
-        for (i=max_worksheets; i<max_worksheets+pages; i++)
-            ws_array[i] = 0;
+/*! Frees all the cells of a worksheet */
+void ws_free_cells(work_sheet *ws)
+{
+    U32 i;
+    U16 j;
 
-        max_worksheets += pages;
-        last_sheet = max_worksheets - 1;
+    for (i=0; i<ws->row_cnt; i++)
+    {
+        for (j=0; j<ws->rows[i].cnt; j++)
+        {
+            cell *c = ws->rows[i].cols[j].c;
+            if (c)
+            {
+                if (c->ustr.str)
+                    free(c->ustr.str);
+                if (c->ustr.fmt_run)
+                    free(c->ustr.fmt_run);
+                if (c->h_link.str)
+                    free(c->h_link.str);
+                free(c);
+            }
+        }
+        free(ws->rows[i].cols);
     }
-    return 0;
+    free(ws->rows);
+    ws->rows = 0;
+    ws->row_cnt = 0;
+    ws->row_size = 0;
 }
 
-int resize_c_array(work_sheet *ws, U32 new_rows, U16 new_cols)
+/*! returns 1 on error, 0 on success */
+int add_more_worksheet_ptrs(xlhtml_ctx *xl)
 {
-    cell **tc_array;
-    if (ws == 0)
-        return 1;
-    if (ws->c_array == 0)
+    work_sheet **tws_array;
+    int pages;
+
+    if (xl->MaxWorksheetsExceeded)
         return 1;
 
-	
-	if((ws->max_rows+new_rows)*(ws->max_cols+new_cols)*sizeof(cell *) > MAX_ARRAY_MEM)
-	{
-		return 1;
-	}
-    tc_array = (cell **)malloc((ws->max_rows+new_rows)*(ws->max_cols+new_cols)*sizeof(cell *));
+    if (xl->sheet_count > (int)xl->max_worksheets)
+        pages = (((xl->sheet_count - xl->max_worksheets)/WORKSHEETS_INCR) + 1) * WORKSHEETS_INCR;
+    else
+        pages = WORKSHEETS_INCR;
+    tws_array = (work_sheet **)realloc(xl->ws_array,
+                (xl->max_worksheets + pages) * sizeof(work_sheet *));
 
-    if (tc_array == NULL)
+    if (tws_array == NULL)
+    {
+        xl->MaxWorksheetsExceeded = 1;
         return 1;
+    }
     else
-    {
-        U32 j;
-        U16 k;
+    {   /* Next init the array... */
+        unsigned int i;
 
-        memset(tc_array, 0, (ws->max_rows+new_rows)*(ws->max_cols+new_cols)*sizeof(cell *));
-        for (j=0; j<(ws->max_rows); j++)
-        {
-            for (k=0; k<ws->max_cols; k++)
-                tc_array[(j*(ws->max_cols+new_cols))+k] = ws->c_array[(j*ws->max_cols)+k];
-        }
-        ws->max_cols += new_cols;
-        ws->max_rows += new_rows;
-        free(ws->c_array);
-        ws->c_array = tc_array;
+        xl->ws_array = tws_array;
+
+        for (i=xl->max_worksheets; i<xl->max_worksheets+pages; i++)
+            xl->ws_array[i] = 0;
+
+        xl->max_worksheets += pages;
+        xl->last_sheet = xl->max_worksheets - 1;
     }
     return 0;
 }
 
-void add_wb_array(U16 r, U16 c, U16 xf, U16 type, U8 uni,
+void add_wb_array(xlhtml_ctx *xl, U16 r, U16 c, U16 xf, U16 type, U8 uni,
                     U8 *str, U16 len, U16 crun_cnt, U8 *fmt_run)
 {
     work_sheet *ws;
+    cell **slot;
 
-    if ((sheet_count < 0)||(r > HARD_MAX_ROWS)||(c > HARD_MAX_COLS))
+    if ((xl->sheet_count < 0)||(r > xl->hard_max_rows)||(c > HARD_MAX_COLS))
         return;
-    if (sheet_count >= (int)max_worksheets)
-    {
-        if (add_more_worksheet_ptrs())
-            return;
-    }
-    if (ws_array[sheet_count] == 0)
+    if (xl->StreamText)
     {
-        if (ws_init(sheet_count))
-            return;
+        stream_cell(xl, r, xf, type, uni, str, len);
+        return;
     }
-    ws = ws_array[sheet_count];
-    if (r >= ws->max_rows)
+    if (xl->sheet_count >= (int)xl->max_worksheets)
     {
-        if (MaxRowExceeded)
+        if (add_more_worksheet_ptrs(xl))
             return;
-        else
-        {
-            int diff = ((r-ws->max_rows)/ROWS_INCR)+1;
-            if(resize_c_array(ws, ROWS_INCR*diff, 0))
-            {
-                MaxRowExceeded = 1;
-                return;
-            }
-        }
     }
-    if (c >= ws->max_cols)
+    if (xl->ws_array[xl->sheet_count] == 0)
     {
-        if (MaxColExceeded)
+        if (ws_init(xl, xl->sheet_count))
             return;
-        else
-        {
-            U16 diff = (U16)(((c-ws->max_cols)/COLS_INCR)+1);
-            if(resize_c_array(ws, 0, (U16)(COLS_INCR*diff)))
-            {
-                MaxColExceeded = 1;
-                return;
-            }
-        }
     }
-    if (ws->c_array[(r*ws->max_cols)+c] == 0)
+    ws = xl->ws_array[xl->sheet_count];
+    slot = ws_add_cell(xl, ws, r, c);
+    if (slot == 0)
+        return;
+    if (*slot == 0)
     {
-        if (r > ws_array[sheet_count]->biggest_row)
-            ws_array[sheet_count]->biggest_row = r;
-        if (c > ws_array[sheet_count]->biggest_col)
-            ws_array[sheet_count]->biggest_col = c;
-        ws->c_array[(r*ws->max_cols)+c] = (cell *)malloc(sizeof(cell));
-        if (ws->c_array[(r*ws->max_cols)+c])
+        if (r > xl->ws_array[xl->sheet_count]->biggest_row)
+            xl->ws_array[xl->sheet_count]->biggest_row = r;
+        if (c > xl->ws_array[xl->sheet_count]->biggest_col)
+            xl->ws_array[xl->sheet_count]->biggest_col = c;
+        (*slot) = (cell *)malloc(sizeof(cell));
+        if ((*slot))
         {
             if (str)
             {
-                ws->c_array[(r*ws->max_cols)+c]->ustr.str = (U8 *)malloc(len+1);
-                if (ws->c_array[(r*ws->max_cols)+c]->ustr.str)
+                (*slot)->ustr.str = (U8 *)malloc(len+1);
+                if ((*slot)->ustr.str)
                 {
-                    memcpy(ws->c_array[(r*ws->max_cols)+c]->ustr.str, str, len);
-                    ws->c_array[(r*ws->max_cols)+c]->ustr.str[len] = 0;
+                    memcpy((*slot)->ustr.str, str, len);
+                    (*slot)->ustr.str[len] = 0;
                 }
-                ws->c_array[(r*ws->max_cols)+c]->ustr.uni = uni;
-                ws->c_array[(r*ws->max_cols)+c]->ustr.len = len;
+                (*slot)->ustr.uni = uni;
+                (*slot)->ustr.len = len;
                 if (fmt_run && crun_cnt)
                 {
                     int rlen = crun_cnt*4;
 
-                    ws->c_array[(r*ws->max_cols)+c]->ustr.fmt_run = malloc(rlen);
-                    if (ws->c_array[(r*ws->max_cols)+c]->ustr.fmt_run)
+                    (*slot)->ustr.fmt_run = malloc(rlen);
+                    if ((*slot)->ustr.fmt_run)
                     {
-                        memcpy(ws->c_array[(r*ws->max_cols)+c]->ustr.fmt_run, fmt_run, rlen);
-                        ws->c_array[(r*ws->max_cols)+c]->ustr.crun_cnt = crun_cnt;
+                        memcpy((*slot)->ustr.fmt_run, fmt_run, rlen);
+                        (*slot)->ustr.crun_cnt = crun_cnt;
                     }
                     else
-                        ws->c_array[(r*ws->max_cols)+c]->ustr.crun_cnt = 0;
+                        (*slot)->ustr.crun_cnt = 0;
                 }
                 else
                 {
-                    ws->c_array[(r*ws->max_cols)+c]->ustr.fmt_run = 0;
-                    ws->c_array[(r*ws->max_cols)+c]->ustr.crun_cnt = 0;
+                    (*slot)->ustr.fmt_run = 0;
+                    (*slot)->ustr.crun_cnt = 0;
                 }
             }
             else
-                uni_string_clear(&ws->c_array[(r*ws->max_cols)+c]->ustr);
-
-            ws->c_array[(r*ws->max_cols)+c]->xfmt = xf;
-            ws->c_array[(r*ws->max_cols)+c]->type = type;
-            ws->c_array[(r*ws->max_cols)+c]->spanned = 0;
-            ws->c_array[(r*ws->max_cols)+c]->rowspan = 0;
-            ws->c_array[(r*ws->max_cols)+c]->colspan = 0;
-            uni_string_clear(&ws->c_array[(r*ws->max_cols)+c]->h_link);
+                uni_string_clear(&(*slot)->ustr);
+
+            (*slot)->xfmt = xf;
+            (*slot)->type = type;
+            (*slot)->spanned = 0;
+            (*slot)->rowspan = 0;
+            (*slot)->colspan = 0;
+            uni_string_clear(&(*slot)->h_link);
         }
     }
     else    /* Default attributes already copied */
     {
-        if (r > ws_array[sheet_count]->biggest_row)
-            ws_array[sheet_count]->biggest_row = r;
-        if (c > ws_array[sheet_count]->biggest_col)
-            ws_array[sheet_count]->biggest_col = c;
+        if (r > xl->ws_array[xl->sheet_count]->biggest_row)
+            xl->ws_array[xl->sheet_count]->biggest_row = r;
+        if (c > xl->ws_array[xl->sheet_count]->biggest_col)
+            xl->ws_array[xl->sheet_count]->biggest_col = c;
         if (str)
         {   /* Check if a place holder is there and free it */
-            if (ws->c_array[(r*ws->max_cols)+c]->ustr.str != 0)
-                free(ws->c_array[(r*ws->max_cols)+c]->ustr.str);
+            if ((*slot)->ustr.str != 0)
+                free((*slot)->ustr.str);
 
-            ws->c_array[(r*ws->max_cols)+c]->ustr.str = (U8 *)malloc(len+1);
-            if (ws->c_array[(r*ws->max_cols)+c]->ustr.str)
+            (*slot)->ustr.str = (U8 *)malloc(len+1);
+            if ((*slot)->ustr.str)
             {
-                memcpy(ws->c_array[(r*ws->max_cols)+c]->ustr.str, str, len);
-                ws->c_array[(r*ws->max_cols)+c]->ustr.str[len] = 0;
+                memcpy((*slot)->ustr.str, str, len);
+                (*slot)->ustr.str[len] = 0;
             }
-            ws->c_array[(r*ws->max_cols)+c]->ustr.len = len;
-            ws->c_array[(r*ws->max_cols)+c]->ustr.uni = uni;
+            (*slot)->ustr.len = len;
+            (*slot)->ustr.uni = uni;
             if (fmt_run && crun_cnt)
             {
                 int rlen = crun_cnt*4;
 
-                ws->c_array[(r*ws->max_cols)+c]->ustr.fmt_run = malloc(rlen);
-                if (ws->c_array[(r*ws->max_cols)+c]->ustr.fmt_run)
+                (*slot)->ustr.fmt_run = malloc(rlen);
+                if ((*slot)->ustr.fmt_run)
                 {
-                    memcpy(ws->c_array[(r*ws->max_cols)+c]->ustr.fmt_run, fmt_run, rlen);
-                    ws->c_array[(r*ws->max_cols)+c]->ustr.crun_cnt = crun_cnt;
+                    memcpy((*slot)->ustr.fmt_run, fmt_run, rlen);
+                    (*slot)->ustr.crun_cnt = crun_cnt;
                 }
                 else
-                    ws->c_array[(r*ws->max_cols)+c]->ustr.crun_cnt = 0;
+                    (*slot)->ustr.crun_cnt = 0;
             }
             else
             {
-                ws->c_array[(r*ws->max_cols)+c]->ustr.fmt_run = 0;
-                ws->c_array[(r*ws->max_cols)+c]->ustr.crun_cnt = 0;
+                (*slot)->ustr.fmt_run = 0;
+                (*slot)->ustr.crun_cnt = 0;
             }
         }
         else
         {
-            if (ws->c_array[(r*ws->max_cols)+c]->ustr.str == 0)
+            if ((*slot)->ustr.str == 0)
             {
-                ws->c_array[(r*ws->max_cols)+c]->ustr.len = 0;
-                ws->c_array[(r*ws->max_cols)+c]->ustr.uni = 0;
-                ws->c_array[(r*ws->max_cols)+c]->ustr.fmt_run = 0;
-                ws->c_array[(r*ws->max_cols)+c]->ustr.crun_cnt = 0;
+                (*slot)->ustr.len = 0;
+                (*slot)->ustr.uni = 0;
+                (*slot)->ustr.fmt_run = 0;
+                (*slot)->ustr.crun_cnt = 0;
             }
         }
-        ws->c_array[(r*ws->max_cols)+c]->xfmt = xf;
-        ws->c_array[(r*ws->max_cols)+c]->type = type;
-        ws->c_array[(r*ws->max_cols)+c]->spanned = 0;
-        ws->c_array[(r*ws->max_cols)+c]->rowspan = 0;
-        ws->c_array[(r*ws->max_cols)+c]->colspan = 0;
+        (*slot)->xfmt = xf;
+        (*slot)->type = type;
+        (*slot)->spanned = 0;
+        (*slot)->rowspan = 0;
+        (*slot)->colspan = 0;
     }
 }
 
-void update_cell_xf(U16 r, U16 c, U16 xf)
+/*! Writes the text of a cell as soon as its record is parsed (-st).
+    Nothing is stored, so memory is bounded by the string table rather
+    than the sheets. Cells are tab separated, a new row starts a new
+    line and a new worksheet is preceded by a blank line. Blank cells
+    are skipped. */
+void stream_cell(xlhtml_ctx *xl, U16 r, U16 xf, U16 type, U8 uni, U8 *str, U16 len)
 {
-    work_sheet *ws;
+    cell c;
 
-    if ((sheet_count < 0)||(r > HARD_MAX_ROWS)||(c > HARD_MAX_COLS))
+    if ((str == 0)||(len == 0))
         return;
-    if (sheet_count >= (int)max_worksheets)
+    if (xl->sheet_count != xl->stream_sheet)
     {
-        if (add_more_worksheet_ptrs())
-            return;
+        if (xl->stream_sheet >= 0)
+            xl_printf(xl, "\n\n");
+        xl->stream_sheet = xl->sheet_count;
+        xl->stream_row = r;
     }
-    if (ws_array[sheet_count] == 0)
+    else if (r != xl->stream_row)
     {
-        if (ws_init(sheet_count))
-            return;
+        xl_putc(xl, 0x0A);
+        xl->stream_row = r;
     }
-    if (r >= ws_array[sheet_count]->max_rows)
+    else
+        xl_putc(xl, '\t');
+
+    c.xfmt = xf;
+    c.type = type;
+    c.ustr.uni = uni;
+    c.ustr.str = str;
+    c.ustr.len = len;
+    c.ustr.fmt_run = 0;
+    c.ustr.crun_cnt = 0;
+    if (IsCellSafe(xl, &c))
+        output_formatted_data(xl, &c.ustr, xl->xf_array[xf]->fmt_idx, IsCellNumeric(&c), IsCellFormula(&c));
+    else
+        OutputString(xl, &c.ustr);
+}
+
+/*! Terminates the last line written by stream_cell */
+void stream_end(xlhtml_ctx *xl)
+{
+    if (xl->stream_sheet >= 0)
+        xl_putc(xl, 0x0A);
+    xl->stream_sheet = -1;
+}
+
+void update_cell_xf(xlhtml_ctx *xl, U16 r, U16 c, U16 xf)
+{
+    work_sheet *ws;
+    cell **slot;
+
+    if ((xl->sheet_count < 0)||(r > xl->hard_max_rows)||(c > HARD_MAX_COLS)||xl->StreamText)
+        return;
+    if (xl->sheet_count >= (int)xl->max_worksheets)
     {
-        if (MaxRowExceeded)
+        if (add_more_worksheet_ptrs(xl))
             return;
-        else
-        {
-            int diff = ((r-ws_array[sheet_count]->max_rows)/ROWS_INCR)+1;
-            if(resize_c_array(ws_array[sheet_count], ROWS_INCR*diff, 0))
-            {
-                MaxRowExceeded = 1;
-                return;
-            }
-        }
     }
-    if (c >= ws_array[sheet_count]->max_cols)
+    if (xl->ws_array[xl->sheet_count] == 0)
     {
-        if (MaxColExceeded)
+        if (ws_init(xl, xl->sheet_count))
             return;
-        else
-        {
-            int diff = ((c-ws_array[sheet_count]->max_cols)/COLS_INCR)+1;
-            if (resize_c_array(ws_array[sheet_count], 0, (U16)(COLS_INCR*diff)))
-            {
-                MaxColExceeded = 1;
-                return;
-            }
-        }
     }
 
-    ws = ws_array[sheet_count];
-    if (ws->c_array[(r*ws->max_cols)+c] == 0)
+    ws = xl->ws_array[xl->sheet_count];
+    slot = ws_add_cell(xl, ws, r, c);
+    if (slot == 0)
+        return;
+    if (*slot == 0)
     {
-        ws->c_array[(r*ws->max_cols)+c] = (cell *)malloc(sizeof(cell));
-        if (ws->c_array[(r*ws->max_cols)+c])
+        (*slot) = (cell *)malloc(sizeof(cell));
+        if ((*slot))
         {
-            uni_string_clear(&ws->c_array[(r*ws->max_cols)+c]->ustr);
-            ws->c_array[(r*ws->max_cols)+c]->xfmt = xf;
-            ws->c_array[(r*ws->max_cols)+c]->type = 1;  /* This is the Blank Cell type */
-
-            if (r > ws_array[sheet_count]->biggest_row)
-                ws_array[sheet_count]->biggest_row = r;
-            if (c > ws_array[sheet_count]->biggest_col)
-                ws_array[sheet_count]->biggest_col = c;
-            ws->c_array[(r*ws->max_cols)+c]->spanned = 0;
-            ws->c_array[(r*ws->max_cols)+c]->rowspan = 0;
-            ws->c_array[(r*ws->max_cols)+c]->colspan = 0;
-            uni_string_clear(&ws->c_array[(r*ws->max_cols)+c]->h_link);
+            uni_string_clear(&(*slot)->ustr);
+            (*slot)->xfmt = xf;
+            (*slot)->type = 1;  /* This is the Blank Cell type */
+
+            if (r > xl->ws_array[xl->sheet_count]->biggest_row)
+                xl->ws_array[xl->sheet_count]->biggest_row = r;
+            if (c > xl->ws_array[xl->sheet_count]->biggest_col)
+                xl->ws_array[xl->sheet_count]->biggest_col = c;
+            (*slot)->spanned = 0;
+            (*slot)->rowspan = 0;
+            (*slot)->colspan = 0;
+            uni_string_clear(&(*slot)->h_link);
         }
     }
 /*  else
     {
         printf("R:%02X C:%02X XF:%02X is:%02X\n",
-            r, c, xf, ws->c_array[r][c]->xfmt);
+            r, c, xf, (*slot)->xfmt);
     } */
 }
 
-void update_cell_hyperlink(U16 r, U16 c, U8 *hyperlink, int len, U16 uni)
+void update_cell_hyperlink(xlhtml_ctx *xl, U16 r, U16 c, U8 *hyperlink, int len, U16 uni)
 {
-    work_sheet *ws;
+    cell *ce;
 
-    if (sheet_count < 0)    /* Used to do a "0 <" check on r & c */
+    if (xl->sheet_count < 0)    /* Used to do a "0 <" check on r & c */
         return;
-    if (sheet_count >= (int)max_worksheets)
+    if (xl->sheet_count >= (int)xl->max_worksheets)
     {
-        if (add_more_worksheet_ptrs())
+        if (add_more_worksheet_ptrs(xl))
             return;
     }
-    if (ws_array[sheet_count] == 0)
-    {
-        if (ws_init(sheet_count))
-            return;
-    }
-    if (r >= ws_array[sheet_count]->max_rows)
-    {
-        if (MaxRowExceeded)
-            return;
-        else
-        {
-            int diff = ((r-ws_array[sheet_count]->max_rows)/ROWS_INCR)+1;
-            if(resize_c_array(ws_array[sheet_count], ROWS_INCR*diff, 0))
-            {
-                MaxRowExceeded = 1;
-                return;
-            }
-        }
-    }
-    if (c >= ws_array[sheet_count]->max_cols)
+    if (xl->ws_array[xl->sheet_count] == 0)
     {
-        if (MaxColExceeded)
+        if (ws_init(xl, xl->sheet_count))
             return;
-        else
-        {
-            int diff = ((c-ws_array[sheet_count]->max_cols)/COLS_INCR)+1;
-            if(resize_c_array(ws_array[sheet_count], 0, (U16)(COLS_INCR*diff)))
-            {
-                MaxColExceeded = 1;
-                return;
-            }
-        }
     }
 
-    ws = ws_array[sheet_count];
-    if (ws->c_array[(r*ws->max_cols)+c] == 0)
+    ce = ws_get_cell(xl->ws_array[xl->sheet_count], r, c);
+    if (ce == 0)
     {   /* should not get here, but just in case */
         return;
     }
-    if (ws->c_array[(r*ws->max_cols)+c]->h_link.str == 0)
+    if (ce->h_link.str == 0)
     {
-        ws->c_array[(r*ws->max_cols)+c]->h_link.str = (U8 *)malloc(len);
-        if (ws->c_array[(r*ws->max_cols)+c]->h_link.str)
-            memcpy(ws->c_array[(r*ws->max_cols)+c]->h_link.str, hyperlink, len);
-        ws->c_array[(r*ws->max_cols)+c]->h_link.uni = uni;
+        ce->h_link.str = (U8 *)malloc(len);
+        if (ce->h_link.str)
+            memcpy(ce->h_link.str, hyperlink, len);
+        ce->h_link.uni = uni;
         if (len)
         {
             if (uni < 2)
-                ws->c_array[(r*ws->max_cols)+c]->h_link.len = (U16)(len-1);
+                ce->h_link.len = (U16)(len-1);
             else
-                ws->c_array[(r*ws->max_cols)+c]->h_link.len = (U16)(len-2);
+                ce->h_link.len = (U16)(len-2);
         }
     }
 /*  else
     {
         printf("R:%02X C:%02X XF:%02X is:%s\n",
-            r, c, xf, ws->c_array[r][c]->h_link.str);
+            r, c, xf, ce->h_link.str);
     } */
 }
 
-void add_str_array(U8 uni, U8 *str, U16 len, U8 *fmt_run, U8 crun_cnt)
+void add_str_array(xlhtml_ctx *xl, U8 uni, U8 *str, U16 len, U8 *fmt_run, U8 crun_cnt)
 {
 
     if ((str == 0)||(len == 0))
     {
-        next_string++; /* increment for empty strings, too */
+        xl->next_string++; /* increment for empty strings, too */
         return;
     }
-    if (next_string >= max_strings)
+    if (xl->next_string >= xl->max_strings)
     {
         uni_string **tstr_array;
-        size_t new_size = (max_strings + STRINGS_INCR) * sizeof(uni_string *);
+        size_t new_size = (xl->max_strings + STRINGS_INCR) * sizeof(uni_string *);
 
-        tstr_array = (uni_string **)realloc(str_array, new_size);
+        tstr_array = (uni_string **)realloc(xl->str_array, new_size);
 
         if (tstr_array == NULL)
         {
-            MaxStringsExceeded = 1;
+            xl->MaxStringsExceeded = 1;
 /*          fprintf(stderr, "%s: cannot allocate %d bytes for string storage %d: %s",
                 PRGNAME, new_size, errno, strerror(errno)); */
             return;
@@ -2298,202 +2564,202 @@ void add_str_array(U8 uni, U8 *str, U16 len, U8 *fmt_run, U8 crun_cnt)
         {
             unsigned long i;
 
-            str_array = tstr_array;
+            xl->str_array = tstr_array;
 
             /* Clear the new string slots */
-            for (i=max_strings; i<(max_strings + STRINGS_INCR); i++)
-                str_array[i] = 0;
+            for (i=xl->max_strings; i<(xl->max_strings + STRINGS_INCR); i++)
+                xl->str_array[i] = 0;
             
-            max_strings += STRINGS_INCR;
+            xl->max_strings += STRINGS_INCR;
         }
     }
     
-    if (str_array[next_string] == 0)
+    if (xl->str_array[xl->next_string] == 0)
     {
-        str_array[next_string] = (uni_string *)malloc(sizeof(uni_string));
-        if (str_array[next_string])
+        xl->str_array[xl->next_string] = (uni_string *)malloc(sizeof(uni_string));
+        if (xl->str_array[xl->next_string])
         {
-            str_array[next_string]->str = (U8 *)malloc(len+1);
-            if (str_array[next_string]->str)
+            xl->str_array[xl->next_string]->str = (U8 *)malloc(len+1);
+            if (xl->str_array[xl->next_string]->str)
             {
-                memcpy(str_array[next_string]->str, str, len);
-                str_array[next_string]->str[len] = 0;
-                str_array[next_string]->len = len;
-                str_array[next_string]->uni = uni;
+                memcpy(xl->str_array[xl->next_string]->str, str, len);
+                xl->str_array[xl->next_string]->str[len] = 0;
+                xl->str_array[xl->next_string]->len = len;
+                xl->str_array[xl->next_string]->uni = uni;
                 if (fmt_run && crun_cnt)
                 {
                     int rlen = crun_cnt*4;
 
-                    str_array[next_string]->fmt_run = malloc(rlen);
-                    if (str_array[next_string]->fmt_run)
+                    xl->str_array[xl->next_string]->fmt_run = malloc(rlen);
+                    if (xl->str_array[xl->next_string]->fmt_run)
                     {
-                        memcpy(str_array[next_string]->fmt_run, fmt_run, rlen);
-                        str_array[next_string]->crun_cnt = crun_cnt;
+                        memcpy(xl->str_array[xl->next_string]->fmt_run, fmt_run, rlen);
+                        xl->str_array[xl->next_string]->crun_cnt = crun_cnt;
                     }
                     else
-                        str_array[next_string]->crun_cnt = 0;
+                        xl->str_array[xl->next_string]->crun_cnt = 0;
                 }
                 else
                 {
-                    str_array[next_string]->fmt_run = 0;
-                    str_array[next_string]->crun_cnt = 0;
+                    xl->str_array[xl->next_string]->fmt_run = 0;
+                    xl->str_array[xl->next_string]->crun_cnt = 0;
                 }
             }
         }
     }
-    next_string++;
+    xl->next_string++;
 }
 
-void add_font(U16 size, U16 attr, U16 c_idx, U16 bold, U16 super, U8 underline,
+void add_font(xlhtml_ctx *xl, U16 size, U16 attr, U16 c_idx, U16 bold, U16 super, U8 underline,
     U16 uni, U8 *n, U16 len)
 {
     if (n == 0)
         return;
-    if (next_font >= max_fonts)
+    if (xl->next_font >= xl->max_fonts)
     {
         font_attr **tfont_array;
         fnt_cnt *tf_cnt;
-        tfont_array = (font_attr **)realloc(font_array, (max_fonts * FONTS_INCR) * sizeof(font_attr *));
-        tf_cnt = (fnt_cnt *)realloc(f_cnt, (max_fonts * FONTS_INCR) * sizeof(fnt_cnt));
+        tfont_array = (font_attr **)realloc(xl->font_array, (xl->max_fonts * FONTS_INCR) * sizeof(font_attr *));
+        tf_cnt = (fnt_cnt *)realloc(xl->f_cnt, (xl->max_fonts * FONTS_INCR) * sizeof(fnt_cnt));
         
         if ((tf_cnt == NULL) || (tfont_array == NULL))
         {
-            MaxFontsExceeded = 1;
+            xl->MaxFontsExceeded = 1;
             return;
         }
         else
         {   /* Next init the array... */
             unsigned int i;
             
-            font_array = tfont_array;
-            f_cnt = tf_cnt;
+            xl->font_array = tfont_array;
+            xl->f_cnt = tf_cnt;
             
-            for (i=max_fonts; i<max_fonts+FONTS_INCR; i++)
+            for (i=xl->max_fonts; i<xl->max_fonts+FONTS_INCR; i++)
             {
-                font_array[i] = 0;
-                f_cnt[i].name = 0;
+                xl->font_array[i] = 0;
+                xl->f_cnt[i].name = 0;
             }
-            max_fonts += FONTS_INCR;
+            xl->max_fonts += FONTS_INCR;
         }
     }
 
-    if (font_array[next_font] == 0)
+    if (xl->font_array[xl->next_font] == 0)
     {
-        font_array[next_font] = (font_attr *)malloc(sizeof(font_attr));
-        if (font_array[next_font])
+        xl->font_array[xl->next_font] = (font_attr *)malloc(sizeof(font_attr));
+        if (xl->font_array[xl->next_font])
         {
-            font_array[next_font]->name.str = (U8 *)malloc(len+1);
-            if (font_array[next_font]->name.str)
-            {
-                font_array[next_font]->attr = attr;
-                font_array[next_font]->c_idx = c_idx;
-                font_array[next_font]->bold = bold;
-                font_array[next_font]->super = super;
-                font_array[next_font]->underline = underline;
-                font_array[next_font]->name.uni = uni;
-                memcpy(font_array[next_font]->name.str, n, len);
-                font_array[next_font]->name.str[len] = 0;   
-                font_array[next_font]->name.len = len;
-                font_array[next_font]->name.fmt_run = 0;
-                font_array[next_font]->name.crun_cnt = 0;
+            xl->font_array[xl->next_font]->name.str = (U8 *)malloc(len+1);
+            if (xl->font_array[xl->next_font]->name.str)
+            {
+                xl->font_array[xl->next_font]->attr = attr;
+                xl->font_array[xl->next_font]->c_idx = c_idx;
+                xl->font_array[xl->next_font]->bold = bold;
+                xl->font_array[xl->next_font]->super = super;
+                xl->font_array[xl->next_font]->underline = underline;
+                xl->font_array[xl->next_font]->name.uni = uni;
+                memcpy(xl->font_array[xl->next_font]->name.str, n, len);
+                xl->font_array[xl->next_font]->name.str[len] = 0;   
+                xl->font_array[xl->next_font]->name.len = len;
+                xl->font_array[xl->next_font]->name.fmt_run = 0;
+                xl->font_array[xl->next_font]->name.crun_cnt = 0;
 
                 /* We will "pre-digest" the font size.. */
                 if (size >= 0x02D0)     /* 36 pts */
-                    font_array[next_font]->size = 7;
+                    xl->font_array[xl->next_font]->size = 7;
                 else if (size >= 0x01E0)    /* 24 pts */
-                    font_array[next_font]->size = 6;
+                    xl->font_array[xl->next_font]->size = 6;
                 else if (size >= 0x0168)    /* 18 pts */
-                    font_array[next_font]->size = 5;
+                    xl->font_array[xl->next_font]->size = 5;
                 else if (size >= 0x00F0)    /* 12 pts */
-                    font_array[next_font]->size = 4;
+                    xl->font_array[xl->next_font]->size = 4;
                 else if (size >= 0x00C8)    /* 10 pts */
-                    font_array[next_font]->size = 3;
+                    xl->font_array[xl->next_font]->size = 3;
                 else if (size >= 0x00A0)    /* 8 pts */
-                    font_array[next_font]->size = 2;
+                    xl->font_array[xl->next_font]->size = 2;
                 else
-                    font_array[next_font]->size = 1;
+                    xl->font_array[xl->next_font]->size = 1;
             }
         }
     }
-    next_font++;
-    if (next_font == 4)     /* Per the doc's - number 4 doesn't exist. */
-        next_font++;
+    xl->next_font++;
+    if (xl->next_font == 4)     /* Per the doc's - number 4 doesn't exist. */
+        xl->next_font++;
 }
 
-void add_ws_title(U16 uni, U8 *n, U16 len)
+void add_ws_title(xlhtml_ctx *xl, U16 uni, U8 *n, U16 len)
 {
     if (n == 0)
         return;
 
-    if (next_ws_title >= max_worksheets)
+    if (xl->next_ws_title >= xl->max_worksheets)
     {
-        if (add_more_worksheet_ptrs())
+        if (add_more_worksheet_ptrs(xl))
             return;
     }
 
-    if (ws_array[next_ws_title] == 0)
+    if (xl->ws_array[xl->next_ws_title] == 0)
     {
-        if (ws_init(next_ws_title))
+        if (ws_init(xl, xl->next_ws_title))
             return;
     }
-    if (ws_array[next_ws_title]->ws_title.str == 0)
+    if (xl->ws_array[xl->next_ws_title]->ws_title.str == 0)
     {
-        ws_array[next_ws_title]->ws_title.str = (U8 *)malloc(len+1);
-        if (ws_array[next_ws_title]->ws_title.str)
+        xl->ws_array[xl->next_ws_title]->ws_title.str = (U8 *)malloc(len+1);
+        if (xl->ws_array[xl->next_ws_title]->ws_title.str)
         {
-            ws_array[next_ws_title]->ws_title.uni = uni;
-            memcpy(ws_array[next_ws_title]->ws_title.str, n, len);
-            ws_array[next_ws_title]->ws_title.str[len] = 0;
-            ws_array[next_ws_title]->ws_title.len = len;
-            ws_array[next_ws_title]->ws_title.crun_cnt = 0;
-            ws_array[next_ws_title]->ws_title.fmt_run = 0;
+            xl->ws_array[xl->next_ws_title]->ws_title.uni = uni;
+            memcpy(xl->ws_array[xl->next_ws_title]->ws_title.str, n, len);
+            xl->ws_array[xl->next_ws_title]->ws_title.str[len] = 0;
+            xl->ws_array[xl->next_ws_title]->ws_title.len = len;
+            xl->ws_array[xl->next_ws_title]->ws_title.crun_cnt = 0;
+            xl->ws_array[xl->next_ws_title]->ws_title.fmt_run = 0;
         }
     }
-    next_ws_title++;
+    xl->next_ws_title++;
 }
 
-void add_xf_array(U16 fnt_idx, U16 fmt_idx, U16 gen, U16 align,
+void add_xf_array(xlhtml_ctx *xl, U16 fnt_idx, U16 fmt_idx, U16 gen, U16 align,
     U16 indent, U16 b_style, U16 b_l_color, U32  b_t_color, U16 cell_color)
 {
-    if (next_xf >= max_xformats)
+    if (xl->next_xf >= xl->max_xformats)
     {
         xf_attr **txf_array;
         
-        txf_array = (xf_attr **)realloc(xf_array, (max_xformats + XFORMATS_INCR) * sizeof(xf_attr *));
+        txf_array = (xf_attr **)realloc(xl->xf_array, (xl->max_xformats + XFORMATS_INCR) * sizeof(xf_attr *));
         if (txf_array == NULL)
         {
-            MaxXFExceeded = 1;
+            xl->MaxXFExceeded = 1;
             return;
         }
         else
         {
             unsigned int i;
             
-            xf_array = txf_array;
+            xl->xf_array = txf_array;
             
-            for (i=max_xformats; i<(max_xformats + XFORMATS_INCR); i++)
-                xf_array[i] = 0;
+            for (i=xl->max_xformats; i<(xl->max_xformats + XFORMATS_INCR); i++)
+                xl->xf_array[i] = 0;
             
-            max_xformats += XFORMATS_INCR;
+            xl->max_xformats += XFORMATS_INCR;
         }
     }
 
-    if (xf_array[next_xf] == 0)
+    if (xl->xf_array[xl->next_xf] == 0)
     {
-        xf_array[next_xf] = (xf_attr *)malloc(sizeof(xf_attr));
-        if (xf_array[next_xf])
+        xl->xf_array[xl->next_xf] = (xf_attr *)malloc(sizeof(xf_attr));
+        if (xl->xf_array[xl->next_xf])
         {
-            xf_array[next_xf]->fnt_idx = fnt_idx;
-            xf_array[next_xf]->fmt_idx = fmt_idx;
-            xf_array[next_xf]->gen = gen;
-            xf_array[next_xf]->align = align;
-            xf_array[next_xf]->indent = indent;
-            xf_array[next_xf]->b_style = b_style;
-            xf_array[next_xf]->b_l_color = b_l_color;
-            xf_array[next_xf]->b_t_color = b_t_color;
-            xf_array[next_xf]->cell_color = cell_color;
+            xl->xf_array[xl->next_xf]->fnt_idx = fnt_idx;
+            xl->xf_array[xl->next_xf]->fmt_idx = fmt_idx;
+            xl->xf_array[xl->next_xf]->gen = gen;
+            xl->xf_array[xl->next_xf]->align = align;
+            xl->xf_array[xl->next_xf]->indent = indent;
+            xl->xf_array[xl->next_xf]->b_style = b_style;
+            xl->xf_array[xl->next_xf]->b_l_color = b_l_color;
+            xl->xf_array[xl->next_xf]->b_t_color = b_t_color;
+            xl->xf_array[xl->next_xf]->cell_color = cell_color;
         }
-        next_xf++;
+        xl->next_xf++;
     }
 }
 
@@ -2566,18 +2832,18 @@ int IsCellNumeric(cell *c)
 /*! \retval 0 not safe at all.
     \retval 1 extended format is OK
     \retval 2 Fonts OK */
-int IsCellSafe(cell *c)
+int IsCellSafe(xlhtml_ctx *xl, cell *c)
 {
     int safe = 0;
     
-    if (c->xfmt < next_xf)
+    if (c->xfmt < xl->next_xf)
     {
-        if (xf_array[c->xfmt])
+        if (xl->xf_array[c->xfmt])
         {
             safe = 1;
-            if (xf_array[c->xfmt]->fnt_idx < next_font)
+            if (xl->xf_array[c->xfmt]->fnt_idx < xl->next_font)
             {
-                if (font_array[xf_array[c->xfmt]->fnt_idx])
+                if (xl->font_array[xl->xf_array[c->xfmt]->fnt_idx])
                     safe = 2;
             }
         }
@@ -2593,12 +2859,12 @@ int IsCellFormula(cell *c)
         return 0;
 }
 
-void output_cell(cell *c, int xml)
+void output_cell(xlhtml_ctx *xl, cell *c, int xml)
 {
     html_attr h;
 
     if (c == NULL)
-        printf( xml ? "" : "<TD>&nbsp;");
+        xl_printf(xl, xml ? "" : "<TD>&nbsp;");
     else if (c->spanned != 0)
         return;
     else
@@ -2607,18 +2873,18 @@ void output_cell(cell *c, int xml)
         html_flag_init(&h);
         if (c->xfmt == 0)
         {   /* Unknown format... */
-            printf( xml ? "" : "<TD>");     /* This section doesn't use Unicode */
+            xl_printf(xl, xml ? "" : "<TD>");     /* This section doesn't use Unicode */
             if (c->ustr.str)
-                OutputString(&(c->ustr));
+                OutputString(xl, &(c->ustr));
             else
-                printf( xml ? "" : "&nbsp;");
+                xl_printf(xl, xml ? "" : "&nbsp;");
         }
         else
         {   /* This is the BIFF7 & 8 stuff... */
             int safe;
             int nullString = 1;
 
-            safe = IsCellSafe(c);
+            safe = IsCellSafe(xl, c);
 
             if (c->ustr.str)
             {
@@ -2629,197 +2895,197 @@ void output_cell(cell *c, int xml)
             }
 
             /* First take care of text color & alignment */
-            printf( xml ? "" : "<TD");
+            xl_printf(xl, xml ? "" : "<TD");
             if ((c->rowspan != 0)||(c->colspan != 0))
             {
                 if (c->colspan)
-                    printf( xml ? "<colspan>%d</colspan>" : " COLSPAN=\"%d\"", c->colspan);
+                    xl_printf(xl, xml ? "<colspan>%d</colspan>" : " COLSPAN=\"%d\"", c->colspan);
                 if (c->rowspan)
-                    printf( xml ? "<rowspan>%d</rowspan>" : " ROWSPAN=\"%d\"", c->rowspan);
+                    xl_printf(xl, xml ? "<rowspan>%d</rowspan>" : " ROWSPAN=\"%d\"", c->rowspan);
             }
             if ((safe > 0)&&(!nullString))
             {
-                switch(xf_array[c->xfmt]->align & 0x0007)
+                switch(xl->xf_array[c->xfmt]->align & 0x0007)
                 {   /* Override default table alignment when needed */
                     case 2:
                     case 6:     /* Center across selection */
-                        if (strcmp(default_alignment, "center") != 0)
-                            printf( xml ? "" : " ALIGN=\"center\"");
+                        if (strcmp(xl->default_alignment, "center") != 0)
+                            xl_printf(xl, xml ? "" : " ALIGN=\"center\"");
                         break;
                     case 0:     /* General alignment */
                         if (numeric)                        /* Numbers */
                         {
-                            if (strcmp(default_alignment, "right") != 0)
-                                printf( xml ? "" : " ALIGN=\"right\"");
+                            if (strcmp(xl->default_alignment, "right") != 0)
+                                xl_printf(xl, xml ? "" : " ALIGN=\"right\"");
                         }
                         else if ((c->type & 0x00FF) == 0x05)
                         {           /* Boolean */
-                            if (strcmp(default_alignment, "center") != 0)
-                                printf( xml ? "" : " ALIGN=\"center\"");
+                            if (strcmp(xl->default_alignment, "center") != 0)
+                                xl_printf(xl, xml ? "" : " ALIGN=\"center\"");
                         }
                         else
                         {
-                            if (strcmp(default_alignment, "left") != 0)
-                                printf( xml ? "" : " ALIGN=\"left\"");
+                            if (strcmp(xl->default_alignment, "left") != 0)
+                                xl_printf(xl, xml ? "" : " ALIGN=\"left\"");
                         }
                         break;
                     case 3:
-                        if (strcmp(default_alignment, "right") != 0)
-                            printf( xml ? "" : " ALIGN=\"right\"");
+                        if (strcmp(xl->default_alignment, "right") != 0)
+                            xl_printf(xl, xml ? "" : " ALIGN=\"right\"");
                         break;
                     case 1:
                     default:
-                        if (strcmp(default_alignment, "left") != 0)
-                            printf( xml ? "" : " ALIGN=\"left\"");
+                        if (strcmp(xl->default_alignment, "left") != 0)
+                            xl_printf(xl, xml ? "" : " ALIGN=\"left\"");
                         break;
                 }
-                switch((xf_array[c->xfmt]->align & 0x0070)>>4)
+                switch((xl->xf_array[c->xfmt]->align & 0x0070)>>4)
                 {
                     case 0:
-                        printf( xml ? "" : " VALIGN=\"top\"");
+                        xl_printf(xl, xml ? "" : " VALIGN=\"top\"");
                         break;
                     case 1:
-                        printf( xml ? "" : " VALIGN=\"center\"");
+                        xl_printf(xl, xml ? "" : " VALIGN=\"center\"");
                         break;
                     case 2:     /* General alignment */
                         if (safe > 1)
                         {
-                            if ((font_array[xf_array[c->xfmt]->fnt_idx]->super & 0x0003) == 0x0001)
-                                printf( xml ? "" : " VALIGN=\"top\"");  /* Superscript */
+                            if ((xl->font_array[xl->xf_array[c->xfmt]->fnt_idx]->super & 0x0003) == 0x0001)
+                                xl_printf(xl, xml ? "" : " VALIGN=\"top\"");  /* Superscript */
                         }
                         break;
                     default:
                         if (safe > 1)
                         {
-                            if ((font_array[xf_array[c->xfmt]->fnt_idx]->super & 0x0003) == 0x0001)
-                                printf( xml ? "" : " VALIGN=\"top\"");  /* Superscript */
+                            if ((xl->font_array[xl->xf_array[c->xfmt]->fnt_idx]->super & 0x0003) == 0x0001)
+                                xl_printf(xl, xml ? "" : " VALIGN=\"top\"");  /* Superscript */
                         }
                         break;
                 }
             }
             /* Next do the bgcolor... BGCOLOR=""   */
-            if (safe && use_colors)
+            if (safe && xl->use_colors)
             {
                 int fgcolor;
                 /* int bgcolor = (xf_array[c->xfmt]->cell_color & 0x3F80) >> 7; */
-                fgcolor = (xf_array[c->xfmt]->cell_color & 0x007F);
+                fgcolor = (xl->xf_array[c->xfmt]->cell_color & 0x007F);
                 /* printf(" XF:%X BG Color:%d, FG Color:%d", c->xfmt, bgcolor, fgcolor); */ 
 
                 /* Might be better by blending bg & fg colors?
                    If valid, fgcolor != black and fgcolor != white */
                 if( ! xml )
                 {
-                    if (numCustomColors)
+                    if (xl->numCustomColors)
                     {
-                        if (fgcolor < numCustomColors)
+                        if (fgcolor < xl->numCustomColors)
                         {
-                            if (strcmp(default_background_color, (char *)customColors[fgcolor-8]) != 0)
-                                printf(" BGCOLOR=\"%s\"", customColors[fgcolor-8]);
+                            if (strcmp(xl->default_background_color, (char *)xl->customColors[fgcolor-8]) != 0)
+                                xl_printf(xl, " BGCOLOR=\"%s\"", xl->customColors[fgcolor-8]);
                         }
                     }
                     else
                     {
                         if (fgcolor < MAX_COLORS)
                         {
-                            if (strcmp(default_background_color, colorTab[fgcolor]) != 0)
-                                printf(" BGCOLOR=\"%s\"", colorTab[fgcolor]);
+                            if (strcmp(xl->default_background_color, colorTab[fgcolor]) != 0)
+                                xl_printf(xl, " BGCOLOR=\"%s\"", colorTab[fgcolor]);
                         }
                     }
                 }
             }
 
             /* Next set the border color... */
-            if (safe && use_colors)
+            if (safe && xl->use_colors)
             {
                 int lcolor, rcolor, tcolor, bcolor;
-                lcolor = xf_array[c->xfmt]->b_l_color & 0x007F;
-                rcolor = (xf_array[c->xfmt]->b_l_color & 0x3F80) >> 7;
-                tcolor = xf_array[c->xfmt]->b_t_color & 0x007F;
-                bcolor = (xf_array[c->xfmt]->b_t_color & 0x3F80) >> 7;
+                lcolor = xl->xf_array[c->xfmt]->b_l_color & 0x007F;
+                rcolor = (xl->xf_array[c->xfmt]->b_l_color & 0x3F80) >> 7;
+                tcolor = xl->xf_array[c->xfmt]->b_t_color & 0x007F;
+                bcolor = (xl->xf_array[c->xfmt]->b_t_color & 0x3F80) >> 7;
                 if (((lcolor & rcolor & tcolor & bcolor) == lcolor)&&(lcolor < MAX_COLORS))
                 {   /* if they are all the same...do it...that is if its different from BLACK */
-                    if (numCustomColors == 0)   /* Don't do custom borders */
+                    if (xl->numCustomColors == 0)   /* Don't do custom borders */
                     {
                         if ((strcmp(colorTab[lcolor], "000000") != 0)&&(strcmp(colorTab[lcolor], "FFFFFF") != 0))
                         {
                             if( !xml )
-                                printf(" BORDERCOLOR=\"%s\"", colorTab[lcolor]);
+                                xl_printf(xl, " BORDERCOLOR=\"%s\"", colorTab[lcolor]);
                         }
                     }
                 }
             }
 
             /* Close up the <TD>... */
-            printf(xml ? "" : ">");
+            xl_printf(xl, xml ? "" : ">");
 
             /* Next set font properties */
             if (safe > 1 && !xml )
             {
                 if (!nullString)
-                    output_start_font_attribute(&h, xf_array[c->xfmt]->fnt_idx);
+                    output_start_font_attribute(xl, &h, xl->xf_array[c->xfmt]->fnt_idx);
             }
 
             /* Finally, take care of font modifications */
             if ((safe > 1)&&(!nullString))
             {
-                if ((font_array[xf_array[c->xfmt]->fnt_idx]->underline&0x0023) > 0)
+                if ((xl->font_array[xl->xf_array[c->xfmt]->fnt_idx]->underline&0x0023) > 0)
                 {
                     if (c->h_link.str)
                     {
-                        printf("<A href=\"");
+                        xl_printf(xl, "<A href=\"");
                         if (c->h_link.uni)
                         {
                             if (memchr((char *)c->h_link.str, ':', c->h_link.len) == 0)
                             {
                                 if (memchr((char *)c->h_link.str, '@', c->h_link.len))
-                                    printf("mailto:");
+                                    xl_printf(xl, "mailto:");
                             }
                         }
-                        OutputString(&(c->h_link));
-                        printf("\">");
+                        OutputString(xl, &(c->h_link));
+                        xl_printf(xl, "\">");
                         h.uflag = 2;
                     }
                     else
                     {
-                        printf("<U>");
+                        xl_printf(xl, "<U>");
                         h.uflag = 1;
                     }
                 }
-                output_start_html_attr(&h, xf_array[c->xfmt]->fnt_idx, 0);
+                output_start_html_attr(xl, &h, xl->xf_array[c->xfmt]->fnt_idx, 0);
             }
             if (c->ustr.str)
             {
                 if (safe)
-                    output_formatted_data(&(c->ustr), xf_array[c->xfmt]->fmt_idx, numeric, IsCellFormula(c));
+                    output_formatted_data(xl, &(c->ustr), xl->xf_array[c->xfmt]->fmt_idx, numeric, IsCellFormula(c));
                 else
-                    OutputString(&(c->ustr));
+                    OutputString(xl, &(c->ustr));
             }
             else
-                printf( xml ? "" : "&nbsp;");
+                xl_printf(xl, xml ? "" : "&nbsp;");
 /*          printf(" T:%02X", c->type & 0x00FF); */
         }
 
         /* Now close the tags... */
-        output_end_html_attr(&h);
+        output_end_html_attr(xl, &h);
         if (h.fflag)
-            printf("</FONT>");
+            xl_printf(xl, "</FONT>");
     }
 
-    if (!aggressive)
-        printf( xml ? "" : "</TD>\n");
+    if (!xl->aggressive)
+        xl_printf(xl, xml ? "" : "</TD>\n");
 }
 
-void output_formatted_data(uni_string *u, U16 idx, int numeric, int formula)
+void output_formatted_data(xlhtml_ctx *xl, uni_string *u, U16 idx, int numeric, int formula)
 {
-    if ((idx < max_xformats)&&(u->str))
+    if ((idx < xl->max_xformats)&&(u->str))
     {
-        if ((formula_warnings)&&(formula)&&(disclaimers))
+        if ((xl->formula_warnings)&&(formula)&&(xl->disclaimers))
         {
-            if( OutputXML )
-                printf( "<NotAccurate/>" );
+            if( xl->OutputXML )
+                xl_printf(xl, "<NotAccurate/>" );
             else
-                printf("** ");
-            notAccurate++;
+                xl_printf(xl, "** ");
+            xl->notAccurate++;
         }
         if (numeric)
         {
@@ -2833,299 +3099,299 @@ void output_formatted_data(uni_string *u, U16 idx, int numeric, int formula)
             {
                 case 0x00:  /* General */
                     dnum = atof((char *)u->str);
-                    printf("%.15g", dnum);
+                    xl_printf(xl, "%.15g", dnum);
                     break;
                 case 0x01:  /* Number 0 */
                     dnum = atof((char *)u->str);
-                    printf("%.0f", dnum);
+                    xl_printf(xl, "%.0f", dnum);
                     break;
                 case 0x02:  /* Number   0.00 */
                     dnum = atof((char *)u->str);
-                    printf("%.2f", dnum);
+                    xl_printf(xl, "%.2f", dnum);
                     break;
                 case 0x03:  /* Number w/comma   0,000 */
-                    PrintFloatComma("%.0f", 0, (F64)atof((char *)u->str));
+                    PrintFloatComma(xl, "%.0f", 0, (F64)atof((char *)u->str));
                     break;
                 case 0x04:  /* Number w/comma   0,000.00 */
-                    PrintFloatComma("%.2f", 0, (F64)atof((char *)u->str));
+                    PrintFloatComma(xl, "%.2f", 0, (F64)atof((char *)u->str));
                     break;
                 case 0x05:  /* Currency, no decimal */
-                    PrintFloatComma("%.0f", 1, (F64)atof((char *)u->str));
+                    PrintFloatComma(xl, "%.0f", 1, (F64)atof((char *)u->str));
                     break;
                 case 0x06:  /* Currency, no decimal Red on Neg */
-                    PrintFloatComma("%.0f", 1, (F64)atof((char *)u->str));
+                    PrintFloatComma(xl, "%.0f", 1, (F64)atof((char *)u->str));
                     break;
                 case 0x07:  /* Currency with decimal */
-                    PrintFloatComma("%.2f", 1, (F64)atof((char *)u->str));
+                    PrintFloatComma(xl, "%.2f", 1, (F64)atof((char *)u->str));
                     break;
                 case 0x08:  /* Currency with decimal Red on Neg */
-                    PrintFloatComma("%.2f", 1, (F64)atof((char *)u->str));
+                    PrintFloatComma(xl, "%.2f", 1, (F64)atof((char *)u->str));
                     break;
                 case 0x09:  /* Percent 0% */
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     dnum = 100.0*atof((char *)u->str);
-                    printf("%.0f%%", dnum);
-                    if (Csv)
-                        printf("\"");
+                    xl_printf(xl, "%.0f%%", dnum);
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x0A:  /* Percent 0.00% */
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     dnum = 100.0*atof((char *)u->str);
-                    printf("%.2f%%", dnum);
-                    if (Csv)
-                        printf("\"");
+                    xl_printf(xl, "%.2f%%", dnum);
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x0B:  /* Scientific 0.00+E00 */
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     dnum = atof((char *)u->str);
-                    printf("%.2E", dnum);
-                    if (Csv)
-                        printf("\"");
+                    xl_printf(xl, "%.2E", dnum);
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x0C:  /* Fraction 1 number  e.g. 1/2, 1/3 */
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     dnum = atof((char *)u->str);
-                    print_as_fraction(dnum, 1);
-                    if (Csv)
-                        printf("\"");
+                    print_as_fraction(xl, dnum, 1);
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x0D:  /* Fraction 2 numbers  e.g. 1/50, 25/33 */
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     dnum = atof((char *)u->str);
-                    print_as_fraction(dnum, 2);
-                    if (Csv)
-                        printf("\"");
+                    print_as_fraction(xl, dnum, 2);
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x0E:  /* Date: m-d-y */
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     num = atol((char *)u->str);
-                    NumToDate(num, &year, &month, &date);
-                    printf("%d-%d-%02d", month, date, year);
-                    if (Csv)
-                        printf("\"");
+                    NumToDate(xl, num, &year, &month, &date);
+                    xl_printf(xl, "%d-%d-%02d", month, date, year);
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x0F:  /* Date: d-mmm-yy */
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     num = atol((char *)u->str);
-                    NumToDate(num, &year, &month, &date);
-                    printf("%d-%s-%02d", date, month_abbr[month-1], year);
-                    if (Csv)
-                        printf("\"");
+                    NumToDate(xl, num, &year, &month, &date);
+                    xl_printf(xl, "%d-%s-%02d", date, month_abbr[month-1], year);
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x10:  /* Date: d-mmm */
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     num = atol((char *)u->str);
-                    NumToDate(num, &year, &month, &date);
-                    printf("%d-%s", date, month_abbr[month-1]);
-                    if (Csv)
-                        printf("\"");
+                    NumToDate(xl, num, &year, &month, &date);
+                    xl_printf(xl, "%d-%s", date, month_abbr[month-1]);
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x11:  /* Date: mmm-yy */
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     num = atol((char *)u->str);
-                    NumToDate(num, &year, &month, &date);
-                    printf("%s-%02d", month_abbr[month-1], year);
-                    if (Csv)
-                        printf("\"");
+                    NumToDate(xl, num, &year, &month, &date);
+                    xl_printf(xl, "%s-%02d", month_abbr[month-1], year);
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x12:  /* Time: h:mm AM/PM */
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     FracToTime(u->str, &hr, &minu, 0, 0);
                     if (hr == 0)
-                        printf("12:%02d AM", minu);
+                        xl_printf(xl, "12:%02d AM", minu);
                     else if (hr < 12)
-                        printf("%d:%02d AM", hr, minu);
+                        xl_printf(xl, "%d:%02d AM", hr, minu);
                     else if (hr == 12)
-                        printf("12:%02d PM", minu);
+                        xl_printf(xl, "12:%02d PM", minu);
                     else
-                        printf("%d:%02d PM", hr-12, minu);
-                    if (Csv)
-                        printf("\"");
+                        xl_printf(xl, "%d:%02d PM", hr-12, minu);
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x13:  /* Time: h:mm:ss AM/PM */
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     FracToTime(u->str, &hr, &minu, &sec, 0);
                     if (hr == 0)
-                        printf("12:%02d:%02d AM", minu, sec);
+                        xl_printf(xl, "12:%02d:%02d AM", minu, sec);
                     else if (hr < 12)
-                        printf("%d:%02d:%02d AM", hr, minu, sec);
+                        xl_printf(xl, "%d:%02d:%02d AM", hr, minu, sec);
                     else if (hr == 12)
-                        printf("12:%02d:%02d PM", minu, sec);
+                        xl_printf(xl, "12:%02d:%02d PM", minu, sec);
                     else
-                        printf("%d:%02d:%02d PM", hr-12, minu, sec);
-                    if (Csv)
-                        printf("\"");
+                        xl_printf(xl, "%d:%02d:%02d PM", hr-12, minu, sec);
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x14:  /* Time: h:mm */
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     FracToTime(u->str, &hr, &minu, 0, 0);
-                    printf("%d:%02d", hr, minu);
-                    if (Csv)
-                        printf("\"");
+                    xl_printf(xl, "%d:%02d", hr, minu);
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x15:  /* Time: h:mm:ss */
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     FracToTime(u->str, &hr, &minu, &sec, 0);
                     if ((hr != 0)||(minu != 0)||(sec != 0))
-                        printf("%d:%02d:%02d", hr, minu, sec);
+                        xl_printf(xl, "%d:%02d:%02d", hr, minu, sec);
                     else
                     {
-                        if (Ascii)
-                            putchar(' ');
+                        if (xl->Ascii)
+                            xl_putc(xl, ' ');
                         else
-                            printf(OutputXML ? "" : "&nbsp;");
+                            xl_printf(xl, xl->OutputXML ? "" : "&nbsp;");
                     }
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x25:  /* Number with comma, no decimal */
-                    if (Csv)
-                        printf("\"");
-                    PrintFloatComma("%.0f", 0, (F64)atof((char *)u->str));
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
+                    PrintFloatComma(xl, "%.0f", 0, (F64)atof((char *)u->str));
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x26:  /* Number with comma, no decimal, red on negative */
-                    if (Csv)
-                        printf("\"");
-                    PrintFloatComma("%.0f", 0, (F64)atof((char *)u->str));
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
+                    PrintFloatComma(xl, "%.0f", 0, (F64)atof((char *)u->str));
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x27:  /* Number with comma & decimal */
-                    if (Csv)
-                        printf("\"");
-                    PrintFloatComma("%.2f", 0, (F64)atof((char *)u->str));
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
+                    PrintFloatComma(xl, "%.2f", 0, (F64)atof((char *)u->str));
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x28:  /* Number with comma & decimal, red on negative */
-                    if (Csv)
-                        printf("\"");
-                    PrintFloatComma("%.2f", 0, (F64)atof((char *)u->str));
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
+                    PrintFloatComma(xl, "%.2f", 0, (F64)atof((char *)u->str));
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x29:  /* Number with comma, no decimal */
-                    if (Csv)
-                        printf("\"");
-                    PrintFloatComma("%.2f", 0, (F64)atof((char *)u->str));
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
+                    PrintFloatComma(xl, "%.2f", 0, (F64)atof((char *)u->str));
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x2a:  /* Currency, no decimal */
-                    if (Csv)
-                        printf("\"");
-                    PrintFloatComma("%.0f", 1, (F64)atof((char *)u->str));
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
+                    PrintFloatComma(xl, "%.0f", 1, (F64)atof((char *)u->str));
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x2B:  /* Number w/comma & decimal 0,000.00 */
-                    if (Csv)
-                        printf("\"");
-                    PrintFloatComma("%.2f", 0, (F64)atof((char *)u->str));
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
+                    PrintFloatComma(xl, "%.2f", 0, (F64)atof((char *)u->str));
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x2C:  /* Accounting Currency  $0,000.00 */
                 {
                     F64 acc_val = atof((char *)u->str);
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     if (acc_val < 0.0)
-                        PrintFloatComma(" (%.2f)", 1, fabs(acc_val));
+                        PrintFloatComma(xl, " (%.2f)", 1, fabs(acc_val));
                     else
-                        PrintFloatComma(" %.2f", 1, acc_val);
-                    if (Csv)
-                        printf("\"");
+                        PrintFloatComma(xl, " %.2f", 1, acc_val);
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 }
                 case 0x2D:  /* Time: mm:ss */
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     FracToTime(u->str, &hr, &minu, &sec, 0);
-                    printf("%02d:%02d", minu, sec);
-                    if (Csv)
-                        printf("\"");
+                    xl_printf(xl, "%02d:%02d", minu, sec);
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x2E:  /* Time: [h]:mm:ss */
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     FracToTime(u->str, &hr, &minu, &sec, 0);
                     if (hr)
-                        printf("%d:%02d:%02d", hr, minu, sec);
+                        xl_printf(xl, "%d:%02d:%02d", hr, minu, sec);
                     else
-                        printf("%02d:%02d", minu, sec);
-                    if (Csv)
-                        printf("\"");
+                        xl_printf(xl, "%02d:%02d", minu, sec);
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x2F:  /* Time: mm:ss.0 */
-                    if (Csv)
-                        printf("\"");
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     FracToTime(u->str, &hr, &minu, &sec, &msec);
-                    printf("%02d:%02d.%01d", minu, sec, msec);
-                    if (Csv)
-                        printf("\"");
+                    xl_printf(xl, "%02d:%02d.%01d", minu, sec, msec);
+                    if (xl->Csv)
+                        xl_printf(xl, "\"");
                     break;
                 case 0x31:  /* Text - if we are here...its a number */
                     dnum = atof((char *)u->str);
-                    printf("%g", dnum);
+                    xl_printf(xl, "%g", dnum);
                     break;
                 default:    /* Unsupported...but, if we are here, its a number */
                     {
                         char *ptr = strchr((char *)u->str, '.');
-                        if( OutputXML )
-                            printf( "<NoFormat/>" );
+                        if( xl->OutputXML )
+                            xl_printf(xl, "<NoFormat/>" );
                         dnum = atof((char *)u->str);
                         if (ptr)
                         {
-                            if (Csv)
-                                printf("\"%.15g\"", dnum );
-                            else if (OutputXML || !disclaimers)
-                                printf("%.15g", dnum );
+                            if (xl->Csv)
+                                xl_printf(xl, "\"%.15g\"", dnum );
+                            else if (xl->OutputXML || !xl->disclaimers)
+                                xl_printf(xl, "%.15g", dnum );
                             else
-                                printf("%.15g *", dnum );
+                                xl_printf(xl, "%.15g *", dnum );
                         }
                         else
                         {
                         num = atol((char *)u->str); 
-                            if (Csv)
-                                printf("%ld", num);
-                            else if (OutputXML || !disclaimers)
-                                printf("%ld", num );
+                            if (xl->Csv)
+                                xl_printf(xl, "%ld", num);
+                            else if (xl->OutputXML || !xl->disclaimers)
+                                xl_printf(xl, "%ld", num );
                             else
-                                printf("%ld *", num );
+                                xl_printf(xl, "%ld *", num );
                         }
 
 /*                      printf(" F:%02X", idx); */
-                        NoFormat++ ;
+                        xl->NoFormat++ ;
                     }
                     break;
             }
         }
         else    /* Text data */
-            OutputString(u);
+            OutputString(xl, u);
     }
     else    /* Error handling just dump it. */
-        OutputString(u);
+        OutputString(xl, u);
 }
 
 
 
-void PrintFloatComma(char *fformat, int is_currency, F64 d)
+void PrintFloatComma(xlhtml_ctx *xl, char *fformat, int is_currency, F64 d)
 {
     int len, int_len, dec_len;
     char *ptr2, buf[64];
@@ -3194,27 +3460,27 @@ void PrintFloatComma(char *fformat, int is_currency, F64 d)
         if (neg)
             buf2[j++] = '-';
         if (is_currency)
-            buf2[j++] = (char)currency_symbol;
+            buf2[j++] = (char)xl->currency_symbol;
         buf2[j] = 0;
 
         len = strlen(buf2);
         for (i=0, j=len-1; i<len;i++, j--)
             buf[i] = buf2[j];
         buf[len] = 0;
-        if (Csv)
-            printf("\"%s\"", buf);
+        if (xl->Csv)
+            xl_printf(xl, "\"%s\"", buf);
         else
-            printf("%s", buf);
+            xl_printf(xl, "%s", buf);
     }
     else    /* too short for commas, just output it as is. */
     {
         if (is_currency)
-            putchar((char)currency_symbol);
-        printf(fformat, d);
+            xl_putc(xl, (char)xl->currency_symbol);
+        xl_printf(xl, fformat, d);
     }
 }
 
-void print_as_fraction(F64 d, int digits)
+void print_as_fraction(xlhtml_ctx *xl, F64 d, int digits)
 {
     F64 i, j, w, r, closest=1.0, lim = 9.0;
     int ci=1, cj=1;
@@ -3223,14 +3489,14 @@ void print_as_fraction(F64 d, int digits)
     if (digits == 2)
         lim = 99.0;
     if (d < 0)
-        putchar('-');
+        xl_putc(xl, '-');
 
     /** take care of whole number part */
     w = fabs(d);
     if (w >= 1.0)
     {
         int n = (int)w;
-        printf("%d ", n);
+        xl_printf(xl, "%d ", n);
         r = w - (F64)n;
     }
     else
@@ -3252,185 +3518,120 @@ void print_as_fraction(F64 d, int digits)
 
     /* Done, print it... */
     if (ci != 0)
-        printf("%d/%d", ci, cj);
+        xl_printf(xl, "%d/%d", ci, cj);
 }
 
-void trim_sheet_edges(unsigned int sheet)
+void trim_sheet_edges(xlhtml_ctx *xl, unsigned int sheet)
 {
-    cell *ce;
-    int not_done = 1;
-    S32 r;
-    U16 c;
+    work_sheet *ws;
+    S32 top = -1, bottom = -1;
+    S32 left = -1, right = -1;
+    U32 i;
+    U16 j;
 
-    if ((sheet >= max_worksheets)||(ws_array[sheet] == 0)||
-            (trim_edges == 0)/*||(ws_array[sheet]->spanned)*/)
-        return;
-    if (ws_array[sheet]->c_array == 0)
+    if ((sheet >= xl->max_worksheets)||(xl->ws_array[sheet] == 0)||
+            (xl->trim_edges == 0)/*||(ws_array[sheet]->spanned)*/)
         return;
-    if (    (ws_array[sheet]->biggest_row == -1) ||
-            (ws_array[sheet]->biggest_col == -1) )
+    ws = xl->ws_array[sheet];
+    if (    (ws->biggest_row == -1) ||
+            (ws->biggest_col == -1) )
         return;
 
-    /* First find top edge */
-    for (r=ws_array[sheet]->first_row; r<=ws_array[sheet]->biggest_row; r++)
-    {
-        for (c=ws_array[sheet]->first_col; c<=ws_array[sheet]->biggest_col; c++)
-        {   /* This stuff happens for each cell... */
-            ce = ws_array[sheet]->c_array[(r*ws_array[sheet]->max_cols)+c];
-            if (ce)
-            {
-                if (ce->ustr.str)
-                {
-                    if (!null_string(ce->ustr.str))
-                    {
-                        not_done = 0;
-                        break;
-                    }
-                }
-            }
-        }
-        if (!not_done)
-            break;
-    }
-    if (not_done)
-        ws_array[sheet]->first_row = ws_array[sheet]->biggest_row;
-    else
-        ws_array[sheet]->first_row = r;
-
-    /* Second Find bottom edge */
-    not_done = 1;
-    for (r=ws_array[sheet]->biggest_row; r>(S32)ws_array[sheet]->first_row; r--)
+    /* Find the bounding box of the cells with something in them */
+    for (i=0; i<ws->row_cnt; i++)
     {
-        for (c=ws_array[sheet]->first_col; c<=ws_array[sheet]->biggest_col; c++)
-        {   /* This stuff happens for each cell... */
-            ce = ws_array[sheet]->c_array[(r*ws_array[sheet]->max_cols)+c];
-            if (ce)
-            {
-                if (ce->ustr.str)
-                {
-                    if (!null_string(ce->ustr.str))
-                    {
-                        not_done = 0;
-                        break;
-                    }
-                }
-            }
-        }
-        if (!not_done)
-            break;
-    }
-    ws_array[sheet]->biggest_row = r;
+        row_entry *re = &ws->rows[i];
 
-    /* Third find left edge */
-    not_done = 1;
-    for (c=ws_array[sheet]->first_col; c<=ws_array[sheet]->biggest_col; c++)
-    {
-        for (r=ws_array[sheet]->first_row; r<=ws_array[sheet]->biggest_row; r++)
+        for (j=0; j<re->cnt; j++)
         {   /* This stuff happens for each cell... */
-            ce = ws_array[sheet]->c_array[(r*ws_array[sheet]->max_cols)+c];
-            if (ce)
-            {
-                if (ce->ustr.str)
-                {
-                    if (!null_string(ce->ustr.str))
-                    {
-                        not_done = 0;
-                        break;
-                    }
-                }
-            }
+            cell *ce = re->cols[j].c;
+
+            if ((ce == 0)||(ce->ustr.str == 0)||null_string(ce->ustr.str))
+                continue;
+            if (!ws_in_view(ws, re->row, re->cols[j].col))
+                continue;
+            if (top == -1)
+                top = re->row;
+            bottom = re->row;
+            if ((left == -1)||(re->cols[j].col < left))
+                left = re->cols[j].col;
+            if (re->cols[j].col > right)
+                right = re->cols[j].col;
         }
-        if (!not_done)
-            break;
     }
-    if (not_done)
-        ws_array[sheet]->first_col = ws_array[sheet]->biggest_col;
-    else
-        ws_array[sheet]->first_col = c;
 
-    /* Last, find right edge */
-    not_done = 1;
-    for (c=ws_array[sheet]->biggest_col; c>ws_array[sheet]->first_col; c--)
-    {
-        for (r=ws_array[sheet]->first_row; r<=ws_array[sheet]->biggest_row; r++)
-        {   /* This stuff happens for each cell... */
-            ce = ws_array[sheet]->c_array[(r*ws_array[sheet]->max_cols)+c];
-            if (ce)
-            {
-                if (ce->ustr.str)
-                {
-                    if (!null_string(ce->ustr.str))
-                    {
-                        not_done = 0;
-                        break;
-                    }
-                }
-            }
-        }
-        if (!not_done)
-            break;
+    if (top == -1)
+    {   /* Nothing but blanks */
+        ws->first_row = ws->biggest_row;
+        ws->first_col = ws->biggest_col;
+        return;
     }
-    ws_array[sheet]->biggest_col = c;
+    ws->first_row = top;
+    ws->biggest_row = bottom;
+    ws->first_col = (U16)left;
+    ws->biggest_col = (S16)right;
 }
 
 /***************
 *! Figures out the best font & alignment for the current table.
 * Also sets the default_font and default_alignment.
 ****************/
-void update_default_font(unsigned int sheet)
+void update_default_font(xlhtml_ctx *xl, unsigned int sheet)
 {
     cell *ce;
     int r, c, f;
+    U32 ri;
+    U16 ci;
 
-    if ((sheet >= max_worksheets)||(ws_array[sheet] == 0))
-        return;
-    if (ws_array[sheet]->c_array == 0)
+    if ((sheet >= xl->max_worksheets)||(xl->ws_array[sheet] == 0))
         return;
 
     /* Clear the book-keeping info... */
     for (r=0; r<FONTS_INCR; r++)
     {
-        f_cnt[r].cnt = 0;
-        if (f_cnt[r].name)
+        xl->f_cnt[r].cnt = 0;
+        if (xl->f_cnt[r].name)
         {
-            if (f_cnt[r].name->str)
-                free(f_cnt[r].name->str);
-            free(f_cnt[r].name);
-            f_cnt[r].name = 0;
+            if (xl->f_cnt[r].name->str)
+                free(xl->f_cnt[r].name->str);
+            free(xl->f_cnt[r].name);
+            xl->f_cnt[r].name = 0;
         }
     }
-    if (default_font.str)
-        free(default_font.str);
+    if (xl->default_font.str)
+        free(xl->default_font.str);
     for (r=0; r<7; r++)
-        fnt_size_cnt[r] = 0;
+        xl->fnt_size_cnt[r] = 0;
 
     /* Now check each cell to see what its using. */
-    for (r=ws_array[sheet]->first_row; r<=ws_array[sheet]->biggest_row; r++)
+    for (ri=0; ri<xl->ws_array[sheet]->row_cnt; ri++)
     {
-        for (c=ws_array[sheet]->first_col; c<=ws_array[sheet]->biggest_col; c++)
+        row_entry *re = &xl->ws_array[sheet]->rows[ri];
+
+        for (ci=0; ci<re->cnt; ci++)
         {   /* This stuff happens for each cell... */
-            ce = ws_array[sheet]->c_array[(r*ws_array[sheet]->max_cols)+c];
-            if (ce)
+            ce = re->cols[ci].c;
+            if (ce && ws_in_view(xl->ws_array[sheet], re->row, re->cols[ci].col))
             {
-                if ((ce->xfmt < next_xf)&&(ce->ustr.str))
+                if ((ce->xfmt < xl->next_xf)&&(ce->ustr.str))
                 {
                     if (strcmp((char *)ce->ustr.str, "&nbsp;"))
                     {
-                        if (ce->xfmt < next_xf)
+                        if (ce->xfmt < xl->next_xf)
                         {
-                            if (xf_array[ce->xfmt])
+                            if (xl->xf_array[ce->xfmt])
                             {
-                                unsigned int fn = xf_array[ce->xfmt]->fnt_idx;
-                                if (fn < next_font)
+                                unsigned int fn = xl->xf_array[ce->xfmt]->fnt_idx;
+                                if (fn < xl->next_font)
                                 {
-                                    if (font_array[fn])
+                                    if (xl->font_array[fn])
                                     {
-                                        if (font_array[fn]->name.str)
+                                        if (xl->font_array[fn]->name.str)
                                         {
                                             /* Here's where we check & increment count... */
-                                            incr_f_cnt(&(font_array[fn]->name));
-                                            if ((font_array[fn]->size < 8)&&(font_array[fn]->size))
-                                                fnt_size_cnt[font_array[fn]->size-1]++;
+                                            incr_f_cnt(xl, &(xl->font_array[fn]->name));
+                                            if ((xl->font_array[fn]->size < 8)&&(xl->font_array[fn]->size))
+                                                xl->fnt_size_cnt[xl->font_array[fn]->size-1]++;
                                         }
                                     }
                                 }
@@ -3442,26 +3643,26 @@ void update_default_font(unsigned int sheet)
         }
     }
 
-    f = get_default_font();
+    f = get_default_font(xl);
     if (f == -1)
     {
-        default_font.str = (U8 *)malloc(6);
-        if (default_font.str)
+        xl->default_font.str = (U8 *)malloc(6);
+        if (xl->default_font.str)
         {
-            strcpy((char *)default_font.str, "Arial");
-            default_font.uni = 0;
-            default_font.len = 5;
+            strcpy((char *)xl->default_font.str, "Arial");
+            xl->default_font.uni = 0;
+            xl->default_font.len = 5;
         }
     }
     else
     {
-        default_font.str = (U8 *)malloc(f_cnt[f].name->len+1);
-        if (default_font.str)
+        xl->default_font.str = (U8 *)malloc(xl->f_cnt[f].name->len+1);
+        if (xl->default_font.str)
         {
-            memcpy(default_font.str, f_cnt[f].name->str, f_cnt[f].name->len);
-            default_font.str[f_cnt[f].name->len] = 0;
-            default_font.uni = f_cnt[f].name->uni;
-            default_font.len = f_cnt[f].name->len;
+            memcpy(xl->default_font.str, xl->f_cnt[f].name->str, xl->f_cnt[f].name->len);
+            xl->default_font.str[xl->f_cnt[f].name->len] = 0;
+            xl->default_font.uni = xl->f_cnt[f].name->uni;
+            xl->default_font.len = xl->f_cnt[f].name->len;
         }
     }
 
@@ -3471,30 +3672,30 @@ void update_default_font(unsigned int sheet)
     f = 3;
     for (r=0; r<7; r++)
     {
-        if (fnt_size_cnt[r] > c)
+        if (xl->fnt_size_cnt[r] > c)
         {
-            c = fnt_size_cnt[r];
+            c = xl->fnt_size_cnt[r];
             f = r;
         }
     }
-    if (fnt_size_cnt[2] == c)       /* favor size 3... */
-        default_fontsize = 3;
+    if (xl->fnt_size_cnt[2] == c)       /* favor size 3... */
+        xl->default_fontsize = 3;
     else
-        default_fontsize = f+1;
+        xl->default_fontsize = f+1;
 
     for (r=0; r<FONTS_INCR; r++)
     {
-        if (f_cnt[r].name != 0)
+        if (xl->f_cnt[r].name != 0)
         {
-            if (f_cnt[r].name->str != 0)
-                free(f_cnt[r].name->str);
-            free(f_cnt[r].name);
-            f_cnt[r].name= 0;
+            if (xl->f_cnt[r].name->str != 0)
+                free(xl->f_cnt[r].name->str);
+            free(xl->f_cnt[r].name);
+            xl->f_cnt[r].name= 0;
         }
     }
 }
 
-void incr_f_cnt(uni_string *name)
+void incr_f_cnt(xlhtml_ctx *xl, uni_string *name)
 {
     int i;
 
@@ -3503,24 +3704,24 @@ void incr_f_cnt(uni_string *name)
 
     for (i=0; i<FONTS_INCR; i++)
     {
-        if (f_cnt[i].name)
+        if (xl->f_cnt[i].name)
         {
-            if (uni_string_comp(name, f_cnt[i].name) == 0)
-                f_cnt[i].cnt++;
+            if (uni_string_comp(name, xl->f_cnt[i].name) == 0)
+                xl->f_cnt[i].cnt++;
         }
         else
         {
-            f_cnt[i].name = (uni_string *)malloc(sizeof(uni_string));
-            if (f_cnt[i].name)
+            xl->f_cnt[i].name = (uni_string *)malloc(sizeof(uni_string));
+            if (xl->f_cnt[i].name)
             {
-                f_cnt[i].name->str = (U8 *)malloc(name->len+1);
-                if (f_cnt[i].name->str)
+                xl->f_cnt[i].name->str = (U8 *)malloc(name->len+1);
+                if (xl->f_cnt[i].name->str)
                 {
-                    memcpy(f_cnt[i].name->str, name->str, name->len);
-                    f_cnt[i].name->str[name->len] = 0;
-                    f_cnt[i].name->uni = name->uni;
-                    f_cnt[i].name->len = name->len;
-                    f_cnt[i].cnt = 1;
+                    memcpy(xl->f_cnt[i].name->str, name->str, name->len);
+                    xl->f_cnt[i].name->str[name->len] = 0;
+                    xl->f_cnt[i].name->uni = name->uni;
+                    xl->f_cnt[i].name->len = name->len;
+                    xl->f_cnt[i].cnt = 1;
                     break;
                 }
             }
@@ -3528,17 +3729,17 @@ void incr_f_cnt(uni_string *name)
     }
 }
 
-int get_default_font(void)
+int get_default_font(xlhtml_ctx *xl)
 {
     int i, m = -1;
 
     for (i=0; i<FONTS_INCR; i++)
     {
-        if (f_cnt[i].name)
+        if (xl->f_cnt[i].name)
         {
-            if (f_cnt[i].name->str)
+            if (xl->f_cnt[i].name->str)
             {
-                if (f_cnt[i].cnt > m)
+                if (xl->f_cnt[i].cnt > m)
                     m = i;
             }
         }
@@ -3546,20 +3747,20 @@ int get_default_font(void)
     return m;
 }
 
-void update_default_alignment(unsigned int sheet, int row)
+void update_default_alignment(xlhtml_ctx *xl, unsigned int sheet, int row)
 {
     int i, left = 0, center = 0, right = 0;
     cell *c;
+    row_entry *re;
 
-    if ((sheet >= max_worksheets)||(ws_array[sheet] == 0))
-        return;
-    if (ws_array[sheet]->c_array == 0)
+    if ((sheet >= xl->max_worksheets)||(xl->ws_array[sheet] == 0))
         return;
 
-    for (i=ws_array[sheet]->first_col; i<=ws_array[sheet]->biggest_col; i++)
+    re = ws_get_row(xl->ws_array[sheet], row);
+    for (i=0; re && i<re->cnt; i++)
     {   /* This stuff happens for each cell... */
-        c = ws_array[sheet]->c_array[(row*ws_array[sheet]->max_cols)+i];
-        if (c)
+        c = re->cols[i].c;
+        if (c && ws_in_view(xl->ws_array[sheet], row, re->cols[i].col))
         {
             int numeric = IsCellNumeric(c);
             if (c->xfmt == 0)
@@ -3568,13 +3769,13 @@ void update_default_alignment(unsigned int sheet, int row)
             }
             else
             {   /* Biff 8 stuff... */
-                if ((c->xfmt < next_xf)&&(c->ustr.str))
+                if ((c->xfmt < xl->next_xf)&&(c->ustr.str))
                 {
                     if (strcmp((char *)c->ustr.str, "&nbsp;"))
                     {
-                        if (xf_array[c->xfmt])
+                        if (xl->xf_array[c->xfmt])
                         {
-                            switch(xf_array[c->xfmt]->align & 0x0007)
+                            switch(xl->xf_array[c->xfmt]->align & 0x0007)
                             {   /* Override default table alignment when needed */
                                 case 2:
                                 case 6:     /* Center across selection */
@@ -3603,17 +3804,17 @@ void update_default_alignment(unsigned int sheet, int row)
         }
     }
     if ((center == 0)&&(left == 0)&&(right == 0))
-        default_alignment = "";
+        xl->default_alignment = "";
     else if ((center >= left)&&(center >= right))       /* Favor center since its the longest word */
-        default_alignment = "center";
+        xl->default_alignment = "center";
     else if ((right >= center)&&(right >= left))
-        default_alignment = "right";            /* Favor right since its second longest */
+        xl->default_alignment = "right";            /* Favor right since its second longest */
     else
-        default_alignment = "left";
+        xl->default_alignment = "left";
 }
 
 
-void OutputString(uni_string *u)
+void OutputString(xlhtml_ctx *xl, uni_string *u)
 {
     unsigned int i;
 
@@ -3624,29 +3825,29 @@ void OutputString(uni_string *u)
     {
         if (null_string(u->str))
         {
-            if (Ascii == 0)
-                printf(OutputXML ? "" : "&nbsp;");
-            else if (!Csv)
-                printf(" ");
+            if (xl->Ascii == 0)
+                xl_printf(xl, xl->OutputXML ? "" : "&nbsp;");
+            else if (!xl->Csv)
+                xl_printf(xl, " ");
         }
         else
         {
-            if (Ascii)  /* If Ascii output requested, simply output the string */
+            if (xl->Ascii)  /* If Ascii output requested, simply output the string */
             {   /* These are broken up for performance */
-                if (Csv)
+                if (xl->Csv)
                 {
                     for (i=0; i<u->len; i++)
                     {
                         if (u->str[i] == 0x22)
-                            printf("\"\"");
+                            xl_printf(xl, "\"\"");
                         else
-                            putchar(u->str[i]);
+                            xl_putc(xl, u->str[i]);
                     }
                 }
                 else
                 {
                     for (i=0; i<u->len; i++)
-                        putchar(u->str[i]);
+                        xl_putc(xl, u->str[i]);
                 }
                 return;
             }
@@ -3665,9 +3866,9 @@ void OutputString(uni_string *u)
                     {   /* Time to change formats */
                         if (format_changed)
                         {   /* if old attributs, close */
-                            output_end_html_attr(&h_flags);
+                            output_end_html_attr(xl, &h_flags);
                             if (h_flags.fflag)
-                                printf("</FONT>");
+                                xl_printf(xl, "</FONT>");
                         }
                         else
                         {   /* FIXME: Also need to consider that a font may already be set for
@@ -3676,8 +3877,8 @@ void OutputString(uni_string *u)
                         }
 
                         /* set new attr */
-                        output_start_font_attribute(&h_flags, fnt_idx);
-                        output_start_html_attr(&h_flags, fnt_idx, 1);
+                        output_start_font_attribute(xl, &h_flags, fnt_idx);
+                        output_start_html_attr(xl, &h_flags, fnt_idx, 1);
 
                         /* get next fmt_run */
                         if (crun_cnt < u->crun_cnt)
@@ -3686,19 +3887,19 @@ void OutputString(uni_string *u)
                             update_crun_info(&loc, &fnt_idx, crun_cnt, u->fmt_run);
                         }
                     }
-                    OutputCharCorrected(u->str[i]);
+                    OutputCharCorrected(xl, u->str[i]);
                 }
                 if (format_changed)
                 {
-                    output_end_html_attr(&h_flags);
+                    output_end_html_attr(xl, &h_flags);
                     if (h_flags.fflag)
-                        printf("</FONT>");
+                        xl_printf(xl, "</FONT>");
                 }
             }
             else
             {
                 for (i=0; i<u->len; i++)
-                    OutputCharCorrected(u->str[i]);
+                    OutputCharCorrected(xl, u->str[i]);
             }
         }
     }
@@ -3706,155 +3907,155 @@ void OutputString(uni_string *u)
     {
         if (u->len == 0)
         {
-            if (Ascii)
-                printf(" ");
+            if (xl->Ascii)
+                xl_printf(xl, " ");
             else
-                printf(OutputXML ? "" : "&nbsp;");
+                xl_printf(xl, xl->OutputXML ? "" : "&nbsp;");
         }
         else
         {
             if (u->len == 2)
             {
                 if (memcmp(u->str, "& ", 2) == 0)
-                    printf("&#8230;");
+                    xl_printf(xl, "&#8230;");
                 else
                 {
                     for (i=0; i<u->len; i+=2)
-                        print_utf8(getShort(&(u->str[i])));
+                        print_utf8(xl, getShort(&(u->str[i])));
                 }
             }
             else
             {
                 for (i=0; i<u->len; i+=2)
-                    print_utf8(getShort(&(u->str[i])));
+                    print_utf8(xl, getShort(&(u->str[i])));
             }
         }
     }   
 }
 
-void OutputCharCorrected(U8 c)
+void OutputCharCorrected(xlhtml_ctx *xl, U8 c)
 {
-    if (MultiByte && (c & 0x80)) 
+    if (xl->MultiByte && (c & 0x80)) 
     {
-        putchar(c);
+        xl_putc(xl, c);
         return;
     }
     switch (c)
     {   /* Special char handlers here... */
         case 0x3C:
-            printf("&lt;");
+            xl_printf(xl, "&lt;");
             break;
         case 0x3E:
-            printf("&gt;");
+            xl_printf(xl, "&gt;");
             break;
         case 0x26:
-            printf("&amp;");
+            xl_printf(xl, "&amp;");
             break;
         case 0x22:
-            printf("&quot;");
+            xl_printf(xl, "&quot;");
             break;
         /* Also need to cover 128-159 since MS uses this area... */
         case 0x80:      /* Euro Symbol */
-            printf("&#8364;");
+            xl_printf(xl, "&#8364;");
             break;
         case 0x82:      /* baseline single quote */
-            printf("&#8218;");
+            xl_printf(xl, "&#8218;");
             break;
         case 0x83:      /* florin */
-            printf("&#402;");
+            xl_printf(xl, "&#402;");
             break;
         case 0x84:      /* baseline double quote */
-            printf("&#8222;");
+            xl_printf(xl, "&#8222;");
             break;
         case 0x85:      /* ellipsis */
-            printf("&#8230;");
+            xl_printf(xl, "&#8230;");
             break;
         case 0x86:      /* dagger */
-            printf("&#8224;");
+            xl_printf(xl, "&#8224;");
             break;
         case 0x87:      /* double dagger */
-            printf("&#8225;");
+            xl_printf(xl, "&#8225;");
             break;
         case 0x88:      /* circumflex accent */
-            printf("&#710;");
+            xl_printf(xl, "&#710;");
             break;
         case 0x89:      /* permile */
-            printf("&#8240;");
+            xl_printf(xl, "&#8240;");
             break;
         case 0x8A:      /* S Hacek */
-            printf("&#352;");
+            xl_printf(xl, "&#352;");
             break;
         case 0x8B:      /* left single guillemet */
-            printf("&#8249;");
+            xl_printf(xl, "&#8249;");
             break;
         case 0x8C:      /* OE ligature */
-            printf("&#338;");
+            xl_printf(xl, "&#338;");
             break;
         case 0x8E:      /*  #LATIN CAPITAL LETTER Z WITH CARON */
-            printf("&#381;");
+            xl_printf(xl, "&#381;");
             break;
         case 0x91:      /* left single quote ? */
-            printf("&#8216;");
+            xl_printf(xl, "&#8216;");
             break;
         case 0x92:      /* right single quote ? */
-            printf("&#8217;");
+            xl_printf(xl, "&#8217;");
             break;
         case 0x93:      /* left double quote */
-            printf("&#8220;");
+            xl_printf(xl, "&#8220;");
             break;
         case 0x94:      /* right double quote */
-            printf("&#8221;");
+            xl_printf(xl, "&#8221;");
             break;
         case 0x95:      /* bullet */
-            printf("&#8226;");
+            xl_printf(xl, "&#8226;");
             break;
         case 0x96:      /* endash */
-            printf("&#8211;");
+            xl_printf(xl, "&#8211;");
             break;
         case 0x97:      /* emdash */
-            printf("&#8212;");
+            xl_printf(xl, "&#8212;");
             break;
         case 0x98:      /* tilde accent */
-            printf("&#732;");
+            xl_printf(xl, "&#732;");
             break;
         case 0x99:      /* trademark ligature */
-            printf("&#8482;");
+            xl_printf(xl, "&#8482;");
             break;
         case 0x9A:      /* s Haceks Hacek */
-            printf("&#353;");
+            xl_printf(xl, "&#353;");
             break;
         case 0x9B:      /* right single guillemet */
-            printf("&#8250;");
+            xl_printf(xl, "&#8250;");
             break;
         case 0x9C:      /* oe ligature */
-            printf("&#339;");
+            xl_printf(xl, "&#339;");
             break;
         case 0x9F:      /* Y Dieresis */
-            printf("&#376;");
+            xl_printf(xl, "&#376;");
             break;
         case 0xE1:              /* a acute */
-            printf("");
+            xl_printf(xl, "");
             break;
         case 0xE9:              /* e acute */
-            printf("");
+            xl_printf(xl, "");
             break;
         case 0xED:              /* i acute */
-            printf("");
+            xl_printf(xl, "");
             break;
         case 0xF3:              /* o acute */
-             printf("");
+             xl_printf(xl, "");
              break;
         case 0xFA:              /* u acute */
-             printf("");
+             xl_printf(xl, "");
              break;
         case 0xFD:              /* y acute */
-             printf("");
+             xl_printf(xl, "");
              break;
         case 0xB0:              /* degrees */
-             printf("deg.");
+             xl_printf(xl, "deg.");
              break;
         default:
-            putchar(c);
+            xl_putc(xl, c);
             break;
     }
 }
@@ -3870,25 +4071,25 @@ void update_crun_info(U16 *loc, U16 *fmt_idx, U16 crun_cnt, U8 *fmt_run)
     *fmt_idx = tfmt_idx;
 }
 
-void put_utf8(U16 c)
+void put_utf8(xlhtml_ctx *xl, U16 c)
 {
-    putchar((int)0x0080 | (c & 0x003F));
+    xl_putc(xl, (int)0x0080 | (c & 0x003F));
 }
 
-void print_utf8(U16 c)
+void print_utf8(xlhtml_ctx *xl, U16 c)
 {
     if (c < 0x80)
-        OutputCharCorrected(c);
+        OutputCharCorrected(xl, c);
     else if (c < 0x800)
     {
-        putchar(0xC0 | (c >> 6));
-        put_utf8(c);
+        xl_putc(xl, 0xC0 | (c >> 6));
+        put_utf8(xl, c);
     }
     else
     {
-        putchar(0xE0 | (c >> 12));
-        put_utf8((U16)(c >> 6));
-        put_utf8(c);
+        xl_putc(xl, 0xE0 | (c >> 12));
+        put_utf8(xl, (U16)(c >> 6));
+        put_utf8(xl, c);
     }
 }
 
@@ -3930,75 +4131,75 @@ void html_flag_init(html_attr *h)
     h->spflag = 0;
 }
 
-void output_start_font_attribute(html_attr *h, U16 fnt_idx)
+void output_start_font_attribute(xlhtml_ctx *xl, html_attr *h, U16 fnt_idx)
 {
-    if(fnt_idx >= next_font)
+    if(fnt_idx >= xl->next_font)
     {
         return;
     }
-    if (uni_string_comp(&default_font, &(font_array[fnt_idx]->name)) != 0)
+    if (uni_string_comp(&xl->default_font, &(xl->font_array[fnt_idx]->name)) != 0)
     {
         h->fflag = 1;
-        printf("<FONT FACE=\"");
-        OutputString(&(font_array[fnt_idx]->name));
-        printf("\"");
+        xl_printf(xl, "<FONT FACE=\"");
+        OutputString(xl, &(xl->font_array[fnt_idx]->name));
+        xl_printf(xl, "\"");
     }
-    if (font_array[fnt_idx]->c_idx != 0x7FFF)
+    if (xl->font_array[fnt_idx]->c_idx != 0x7FFF)
     {
         char color[8];
-        if (numCustomColors)
+        if (xl->numCustomColors)
         {
-            if ((font_array[fnt_idx]->c_idx < numCustomColors)&&use_colors)
-                strcpy(color, (char *)customColors[font_array[fnt_idx]->c_idx-8]);
+            if ((xl->font_array[fnt_idx]->c_idx < xl->numCustomColors)&&xl->use_colors)
+                strcpy(color, (char *)xl->customColors[xl->font_array[fnt_idx]->c_idx-8]);
             else
                 strcpy(color, "000000");
         }
         else
         {
-            if ((font_array[fnt_idx]->c_idx < MAX_COLORS)&&use_colors)
-                strcpy(color, colorTab[font_array[fnt_idx]->c_idx]);
+            if ((xl->font_array[fnt_idx]->c_idx < MAX_COLORS)&&xl->use_colors)
+                strcpy(color, colorTab[xl->font_array[fnt_idx]->c_idx]);
             else
                 strcpy(color, "000000");
         }
         if (strcmp(color, "000000") != 0)
         {
             if (h->fflag)
-                printf(" COLOR=\"%s\"", color);
+                xl_printf(xl, " COLOR=\"%s\"", color);
             else
             {
                 h->fflag = 1;
-                printf("<FONT COLOR=\"%s\"", color);
+                xl_printf(xl, "<FONT COLOR=\"%s\"", color);
             }
         }
     }
-    if (font_array[fnt_idx]->super & 0x0003)
+    if (xl->font_array[fnt_idx]->super & 0x0003)
     {
         if (h->fflag)
-            printf(" SIZE=2");      /* Sub & Superscript */
+            xl_printf(xl, " SIZE=2");      /* Sub & Superscript */
         else
         {
             h->fflag = 1;
-            printf("<FONT SIZE=2");     /* Sub & Superscript */
+            xl_printf(xl, "<FONT SIZE=2");     /* Sub & Superscript */
         }
     }
     else
     {
         if (h->fflag)
         {
-            if (font_array[fnt_idx]->size != default_fontsize)
-                printf(" SIZE=%d", font_array[fnt_idx]->size);
+            if (xl->font_array[fnt_idx]->size != xl->default_fontsize)
+                xl_printf(xl, " SIZE=%d", xl->font_array[fnt_idx]->size);
         }
         else
         {
-            if (font_array[fnt_idx]->size != default_fontsize)
+            if (xl->font_array[fnt_idx]->size != xl->default_fontsize)
             {
                 h->fflag = 1;
-                printf("<FONT SIZE=%d", font_array[fnt_idx]->size);
+                xl_printf(xl, "<FONT SIZE=%d", xl->font_array[fnt_idx]->size);
             }
         }
     }
     if (h->fflag)
-        printf(">");
+        xl_printf(xl, ">");
 }
 
 
@@ -12,13 +12,12 @@
 #include <ctype.h>		/* For isprint() */
 #include <errno.h>
 #include "version.h"
+#include "libxlhtml.h"
 
 /* Used by packed string array Opcode: 0xFC */
-#define HARD_MAX_ROWS_97	0x7FFE    /*!< Used in add_wb_array to prevent OOM */
-#define HARD_MAX_ROWS_95	0x3FFF    /*!< Used in add_wb_array to prevent OOM */
+#define HARD_MAX_ROWS_97	0xFFFF    /*!< Last row of a biff8 sheet, checked in add_wb_array */
+#define HARD_MAX_ROWS_95	0x3FFF    /*!< Last row of a biff7 sheet, checked in add_wb_array */
 #define HARD_MAX_COLS		256	      /*!< Used in add_wb_array to prevent OOM */
-
-static U16 HARD_MAX_ROWS = HARD_MAX_ROWS_97;
 /**********************************
 *
 *	Don't change anything below here...
@@ -29,6 +28,7 @@ static U16 HARD_MAX_ROWS = HARD_MAX_ROWS_97;
 #define MAX_COLORS		65	/*!< This is the size of the built-in color table */
 #define EXCEL95		0x500		/*!< This is the file stamp for biff7 - Excel 5 & 95 */
 #define EXCEL97		0x600		/*!< This is the file stamp for biff8 - Excel 97 & 2000 */
+#define OUT_SIZE		4096		/*!< Output is handed to the sink in blocks of this size */
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -54,16 +54,30 @@ typedef struct 		/*!< This is everything we need for a cell */
 	uni_string h_link;	/*!< If a hyperlinked cell, this is the link*/
 }cell;
 
+typedef struct		/*!< A populated cell of a row */
+{
+	U16 col;
+	cell *c;
+}col_entry;
+
+typedef struct		/*!< The populated cells of a row, sorted by column */
+{
+	U32 row;
+	U16 cnt;		/*!< Cells in use */
+	U16 size;		/*!< Cells allocated */
+	col_entry *cols;
+}row_entry;
+
 typedef struct	/*!< This encapsulates some information about each worksheet */
 {
 	U32 first_row;
 	S32 biggest_row;
-	U32 max_rows;
 	U16 first_col;
 	S16 biggest_col;
-	U16 max_cols;
 	uni_string ws_title;
-	cell **c_array;
+	row_entry *rows;	/*!< Rows with cells in them, sorted by row */
+	U32 row_cnt;		/*!< Rows in use */
+	U32 row_size;		/*!< Rows allocated */
 	U16 spanned;
 }work_sheet;
 
@@ -108,4 +122,98 @@ typedef struct		/*!< HTML Attribute */
 	int spflag;		/*!< Superscript */
 }html_attr;
 
+struct xlhtml_ctx	/*!< Everything a conversion needs, one per thread converting */
+{
+	/* Command line flags */
+	int use_colors;		/*!< Whether or not to use colors in output */
+	int aggressive;		/*!< Aggressive html optimization */
+	int formula_warnings;	/*!< Whether or not to suppress formula warnings */
+	int disclaimers;	/*!< Whether or not to suppress all other disclaimers */
+	int center_tables;	/*!< Whether or not to center justify tables or leave it left */
+	int trim_edges;		/*!< Whether or not to trim the edges of columns or rows */
+	char default_text_color[7];
+	char default_background_color[7];
+	char *default_image;	/*!< Point to background image */
+	int Ascii;		/*!< Whether or not to out ascii instaed of html */
+	int Csv;		/*!< Whether or not to out csv instaed of html */
+	int OutputXML;		/*!< Output as xml */
+	int DumpPage;		/*!< Dump page count & max cols & rows */
+	int StreamText;		/*!< Output cell text as it is parsed instead of a table */
+	int Xtract;		/*!< Extract a range on a page. */
+	int MultiByte;		/*!< Output as multibyte */
+	int NoHeaders;		/*!< Dont output html header */
+	S16 xp, xr1, xr2, xc1, xc2;	/*!< Extraction info... */
+
+	/* The workbook source, see xlhtml_open_file() & xlhtml_open_buffer() */
+	char filename[256];
+	const U8 *mem;		/*!< The workbook in memory, or 0 to read filename */
+	U32 mem_len;
+
+	/* The output sink, see xlhtml_convert() */
+	xlhtml_sink sink;
+	void *sink_user;
+	U8 out[OUT_SIZE];
+	U32 out_len;
+
+	/* Global data */
+	int file_version;
+	U32 next_string;
+	unsigned int next_font, next_ws_title, next_xf;
+	U8 working_buffer[WBUFF_SIZE];
+	int sheet_count;	/*!< Number of worksheets found */
+	uni_string default_font;	/*!< Font for table */
+	int default_fontsize;	/*!< Default font size for table */
+	char *default_alignment;	/*!< Alignment for table */
+	int first_sheet;	/*!< First worksheet to display */
+	int last_sheet;		/*!< The last worksheet to display */
+	int currency_symbol;	/*!< What to use for currency */
+	U16 str_formula_row;	/*!< Data holders for string formulas */
+	U16 str_formula_col;
+	U16 str_formula_format;
+	U16 hard_max_rows;	/*!< HARD_MAX_ROWS_97 or HARD_MAX_ROWS_95 */
+	int DatesR1904;		/*!< Flag that the dates are based on McIntosh Dates system */
+	int numCustomColors;
+	U8 **customColors;
+	int stream_sheet;	/*!< Worksheet of the last cell written by stream_cell */
+	U16 stream_row;		/*!< Row of the last cell written by stream_cell */
+
+	/* Limits */
+	unsigned int max_fonts;
+	unsigned int max_xformats;
+	unsigned long max_strings;
+	unsigned int max_worksheets;
+
+	/* Global arrays */
+	xf_attr **xf_array;
+	work_sheet **ws_array;
+	uni_string **str_array;
+	font_attr **font_array;
+	fnt_cnt *f_cnt;
+	int fnt_size_cnt[7];	/*!< Html has only 7 sizes... */
+	uni_string author;
+	char *title;
+	char *lastUpdated;
+
+	/* Some Global Flags */
+	int notAccurate;	/*!< Flag used to indicate that stale data was used */
+	int NoFormat;		/*!< Flag used to indicated unimplemented format */
+	int NotImplemented;	/*!< Flag to print unimplemented cell type message */
+	int Unsupported;	/*!< Flag to print unsupported cell type message */
+	int MaxPalExceeded;
+	int MaxXFExceeded;
+	int MaxFormatsExceeded;
+	int MaxColExceeded;
+	int MaxRowExceeded;
+	int MaxWorksheetsExceeded;
+	int MaxStringsExceeded;
+	int MaxFontsExceeded;
+	int UnicodeStrings;	/*!< 0==ASCII, 1==windows-1252, 2==uft-8 */
+	int CodePage;		/*!< Micosoft CodePage as specified in the Excel file. */
+	int tooold;
+};
+
+/* Output goes to the context's sink, these are in xlhtml.c */
+void xl_printf(xlhtml_ctx *, const char *, ...);
+void xl_putc(xlhtml_ctx *, int);
+void xl_flush(xlhtml_ctx *);
 
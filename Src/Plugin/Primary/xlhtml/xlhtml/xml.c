@@ -1,179 +1,157 @@
 
 #include "xlhtml.h"
 
-extern int  first_sheet;
-extern int  last_sheet;
-extern uni_string  default_font;
-extern void trim_sheet_edges(unsigned int);
-extern int  next_ws_title;
-extern void SetupExtraction(void);
-extern void update_default_font(unsigned int);
-extern void OutputString(uni_string * );
-extern char *lastUpdated; 
-extern int  file_version;
-extern int  NoFormat;
-extern int  notAccurate;
-extern int  formula_warnings;
-extern int  disclaimers;
-extern int  NotImplemented;
-extern int  Unsupported;
-extern int  MaxWorksheetsExceeded;
-extern int  MaxRowExceeded;
-extern int  MaxColExceeded;
-extern int  MaxStringsExceeded;
-extern int  MaxFontsExceeded;
-extern int  MaxPalExceeded;
-extern int  MaxXFExceeded;
-extern int  MaxFormatsExceeded;
-extern char colorTab[MAX_COLORS];
-extern char filename[256];
-extern int  UnicodeStrings;
-extern int  CodePage; 
-extern char *title;
-extern void update_default_alignment(unsigned int, int);
-extern void output_cell( cell *, int); 
-extern uni_string author;
-
-work_sheet **ws_array;
-
-
-void OutputTableXML(void)
+extern void trim_sheet_edges(xlhtml_ctx *, unsigned int);
+extern void SetupExtraction(xlhtml_ctx *);
+extern void update_default_font(xlhtml_ctx *, unsigned int);
+extern void OutputString(xlhtml_ctx *, uni_string * );
+extern void update_default_alignment(xlhtml_ctx *, unsigned int, int);
+extern void output_cell(xlhtml_ctx *, cell *, int); 
+extern row_entry *ws_get_row(work_sheet *, U32);
+extern cell *row_next_cell(row_entry *, U16, U16 *);
+
+
+
+void OutputTableXML(xlhtml_ctx *xl)
 {
     int i, j, k;
 
-        printf( "<?xml version=\"1.0\" encoding=\"" );
-        switch (UnicodeStrings)
+        xl_printf(xl, "<?xml version=\"1.0\" encoding=\"" );
+        switch (xl->UnicodeStrings)
     {
         case 0:
-            printf("iso-8859-1\" ?>\n");        /* Latin-1 */
+            xl_printf(xl, "iso-8859-1\" ?>\n");        /* Latin-1 */
             break;
         case 1:
-            printf("windows-1252\"?>\n");       /* Microsoft */
+            xl_printf(xl, "windows-1252\"?>\n");       /* Microsoft */
             break;
         default:
-            printf("utf-8\"?>\n");          /* Unicode */
+            xl_printf(xl, "utf-8\"?>\n");          /* Unicode */
             break;
     }
 
-    SetupExtraction();
+    SetupExtraction(xl);
 
-    printf( "<excel_workbook>\n" );
-    printf( "\t<sheets>\n" );
+    xl_printf(xl, "<excel_workbook>\n" );
+    xl_printf(xl, "\t<sheets>\n" );
 
     /* Here's where we dump the Html Page out */
-    for (i=first_sheet; i<=last_sheet; i++) /* For each worksheet */
+    for (i=xl->first_sheet; i<=xl->last_sheet; i++) /* For each worksheet */
     {
-        trim_sheet_edges(i);
-             update_default_font(i);
-        if (ws_array[i] == 0)
+        trim_sheet_edges(xl, i);
+             update_default_font(xl, i);
+        if (xl->ws_array[i] == 0)
             continue;
-        if ((ws_array[i]->biggest_row == -1)||(ws_array[i]->biggest_col == -1))
-            continue;
-        if (ws_array[i]->c_array == 0)
+        if ((xl->ws_array[i]->biggest_row == -1)||(xl->ws_array[i]->biggest_col == -1))
             continue;
 
-        printf( "\t\t<sheet>\n" );
-        printf( "\t\t\t<page>%d</page>\n", i );
+        xl_printf(xl, "\t\t<sheet>\n" );
+        xl_printf(xl, "\t\t\t<page>%d</page>\n", i );
         
         /* Print its name */
-        if (next_ws_title > 0)
+        if (xl->next_ws_title > 0)
         {
-            if (ws_array[i]->ws_title.str)
+            if (xl->ws_array[i]->ws_title.str)
             {
-                printf("\t\t\t<pagetitle>");
-                OutputString(&ws_array[i]->ws_title);
-                printf("</pagetitle>\n");
+                xl_printf(xl, "\t\t\t<pagetitle>");
+                OutputString(xl, &xl->ws_array[i]->ws_title);
+                xl_printf(xl, "</pagetitle>\n");
             }
             else
-                printf("\t\t\t<pagetitle>(Unknown Page)</pagetitle>\n");
+                xl_printf(xl, "\t\t\t<pagetitle>(Unknown Page)</pagetitle>\n");
         }
 
-        printf( "\t\t\t<firstrow>%ld</firstrow>\n", ws_array[i]->first_row );
-        printf( "\t\t\t<lastrow>%ld</lastrow>\n", ws_array[i]->biggest_row );
-        printf( "\t\t\t<firstcol>%d</firstcol>\n", ws_array[i]->first_col );
-        printf( "\t\t\t<lastcol>%d</lastcol>\n", ws_array[i]->biggest_col );
-        printf( "\t\t\t<rows>\n" );
+        xl_printf(xl, "\t\t\t<firstrow>%ld</firstrow>\n", xl->ws_array[i]->first_row );
+        xl_printf(xl, "\t\t\t<lastrow>%ld</lastrow>\n", xl->ws_array[i]->biggest_row );
+        xl_printf(xl, "\t\t\t<firstcol>%d</firstcol>\n", xl->ws_array[i]->first_col );
+        xl_printf(xl, "\t\t\t<lastcol>%d</lastcol>\n", xl->ws_array[i]->biggest_col );
+        xl_printf(xl, "\t\t\t<rows>\n" );
 
-        for (j=ws_array[i]->first_row; j<=ws_array[i]->biggest_row; j++)
+        for (j=xl->ws_array[i]->first_row; j<=xl->ws_array[i]->biggest_row; j++)
         {
-            update_default_alignment(i, j);
-            printf("\t\t\t\t<row>\n");
-            for (k=ws_array[i]->first_col; k<=ws_array[i]->biggest_col; k++)
+            row_entry *re = ws_get_row(xl->ws_array[i], j);
+            U16 ci = 0;
+
+            update_default_alignment(xl, i, j);
+            xl_printf(xl, "\t\t\t\t<row>\n");
+            for (k=xl->ws_array[i]->first_col; k<=xl->ws_array[i]->biggest_col; k++)
             {
-                printf("\t\t\t\t\t<cell row=\"%d\" col=\"%d\">", j, k );
-                output_cell(ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k], 1); /* This stuff happens for each cell... */
-                printf("</cell>\n" );
-                if (ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k])
+                cell *c = row_next_cell(re, (U16)k, &ci);
+
+                xl_printf(xl, "\t\t\t\t\t<cell row=\"%d\" col=\"%d\">", j, k );
+                output_cell(xl, c, 1); /* This stuff happens for each cell... */
+                xl_printf(xl, "</cell>\n" );
+                if (c)
                 {
-                    if (ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k]->colspan != 0)
-                        k += ws_array[i]->c_array[(j*ws_array[i]->max_cols)+k]->colspan-1;
+                    if (c->colspan != 0)
+                        k += c->colspan-1;
                 }
                                 
             }
 
-            printf("</row>\n");
+            xl_printf(xl, "</row>\n");
         }
-        printf( "\t\t\t</rows>\n" );
-        printf("\t\t</sheet>\n"); 
+        xl_printf(xl, "\t\t\t</rows>\n" );
+        xl_printf(xl, "\t\t</sheet>\n"); 
     }
-     printf( "\t</sheets>\n" );
+     xl_printf(xl, "\t</sheets>\n" );
 
     /* Print the author's name in itallics... */
-    if (author.str)
+    if (xl->author.str)
     {
-        printf("\t<author>");
-        OutputString(&author);
-        printf("</author>\n");
+        xl_printf(xl, "\t<author>");
+        OutputString(xl, &xl->author);
+        xl_printf(xl, "</author>\n");
     }
 
     /* Print when & how the file was last updated. */
-    if (lastUpdated)
-        printf("\t<lastwrite>%s</lastwrite>", lastUpdated);
-    printf( "\t<excelversion>" );
-    switch (file_version)
+    if (xl->lastUpdated)
+        xl_printf(xl, "\t<lastwrite>%s</lastwrite>", xl->lastUpdated);
+    xl_printf(xl, "\t<excelversion>" );
+    switch (xl->file_version)
     {
         case EXCEL95:
-            printf("using Excel 5.0 or 95");
+            xl_printf(xl, "using Excel 5.0 or 95");
             break;
         case EXCEL97:
-            printf("using Excel 97/2000");
+            xl_printf(xl, "using Excel 97/2000");
             break;
         default:
-            printf("using Excel ????");
+            xl_printf(xl, "using Excel ????");
             break;
     }
-    printf("</excelversion>\n");
+    xl_printf(xl, "</excelversion>\n");
     
     /* Next print Disclaimers... */
-    if (NoFormat)
-        printf("\t<noformat>%d</noformat>\n", NoFormat );
-    if ((notAccurate)&&(formula_warnings)&&(disclaimers))
-        printf("\t<accuracy>%d</accuracy>\n", notAccurate );
-    if (NotImplemented&&(disclaimers))
-        printf("\t<notimplemented>%d</notimplemented>\n", NotImplemented );
-    if (Unsupported&&(disclaimers))
-        printf("\t<unsupported>%d</unsupported>\n", Unsupported );
+    if (xl->NoFormat)
+        xl_printf(xl, "\t<noformat>%d</noformat>\n", xl->NoFormat );
+    if ((xl->notAccurate)&&(xl->formula_warnings)&&(xl->disclaimers))
+        xl_printf(xl, "\t<accuracy>%d</accuracy>\n", xl->notAccurate );
+    if (xl->NotImplemented&&(xl->disclaimers))
+        xl_printf(xl, "\t<notimplemented>%d</notimplemented>\n", xl->NotImplemented );
+    if (xl->Unsupported&&(xl->disclaimers))
+        xl_printf(xl, "\t<unsupported>%d</unsupported>\n", xl->Unsupported );
 
     /* Now out exceeded capacity warnings... */
-    if (MaxWorksheetsExceeded)
-        printf("\t<MaxWorksheetsExceeded>The Maximum Number of Worksheets were exceeded, you might want to increase it.</MaxWorksheetsExceeded>\n ");
-    if (MaxRowExceeded)
-        printf("\t<MaxRowExceeded>The Maximum Number of Rows were exceeded, you might want to increase it.</MaxRowExceeded>\n ");
-    if (MaxColExceeded)
-        printf("\t<MaxColExceeded>The Maximum Number of Columns were exceeded, you might want to increase it.</MaxColExceeded>\n");
-    if (MaxStringsExceeded)
-        printf("\t<MaxStringsExceeded>The Maximum Number of Strings were exceeded, you might want to increase it.</MaxStringsExceeded>\n");
-    if (MaxFontsExceeded)
-        printf("\t<MaxFontsExceeded>The Maximum Number of Fonts were exceeded, you might want to increase it.</MaxFontsExceeded>\n");
-    if (MaxPalExceeded)
-        printf("\t<MaxPalExceeded>The Maximum Number of Color Palettes were exceeded, you might want to increase it.</MaxPalExceeded>\n");
-    if (MaxXFExceeded)
-        printf("\t<MaxXFExceeded>The Maximum Number of Extended Formats were exceeded, you might want to increase it.</MaxXFExceeded>\n");
-    if (MaxFormatsExceeded)
-        printf("\t<MaxFormatsExceeded>The Maximum Number of Formats were exceeded, you might want to increase it.</MaxFormatsExceeded>\n");
+    if (xl->MaxWorksheetsExceeded)
+        xl_printf(xl, "\t<MaxWorksheetsExceeded>The Maximum Number of Worksheets were exceeded, you might want to increase it.</MaxWorksheetsExceeded>\n ");
+    if (xl->MaxRowExceeded)
+        xl_printf(xl, "\t<MaxRowExceeded>The Maximum Number of Rows were exceeded, you might want to increase it.</MaxRowExceeded>\n ");
+    if (xl->MaxColExceeded)
+        xl_printf(xl, "\t<MaxColExceeded>The Maximum Number of Columns were exceeded, you might want to increase it.</MaxColExceeded>\n");
+    if (xl->MaxStringsExceeded)
+        xl_printf(xl, "\t<MaxStringsExceeded>The Maximum Number of Strings were exceeded, you might want to increase it.</MaxStringsExceeded>\n");
+    if (xl->MaxFontsExceeded)
+        xl_printf(xl, "\t<MaxFontsExceeded>The Maximum Number of Fonts were exceeded, you might want to increase it.</MaxFontsExceeded>\n");
+    if (xl->MaxPalExceeded)
+        xl_printf(xl, "\t<MaxPalExceeded>The Maximum Number of Color Palettes were exceeded, you might want to increase it.</MaxPalExceeded>\n");
+    if (xl->MaxXFExceeded)
+        xl_printf(xl, "\t<MaxXFExceeded>The Maximum Number of Extended Formats were exceeded, you might want to increase it.</MaxXFExceeded>\n");
+    if (xl->MaxFormatsExceeded)
+        xl_printf(xl, "\t<MaxFormatsExceeded>The Maximum Number of Formats were exceeded, you might want to increase it.</MaxFormatsExceeded>\n");
 
     /* Output Credit */
-    printf("\t<tool>Created with xlhtml %s</tool>\n", VERSION);
-    printf("\t<toollink>http://chicago.sf.net/xlhtml/</toollink>\n");
-     printf( "</excel_workbook>\n" );
+    xl_printf(xl, "\t<tool>Created with xlhtml %s</tool>\n", VERSION);
+    xl_printf(xl, "\t<toollink>http://chicago.sf.net/xlhtml/</toollink>\n");
+     xl_printf(xl, "</excel_workbook>\n" );
 }
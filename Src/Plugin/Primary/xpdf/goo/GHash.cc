@@ -18,46 +18,51 @@
 
 //------------------------------------------------------------------------
 
+// The table uses open addressing with linear probing.  Each bucket
+// keeps the full hash value of its key, so most non-matching buckets
+// are skipped without a string compare.  Removed entries leave a
+// marker behind (so probe sequences stay intact) until the next
+// expand().
+
 struct GHashBucket {
-  GString *key;
+  GString *key;			// NULL for an empty or removed bucket
   union {
     void *p;
     int i;
   } val;
-  GHashBucket *next;
+  Guint h;			// hash value of key
+  GBool removed;		// set if the entry was removed
 };
 
 struct GHashIter {
   int h;
-  GHashBucket *p;
 };
 
+#define gHashInitSize 8
+
 //------------------------------------------------------------------------
 
 GHash::GHash(GBool deleteKeysA) {
   int h;
 
   deleteKeys = deleteKeysA;
-  size = 7;
-  tab = (GHashBucket **)gmalloc(size * sizeof(GHashBucket *));
+  size = gHashInitSize;
+  tab = (GHashBucket *)gmalloc(size * sizeof(GHashBucket));
   for (h = 0; h < size; ++h) {
-    tab[h] = NULL;
+    tab[h].key = NULL;
+    tab[h].removed = gFalse;
   }
-  len = 0;
+  len = nUsed = 0;
 }
 
 GHash::~GHash() {
-  GHashBucket *p;
   int h;
 
-  for (h = 0; h < size; ++h) {
-    while (tab[h]) {
-      p = tab[h];
-      tab[h] = p->next;
-      if (deleteKeys) {
-	delete p->key;
+  if (deleteKeys) {
+    for (h = 0; h < size; ++h) {
+      if (tab[h].key) {
+	delete tab[h].key;
       }
-      delete p;
     }
   }
   gfree(tab);
@@ -65,47 +70,22 @@ GHash::~GHash() {
 
 void GHash::add(GString *key, void *val) {
   GHashBucket *p;
-  int h;
-
-  // expand the table if necessary
-  if (len >= size) {
-    expand();
-  }
 
-  // add the new symbol
-  p = new GHashBucket;
-  p->key = key;
+  p = findFree(key, hash(key));
   p->val.p = val;
-  h = hash(key);
-  p->next = tab[h];
-  tab[h] = p;
-  ++len;
 }
 
 void GHash::add(GString *key, int val) {
   GHashBucket *p;
-  int h;
 
-  // expand the table if necessary
-  if (len >= size) {
-    expand();
-  }
-
-  // add the new symbol
-  p = new GHashBucket;
-  p->key = key;
+  p = findFree(key, hash(key));
   p->val.i = val;
-  h = hash(key);
-  p->next = tab[h];
-  tab[h] = p;
-  ++len;
 }
 
 void *GHash::lookup(GString *key) {
   GHashBucket *p;
-  int h;
 
-  if (!(p = find(key, &h))) {
+  if (!(p = find(key))) {
     return NULL;
   }
   return p->val.p;
@@ -113,9 +93,8 @@ void *GHash::lookup(GString *key) {
 
 int GHash::lookupInt(GString *key) {
   GHashBucket *p;
-  int h;
 
-  if (!(p = find(key, &h))) {
+  if (!(p = find(key))) {
     return 0;
   }
   return p->val.i;
@@ -123,9 +102,8 @@ int GHash::lookupInt(GString *key) {
 
 void *GHash::lookup(char *key) {
   GHashBucket *p;
-  int h;
 
-  if (!(p = find(key, &h))) {
+  if (!(p = find(key))) {
     return NULL;
   }
   return p->val.p;
@@ -133,9 +111,8 @@ void *GHash::lookup(char *key) {
 
 int GHash::lookupInt(char *key) {
   GHashBucket *p;
-  int h;
 
-  if (!(p = find(key, &h))) {
+  if (!(p = find(key))) {
     return 0;
   }
   return p->val.i;
@@ -143,119 +120,82 @@ int GHash::lookupInt(char *key) {
 
 void *GHash::remove(GString *key) {
   GHashBucket *p;
-  GHashBucket **q;
-  void *val;
-  int h;
 
-  if (!(p = find(key, &h))) {
+  if (!(p = find(key))) {
     return NULL;
   }
-  q = &tab[h];
-  while (*q != p) {
-    q = &((*q)->next);
-  }
-  *q = p->next;
   if (deleteKeys) {
     delete p->key;
   }
-  val = p->val.p;
-  delete p;
+  p->key = NULL;
+  p->removed = gTrue;
   --len;
-  return val;
+  return p->val.p;
 }
 
 int GHash::removeInt(GString *key) {
   GHashBucket *p;
-  GHashBucket **q;
-  int val;
-  int h;
 
-  if (!(p = find(key, &h))) {
+  if (!(p = find(key))) {
     return 0;
   }
-  q = &tab[h];
-  while (*q != p) {
-    q = &((*q)->next);
-  }
-  *q = p->next;
   if (deleteKeys) {
     delete p->key;
   }
-  val = p->val.i;
-  delete p;
+  p->key = NULL;
+  p->removed = gTrue;
   --len;
-  return val;
+  return p->val.i;
 }
 
 void *GHash::remove(char *key) {
   GHashBucket *p;
-  GHashBucket **q;
-  void *val;
-  int h;
 
-  if (!(p = find(key, &h))) {
+  if (!(p = find(key))) {
     return NULL;
   }
-  q = &tab[h];
-  while (*q != p) {
-    q = &((*q)->next);
-  }
-  *q = p->next;
   if (deleteKeys) {
     delete p->key;
   }
-  val = p->val.p;
-  delete p;
+  p->key = NULL;
+  p->removed = gTrue;
   --len;
-  return val;
+  return p->val.p;
 }
 
 int GHash::removeInt(char *key) {
   GHashBucket *p;
-  GHashBucket **q;
-  int val;
-  int h;
 
-  if (!(p = find(key, &h))) {
+  if (!(p = find(key))) {
     return 0;
   }
-  q = &tab[h];
-  while (*q != p) {
-    q = &((*q)->next);
-  }
-  *q = p->next;
   if (deleteKeys) {
     delete p->key;
   }
-  val = p->val.i;
-  delete p;
+  p->key = NULL;
+  p->removed = gTrue;
   --len;
-  return val;
+  return p->val.i;
 }
 
 void GHash::startIter(GHashIter **iter) {
   *iter = new GHashIter;
   (*iter)->h = -1;
-  (*iter)->p = NULL;
 }
 
 GBool GHash::getNext(GHashIter **iter, GString **key, void **val) {
   if (!*iter) {
     return gFalse;
   }
-  if ((*iter)->p) {
-    (*iter)->p = (*iter)->p->next;
-  }
-  while (!(*iter)->p) {
+  do {
     if (++(*iter)->h == size) {
       delete *iter;
       *iter = NULL;
       return gFalse;
     }
-    (*iter)->p = tab[(*iter)->h];
-  }
-  *key = (*iter)->p->key;
-  *val = (*iter)->p->val.p;
+  } while (!tab[(*iter)->h].key);
+  *key = tab[(*iter)->h].key;
+  *val = tab[(*iter)->h].val.p;
   return gTrue;
 }
 
@@ -263,19 +203,15 @@ GBool GHash::getNext(GHashIter **iter, GString **key, int *val) {
   if (!*iter) {
     return gFalse;
   }
-  if ((*iter)->p) {
-    (*iter)->p = (*iter)->p->next;
-  }
-  while (!(*iter)->p) {
+  do {
     if (++(*iter)->h == size) {
       delete *iter;
       *iter = NULL;
       return gFalse;
     }
-    (*iter)->p = tab[(*iter)->h];
-  }
-  *key = (*iter)->p->key;
-  *val = (*iter)->p->val.i;
+  } while (!tab[(*iter)->h].key);
+  *key = tab[(*iter)->h].key;
+  *val = tab[(*iter)->h].val.i;
   return gTrue;
 }
 
@@ -284,73 +220,125 @@ void GHash::killIter(GHashIter **iter) {
   *iter = NULL;
 }
 
+// Rebuild the table, dropping removed-entry markers, and growing it
+// so it is at most half full.
 void GHash::expand() {
-  GHashBucket **oldTab;
-  GHashBucket *p;
-  int oldSize, h, i;
+  GHashBucket *oldTab;
+  int oldSize, start, h, i, j;
 
   oldSize = size;
   oldTab = tab;
-  size = 2*size + 1;
-  tab = (GHashBucket **)gmalloc(size * sizeof(GHashBucket *));
-  for (h = 0; h < size; ++h) {
-    tab[h] = NULL;
+  size = gHashInitSize;
+  while (size < 2 * (len + 1)) {
+    size *= 2;
   }
-  for (i = 0; i < oldSize; ++i) {
-    while (oldTab[i]) {
-      p = oldTab[i];
-      oldTab[i] = oldTab[i]->next;
-      h = hash(p->key);
-      p->next = tab[h];
-      tab[h] = p;
+  tab = (GHashBucket *)gmalloc(size * sizeof(GHashBucket));
+  for (h = 0; h < size; ++h) {
+    tab[h].key = NULL;
+    tab[h].removed = gFalse;
+  }
+  // start just past an empty bucket, so entries with the same key are
+  // re-added in their probe order, i.e., most recent first
+  for (start = 0; oldTab[start].key || oldTab[start].removed; ++start) ;
+  for (j = 1; j <= oldSize; ++j) {
+    i = (start + j) & (oldSize - 1);
+    if (oldTab[i].key) {
+      for (h = oldTab[i].h & (size - 1); tab[h].key; h = (h + 1) & (size - 1)) ;
+      tab[h] = oldTab[i];
     }
   }
+  nUsed = len;
   gfree(oldTab);
 }
 
-GHashBucket *GHash::find(GString *key, int *h) {
+// Add a new entry for <key>, and return its bucket (the caller fills
+// in the value).  If <key> is already in the table, the new entry
+// takes the place of the most recent old one in the probe sequence,
+// and the old ones each move down one place, so lookups see the most
+// recently added entry, and the older ones again (in order) once the
+// newer ones are removed.
+GHashBucket *GHash::findFree(GString *key, Guint h) {
+  GHashBucket carry, tmp;
   GHashBucket *p;
+  int i;
+
+  // expand the table if necessary
+  if (4 * (nUsed + 1) > 3 * size) {
+    expand();
+  }
 
-  *h = hash(key);
-  for (p = tab[*h]; p; p = p->next) {
-    if (!p->key->cmp(key)) {
-      return p;
+  carry.key = key;
+  carry.val.p = NULL;
+  carry.h = h;
+  carry.removed = gFalse;
+  p = NULL;
+  for (i = h & (size - 1); tab[i].key; i = (i + 1) & (size - 1)) {
+    if (tab[i].h == h && !tab[i].key->cmp(key)) {
+      tmp = tab[i];
+      tab[i] = carry;
+      carry = tmp;
+      if (!p) {
+	p = &tab[i];
+      }
+    }
+  }
+  if (!tab[i].removed) {
+    ++nUsed;
+  }
+  tab[i] = carry;
+  ++len;
+  return p ? p : &tab[i];
+}
+
+GHashBucket *GHash::find(GString *key) {
+  Guint h;
+  int i;
+
+  h = hash(key);
+  for (i = h & (size - 1);
+       tab[i].key || tab[i].removed;
+       i = (i + 1) & (size - 1)) {
+    if (tab[i].key && tab[i].h == h && !tab[i].key->cmp(key)) {
+      return &tab[i];
     }
   }
   return NULL;
 }
 
-GHashBucket *GHash::find(char *key, int *h) {
-  GHashBucket *p;
+GHashBucket *GHash::find(char *key) {
+  Guint h;
+  int i;
 
-  *h = hash(key);
-  for (p = tab[*h]; p; p = p->next) {
-    if (!p->key->cmp(key)) {
-      return p;
+  h = hash(key);
+  for (i = h & (size - 1);
+       tab[i].key || tab[i].removed;
+       i = (i + 1) & (size - 1)) {
+    if (tab[i].key && tab[i].h == h && !tab[i].key->cmp(key)) {
+      return &tab[i];
     }
   }
   return NULL;
 }
 
-int GHash::hash(GString *key) {
+Guint GHash::hash(GString *key) {
   char *p;
-  unsigned int h;
+  Guint h;
   int i;
 
   h = 0;
   for (p = key->getCString(), i = 0; i < key->getLength(); ++p, ++i) {
-    h = 17 * h + (int)(*p & 0xff);
+    h = 31 * h + (Guint)(*p & 0xff);
   }
-  return (int)(h % size);
+  return h ^ (h >> 16);
 }
 
-int GHash::hash(char *key) {
+Guint GHash::hash(char *key) {
   char *p;
-  unsigned int h;
+  Guint h;
 
   h = 0;
   for (p = key; *p; ++p) {
-    h = 17 * h + (int)(*p & 0xff);
+    h = 31 * h + (Guint)(*p & 0xff);
   }
-  return (int)(h % size);
+  return h ^ (h >> 16);
 }
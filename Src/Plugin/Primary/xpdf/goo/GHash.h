@@ -47,15 +47,17 @@ public:
 private:
 
   void expand();
-  GHashBucket *find(GString *key, int *h);
-  GHashBucket *find(char *key, int *h);
-  int hash(GString *key);
-  int hash(char *key);
+  GHashBucket *find(GString *key);
+  GHashBucket *find(char *key);
+  GHashBucket *findFree(GString *key, Guint h);
+  Guint hash(GString *key);
+  Guint hash(char *key);
 
   GBool deleteKeys;		// set if key strings should be deleted
-  int size;			// number of buckets
+  int size;			// number of buckets (a power of 2)
   int len;			// number of entries
-  GHashBucket **tab;
+  int nUsed;			// number of entries plus removed slots
+  GHashBucket *tab;		// open-addressed bucket table
 };
 
 #define deleteGHash(hash, T)                       \
@@ -26,7 +26,15 @@
 #  if defined(VMS) && (__DECCXX_VER < 50200000)
 #    include <unixlib.h>
 #  endif
+#  if !defined(VMS) && !defined(ACORN) && !defined(MACOS)
+#    include <sys/mman.h>
+#  endif
+#else
+#  include <io.h>
+#  include <fcntl.h>
 #endif // WIN32
+#include <errno.h>
+#include "gmem.h"
 #include "GString.h"
 #include "gfile.h"
 
@@ -425,8 +433,12 @@ GString *makePathAbsolute(GString *path) {
 
 time_t getModTime(char *fileName) {
 #ifdef WIN32
-  //~ should implement this, but it's (currently) only used in xpdf
-  return 0;
+  struct _stat statBuf;
+
+  if (_stat(fileName, &statBuf)) {
+    return 0;
+  }
+  return statBuf.st_mtime;
 #else
   struct stat statBuf;
 
@@ -522,6 +534,58 @@ GBool openTempFile(GString **name, FILE **f, char *mode, char *ext) {
 #endif
 }
 
+GBool openTempFileFor(GString *fileName, GString **name, FILE **f) {
+  static int counter = 0;
+  char buf[32];
+  int pid, i;
+#if !defined(ACORN) && !defined(MACOS) && !defined(VMS)
+  int fd;
+#endif
+
+#if defined(WIN32)
+  pid = (int)GetCurrentProcessId();
+#elif defined(ACORN) || defined(MACOS)
+  pid = 0;
+#else
+  pid = (int)getpid();
+#endif
+  for (i = 0; i < 16; ++i) {
+    sprintf(buf, ".%d-%d.tmp", pid, counter++);
+    *name = fileName->copy()->append(buf);
+#if defined(WIN32)
+    fd = _open((*name)->getCString(),
+	       _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY,
+	       _S_IREAD | _S_IWRITE);
+    if (fd >= 0) {
+      if ((*f = _fdopen(fd, "wb"))) {
+	return gTrue;
+      }
+      _close(fd);
+      remove((*name)->getCString());
+    }
+#elif defined(ACORN) || defined(MACOS) || defined(VMS)
+    if ((*f = fopen((*name)->getCString(), "wb"))) {
+      return gTrue;
+    }
+#else
+    fd = open((*name)->getCString(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd >= 0) {
+      if ((*f = fdopen(fd, "wb"))) {
+	return gTrue;
+      }
+      close(fd);
+      remove((*name)->getCString());
+    }
+#endif
+    delete *name;
+    // another thread may have taken the same counter value
+    if (errno != EEXIST) {
+      break;
+    }
+  }
+  return gFalse;
+}
+
 GBool executeCommand(char *cmd) {
 #ifdef VMS
   return system(cmd) ? gTrue : gFalse;
@@ -703,3 +767,91 @@ void GDir::rewind() {
 #endif
 #endif
 }
+
+//------------------------------------------------------------------------
+// GMappedFile
+//------------------------------------------------------------------------
+
+GMappedFile::GMappedFile(char *fileName) {
+  data = NULL;
+  length = 0;
+#if defined(WIN32)
+  DWORD size;
+
+  mapping = NULL;
+  file = CreateFile(fileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+		    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    file = NULL;
+    return;
+  }
+  size = GetFileSize(file, NULL);
+  if (size == 0xFFFFFFFF || size == 0) {
+    return;
+  }
+  if (!(mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL))) {
+    return;
+  }
+  if ((data = (char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0))) {
+    length = (Guint)size;
+  }
+#elif defined(ACORN) || defined(MACOS) || defined(VMS)
+  FILE *f;
+  long size;
+
+  if (!(f = fopen(fileName, "rb"))) {
+    return;
+  }
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (size > 0) {
+    data = (char *)gmalloc(size);
+    if (fread(data, 1, size, f) == (size_t)size) {
+      length = (Guint)size;
+    } else {
+      gfree(data);
+      data = NULL;
+    }
+  }
+  fclose(f);
+#else
+  struct stat st;
+  void *p;
+  int fd;
+
+  mapped = gFalse;
+  if ((fd = open(fileName, O_RDONLY)) < 0) {
+    return;
+  }
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p != MAP_FAILED) {
+      data = (char *)p;
+      length = (Guint)st.st_size;
+      mapped = gTrue;
+    }
+  }
+  close(fd);
+#endif
+}
+
+GMappedFile::~GMappedFile() {
+#if defined(WIN32)
+  if (data) {
+    UnmapViewOfFile(data);
+  }
+  if (mapping) {
+    CloseHandle(mapping);
+  }
+  if (file) {
+    CloseHandle(file);
+  }
+#elif defined(ACORN) || defined(MACOS) || defined(VMS)
+  gfree(data);
+#else
+  if (mapped) {
+    munmap(data, length);
+  }
+#endif
+}
@@ -85,6 +85,13 @@ extern time_t getModTime(char *fileName);
 // should be "w" or "wb".  Returns true on success.
 extern GBool openTempFile(GString **name, FILE **f, char *mode, char *ext);
 
+// Create a new file next to <fileName>, to be renamed over it once
+// written.  The name includes the process ID and a counter, and the
+// file is created exclusively, so concurrent writers never share a
+// temporary file.  Returns both the name and the file pointer (opened
+// for binary writing).  Returns true on success.
+extern GBool openTempFileFor(GString *fileName, GString **name, FILE **f);
+
 // Execute <command>.  Returns true on success.
 extern GBool executeCommand(char *cmd);
 
@@ -135,4 +142,36 @@ private:
 #endif
 };
 
+//------------------------------------------------------------------------
+// GMappedFile
+//------------------------------------------------------------------------
+
+// Read-only view of the contents of a file.  Where the OS supports it,
+// the file is memory-mapped, so its pages are shared by all processes
+// that map the same file; otherwise the file is read into memory.
+class GMappedFile {
+public:
+
+  GMappedFile(char *fileName);
+  ~GMappedFile();
+
+  // Was the file opened successfully?
+  GBool isOk() { return data != NULL; }
+
+  char *getData() { return data; }
+  Guint getLength() { return length; }
+
+private:
+
+  char *data;			// file contents (NULL on failure)
+  Guint length;			// file length
+#if defined(WIN32)
+  HANDLE file;			// file handle from CreateFile()
+  HANDLE mapping;		// mapping handle from CreateFileMapping()
+#elif defined(ACORN) || defined(MACOS) || defined(VMS)
+#else
+  GBool mapped;			// set if <data> is from mmap()
+#endif
+};
+
 #endif
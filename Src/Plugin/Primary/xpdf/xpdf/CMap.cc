@@ -26,13 +26,21 @@
 
 //------------------------------------------------------------------------
 
-struct CMapVectorEntry {
-  GBool isVector;
-  union {
-    CMapVectorEntry *vector;
-    CID cid;
-  };
-};
+// Each vector entry is either a CID or, if cMapVectorFlag is set, the
+// index of the vector for the next byte of the char code.  Vectors are
+// only ever added after the vector that points to them, which keeps
+// compiled CMap files free of loops.
+#define cMapVectorFlag 0x80000000
+
+#define cMapVector(idx) (vectors + (idx) * 256)
+
+// Compiled CMap files hold a header followed by the vectors.  They are
+// written in native byte order, which the magic number checks.  CMaps
+// that use another CMap are never compiled, because only the top-level
+// file's modification time is recorded.
+#define cMapBinMagic   0x78434d32	// "xCM2"
+#define cMapBinHdrSize 4		// magic, source mod time, wMode,
+					//   nVectors
 
 //------------------------------------------------------------------------
 
@@ -45,13 +53,16 @@ static int getCharFromFile(void *data) {
 CMap *CMap::parse(CMapCache *cache, GString *collectionA,
 		  GString *cMapNameA) {
   FILE *f;
+  GString *fileName, *binFileName;
+  Guint modTime;
   CMap *cmap;
   PSTokenizer *pst;
   char tok1[256], tok2[256], tok3[256];
   int n1, n2, n3;
   Guint start, end;
+  GBool usesCMap;
 
-  if (!(f = globalParams->findCMapFile(collectionA, cMapNameA))) {
+  if (!(f = globalParams->findCMapFile(collectionA, cMapNameA, &fileName))) {
 
     // Check for an identity CMap.
     if (!cMapNameA->cmp("Identity") || !cMapNameA->cmp("Identity-H")) {
@@ -66,7 +77,20 @@ CMap *CMap::parse(CMapCache *cache, GString *collectionA,
     return NULL;
   }
 
+  // use the compiled CMap if it's up to date
+  modTime = (Guint)getModTime(fileName->getCString());
+  delete fileName;
+  if ((binFileName = globalParams->getCMapCacheFile(collectionA, cMapNameA,
+						     ".cmapbin"))) {
+    if ((cmap = parseBinary(collectionA, cMapNameA, binFileName, modTime))) {
+      delete binFileName;
+      fclose(f);
+      return cmap;
+    }
+  }
+
   cmap = new CMap(collectionA->copy(), cMapNameA->copy());
+  usesCMap = gFalse;
 
   pst = new PSTokenizer(&getCharFromFile, f);
   pst->getToken(tok1, sizeof(tok1), &n1);
@@ -74,6 +98,7 @@ CMap *CMap::parse(CMapCache *cache, GString *collectionA,
     if (!strcmp(tok2, "usecmap")) {
       if (tok1[0] == '/') {
 	cmap->useCMap(cache, tok1 + 1);
+	usesCMap = gTrue;
       }
       pst->getToken(tok1, sizeof(tok1), &n1);
     } else if (!strcmp(tok1, "/WMode")) {
@@ -95,7 +120,7 @@ CMap *CMap::parse(CMapCache *cache, GString *collectionA,
 	  sscanf(tok1 + 1, "%x", &start);
 	  sscanf(tok2 + 1, "%x", &end);
 	  n1 = (n1 - 2) / 2;
-	  cmap->addCodeSpace(cmap->vector, start, end, n1);
+	  cmap->addCodeSpace(0, start, end, n1);
 	}
       }
       pst->getToken(tok1, sizeof(tok1), &n1);
@@ -129,20 +154,24 @@ CMap *CMap::parse(CMapCache *cache, GString *collectionA,
 
   fclose(f);
 
+  if (binFileName) {
+    if (!usesCMap) {
+      cmap->writeBinary(binFileName, modTime);
+    }
+    delete binFileName;
+  }
+
   return cmap;
 }
 
 CMap::CMap(GString *collectionA, GString *cMapNameA) {
-  int i;
-
   collection = collectionA;
   cMapName = cMapNameA;
   wMode = 0;
-  vector = (CMapVectorEntry *)gmalloc(256 * sizeof(CMapVectorEntry));
-  for (i = 0; i < 256; ++i) {
-    vector[i].isVector = gFalse;
-    vector[i].cid = 0;
-  }
+  vectors = NULL;
+  nVectors = vectorsSize = 0;
+  addVector();
+  binFile = NULL;
   refCnt = 1;
 #if MULTITHREADED
   gInitMutex(&mutex);
@@ -153,13 +182,90 @@ CMap::CMap(GString *collectionA, GString *cMapNameA, int wModeA) {
   collection = collectionA;
   cMapName = cMapNameA;
   wMode = wModeA;
-  vector = NULL;
+  vectors = NULL;
+  nVectors = vectorsSize = 0;
+  binFile = NULL;
   refCnt = 1;
 #if MULTITHREADED
   gInitMutex(&mutex);
 #endif
 }
 
+// Map a compiled CMap file.  Returns NULL if the file is missing,
+// invalid, or older than the CMap file it was compiled from.
+CMap *CMap::parseBinary(GString *collectionA, GString *cMapNameA,
+			GString *binFileName, Guint modTime) {
+  GMappedFile *mf;
+  Guint *hdr, *vec;
+  Guint nVectorsA, i, j;
+  CMap *cmap;
+
+  mf = new GMappedFile(binFileName->getCString());
+  if (!mf->isOk() || mf->getLength() < cMapBinHdrSize * sizeof(Guint)) {
+    goto err;
+  }
+  hdr = (Guint *)mf->getData();
+  nVectorsA = hdr[3];
+  if (hdr[0] != cMapBinMagic || hdr[1] != modTime || hdr[2] > 1 ||
+      nVectorsA == 0 ||
+      nVectorsA > (mf->getLength() / sizeof(Guint)) / 256 ||
+      mf->getLength() !=
+        (cMapBinHdrSize + nVectorsA * 256) * sizeof(Guint)) {
+    goto err;
+  }
+  vec = hdr + cMapBinHdrSize;
+  for (i = 0; i < nVectorsA; ++i) {
+    for (j = 0; j < 256; ++j, ++vec) {
+      if ((*vec & cMapVectorFlag) &&
+	  ((*vec & ~cMapVectorFlag) <= i ||
+	   (*vec & ~cMapVectorFlag) >= nVectorsA)) {
+	goto err;
+      }
+    }
+  }
+
+  cmap = new CMap(collectionA->copy(), cMapNameA->copy(), (int)hdr[2]);
+  cmap->vectors = hdr + cMapBinHdrSize;
+  cmap->nVectors = cmap->vectorsSize = nVectorsA;
+  cmap->binFile = mf;
+  return cmap;
+
+ err:
+  delete mf;
+  return NULL;
+}
+
+// Write the compiled form of this CMap.  The file is written under a
+// temporary name unique to this process and then renamed, so other
+// processes never see a partial file.
+void CMap::writeBinary(GString *binFileName, Guint modTime) {
+  GString *tmpFileName;
+  FILE *f;
+  Guint hdr[cMapBinHdrSize];
+  GBool ok;
+
+  if (!openTempFileFor(binFileName, &tmpFileName, &f)) {
+    return;
+  }
+  hdr[0] = cMapBinMagic;
+  hdr[1] = modTime;
+  hdr[2] = (Guint)wMode;
+  hdr[3] = nVectors;
+  ok = fwrite(hdr, sizeof(Guint), cMapBinHdrSize, f) == cMapBinHdrSize &&
+       fwrite(vectors, 256 * sizeof(Guint), nVectors, f) == nVectors;
+  if (fclose(f)) {
+    ok = gFalse;
+  }
+  if (ok) {
+    remove(binFileName->getCString());
+    ok = !rename(tmpFileName->getCString(), binFileName->getCString());
+  }
+  if (!ok) {
+    remove(tmpFileName->getCString());
+  }
+  delete tmpFileName;
+}
+
 void CMap::useCMap(CMapCache *cache, char *useName) {
   GString *useNameStr;
   CMap *subCMap;
@@ -170,39 +276,50 @@ void CMap::useCMap(CMapCache *cache, char *useName) {
   if (!subCMap) {
     return;
   }
-  copyVector(vector, subCMap->vector);
+  if (subCMap->vectors) {
+    copyVector(0, subCMap, 0);
+  }
   subCMap->decRefCnt();
 }
 
-void CMap::copyVector(CMapVectorEntry *dest, CMapVectorEntry *src) {
-  int i, j;
+// Add a new, all-zero vector.  Returns its index.  This may move the
+// vectors array.
+Guint CMap::addVector() {
+  if (nVectors == vectorsSize) {
+    vectorsSize = vectorsSize ? 2 * vectorsSize : 16;
+    vectors = (Guint *)grealloc(vectors, vectorsSize * 256 * sizeof(Guint));
+  }
+  memset(cMapVector(nVectors), 0, 256 * sizeof(Guint));
+  return nVectors++;
+}
+
+void CMap::copyVector(Guint dest, CMap *src, Guint srcVec) {
+  Guint e, vec;
+  int i;
 
   for (i = 0; i < 256; ++i) {
-    if (src[i].isVector) {
-      if (!dest[i].isVector) {
-	dest[i].isVector = gTrue;
-	dest[i].vector =
-	  (CMapVectorEntry *)gmalloc(256 * sizeof(CMapVectorEntry));
-	for (j = 0; j < 256; ++j) {
-	  dest[i].vector[j].isVector = gFalse;
-	  dest[i].vector[j].cid = 0;
-	}
+    e = src->vectors[srcVec * 256 + i];
+    if (e & cMapVectorFlag) {
+      if (!(cMapVector(dest)[i] & cMapVectorFlag)) {
+	vec = addVector();
+	cMapVector(dest)[i] = cMapVectorFlag | vec;
       }
-      copyVector(dest[i].vector, src[i].vector);
+      copyVector(cMapVector(dest)[i] & ~cMapVectorFlag,
+		 src, e & ~cMapVectorFlag);
     } else {
-      if (dest[i].isVector) {
+      if (cMapVector(dest)[i] & cMapVectorFlag) {
 	error(-1, "Collision in usecmap");
       } else {
-	dest[i].cid = src[i].cid;
+	cMapVector(dest)[i] = e;
       }
     }
   }
 }
 
-void CMap::addCodeSpace(CMapVectorEntry *vec, Guint start, Guint end,
+void CMap::addCodeSpace(Guint vec, Guint start, Guint end,
 			Guint nBytes) {
-  Guint start2, end2;
-  int startByte, endByte, i, j;
+  Guint start2, end2, vec2;
+  int startByte, endByte, i;
 
   if (nBytes > 1) {
     startByte = (start >> (8 * (nBytes - 1))) & 0xff;
@@ -210,43 +327,39 @@ void CMap::addCodeSpace(CMapVectorEntry *vec, Guint start, Guint end,
     start2 = start & ((1 << (8 * (nBytes - 1))) - 1);
     end2 = end & ((1 << (8 * (nBytes - 1))) - 1);
     for (i = startByte; i <= endByte; ++i) {
-      if (!vec[i].isVector) {
-	vec[i].isVector = gTrue;
-	vec[i].vector =
-	  (CMapVectorEntry *)gmalloc(256 * sizeof(CMapVectorEntry));
-	for (j = 0; j < 256; ++j) {
-	  vec[i].vector[j].isVector = gFalse;
-	  vec[i].vector[j].cid = 0;
-	}
+      if (!(cMapVector(vec)[i] & cMapVectorFlag)) {
+	vec2 = addVector();
+	cMapVector(vec)[i] = cMapVectorFlag | vec2;
       }
-      addCodeSpace(vec[i].vector, start2, end2, nBytes - 1);
+      addCodeSpace(cMapVector(vec)[i] & ~cMapVectorFlag,
+		   start2, end2, nBytes - 1);
     }
   }
 }
 
 void CMap::addCIDs(Guint start, Guint end, Guint nBytes, CID firstCID) {
-  CMapVectorEntry *vec;
+  Guint *vec;
   CID cid;
   int byte;
   Guint i;
 
-  vec = vector;
+  vec = cMapVector(0);
   for (i = nBytes - 1; i >= 1; --i) {
     byte = (start >> (8 * i)) & 0xff;
-    if (!vec[byte].isVector) {
+    if (!(vec[byte] & cMapVectorFlag)) {
       error(-1, "Invalid CID (%*x - %*x) in CMap",
 	    2*nBytes, start, 2*nBytes, end);
       return;
     }
-    vec = vec[byte].vector;
+    vec = cMapVector(vec[byte] & ~cMapVectorFlag);
   }
   cid = firstCID;
   for (byte = (int)(start & 0xff); byte <= (int)(end & 0xff); ++byte) {
-    if (vec[byte].isVector) {
+    if (vec[byte] & cMapVectorFlag) {
       error(-1, "Invalid CID (%*x - %*x) in CMap",
 	    2*nBytes, start, 2*nBytes, end);
     } else {
-      vec[byte].cid = cid;
+      vec[byte] = cid & ~cMapVectorFlag;
     }
     ++cid;
   }
@@ -255,25 +368,16 @@ void CMap::addCIDs(Guint start, Guint end, Guint nBytes, CID firstCID) {
 CMap::~CMap() {
   delete collection;
   delete cMapName;
-  if (vector) {
-    freeCMapVector(vector);
+  if (binFile) {
+    delete binFile;
+  } else {
+    gfree(vectors);
   }
 #if MULTITHREADED
   gDestroyMutex(&mutex);
 #endif
 }
 
-void CMap::freeCMapVector(CMapVectorEntry *vec) {
-  int i;
-
-  for (i = 0; i < 256; ++i) {
-    if (vec[i].isVector) {
-      freeCMapVector(vec[i].vector);
-    }
-  }
-  gfree(vec);
-}
-
 void CMap::incRefCnt() {
 #if MULTITHREADED
   gLockMutex(&mutex);
@@ -304,10 +408,10 @@ GBool CMap::match(GString *collectionA, GString *cMapNameA) {
 }
 
 CID CMap::getCID(char *s, int len, int *nUsed) {
-  CMapVectorEntry *vec;
+  Guint *vec;
   int n, i;
 
-  if (!(vec = vector)) {
+  if (!(vec = vectors)) {
     // identity CMap
     *nUsed = 2;
     if (len < 2) {
@@ -322,20 +426,22 @@ CID CMap::getCID(char *s, int len, int *nUsed) {
       return 0;
     }
     i = s[n++] & 0xff;
-    if (!vec[i].isVector) {
+    if (!(vec[i] & cMapVectorFlag)) {
       *nUsed = n;
-      return vec[i].cid;
+      return (CID)vec[i];
     }
-    vec = vec[i].vector;
+    vec = cMapVector(vec[i] & ~cMapVectorFlag);
   }
 }
 
 //------------------------------------------------------------------------
 
-CMapCache::CMapCache() {
+CMapCache::CMapCache(int sizeA) {
   int i;
 
-  for (i = 0; i < cMapCacheSize; ++i) {
+  size = sizeA;
+  cache = (CMap **)gmalloc(size * sizeof(CMap *));
+  for (i = 0; i < size; ++i) {
     cache[i] = NULL;
   }
 }
@@ -343,11 +449,12 @@ CMapCache::CMapCache() {
 CMapCache::~CMapCache() {
   int i;
 
-  for (i = 0; i < cMapCacheSize; ++i) {
+  for (i = 0; i < size; ++i) {
     if (cache[i]) {
       cache[i]->decRefCnt();
     }
   }
+  gfree(cache);
 }
 
 CMap *CMapCache::getCMap(GString *collection, GString *cMapName) {
@@ -358,7 +465,7 @@ CMap *CMapCache::getCMap(GString *collection, GString *cMapName) {
     cache[0]->incRefCnt();
     return cache[0];
   }
-  for (i = 1; i < cMapCacheSize; ++i) {
+  for (i = 1; i < size; ++i) {
     if (cache[i] && cache[i]->match(collection, cMapName)) {
       cmap = cache[i];
       for (j = i; j >= 1; --j) {
@@ -370,10 +477,10 @@ CMap *CMapCache::getCMap(GString *collection, GString *cMapName) {
     }
   }
   if ((cmap = CMap::parse(this, collection, cMapName))) {
-    if (cache[cMapCacheSize - 1]) {
-      cache[cMapCacheSize - 1]->decRefCnt();
+    if (cache[size - 1]) {
+      cache[size - 1]->decRefCnt();
     }
-    for (j = cMapCacheSize - 1; j >= 1; --j) {
+    for (j = size - 1; j >= 1; --j) {
       cache[j] = cache[j - 1];
     }
     cache[0] = cmap;
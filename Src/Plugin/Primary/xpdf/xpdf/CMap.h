@@ -23,7 +23,7 @@
 #endif
 
 class GString;
-struct CMapVectorEntry;
+class GMappedFile;
 class CMapCache;
 
 //------------------------------------------------------------------------
@@ -32,7 +32,9 @@ class CMap {
 public:
 
   // Create the CMap specified by <collection> and <cMapName>.  Sets
-  // the initial reference count to 1.  Returns NULL on failure.
+  // the initial reference count to 1.  Returns NULL on failure.  If
+  // there is a CMap cache directory, a compiled copy of the CMap is
+  // used (and created if it is missing or out of date).
   static CMap *parse(CMapCache *cache, GString *collectionA,
 		     GString *cMapNameA);
 
@@ -60,18 +62,25 @@ private:
 
   CMap(GString *collectionA, GString *cMapNameA);
   CMap(GString *collectionA, GString *cMapNameA, int wModeA);
+  static CMap *parseBinary(GString *collectionA, GString *cMapNameA,
+			   GString *binFileName, Guint modTime);
+  void writeBinary(GString *binFileName, Guint modTime);
   void useCMap(CMapCache *cache, char *useName);
-  void copyVector(CMapVectorEntry *dest, CMapVectorEntry *src);
-  void addCodeSpace(CMapVectorEntry *vec, Guint start, Guint end,
-		    Guint nBytes);
+  Guint addVector();
+  void copyVector(Guint dest, CMap *src, Guint srcVec);
+  void addCodeSpace(Guint vec, Guint start, Guint end, Guint nBytes);
   void addCIDs(Guint start, Guint end, Guint nBytes, CID firstCID);
-  void freeCMapVector(CMapVectorEntry *vec);
 
   GString *collection;
   GString *cMapName;
   int wMode;			// writing mode (0=horizontal, 1=vertical)
-  CMapVectorEntry *vector;	// vector for first byte (NULL for
-				//   identity CMap)
+  Guint *vectors;		// 256-entry vectors, one per byte of
+				//   char code; vector 0 is for the first
+				//   byte (NULL for identity CMap)
+  Guint nVectors;		// number of vectors
+  Guint vectorsSize;		// allocated size of vectors array
+  GMappedFile *binFile;		// compiled CMap file which <vectors>
+				//   points into (NULL if parsed)
   int refCnt;
 #ifdef MULTITHREADED
   GMutex mutex;
@@ -80,12 +89,12 @@ private:
 
 //------------------------------------------------------------------------
 
-#define cMapCacheSize 4
+#define defaultCMapCacheSize 16
 
 class CMapCache {
 public:
 
-  CMapCache();
+  CMapCache(int sizeA);
   ~CMapCache();
 
   // Get the <cMapName> CMap for the specified character collection.
@@ -96,7 +105,8 @@ public:
 
 private:
 
-  CMap *cache[cMapCacheSize];
+  CMap **cache;
+  int size;
 };
 
 #endif
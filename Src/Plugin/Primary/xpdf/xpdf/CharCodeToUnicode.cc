@@ -26,6 +26,11 @@
 
 #define maxUnicodeString 8
 
+// Compiled cidToUnicode files hold a header followed by the map.  They
+// are written in native byte order, which the magic number checks.
+#define ctuBinMagic   0x78435531	// "xCU1"
+#define ctuBinHdrSize 3			// magic, source mod time, mapLen
+
 struct CharCodeToUnicodeString {
   CharCode c;
   Unicode u[maxUnicodeString];
@@ -55,14 +60,23 @@ static int getCharFromFile(void *data) {
 //------------------------------------------------------------------------
 
 CharCodeToUnicode *CharCodeToUnicode::parseCIDToUnicode(GString *fileName,
-							GString *collection) {
+							GString *collection,
+							GString *binFileName) {
   FILE *f;
   Unicode *mapA;
   CharCode size, mapLenA;
   char buf[64];
   Unicode u;
+  Guint modTime;
   CharCodeToUnicode *ctu;
 
+  // use the compiled mapping if it's up to date
+  modTime = (Guint)getModTime(fileName->getCString());
+  if (binFileName &&
+      (ctu = parseBinary(binFileName, collection, modTime))) {
+    return ctu;
+  }
+
   if (!(f = fopen(fileName->getCString(), "r"))) {
     error(-1, "Couldn't open cidToUnicode file '%s'",
 	  fileName->getCString());
@@ -92,9 +106,83 @@ CharCodeToUnicode *CharCodeToUnicode::parseCIDToUnicode(GString *fileName,
   ctu = new CharCodeToUnicode(collection->copy(), mapA, mapLenA, gTrue,
 			      NULL, 0, 0);
   gfree(mapA);
+  if (binFileName) {
+    ctu->writeBinary(binFileName, modTime);
+  }
   return ctu;
 }
 
+// Map a compiled cidToUnicode file.  Returns NULL if the file is
+// missing, invalid, or older than the file it was compiled from.
+CharCodeToUnicode *CharCodeToUnicode::parseBinary(GString *binFileName,
+						  GString *collection,
+						  Guint modTime) {
+  GMappedFile *mf;
+  Guint *hdr;
+  CharCodeToUnicode *ctu;
+
+  mf = new GMappedFile(binFileName->getCString());
+  if (!mf->isOk() || mf->getLength() < ctuBinHdrSize * sizeof(Guint)) {
+    delete mf;
+    return NULL;
+  }
+  hdr = (Guint *)mf->getData();
+  if (hdr[0] != ctuBinMagic || hdr[1] != modTime ||
+      hdr[2] != mf->getLength() / sizeof(Unicode) - ctuBinHdrSize ||
+      mf->getLength() % sizeof(Unicode) != 0) {
+    delete mf;
+    return NULL;
+  }
+  ctu = new CharCodeToUnicode(collection->copy(),
+			      (Unicode *)(hdr + ctuBinHdrSize), hdr[2], gFalse,
+			      NULL, 0, 0);
+  ctu->binFile = mf;
+  return ctu;
+}
+
+// Write the compiled form of this mapping.  The file is written under
+// a temporary name unique to this process and then renamed, so other
+// processes never see a partial file.
+void CharCodeToUnicode::writeBinary(GString *binFileName, Guint modTime) {
+  GString *tmpFileName;
+  FILE *f;
+  Guint hdr[ctuBinHdrSize];
+  GBool ok;
+
+  if (!openTempFileFor(binFileName, &tmpFileName, &f)) {
+    return;
+  }
+  hdr[0] = ctuBinMagic;
+  hdr[1] = modTime;
+  hdr[2] = mapLen;
+  ok = fwrite(hdr, sizeof(Guint), ctuBinHdrSize, f) == ctuBinHdrSize &&
+       fwrite(map, sizeof(Unicode), mapLen, f) == mapLen;
+  if (fclose(f)) {
+    ok = gFalse;
+  }
+  if (ok) {
+    remove(binFileName->getCString());
+    ok = !rename(tmpFileName->getCString(), binFileName->getCString());
+  }
+  if (!ok) {
+    remove(tmpFileName->getCString());
+  }
+  delete tmpFileName;
+}
+
+// Copy a mapped (read-only) map into memory so it can be modified.
+void CharCodeToUnicode::unshareMap() {
+  Unicode *mapA;
+
+  if (binFile) {
+    mapA = (Unicode *)gmalloc(mapLen * sizeof(Unicode));
+    memcpy(mapA, map, mapLen * sizeof(Unicode));
+    map = mapA;
+    delete binFile;
+    binFile = NULL;
+  }
+}
+
 CharCodeToUnicode *CharCodeToUnicode::parseUnicodeToUnicode(
 						    GString *fileName) {
   FILE *f;
@@ -317,6 +405,7 @@ void CharCodeToUnicode::addMapping(CharCode code, char *uStr, int n,
   char uHex[5];
   int j;
 
+  unshareMap();
   if (code >= mapLen) {
     oldLen = mapLen;
     mapLen = (code + 256) & ~255;
@@ -363,6 +452,7 @@ CharCodeToUnicode::CharCodeToUnicode(GString *tagA) {
   }
   sMap = NULL;
   sMapLen = sMapSize = 0;
+  binFile = NULL;
   refCnt = 1;
 #if MULTITHREADED
   gInitMutex(&mutex);
@@ -384,6 +474,7 @@ CharCodeToUnicode::CharCodeToUnicode(GString *tagA, Unicode *mapA,
   sMap = sMapA;
   sMapLen = sMapLenA;
   sMapSize = sMapSizeA;
+  binFile = NULL;
   refCnt = 1;
 #if MULTITHREADED
   gInitMutex(&mutex);
@@ -394,7 +485,11 @@ CharCodeToUnicode::~CharCodeToUnicode() {
   if (tag) {
     delete tag;
   }
-  gfree(map);
+  if (binFile) {
+    delete binFile;
+  } else {
+    gfree(map);
+  }
   if (sMap) {
     gfree(sMap);
   }
@@ -435,6 +530,7 @@ GBool CharCodeToUnicode::match(GString *tagA) {
 void CharCodeToUnicode::setMapping(CharCode c, Unicode *u, int len) {
   int i;
 
+  unshareMap();
   if (len == 1) {
     map[c] = u[0];
   } else {
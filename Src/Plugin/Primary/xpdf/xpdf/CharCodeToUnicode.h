@@ -24,6 +24,7 @@
 #endif
 
 struct CharCodeToUnicodeString;
+class GMappedFile;
 
 //------------------------------------------------------------------------
 
@@ -31,10 +32,13 @@ class CharCodeToUnicode {
 public:
 
   // Read the CID-to-Unicode mapping for <collection> from the file
-  // specified by <fileName>.  Sets the initial reference count to 1.
+  // specified by <fileName>.  If <binFileName> is non-NULL, it names
+  // a compiled copy of the mapping, which is used if it is up to date,
+  // and written otherwise.  Sets the initial reference count to 1.
   // Returns NULL on failure.
   static CharCodeToUnicode *parseCIDToUnicode(GString *fileName,
-					      GString *collection);
+					      GString *collection,
+					      GString *binFileName);
 
   // Create a Unicode-to-Unicode mapping from the file specified by
   // <fileName>.  Sets the initial reference count to 1.  Returns NULL
@@ -69,6 +73,10 @@ public:
 
 private:
 
+  static CharCodeToUnicode *parseBinary(GString *binFileName,
+					GString *collection, Guint modTime);
+  void writeBinary(GString *binFileName, Guint modTime);
+  void unshareMap();
   void parseCMap1(int (*getCharFunc)(void *), void *data, int nBits);
   void addMapping(CharCode code, char *uStr, int n, int offset);
   CharCodeToUnicode(GString *tagA);
@@ -82,6 +90,8 @@ private:
   CharCode mapLen;
   CharCodeToUnicodeString *sMap;
   int sMapLen, sMapSize;
+  GMappedFile *binFile;		// compiled file which <map> points into
+				//   (NULL if <map> was allocated)
   int refCnt;
 #ifdef MULTITHREADED
   GMutex mutex;
@@ -19,6 +19,24 @@
 #include "XRef.h"
 #include "Dict.h"
 
+//------------------------------------------------------------------------
+
+// Dictionaries with more than this many entries (font widths, resource
+// and name dictionaries, etc.) get a hash index; smaller ones are
+// searched linearly, which is faster than hashing the key.
+#define dictIndexMinLength 16
+
+//------------------------------------------------------------------------
+
+static inline Guint hashKey(char *key) {
+  Guint h;
+
+  for (h = 0; *key; ++key) {
+    h = 31 * h + (Guint)(*key & 0xff);
+  }
+  return h;
+}
+
 //------------------------------------------------------------------------
 // Dict
 //------------------------------------------------------------------------
@@ -27,6 +45,8 @@ Dict::Dict(XRef *xrefA) {
   xref = xrefA;
   entries = NULL;
   size = length = 0;
+  index = NULL;
+  indexSize = 0;
   ref = 1;
 }
 
@@ -38,6 +58,7 @@ Dict::~Dict() {
     entries[i].val.free();
   }
   gfree(entries);
+  gfree(index);
 }
 
 void Dict::add(char *key, Object *val) {
@@ -52,11 +73,59 @@ void Dict::add(char *key, Object *val) {
   entries[length].key = key;
   entries[length].val = *val;
   ++length;
+  if (index) {
+    if (2 * length > indexSize) {
+      rebuildIndex();
+    } else {
+      addToIndex(length - 1);
+    }
+  } else if (length > dictIndexMinLength) {
+    rebuildIndex();
+  }
 }
 
-inline DictEntry *Dict::find(char *key) {
+void Dict::rebuildIndex() {
   int i;
 
+  indexSize = indexSize ? 2 * indexSize : 64;
+  while (indexSize < 2 * length) {
+    indexSize *= 2;
+  }
+  gfree(index);
+  index = (int *)gmalloc(indexSize * sizeof(int));
+  memset(index, 0, indexSize * sizeof(int));
+  for (i = 0; i < length; ++i) {
+    addToIndex(i);
+  }
+}
+
+void Dict::addToIndex(int i) {
+  int h;
+
+  h = (int)(hashKey(entries[i].key) & (indexSize - 1));
+  while (index[h]) {
+    // keep the first entry for a duplicated key, as the linear search
+    // does
+    if (!strcmp(entries[i].key, entries[index[h] - 1].key)) {
+      return;
+    }
+    h = (h + 1) & (indexSize - 1);
+  }
+  index[h] = i + 1;
+}
+
+inline DictEntry *Dict::find(char *key) {
+  int h, i;
+
+  if (index) {
+    h = (int)(hashKey(key) & (indexSize - 1));
+    while ((i = index[h])) {
+      if (!strcmp(key, entries[i - 1].key))
+	return &entries[i - 1];
+      h = (h + 1) & (indexSize - 1);
+    }
+    return NULL;
+  }
   for (i = 0; i < length; ++i) {
     if (!strcmp(key, entries[i].key))
       return &entries[i];
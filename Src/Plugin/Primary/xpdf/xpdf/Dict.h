@@ -69,9 +69,14 @@ private:
   DictEntry *entries;		// array of entries
   int size;			// size of <entries> array
   int length;			// number of entries in dictionary
+  int *index;			// hash index: entry number + 1, or 0 if
+				//   empty (NULL for small dictionaries)
+  int indexSize;		// size of <index> array (a power of 2)
   int ref;			// reference count
 
   DictEntry *find(char *key);
+  void rebuildIndex();
+  void addToIndex(int i);
 };
 
 #endif
@@ -23,6 +23,7 @@
 #include "Array.h"
 #include "Dict.h"
 #include "Stream.h"
+#include "JPXStream.h"
 #include "Lexer.h"
 #include "Parser.h"
 #include "GfxFont.h"
@@ -2537,6 +2538,9 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
   Object maskObj;
   GBool haveMask;
   int maskColors[2*gfxColorMaxComps];
+  double *ctm;
+  double devW, devH;
+  Guint reduction;
   Object obj1, obj2;
   int i;
 
@@ -2664,6 +2668,22 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
       haveMask = gTrue;
     }
 
+    // skip the JPEG 2000 resolution levels that wouldn't be visible at
+    // the size the image is drawn on the device (e.g., thumbnails and
+    // low-resolution previews)
+    if (str->getKind() == strJPX && out->useReducedImages()) {
+      ctm = state->getCTM();
+      devW = sqrt(ctm[0] * ctm[0] + ctm[1] * ctm[1]);
+      devH = sqrt(ctm[2] * ctm[2] + ctm[3] * ctm[3]);
+      reduction = 0;
+      while (reduction < 16 &&
+	     (width >> (reduction + 1)) >= devW &&
+	     (height >> (reduction + 1)) >= devH) {
+	++reduction;
+      }
+      ((JPXStream *)str)->setReduction(reduction);
+    }
+
     // draw it
     out->drawImage(state, ref, str, width, height, colorMap,
 		   haveMask ? maskColors : (int *)NULL,  inlineImg);
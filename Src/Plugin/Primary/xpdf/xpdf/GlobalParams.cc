@@ -54,8 +54,8 @@
 
 //------------------------------------------------------------------------
 
-#define cidToUnicodeCacheSize     4
-#define unicodeToUnicodeCacheSize 4
+#define defaultCIDToUnicodeCacheSize 16
+#define unicodeToUnicodeCacheSize    4
 
 //------------------------------------------------------------------------
 
@@ -91,6 +91,27 @@ static char *displayFontDirs[] = {
 
 GlobalParams *globalParams = NULL;
 
+//------------------------------------------------------------------------
+
+// Collection and CMap names come from the PDF file, so only plain names
+// (letters, digits, '-', '_', '+', and non-leading '.') are used to
+// build cache file names.
+static GBool isCacheFileName(GString *name) {
+  char *p;
+
+  p = name->getCString();
+  if (!*p || *p == '.') {
+    return gFalse;
+  }
+  for (; *p; ++p) {
+    if (!(isalnum(*p & 0xff) || *p == '-' || *p == '_' || *p == '+' ||
+	  *p == '.')) {
+      return gFalse;
+    }
+  }
+  return gTrue;
+}
+
 //------------------------------------------------------------------------
 // DisplayFontParam
 //------------------------------------------------------------------------
@@ -239,12 +260,9 @@ GlobalParams::GlobalParams(char *cfgFileName) {
   mapNumericCharNames = gTrue;
   printCommands = gFalse;
   errQuiet = gFalse;
-
-  cidToUnicodeCache = new CharCodeToUnicodeCache(cidToUnicodeCacheSize);
-  unicodeToUnicodeCache =
-      new CharCodeToUnicodeCache(unicodeToUnicodeCacheSize);
-  unicodeMapCache = new UnicodeMapCache();
-  cMapCache = new CMapCache();
+  cMapCacheDir = NULL;
+  cMapCacheSize = defaultCMapCacheSize;
+  cidToUnicodeCacheSize = defaultCIDToUnicodeCacheSize;
 
   // set up the initial nameToUnicode table
   for (i = 0; nameToUnicodeTab[i].name; ++i) {
@@ -306,6 +324,13 @@ GlobalParams::GlobalParams(char *cfgFileName) {
     delete fileName;
     fclose(f);
   }
+
+  // the cache sizes can be set in the config file
+  cidToUnicodeCache = new CharCodeToUnicodeCache(cidToUnicodeCacheSize);
+  unicodeToUnicodeCache =
+      new CharCodeToUnicodeCache(unicodeToUnicodeCacheSize);
+  unicodeMapCache = new UnicodeMapCache();
+  cMapCache = new CMapCache(cMapCacheSize);
 }
 
 void GlobalParams::parseFile(GString *fileName, FILE *f) {
@@ -366,6 +391,13 @@ void GlobalParams::parseFile(GString *fileName, FILE *f) {
 	parseCMapDir(tokens, fileName, line);
       } else if (!cmd->cmp("toUnicodeDir")) {
 	parseToUnicodeDir(tokens, fileName, line);
+      } else if (!cmd->cmp("cMapCacheDir")) {
+	parseCommand("cMapCacheDir", &cMapCacheDir, tokens, fileName, line);
+      } else if (!cmd->cmp("cMapCacheSize")) {
+	parseInteger("cMapCacheSize", &cMapCacheSize, tokens, fileName, line);
+      } else if (!cmd->cmp("cidToUnicodeCacheSize")) {
+	parseInteger("cidToUnicodeCacheSize", &cidToUnicodeCacheSize,
+		     tokens, fileName, line);
       } else if (!cmd->cmp("displayFontT1")) {
 	parseDisplayFont(tokens, displayFonts, displayFontT1, fileName, line);
       } else if (!cmd->cmp("displayFontTT")) {
@@ -825,6 +857,37 @@ void GlobalParams::parseYesNo(char *cmdName, GBool *flag,
   }
 }
 
+void GlobalParams::parseInteger(char *cmdName, int *val,
+				GList *tokens, GString *fileName, int line) {
+  GString *tok;
+  int i;
+
+  if (tokens->getLength() != 2) {
+    error(-1, "Bad '%s' config file command (%s:%d)",
+	  cmdName, fileName->getCString(), line);
+    return;
+  }
+  tok = (GString *)tokens->get(1);
+  if (tok->getLength() == 0) {
+    error(-1, "Bad '%s' config file command (%s:%d)",
+	  cmdName, fileName->getCString(), line);
+    return;
+  }
+  for (i = 0; i < tok->getLength(); ++i) {
+    if (tok->getChar(i) < '0' || tok->getChar(i) > '9') {
+      error(-1, "Bad '%s' config file command (%s:%d)",
+	    cmdName, fileName->getCString(), line);
+      return;
+    }
+  }
+  if ((i = atoi(tok->getCString())) < 1) {
+    error(-1, "Bad '%s' config file command (%s:%d)",
+	  cmdName, fileName->getCString(), line);
+    return;
+  }
+  *val = i;
+}
+
 GBool GlobalParams::parseYesNo2(char *token, GBool *flag) {
   if (!strcmp(token, "yes")) {
     *flag = gTrue;
@@ -869,6 +932,9 @@ GlobalParams::~GlobalParams() {
   if (movieCommand) {
     delete movieCommand;
   }
+  if (cMapCacheDir) {
+    delete cMapCacheDir;
+  }
 
   cMapDirs->startIter(&iter);
   while (cMapDirs->getNext(&iter, &key, (void **)&list)) {
@@ -976,7 +1042,8 @@ FILE *GlobalParams::getUnicodeMapFile(GString *encodingName) {
   return f;
 }
 
-FILE *GlobalParams::findCMapFile(GString *collection, GString *cMapName) {
+FILE *GlobalParams::findCMapFile(GString *collection, GString *cMapName,
+				 GString **fileNameA) {
   GList *list;
   GString *dir;
   GString *fileName;
@@ -992,11 +1059,12 @@ FILE *GlobalParams::findCMapFile(GString *collection, GString *cMapName) {
     dir = (GString *)list->get(i);
     fileName = appendToPath(dir->copy(), cMapName->getCString());
     f = fopen(fileName->getCString(), "r");
-    delete fileName;
     if (f) {
       unlockGlobalParams;
+      *fileNameA = fileName;
       return f;
     }
+    delete fileName;
   }
   unlockGlobalParams;
   return NULL;
@@ -1352,15 +1420,53 @@ GBool GlobalParams::getErrQuiet() {
   return q;
 }
 
+// Returns the name of the file in the CMap cache directory which holds
+// the compiled form of <name> (a CMap or cidToUnicode file) for
+// <collection>, or NULL if there is no cache directory or either name
+// is unsafe to use as a file name.
+GString *GlobalParams::getCMapCacheFile(GString *collection, GString *name,
+					char *ext) {
+  GString *s;
+
+  lockGlobalParams;
+  s = getCMapCacheFile2(collection, name, ext);
+  unlockGlobalParams;
+  return s;
+}
+
+GString *GlobalParams::getCMapCacheFile2(GString *collection, GString *name,
+					 char *ext) {
+  GString *s, *path;
+
+  if (!cMapCacheDir ||
+      !isCacheFileName(collection) || (name && !isCacheFileName(name))) {
+    return NULL;
+  }
+  s = collection->copy();
+  if (name) {
+    s->append('.')->append(name);
+  }
+  s->append(ext);
+  path = appendToPath(cMapCacheDir->copy(), s->getCString());
+  delete s;
+  return path;
+}
+
 CharCodeToUnicode *GlobalParams::getCIDToUnicode(GString *collection) {
-  GString *fileName;
+  GString *fileName, *binFileName;
   CharCodeToUnicode *ctu;
 
   lockGlobalParams;
   if (!(ctu = cidToUnicodeCache->getCharCodeToUnicode(collection))) {
-    if ((fileName = (GString *)cidToUnicodes->lookup(collection)) &&
-	(ctu = CharCodeToUnicode::parseCIDToUnicode(fileName, collection))) {
-      cidToUnicodeCache->add(ctu);
+    if ((fileName = (GString *)cidToUnicodes->lookup(collection))) {
+      binFileName = getCMapCacheFile2(collection, NULL, ".ctubin");
+      if ((ctu = CharCodeToUnicode::parseCIDToUnicode(fileName, collection,
+						       binFileName))) {
+	cidToUnicodeCache->add(ctu);
+      }
+      if (binFileName) {
+	delete binFileName;
+      }
     }
   }
   unlockGlobalParams;
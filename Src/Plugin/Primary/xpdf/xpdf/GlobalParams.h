@@ -124,7 +124,8 @@ public:
   Unicode mapNameToUnicode(char *charName);
   UnicodeMap *getResidentUnicodeMap(GString *encodingName);
   FILE *getUnicodeMapFile(GString *encodingName);
-  FILE *findCMapFile(GString *collection, GString *cMapName);
+  FILE *findCMapFile(GString *collection, GString *cMapName,
+		     GString **fileNameA);
   FILE *findToUnicodeFile(GString *name);
   DisplayFontParam *getDisplayFont(GString *fontName);
   DisplayFontParam *getDisplayCIDFont(GString *fontName, GString *collection);
@@ -160,6 +161,7 @@ public:
   GBool getMapNumericCharNames();
   GBool getPrintCommands();
   GBool getErrQuiet();
+  GString *getCMapCacheFile(GString *collection, GString *name, char *ext);
 
   CharCodeToUnicode *getCIDToUnicode(GString *collection);
   CharCodeToUnicode *getUnicodeToUnicode(GString *fontName);
@@ -226,8 +228,11 @@ private:
 		    GList *tokens, GString *fileName, int line);
   void parseYesNo(char *cmdName, GBool *flag,
 		  GList *tokens, GString *fileName, int line);
+  void parseInteger(char *cmdName, int *val,
+		    GList *tokens, GString *fileName, int line);
   GBool parseYesNo2(char *token, GBool *flag);
   UnicodeMap *getUnicodeMap2(GString *encodingName);
+  GString *getCMapCacheFile2(GString *collection, GString *name, char *ext);
 
   //----- static tables
 
@@ -295,6 +300,11 @@ private:
   GBool mapNumericCharNames;	// map numeric char names (from font subsets)?
   GBool printCommands;		// print the drawing commands
   GBool errQuiet;		// suppress error messages?
+  GString *cMapCacheDir;	// directory for compiled CMaps and
+				//   cidToUnicode files (NULL if none)
+  int cMapCacheSize;		// number of CMaps kept in memory
+  int cidToUnicodeCacheSize;	// number of cidToUnicode mappings kept
+				//   in memory
 
   CharCodeToUnicodeCache *cidToUnicodeCache;
   CharCodeToUnicodeCache *unicodeToUnicodeCache;
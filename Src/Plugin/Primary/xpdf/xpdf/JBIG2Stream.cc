@@ -666,6 +666,9 @@ public:
   void combine(JBIG2Bitmap *bitmap, int x, int y, Guint combOp);
   Guchar *getDataPtr() { return data; }
   int getDataSize() { return h * line; }
+  Guchar *getLinePtr(int y)
+    { return (y < 0 || y >= h) ? (Guchar *)NULL : data + y * line; }
+  int getLineSize() { return line; }
 
 private:
 
@@ -776,9 +779,56 @@ void JBIG2Bitmap::duplicateRow(int yDest, int ySrc) {
   memcpy(data + yDest * line, data + ySrc * line, line);
 }
 
+// Combine <n> byte-aligned source bytes into the destination, a
+// 32-bit word at a time where possible.
+static void combineAlignedBytes(Guchar *destPtr, Guchar *srcPtr, int n,
+				Guint combOp) {
+  Guint src, dest;
+
+  if (combOp == 4) { // replace
+    memcpy(destPtr, srcPtr, n);
+    return;
+  }
+  for (; n >= 4; n -= 4, destPtr += 4, srcPtr += 4) {
+    memcpy(&src, srcPtr, 4);
+    memcpy(&dest, destPtr, 4);
+    switch (combOp) {
+    case 0: // or
+      dest |= src;
+      break;
+    case 1: // and
+      dest &= src;
+      break;
+    case 2: // xor
+      dest ^= src;
+      break;
+    case 3: // xnor
+      dest ^= ~src;
+      break;
+    }
+    memcpy(destPtr, &dest, 4);
+  }
+  for (; n > 0; --n, ++destPtr, ++srcPtr) {
+    switch (combOp) {
+    case 0: // or
+      *destPtr |= *srcPtr;
+      break;
+    case 1: // and
+      *destPtr &= *srcPtr;
+      break;
+    case 2: // xor
+      *destPtr ^= *srcPtr;
+      break;
+    case 3: // xnor
+      *destPtr ^= *srcPtr ^ 0xff;
+      break;
+    }
+  }
+}
+
 void JBIG2Bitmap::combine(JBIG2Bitmap *bitmap, int x, int y,
 			  Guint combOp) {
-  int x0, x1, y0, y1, xx, yy;
+  int x0, x1, y0, y1, xx, yy, n;
   Guchar *srcPtr, *destPtr;
   Guint src0, src1, src, dest, s1, s2, m1, m2, m3;
   GBool oneByte;
@@ -906,7 +956,16 @@ void JBIG2Bitmap::combine(JBIG2Bitmap *bitmap, int x, int y,
 	xx = x0;
       }
 
-      // middle bytes
+      // middle bytes -- if the source is byte-aligned with the
+      // destination, these can be combined without any shifting
+      if (s1 == 0 && xx < x1 - 8) {
+	n = (x1 - 1 - xx) >> 3;
+	combineAlignedBytes(destPtr, srcPtr, n, combOp);
+	destPtr += n;
+	srcPtr += n;
+	src1 = srcPtr[-1];
+	xx += n << 3;
+      }
       for (; xx < x1 - 8; xx += 8) {
 	dest = *destPtr;
 	src0 = src1;
@@ -2435,13 +2494,16 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
 					    int *atx, int *aty,
 					    int mmrDataLength) {
   JBIG2Bitmap *bitmap;
-  GBool ltp;
+  GBool ltp, fast;
   Guint ltpCX, cx, cx0, cx1, cx2;
   JBIG2BitmapPtr cxPtr0, cxPtr1;
   JBIG2BitmapPtr atPtr0, atPtr1, atPtr2, atPtr3;
+  Guchar *winLine[6], *linePtr;
+  Guint win[6];
   int *refLine, *codingLine;
   int code1, code2, code3;
   int x, y, a0, pix, i, refI, codingI;
+  int nAT, nWin, lineSize, b, k;
 
   bitmap = new JBIG2Bitmap(0, w, h);
   bitmap->clearToZero();
@@ -2620,6 +2682,21 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
       }
     }
 
+    // the fast path below reads the context pixels from the two
+    // previous rows and the AT pixels through 24-bit windows that
+    // slide a byte at a time; this works as long as every AT pixel is
+    // in a previous row and no more than 8 pixels left or right of
+    // the current one (which covers the nominal AT positions)
+    nAT = templ == 0 ? 4 : 1;
+    nWin = 2 + nAT;
+    fast = gTrue;
+    for (i = 0; i < nAT; ++i) {
+      if (aty[i] >= 0 || atx[i] < -8 || atx[i] > 8) {
+	fast = gFalse;
+      }
+    }
+    lineSize = bitmap->getLineSize();
+
     ltp = 0;
     cx = cx0 = cx1 = cx2 = 0; // make gcc happy
     for (y = 0; y < h; ++y) {
@@ -2635,6 +2712,99 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
 	}
       }
 
+      if (fast) {
+
+	// set up the windows: win[i] holds the pixels from 8 to the
+	// left through 15 to the right of the first pixel in the
+	// current byte, so pixel x + dx is at bit 15 - (x & 7) - dx
+	winLine[0] = bitmap->getLinePtr(y - 2);
+	winLine[1] = bitmap->getLinePtr(y - 1);
+	for (i = 0; i < nAT; ++i) {
+	  winLine[2 + i] = bitmap->getLinePtr(y + aty[i]);
+	}
+	for (i = 0; i < nWin; ++i) {
+	  if (winLine[i]) {
+	    win[i] = winLine[i][0] << 8;
+	    if (lineSize > 1) {
+	      win[i] |= winLine[i][1];
+	    }
+	  } else {
+	    win[i] = 0;
+	  }
+	}
+	linePtr = bitmap->getLinePtr(y);
+	cx2 = 0;
+
+	// decode the row
+	for (x = 0, b = 0; x < w; ++b) {
+	  if (b > 0) {
+	    for (i = 0; i < nWin; ++i) {
+	      win[i] = (win[i] << 8) & 0xffffff;
+	      if (winLine[i] && b + 1 < lineSize) {
+		win[i] |= winLine[i][b + 1];
+	      }
+	    }
+	  }
+	  for (k = 0; k < 8 && x < w; ++k, ++x) {
+
+	    // build the context
+	    switch (templ) {
+	    case 0:
+	      cx = (((win[0] >> (14 - k)) & 0x07) << 13) |
+		   (((win[1] >> (13 - k)) & 0x1f) << 8) |
+		   (cx2 << 4) |
+		   (((win[2] >> (15 - k - atx[0])) & 1) << 3) |
+		   (((win[3] >> (15 - k - atx[1])) & 1) << 2) |
+		   (((win[4] >> (15 - k - atx[2])) & 1) << 1) |
+		   ((win[5] >> (15 - k - atx[3])) & 1);
+	      break;
+	    case 1:
+	      cx = (((win[0] >> (13 - k)) & 0x0f) << 9) |
+		   (((win[1] >> (13 - k)) & 0x1f) << 4) |
+		   (cx2 << 1) |
+		   ((win[2] >> (15 - k - atx[0])) & 1);
+	      break;
+	    case 2:
+	      cx = (((win[0] >> (14 - k)) & 0x07) << 7) |
+		   (((win[1] >> (14 - k)) & 0x0f) << 3) |
+		   (cx2 << 1) |
+		   ((win[2] >> (15 - k - atx[0])) & 1);
+	      break;
+	    case 3:
+	      cx = (((win[1] >> (14 - k)) & 0x1f) << 5) |
+		   (cx2 << 1) |
+		   ((win[2] >> (15 - k - atx[0])) & 1);
+	      break;
+	    }
+
+	    // check for a skipped pixel
+	    if (useSkip && skip->getPixel(x, y)) {
+	      pix = 0;
+
+	    // decode the pixel
+	    } else if ((pix = arithDecoder->decodeBit(cx,
+						      genericRegionStats))) {
+	      linePtr[b] |= 0x80 >> k;
+	    }
+
+	    // update the context
+	    switch (templ) {
+	    case 0:
+	    case 3:
+	      cx2 = ((cx2 << 1) | pix) & 0x0f;
+	      break;
+	    case 1:
+	      cx2 = ((cx2 << 1) | pix) & 0x07;
+	      break;
+	    case 2:
+	      cx2 = ((cx2 << 1) | pix) & 0x03;
+	      break;
+	    }
+	  }
+	}
+	continue;
+      }
+
       switch (templ) {
       case 0:
 
@@ -13,6 +13,9 @@
 #endif
 
 #include "gmem.h"
+#if MULTITHREADED
+#include "GMutex.h"
+#endif
 #include "Error.h"
 #include "JArithmeticDecoder.h"
 #include "JPXStream.h"
@@ -58,6 +61,56 @@
 
 //------------------------------------------------------------------------
 
+#if MULTITHREADED
+
+// maximum number of threads (including the calling thread) used to
+// decode tiles in parallel
+#define jpxMaxTileThreads    4
+
+// Tiles waiting to be decoded by the worker threads.
+struct JPXTileQueue {
+  JPXStream *str;
+  GMutex mutex;
+  Guint nextTile;		// index of the next tile to be decoded
+  GBool ok;			// cleared if any tile fails to decode
+
+  void run();
+};
+
+void JPXTileQueue::run() {
+  Guint tileIdx;
+
+  while (1) {
+    gLockMutex(&mutex);
+    tileIdx = nextTile++;
+    gUnlockMutex(&mutex);
+    if (tileIdx >= str->img.nXTiles * str->img.nYTiles) {
+      break;
+    }
+    if (!str->decodeTile(&str->img.tiles[tileIdx])) {
+      gLockMutex(&mutex);
+      ok = gFalse;
+      gUnlockMutex(&mutex);
+    }
+  }
+}
+
+#ifdef WIN32
+static DWORD WINAPI jpxTileThread(LPVOID arg) {
+  ((JPXTileQueue *)arg)->run();
+  return 0;
+}
+#else
+static void *jpxTileThread(void *arg) {
+  ((JPXTileQueue *)arg)->run();
+  return NULL;
+}
+#endif
+
+#endif // MULTITHREADED
+
+//------------------------------------------------------------------------
+
 // arithmetic decoder context for the significance propagation and
 // cleanup passes:
 //     [horiz][vert][diag][subband]
@@ -188,6 +241,7 @@ JPXStream::JPXStream(Stream *strA):
   haveChannelDefn = gFalse;
 
   img.tiles = NULL;
+  reduction = 0;
   bitBuf = 0;
   bitBufLen = 0;
   bitBufSkip = gFalse;
@@ -242,6 +296,8 @@ JPXStream::~JPXStream() {
 		      if (subband->cbs) {
 			for (k = 0; k < subband->nXCBs * subband->nYCBs; ++k) {
 			  cb = &subband->cbs[k];
+			  gfree(cb->dataBuf);
+			  gfree(cb->segs);
 			  gfree(cb->coeffs);
 			  if (cb->stats) {
 			    delete cb->stats;
@@ -322,6 +378,7 @@ int JPXStream::lookChar() {
 void JPXStream::fillReadBuf() {
   JPXTileComp *tileComp;
   Guint tileIdx, tx, ty;
+  int rx, ry;
   int pix, pixBits;
 
   do {
@@ -337,6 +394,16 @@ void JPXStream::fillReadBuf() {
 #endif
     tx = jpxCeilDiv((curX - img.xTileOffset) % img.xTileSize, tileComp->hSep);
     ty = jpxCeilDiv((curY - img.yTileOffset) % img.yTileSize, tileComp->vSep);
+    if (tileComp->reduction) {
+      // map to the reduced resolution image, which is stored in the
+      // upper-left corner of the data array
+      rx = (int)((tileComp->x0 + tx) >> tileComp->reduction)
+	   - (int)jpxCeilDivPow2(tileComp->x0, tileComp->reduction);
+      ry = (int)((tileComp->y0 + ty) >> tileComp->reduction)
+	   - (int)jpxCeilDivPow2(tileComp->y0, tileComp->reduction);
+      tx = rx < 0 ? 0 : rx;
+      ty = ry < 0 ? 0 : ry;
+    }
     pix = (int)tileComp->data[ty * (tileComp->x1 - tileComp->x0) + tx];
     pixBits = tileComp->prec;
 #if 1 //~ ignore the palette, assume the PDF ColorSpace object is valid
@@ -661,8 +728,6 @@ GBool JPXStream::readColorSpecBox(Guint dataLen) {
 }
 
 GBool JPXStream::readCodestream(Guint len) {
-  JPXTile *tile;
-  JPXTileComp *tileComp;
   int segType;
   GBool haveSIZ, haveCOD, haveQCD, haveSOT;
   Guint precinctSize, style;
@@ -1144,15 +1209,8 @@ GBool JPXStream::readCodestream(Guint len) {
   }
 
   //----- finish decoding the image
-  for (i = 0; i < img.nXTiles * img.nYTiles; ++i) {
-    tile = &img.tiles[i];
-    for (comp = 0; comp < img.nComps; ++comp) {
-      tileComp = &tile->tileComps[comp];
-      inverseTransform(tileComp);
-    }
-    if (!inverseMultiCompAndDC(tile)) {
-      return gFalse;
-    }
+  if (!decodeTiles()) {
+    return gFalse;
   }
 
   //~ can free memory below tileComps here, and also tileComp.buf
@@ -1541,6 +1599,8 @@ GBool JPXStream::readTilePart() {
       tileComp->y1 = jpxCeilDiv(tile->y1, tileComp->hSep);
       tileComp->cbW = 1 << tileComp->codeBlockW;
       tileComp->cbH = 1 << tileComp->codeBlockH;
+      tileComp->reduction = reduction < tileComp->nDecompLevels
+	                      ? reduction : tileComp->nDecompLevels;
       tileComp->data = (int *)gmalloc((tileComp->x1 - tileComp->x0) *
 				      (tileComp->y1 - tileComp->y0) *
 				      sizeof(int));
@@ -1650,6 +1710,10 @@ GBool JPXStream::readTilePart() {
 		cb->lBlock = 3;
 		cb->nextPass = jpxPassCleanup;
 		cb->nZeroBitPlanes = 0;
+		cb->dataBuf = NULL;
+		cb->dataBufLen = cb->dataBufSize = 0;
+		cb->segs = NULL;
+		cb->nSegs = cb->segsSize = 0;
 		cb->coeffs =
 		    (JPXCoeff *)gmalloc((1 << (tileComp->codeBlockW
 					       + tileComp->codeBlockH))
@@ -1956,308 +2020,459 @@ GBool JPXStream::readTilePartData(Guint tileIdx,
   return gFalse;
 }
 
+// Read the data for one code-block from the current packet.  The data
+// is saved in the code-block and entropy decoded later, by
+// decodeTile(), so that tiles can be decoded independently of the
+// order of the codestream.  Data for resolution levels that are being
+// skipped is discarded.
 GBool JPXStream::readCodeBlockData(JPXTileComp *tileComp,
 				   JPXResLevel *resLevel,
 				   JPXPrecinct *precinct,
 				   JPXSubband *subband,
 				   Guint res, Guint sb,
 				   JPXCodeBlock *cb) {
+  int c;
+  Guint i;
+
+  if (res > tileComp->nDecompLevels - tileComp->reduction) {
+    for (i = 0; i < cb->dataLen; ++i) {
+      if (str->getChar() == EOF) {
+	break;
+      }
+    }
+    return gTrue;
+  }
+
+  if (cb->dataBufLen + cb->dataLen > cb->dataBufSize) {
+    cb->dataBufSize = 2 * cb->dataBufSize + cb->dataLen;
+    cb->dataBuf = (char *)grealloc(cb->dataBuf, cb->dataBufSize);
+  }
+  for (i = 0; i < cb->dataLen; ++i) {
+    // the arithmetic decoder treats EOF like 0xff
+    if ((c = str->getChar()) == EOF) {
+      c = 0xff;
+    }
+    cb->dataBuf[cb->dataBufLen++] = (char)c;
+  }
+
+  if (cb->nSegs == cb->segsSize) {
+    cb->segsSize += 8;
+    cb->segs = (JPXCodeBlockSeg *)grealloc(cb->segs, cb->segsSize *
+					   sizeof(JPXCodeBlockSeg));
+  }
+  cb->segs[cb->nSegs].dataLen = cb->dataLen;
+  cb->segs[cb->nSegs].nCodingPasses = cb->nCodingPasses;
+  ++cb->nSegs;
+
+  return gTrue;
+}
+
+// Entropy decode the saved data for one code-block.
+void JPXStream::decodeCodeBlock(JPXTileComp *tileComp, Guint res, Guint sb,
+				JPXCodeBlock *cb) {
   JPXCoeff *coeff0, *coeff1, *coeff;
+  Stream *cbStr;
+  Object obj;
   JArithmeticDecoder *arithDecoder;
   Guint horiz, vert, diag, all, cx, xorBit;
   int horizSign, vertSign;
-  Guint i, x, y0, y1, y2;
-
-  arithDecoder = new JArithmeticDecoder();
-  arithDecoder->setStream(str, cb->dataLen);
-  arithDecoder->start();
-
-  for (i = 0; i < cb->nCodingPasses; ++i) {
-    switch (cb->nextPass) {
-
-    //----- significance propagation pass
-    case jpxPassSigProp:
-      for (y0 = cb->y0, coeff0 = cb->coeffs;
-	   y0 < cb->y1;
-	   y0 += 4, coeff0 += 4 << tileComp->codeBlockW) {
-	for (x = cb->x0, coeff1 = coeff0;
-	     x < cb->x1;
-	     ++x, ++coeff1) {
-	  for (y1 = 0, coeff = coeff1;
-	       y1 < 4 && y0+y1 < cb->y1;
-	       ++y1, coeff += tileComp->cbW) {
-	    if (!(coeff->flags & jpxCoeffSignificant)) {
-	      horiz = vert = diag = 0;
-	      horizSign = vertSign = 2;
-	      if (x > cb->x0) {
-		if (coeff[-1].flags & jpxCoeffSignificant) {
-		  ++horiz;
-		  horizSign += (coeff[-1].flags & jpxCoeffSign) ? -1 : 1;
-		}
-		if (y0+y1 > cb->y0) {
-		  diag += (coeff[-tileComp->cbW - 1].flags
-			   >> jpxCoeffSignificantB) & 1;
-		}
-		if (y0+y1 < cb->y1 - 1) {
-		  diag += (coeff[tileComp->cbW - 1].flags
-			   >> jpxCoeffSignificantB) & 1;
-		}
-	      }
-	      if (x < cb->x1 - 1) {
-		if (coeff[1].flags & jpxCoeffSignificant) {
-		  ++horiz;
-		  horizSign += (coeff[1].flags & jpxCoeffSign) ? -1 : 1;
-		}
-		if (y0+y1 > cb->y0) {
-		  diag += (coeff[-tileComp->cbW + 1].flags
-			   >> jpxCoeffSignificantB) & 1;
-		}
-		if (y0+y1 < cb->y1 - 1) {
-		  diag += (coeff[tileComp->cbW + 1].flags
-			   >> jpxCoeffSignificantB) & 1;
-		}
-	      }
-	      if (y0+y1 > cb->y0) {
-		if (coeff[-tileComp->cbW].flags & jpxCoeffSignificant) {
-		  ++vert;
-		  vertSign += (coeff[-tileComp->cbW].flags & jpxCoeffSign)
-		              ? -1 : 1;
-		}
-	      }
-	      if (y0+y1 < cb->y1 - 1) {
-		if (coeff[tileComp->cbW].flags & jpxCoeffSignificant) {
-		  ++vert;
-		  vertSign += (coeff[tileComp->cbW].flags & jpxCoeffSign)
-		              ? -1 : 1;
-		}
-	      }
-	      cx = sigPropContext[horiz][vert][diag][res == 0 ? 1 : sb];
-	      if (cx != 0) {
-		if (arithDecoder->decodeBit(cx, cb->stats)) {
-		  coeff->flags |= jpxCoeffSignificant | jpxCoeffFirstMagRef;
-		  coeff->mag = (coeff->mag << 1) | 1;
-		  cx = signContext[horizSign][vertSign][0];
-		  xorBit = signContext[horizSign][vertSign][1];
-		  if (arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
-		    coeff->flags |= jpxCoeffSign;
-		  }
-		}
-		++coeff->len;
-		coeff->flags |= jpxCoeffTouched;
-	      }
-	    }
-	  }
-	}
-      }
-      ++cb->nextPass;
-      break;
+  Guint seg, i, x, y0, y1, y2;
 
-    //----- magnitude refinement pass
-    case jpxPassMagRef:
-      for (y0 = cb->y0, coeff0 = cb->coeffs;
-	   y0 < cb->y1;
-	   y0 += 4, coeff0 += 4 << tileComp->codeBlockW) {
-	for (x = cb->x0, coeff1 = coeff0;
-	     x < cb->x1;
-	     ++x, ++coeff1) {
-	  for (y1 = 0, coeff = coeff1;
-	       y1 < 4 && y0+y1 < cb->y1;
-	       ++y1, coeff += tileComp->cbW) {
-	    if ((coeff->flags & jpxCoeffSignificant) &&
-		!(coeff->flags & jpxCoeffTouched)) {
-	      if (coeff->flags & jpxCoeffFirstMagRef) {
-		all = 0;
+  if (!cb->nSegs) {
+    return;
+  }
+  obj.initNull();
+  cbStr = new MemStream(cb->dataBuf, 0, cb->dataBufLen, &obj);
+  cbStr->reset();
+
+  for (seg = 0; seg < cb->nSegs; ++seg) {
+    arithDecoder = new JArithmeticDecoder();
+    arithDecoder->setStream(cbStr, cb->segs[seg].dataLen);
+    arithDecoder->start();
+
+    for (i = 0; i < cb->segs[seg].nCodingPasses; ++i) {
+      switch (cb->nextPass) {
+
+      //----- significance propagation pass
+      case jpxPassSigProp:
+	for (y0 = cb->y0, coeff0 = cb->coeffs;
+	     y0 < cb->y1;
+	     y0 += 4, coeff0 += 4 << tileComp->codeBlockW) {
+	  for (x = cb->x0, coeff1 = coeff0;
+	       x < cb->x1;
+	       ++x, ++coeff1) {
+	    for (y1 = 0, coeff = coeff1;
+		 y1 < 4 && y0+y1 < cb->y1;
+		 ++y1, coeff += tileComp->cbW) {
+	      if (!(coeff->flags & jpxCoeffSignificant)) {
+		horiz = vert = diag = 0;
+		horizSign = vertSign = 2;
 		if (x > cb->x0) {
-		  all += (coeff[-1].flags >> jpxCoeffSignificantB) & 1;
+		  if (coeff[-1].flags & jpxCoeffSignificant) {
+		    ++horiz;
+		    horizSign += (coeff[-1].flags & jpxCoeffSign) ? -1 : 1;
+		  }
 		  if (y0+y1 > cb->y0) {
-		    all += (coeff[-tileComp->cbW - 1].flags
-			    >> jpxCoeffSignificantB) & 1;
+		    diag += (coeff[-tileComp->cbW - 1].flags
+			     >> jpxCoeffSignificantB) & 1;
 		  }
 		  if (y0+y1 < cb->y1 - 1) {
-		    all += (coeff[tileComp->cbW - 1].flags
-			    >> jpxCoeffSignificantB) & 1;
+		    diag += (coeff[tileComp->cbW - 1].flags
+			     >> jpxCoeffSignificantB) & 1;
 		  }
 		}
 		if (x < cb->x1 - 1) {
-		  all += (coeff[1].flags >> jpxCoeffSignificantB) & 1;
+		  if (coeff[1].flags & jpxCoeffSignificant) {
+		    ++horiz;
+		    horizSign += (coeff[1].flags & jpxCoeffSign) ? -1 : 1;
+		  }
 		  if (y0+y1 > cb->y0) {
-		    all += (coeff[-tileComp->cbW + 1].flags
-			    >> jpxCoeffSignificantB) & 1;
+		    diag += (coeff[-tileComp->cbW + 1].flags
+			     >> jpxCoeffSignificantB) & 1;
 		  }
 		  if (y0+y1 < cb->y1 - 1) {
-		    all += (coeff[tileComp->cbW + 1].flags
-			    >> jpxCoeffSignificantB) & 1;
+		    diag += (coeff[tileComp->cbW + 1].flags
+			     >> jpxCoeffSignificantB) & 1;
 		  }
 		}
 		if (y0+y1 > cb->y0) {
-		  all += (coeff[-tileComp->cbW].flags
-			  >> jpxCoeffSignificantB) & 1;
+		  if (coeff[-tileComp->cbW].flags & jpxCoeffSignificant) {
+		    ++vert;
+		    vertSign += (coeff[-tileComp->cbW].flags & jpxCoeffSign)
+				? -1 : 1;
+		  }
 		}
 		if (y0+y1 < cb->y1 - 1) {
-		  all += (coeff[tileComp->cbW].flags
-			  >> jpxCoeffSignificantB) & 1;
+		  if (coeff[tileComp->cbW].flags & jpxCoeffSignificant) {
+		    ++vert;
+		    vertSign += (coeff[tileComp->cbW].flags & jpxCoeffSign)
+				? -1 : 1;
+		  }
+		}
+		cx = sigPropContext[horiz][vert][diag][res == 0 ? 1 : sb];
+		if (cx != 0) {
+		  if (arithDecoder->decodeBit(cx, cb->stats)) {
+		    coeff->flags |= jpxCoeffSignificant | jpxCoeffFirstMagRef;
+		    coeff->mag = (coeff->mag << 1) | 1;
+		    cx = signContext[horizSign][vertSign][0];
+		    xorBit = signContext[horizSign][vertSign][1];
+		    if (arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
+		      coeff->flags |= jpxCoeffSign;
+		    }
+		  }
+		  ++coeff->len;
+		  coeff->flags |= jpxCoeffTouched;
 		}
-		cx = all ? 15 : 14;
-	      } else {
-		cx = 16;
 	      }
-	      coeff->mag = (coeff->mag << 1) |
-		           arithDecoder->decodeBit(cx, cb->stats);
-	      ++coeff->len;
-	      coeff->flags |= jpxCoeffTouched;
-	      coeff->flags &= ~jpxCoeffFirstMagRef;
 	    }
 	  }
 	}
-      }
-      ++cb->nextPass;
-      break;
-
-    //----- cleanup pass
-    case jpxPassCleanup:
-      for (y0 = cb->y0, coeff0 = cb->coeffs;
-	   y0 < cb->y1;
-	   y0 += 4, coeff0 += 4 << tileComp->codeBlockW) {
-	for (x = cb->x0, coeff1 = coeff0;
-	     x < cb->x1;
-	     ++x, ++coeff1) {
-	  y1 = 0;
-	  if (y0 + 3 < cb->y1 &&
-	      !(coeff1->flags & jpxCoeffTouched) &&
-	      !(coeff1[tileComp->cbW].flags & jpxCoeffTouched) &&
-	      !(coeff1[2 * tileComp->cbW].flags & jpxCoeffTouched) &&
-	      !(coeff1[3 * tileComp->cbW].flags & jpxCoeffTouched) &&
-	      (x == cb->x0 || y0 == cb->y0 ||
-	       !(coeff1[-tileComp->cbW - 1].flags
-		 & jpxCoeffSignificant)) &&
-	      (y0 == cb->y0 ||
-	       !(coeff1[-tileComp->cbW].flags & jpxCoeffSignificant)) &&
-	      (x == cb->x1 - 1 || y0 == cb->y0 ||
-	       !(coeff1[-tileComp->cbW + 1].flags & jpxCoeffSignificant)) &&
-	      (x == cb->x0 ||
-	       (!(coeff1[-1].flags & jpxCoeffSignificant) &&
-		!(coeff1[tileComp->cbW - 1].flags
-		  & jpxCoeffSignificant) &&
-		!(coeff1[2 * tileComp->cbW - 1].flags
-		  & jpxCoeffSignificant) && 
-		!(coeff1[3 * tileComp->cbW - 1].flags
-		  & jpxCoeffSignificant))) &&
-	      (x == cb->x1 - 1 ||
-	       (!(coeff1[1].flags & jpxCoeffSignificant) &&
-		!(coeff1[tileComp->cbW + 1].flags
-		  & jpxCoeffSignificant) &&
-		!(coeff1[2 * tileComp->cbW + 1].flags
-		  & jpxCoeffSignificant) &&
-		!(coeff1[3 * tileComp->cbW + 1].flags
-		  & jpxCoeffSignificant))) &&
-	      (x == cb->x0 || y0+4 == cb->y1 ||
-	       !(coeff1[4 * tileComp->cbW - 1].flags & jpxCoeffSignificant)) &&
-	      (y0+4 == cb->y1 ||
-	       !(coeff1[4 * tileComp->cbW].flags & jpxCoeffSignificant)) &&
-	      (x == cb->x1 - 1 || y0+4 == cb->y1 ||
-	       !(coeff1[4 * tileComp->cbW + 1].flags
-		 & jpxCoeffSignificant))) {
-	    if (arithDecoder->decodeBit(jpxContextRunLength, cb->stats)) {
-	      y1 = arithDecoder->decodeBit(jpxContextUniform, cb->stats);
-	      y1 = (y1 << 1) |
-		   arithDecoder->decodeBit(jpxContextUniform, cb->stats);
-	      for (y2 = 0, coeff = coeff1;
-		   y2 < y1;
-		   ++y2, coeff += tileComp->cbW) {
-		++coeff->len;
-	      }
-	      coeff->flags |= jpxCoeffSignificant | jpxCoeffFirstMagRef;
-	      coeff->mag = (coeff->mag << 1) | 1;
-	      ++coeff->len;
-	      cx = signContext[2][2][0];
-	      xorBit = signContext[2][2][1];
-	      if (arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
-		coeff->flags |= jpxCoeffSign;
-	      }
-	      ++y1;
-	    } else {
-	      for (y1 = 0, coeff = coeff1;
-		   y1 < 4;
-		   ++y1, coeff += tileComp->cbW) {
+	++cb->nextPass;
+	break;
+
+      //----- magnitude refinement pass
+      case jpxPassMagRef:
+	for (y0 = cb->y0, coeff0 = cb->coeffs;
+	     y0 < cb->y1;
+	     y0 += 4, coeff0 += 4 << tileComp->codeBlockW) {
+	  for (x = cb->x0, coeff1 = coeff0;
+	       x < cb->x1;
+	       ++x, ++coeff1) {
+	    for (y1 = 0, coeff = coeff1;
+		 y1 < 4 && y0+y1 < cb->y1;
+		 ++y1, coeff += tileComp->cbW) {
+	      if ((coeff->flags & jpxCoeffSignificant) &&
+		  !(coeff->flags & jpxCoeffTouched)) {
+		if (coeff->flags & jpxCoeffFirstMagRef) {
+		  all = 0;
+		  if (x > cb->x0) {
+		    all += (coeff[-1].flags >> jpxCoeffSignificantB) & 1;
+		    if (y0+y1 > cb->y0) {
+		      all += (coeff[-tileComp->cbW - 1].flags
+			      >> jpxCoeffSignificantB) & 1;
+		    }
+		    if (y0+y1 < cb->y1 - 1) {
+		      all += (coeff[tileComp->cbW - 1].flags
+			      >> jpxCoeffSignificantB) & 1;
+		    }
+		  }
+		  if (x < cb->x1 - 1) {
+		    all += (coeff[1].flags >> jpxCoeffSignificantB) & 1;
+		    if (y0+y1 > cb->y0) {
+		      all += (coeff[-tileComp->cbW + 1].flags
+			      >> jpxCoeffSignificantB) & 1;
+		    }
+		    if (y0+y1 < cb->y1 - 1) {
+		      all += (coeff[tileComp->cbW + 1].flags
+			      >> jpxCoeffSignificantB) & 1;
+		    }
+		  }
+		  if (y0+y1 > cb->y0) {
+		    all += (coeff[-tileComp->cbW].flags
+			    >> jpxCoeffSignificantB) & 1;
+		  }
+		  if (y0+y1 < cb->y1 - 1) {
+		    all += (coeff[tileComp->cbW].flags
+			    >> jpxCoeffSignificantB) & 1;
+		  }
+		  cx = all ? 15 : 14;
+		} else {
+		  cx = 16;
+		}
+		coeff->mag = (coeff->mag << 1) |
+			     arithDecoder->decodeBit(cx, cb->stats);
 		++coeff->len;
+		coeff->flags |= jpxCoeffTouched;
+		coeff->flags &= ~jpxCoeffFirstMagRef;
 	      }
-	      y1 = 4;
 	    }
 	  }
-	  for (coeff = &coeff1[y1 << tileComp->codeBlockW];
-	       y1 < 4 && y0 + y1 < cb->y1;
-	       ++y1, coeff += tileComp->cbW) {
-	    if (!(coeff->flags & jpxCoeffTouched)) {
-	      horiz = vert = diag = 0;
-	      horizSign = vertSign = 2;
-	      if (x > cb->x0) {
-		if (coeff[-1].flags & jpxCoeffSignificant) {
-		  ++horiz;
-		  horizSign += (coeff[-1].flags & jpxCoeffSign) ? -1 : 1;
+	}
+	++cb->nextPass;
+	break;
+
+      //----- cleanup pass
+      case jpxPassCleanup:
+	for (y0 = cb->y0, coeff0 = cb->coeffs;
+	     y0 < cb->y1;
+	     y0 += 4, coeff0 += 4 << tileComp->codeBlockW) {
+	  for (x = cb->x0, coeff1 = coeff0;
+	       x < cb->x1;
+	       ++x, ++coeff1) {
+	    y1 = 0;
+	    if (y0 + 3 < cb->y1 &&
+		!(coeff1->flags & jpxCoeffTouched) &&
+		!(coeff1[tileComp->cbW].flags & jpxCoeffTouched) &&
+		!(coeff1[2 * tileComp->cbW].flags & jpxCoeffTouched) &&
+		!(coeff1[3 * tileComp->cbW].flags & jpxCoeffTouched) &&
+		(x == cb->x0 || y0 == cb->y0 ||
+		 !(coeff1[-tileComp->cbW - 1].flags
+		   & jpxCoeffSignificant)) &&
+		(y0 == cb->y0 ||
+		 !(coeff1[-tileComp->cbW].flags & jpxCoeffSignificant)) &&
+		(x == cb->x1 - 1 || y0 == cb->y0 ||
+		 !(coeff1[-tileComp->cbW + 1].flags & jpxCoeffSignificant)) &&
+		(x == cb->x0 ||
+		 (!(coeff1[-1].flags & jpxCoeffSignificant) &&
+		  !(coeff1[tileComp->cbW - 1].flags
+		    & jpxCoeffSignificant) &&
+		  !(coeff1[2 * tileComp->cbW - 1].flags
+		    & jpxCoeffSignificant) && 
+		  !(coeff1[3 * tileComp->cbW - 1].flags
+		    & jpxCoeffSignificant))) &&
+		(x == cb->x1 - 1 ||
+		 (!(coeff1[1].flags & jpxCoeffSignificant) &&
+		  !(coeff1[tileComp->cbW + 1].flags
+		    & jpxCoeffSignificant) &&
+		  !(coeff1[2 * tileComp->cbW + 1].flags
+		    & jpxCoeffSignificant) &&
+		  !(coeff1[3 * tileComp->cbW + 1].flags
+		    & jpxCoeffSignificant))) &&
+		(x == cb->x0 || y0+4 == cb->y1 ||
+		 !(coeff1[4 * tileComp->cbW - 1].flags & jpxCoeffSignificant)) &&
+		(y0+4 == cb->y1 ||
+		 !(coeff1[4 * tileComp->cbW].flags & jpxCoeffSignificant)) &&
+		(x == cb->x1 - 1 || y0+4 == cb->y1 ||
+		 !(coeff1[4 * tileComp->cbW + 1].flags
+		   & jpxCoeffSignificant))) {
+	      if (arithDecoder->decodeBit(jpxContextRunLength, cb->stats)) {
+		y1 = arithDecoder->decodeBit(jpxContextUniform, cb->stats);
+		y1 = (y1 << 1) |
+		     arithDecoder->decodeBit(jpxContextUniform, cb->stats);
+		for (y2 = 0, coeff = coeff1;
+		     y2 < y1;
+		     ++y2, coeff += tileComp->cbW) {
+		  ++coeff->len;
 		}
-		if (y0+y1 > cb->y0) {
-		  diag += (coeff[-tileComp->cbW - 1].flags
-			   >> jpxCoeffSignificantB) & 1;
+		coeff->flags |= jpxCoeffSignificant | jpxCoeffFirstMagRef;
+		coeff->mag = (coeff->mag << 1) | 1;
+		++coeff->len;
+		cx = signContext[2][2][0];
+		xorBit = signContext[2][2][1];
+		if (arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
+		  coeff->flags |= jpxCoeffSign;
 		}
-		if (y0+y1 < cb->y1 - 1) {
-		  diag += (coeff[tileComp->cbW - 1].flags
-			   >> jpxCoeffSignificantB) & 1;
+		++y1;
+	      } else {
+		for (y1 = 0, coeff = coeff1;
+		     y1 < 4;
+		     ++y1, coeff += tileComp->cbW) {
+		  ++coeff->len;
 		}
+		y1 = 4;
 	      }
-	      if (x < cb->x1 - 1) {
-		if (coeff[1].flags & jpxCoeffSignificant) {
-		  ++horiz;
-		  horizSign += (coeff[1].flags & jpxCoeffSign) ? -1 : 1;
+	    }
+	    for (coeff = &coeff1[y1 << tileComp->codeBlockW];
+		 y1 < 4 && y0 + y1 < cb->y1;
+		 ++y1, coeff += tileComp->cbW) {
+	      if (!(coeff->flags & jpxCoeffTouched)) {
+		horiz = vert = diag = 0;
+		horizSign = vertSign = 2;
+		if (x > cb->x0) {
+		  if (coeff[-1].flags & jpxCoeffSignificant) {
+		    ++horiz;
+		    horizSign += (coeff[-1].flags & jpxCoeffSign) ? -1 : 1;
+		  }
+		  if (y0+y1 > cb->y0) {
+		    diag += (coeff[-tileComp->cbW - 1].flags
+			     >> jpxCoeffSignificantB) & 1;
+		  }
+		  if (y0+y1 < cb->y1 - 1) {
+		    diag += (coeff[tileComp->cbW - 1].flags
+			     >> jpxCoeffSignificantB) & 1;
+		  }
+		}
+		if (x < cb->x1 - 1) {
+		  if (coeff[1].flags & jpxCoeffSignificant) {
+		    ++horiz;
+		    horizSign += (coeff[1].flags & jpxCoeffSign) ? -1 : 1;
+		  }
+		  if (y0+y1 > cb->y0) {
+		    diag += (coeff[-tileComp->cbW + 1].flags
+			     >> jpxCoeffSignificantB) & 1;
+		  }
+		  if (y0+y1 < cb->y1 - 1) {
+		    diag += (coeff[tileComp->cbW + 1].flags
+			     >> jpxCoeffSignificantB) & 1;
+		  }
 		}
 		if (y0+y1 > cb->y0) {
-		  diag += (coeff[-tileComp->cbW + 1].flags
-			   >> jpxCoeffSignificantB) & 1;
+		  if (coeff[-tileComp->cbW].flags & jpxCoeffSignificant) {
+		    ++vert;
+		    vertSign += (coeff[-tileComp->cbW].flags & jpxCoeffSign)
+				? -1 : 1;
+		  }
 		}
 		if (y0+y1 < cb->y1 - 1) {
-		  diag += (coeff[tileComp->cbW + 1].flags
-			   >> jpxCoeffSignificantB) & 1;
-		}
-	      }
-	      if (y0+y1 > cb->y0) {
-		if (coeff[-tileComp->cbW].flags & jpxCoeffSignificant) {
-		  ++vert;
-		  vertSign += (coeff[-tileComp->cbW].flags & jpxCoeffSign)
-		              ? -1 : 1;
-		}
-	      }
-	      if (y0+y1 < cb->y1 - 1) {
-		if (coeff[tileComp->cbW].flags & jpxCoeffSignificant) {
-		  ++vert;
-		  vertSign += (coeff[tileComp->cbW].flags & jpxCoeffSign)
-		              ? -1 : 1;
+		  if (coeff[tileComp->cbW].flags & jpxCoeffSignificant) {
+		    ++vert;
+		    vertSign += (coeff[tileComp->cbW].flags & jpxCoeffSign)
+				? -1 : 1;
+		  }
 		}
-	      }
-	      cx = sigPropContext[horiz][vert][diag][res == 0 ? 1 : sb];
-	      if (arithDecoder->decodeBit(cx, cb->stats)) {
-		coeff->flags |= jpxCoeffSignificant | jpxCoeffFirstMagRef;
-		coeff->mag = (coeff->mag << 1) | 1;
-		cx = signContext[horizSign][vertSign][0];
-		xorBit = signContext[horizSign][vertSign][1];
-		if (arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
-		  coeff->flags |= jpxCoeffSign;
+		cx = sigPropContext[horiz][vert][diag][res == 0 ? 1 : sb];
+		if (arithDecoder->decodeBit(cx, cb->stats)) {
+		  coeff->flags |= jpxCoeffSignificant | jpxCoeffFirstMagRef;
+		  coeff->mag = (coeff->mag << 1) | 1;
+		  cx = signContext[horizSign][vertSign][0];
+		  xorBit = signContext[horizSign][vertSign][1];
+		  if (arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
+		    coeff->flags |= jpxCoeffSign;
+		  }
 		}
+		++coeff->len;
+	      } else {
+		coeff->flags &= ~jpxCoeffTouched;
 	      }
-	      ++coeff->len;
-	    } else {
-	      coeff->flags &= ~jpxCoeffTouched;
 	    }
 	  }
 	}
+	cb->nextPass = jpxPassSigProp;
+	break;
       }
-      cb->nextPass = jpxPassSigProp;
-      break;
     }
+
+    delete arithDecoder;
   }
 
-  delete arithDecoder;
+  delete cbStr;
+  gfree(cb->dataBuf);
+  cb->dataBuf = NULL;
+  cb->dataBufLen = cb->dataBufSize = 0;
+  gfree(cb->segs);
+  cb->segs = NULL;
+  cb->nSegs = cb->segsSize = 0;
+}
+
+// Entropy decode the saved code-block data and do the inverse
+// transforms for all tiles.  The tiles are independent of each other,
+// so with multithreading they are spread over several threads.
+GBool JPXStream::decodeTiles() {
+  Guint nTiles, i;
+#if MULTITHREADED
+  JPXTileQueue queue;
+#ifdef WIN32
+  HANDLE threads[jpxMaxTileThreads];
+#else
+  pthread_t threads[jpxMaxTileThreads];
+#endif
+  int nThreads, t;
+#endif
+
+  nTiles = img.nXTiles * img.nYTiles;
+
+#if MULTITHREADED
+  if (nTiles > 1) {
+    queue.str = this;
+    gInitMutex(&queue.mutex);
+    queue.nextTile = 0;
+    queue.ok = gTrue;
+    for (nThreads = 0;
+	 nThreads < jpxMaxTileThreads - 1 && (Guint)nThreads < nTiles - 1;
+	 ++nThreads) {
+#ifdef WIN32
+      if (!(threads[nThreads] = CreateThread(NULL, 0, &jpxTileThread,
+					     &queue, 0, NULL))) {
+	break;
+      }
+#else
+      if (pthread_create(&threads[nThreads], NULL, &jpxTileThread, &queue)) {
+	break;
+      }
+#endif
+    }
+    // the calling thread works on the queue too (and does all of
+    // the work if no threads could be started)
+    queue.run();
+    for (t = 0; t < nThreads; ++t) {
+#ifdef WIN32
+      WaitForSingleObject(threads[t], INFINITE);
+      CloseHandle(threads[t]);
+#else
+      pthread_join(threads[t], NULL);
+#endif
+    }
+    gDestroyMutex(&queue.mutex);
+    return queue.ok;
+  }
+#endif
+
+  for (i = 0; i < nTiles; ++i) {
+    if (!decodeTile(&img.tiles[i])) {
+      return gFalse;
+    }
+  }
   return gTrue;
 }
 
+// Decode one tile: entropy decode the code-blocks, then do the
+// inverse wavelet, multi-component, and DC level shift transforms.
+GBool JPXStream::decodeTile(JPXTile *tile) {
+  JPXTileComp *tileComp;
+  JPXResLevel *resLevel;
+  JPXPrecinct *precinct;
+  JPXSubband *subband;
+  Guint comp, r, pre, sb, k;
+
+  for (comp = 0; comp < img.nComps; ++comp) {
+    tileComp = &tile->tileComps[comp];
+    for (r = 0; r <= tileComp->nDecompLevels - tileComp->reduction; ++r) {
+      resLevel = &tileComp->resLevels[r];
+      for (pre = 0; pre < 1; ++pre) {
+	precinct = &resLevel->precincts[pre];
+	for (sb = 0; sb < (Guint)(r == 0 ? 1 : 3); ++sb) {
+	  subband = &precinct->subbands[sb];
+	  for (k = 0; k < subband->nXCBs * subband->nYCBs; ++k) {
+	    decodeCodeBlock(tileComp, r, sb, &subband->cbs[k]);
+	  }
+	}
+      }
+    }
+    inverseTransform(tileComp);
+  }
+  return inverseMultiCompAndDC(tile);
+}
+
 // Inverse quantization, and wavelet transform (IDWT).  This also does
 // the initial shift to convert to fixed point format.
 void JPXStream::inverseTransform(JPXTileComp *tileComp) {
@@ -2334,7 +2549,7 @@ void JPXStream::inverseTransform(JPXTileComp *tileComp) {
 
   //----- IDWT for each level
 
-  for (r = 1; r <= tileComp->nDecompLevels; ++r) {
+  for (r = 1; r <= tileComp->nDecompLevels - tileComp->reduction; ++r) {
     resLevel = &tileComp->resLevels[r];
 
     // (n)LL is already in the upper-left corner of the
@@ -2580,7 +2795,7 @@ GBool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
   JPXTileComp *tileComp;
   int coeff, d0, d1, d2, minVal, maxVal, zeroVal;
   int *dataPtr;
-  Guint j, comp, x, y;
+  Guint j, comp, x, y, w, h, stride;
 
   //----- inverse multi-component transform
 
@@ -2592,12 +2807,28 @@ GBool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
 	tile->tileComps[1].vSep != tile->tileComps[2].vSep) {
       return gFalse;
     }
+    // the three components must have the same (reduced) size, since
+    // the loops below index them all with comp 0's size and stride
+    // -- COC markers can give them different numbers of levels, which
+    // leaves them at different reductions
+    for (comp = 1; comp < 3; ++comp) {
+      if (tile->tileComps[comp].x1 - tile->tileComps[comp].x0 !=
+	    tile->tileComps[0].x1 - tile->tileComps[0].x0 ||
+	  tile->tileComps[comp].y1 - tile->tileComps[comp].y0 !=
+	    tile->tileComps[0].y1 - tile->tileComps[0].y0 ||
+	  tile->tileComps[comp].reduction != tile->tileComps[0].reduction) {
+	return gFalse;
+      }
+    }
 
     // inverse irreversible multiple component transform
     if (tile->tileComps[0].transform == 0) {
-      j = 0;
-      for (y = 0; y < tile->tileComps[0].y1 - tile->tileComps[0].y0; ++y) {
-	for (x = 0; x < tile->tileComps[0].x1 - tile->tileComps[0].x0; ++x) {
+      tileComp = &tile->tileComps[0];
+      getReducedSize(tileComp, &w, &h);
+      stride = tileComp->x1 - tileComp->x0;
+      for (y = 0; y < h; ++y) {
+	for (x = 0; x < w; ++x) {
+	  j = y * stride + x;
 	  d0 = tile->tileComps[0].data[j];
 	  d1 = tile->tileComps[1].data[j];
 	  d2 = tile->tileComps[2].data[j];
@@ -2605,22 +2836,23 @@ GBool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
 	  tile->tileComps[1].data[j] =
 	      (int)(d0 - 0.34413 * d1 - 0.71414 * d2 + 0.5);
 	  tile->tileComps[2].data[j] = (int)(d0 + 1.772 * d1 + 0.5);
-	  ++j;
 	}
       }
 
     // inverse reversible multiple component transform
     } else {
-      j = 0;
-      for (y = 0; y < tile->tileComps[0].y1 - tile->tileComps[0].y0; ++y) {
-	for (x = 0; x < tile->tileComps[0].x1 - tile->tileComps[0].x0; ++x) {
+      tileComp = &tile->tileComps[0];
+      getReducedSize(tileComp, &w, &h);
+      stride = tileComp->x1 - tileComp->x0;
+      for (y = 0; y < h; ++y) {
+	for (x = 0; x < w; ++x) {
+	  j = y * stride + x;
 	  d0 = tile->tileComps[0].data[j];
 	  d1 = tile->tileComps[1].data[j];
 	  d2 = tile->tileComps[2].data[j];
 	  tile->tileComps[0].data[j] = d0 - ((d2 + d1) >> 2);
 	  tile->tileComps[1].data[j] = d2 - d1;
 	  tile->tileComps[2].data[j] = d0 - d1;
-	  ++j;
 	}
       }
     }
@@ -2629,14 +2861,16 @@ GBool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
   //----- DC level shift
   for (comp = 0; comp < img.nComps; ++comp) {
     tileComp = &tile->tileComps[comp];
+    getReducedSize(tileComp, &w, &h);
+    stride = tileComp->x1 - tileComp->x0;
 
     // signed: clip
     if (tileComp->sgned) {
       minVal = -(1 << (tileComp->prec - 1));
       maxVal = (1 << (tileComp->prec - 1)) - 1;
-      dataPtr = tileComp->data;
-      for (y = 0; y < tileComp->y1 - tileComp->y0; ++y) {
-	for (x = 0; x < tileComp->x1 - tileComp->x0; ++x) {
+      for (y = 0; y < h; ++y) {
+	dataPtr = &tileComp->data[y * stride];
+	for (x = 0; x < w; ++x) {
 	  coeff = *dataPtr;
 	  if (tileComp->transform == 0) {
 	    coeff >>= fracBits;
@@ -2654,9 +2888,9 @@ GBool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
     } else {
       maxVal = (1 << tileComp->prec) - 1;
       zeroVal = 1 << (tileComp->prec - 1);
-      dataPtr = tileComp->data;
-      for (y = 0; y < tileComp->y1 - tileComp->y0; ++y) {
-	for (x = 0; x < tileComp->x1 - tileComp->x0; ++x) {
+      for (y = 0; y < h; ++y) {
+	dataPtr = &tileComp->data[y * stride];
+	for (x = 0; x < w; ++x) {
 	  coeff = *dataPtr;
 	  if (tileComp->transform == 0) {
 	    coeff >>= fracBits;
@@ -2676,6 +2910,15 @@ GBool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
   return gTrue;
 }
 
+// Get the size of the (possibly reduced resolution) decoded image for
+// a tile-component.
+void JPXStream::getReducedSize(JPXTileComp *tileComp, Guint *w, Guint *h) {
+  *w = jpxCeilDivPow2(tileComp->x1, tileComp->reduction)
+       - jpxCeilDivPow2(tileComp->x0, tileComp->reduction);
+  *h = jpxCeilDivPow2(tileComp->y1, tileComp->reduction)
+       - jpxCeilDivPow2(tileComp->y0, tileComp->reduction);
+}
+
 GBool JPXStream::readBoxHdr(Guint *boxType, Guint *boxLen, Guint *dataLen) {
   Guint len, lenH;
 
@@ -20,6 +20,7 @@
 #include "Stream.h"
 
 class JArithmeticDecoderStats;
+struct JPXTileQueue;
 
 //------------------------------------------------------------------------
 
@@ -114,6 +115,13 @@ struct JPXCoeff {
 
 //------------------------------------------------------------------------
 
+struct JPXCodeBlockSeg {
+  Guint dataLen;		// length of this segment's data
+  Guint nCodingPasses;		// number of coding passes in this segment
+};
+
+//------------------------------------------------------------------------
+
 struct JPXCodeBlock {
   //----- size
   Guint x0, y0, x1, y1;		// bounds
@@ -133,6 +141,14 @@ struct JPXCodeBlock {
   Guint nCodingPasses;		// number of coding passes in this pkt
   Guint dataLen;		// pkt data length
 
+  //----- compressed data (saved until the tile is decoded)
+  char *dataBuf;		// data from all packets read so far
+  Guint dataBufLen;		// number of bytes in dataBuf
+  Guint dataBufSize;		// allocated size of dataBuf
+  JPXCodeBlockSeg *segs;	// one segment per packet
+  Guint nSegs;			// number of entries in segs
+  Guint segsSize;		// allocated size of segs
+
   //----- coefficient data
   JPXCoeff *coeffs;		// the coefficients
   JArithmeticDecoderStats	// arithmetic decoder stats
@@ -209,6 +225,8 @@ struct JPXTileComp {
   Guint x0, y0, x1, y1;		// bounds of the tile-comp, in ref coords
   Guint cbW;			// code-block width
   Guint cbH;			// code-block height
+  Guint reduction;		// number of (highest) resolution levels
+				//   that are not decoded
 
   //----- image data
   int *data;			// the decoded image data
@@ -276,6 +294,12 @@ public:
   virtual GString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
+  // Skip the <reductionA> highest resolution levels when decoding
+  // (e.g., 1 for a half-size image); the reduced image is pixel
+  // replicated back to full size on output.  This must be called
+  // before reset().
+  void setReduction(Guint reductionA) { reduction = reductionA; }
+
 private:
 
   void fillReadBuf();
@@ -291,6 +315,10 @@ private:
 			  JPXSubband *subband,
 			  Guint res, Guint sb,
 			  JPXCodeBlock *cb);
+  void decodeCodeBlock(JPXTileComp *tileComp, Guint res, Guint sb,
+		       JPXCodeBlock *cb);
+  GBool decodeTiles();
+  GBool decodeTile(JPXTile *tile);
   void inverseTransform(JPXTileComp *tileComp);
   void inverseTransformLevel(JPXTileComp *tileComp,
 			     Guint r, JPXResLevel *resLevel,
@@ -300,6 +328,7 @@ private:
 			  int *data, Guint stride,
 			  Guint i0, Guint i1);
   GBool inverseMultiCompAndDC(JPXTile *tile);
+  void getReducedSize(JPXTileComp *tileComp, Guint *w, Guint *h);
   GBool readBoxHdr(Guint *boxType, Guint *boxLen, Guint *dataLen);
   int readMarkerHdr(int *segType, Guint *segLen);
   GBool readUByte(Guint *x);
@@ -325,6 +354,7 @@ private:
   GBool haveChannelDefn;	// set if a channel defn has been found
 
   JPXImage img;			// JPEG2000 decoder data
+  Guint reduction;		// number of resolution levels to skip
   Guint bitBuf;			// buffer for bit reads
   int bitBufLen;		// number of bits in bitBuf
   GBool bitBufSkip;		// true if next bit should be skipped
@@ -335,6 +365,8 @@ private:
   Guint curX, curY, curComp;	// current position for lookChar/getChar
   Guint readBuf;		// read buffer
   Guint readBufLen;		// number of valid bits in readBuf
+
+  friend struct JPXTileQueue;
 };
 
 #endif
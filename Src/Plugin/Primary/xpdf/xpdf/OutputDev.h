@@ -55,6 +55,11 @@ public:
   // Does this device need non-text content?
   virtual GBool needNonText() { return gTrue; }
 
+  // Does this device render images at device resolution?  If so,
+  // JPEG 2000 images drawn smaller than their native size are decoded
+  // at a reduced resolution.
+  virtual GBool useReducedImages() { return gFalse; }
+
   //----- initialization and control
 
   // Set default transform matrix.
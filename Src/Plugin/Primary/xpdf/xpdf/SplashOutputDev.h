@@ -66,6 +66,9 @@ public:
   // text in Type 3 fonts will be drawn with drawChar/drawString.
   virtual GBool interpretType3Chars() { return gTrue; }
 
+  // Does this device render images at device resolution?
+  virtual GBool useReducedImages() { return gTrue; }
+
   //----- initialization and control
 
   // Start a page.
@@ -2051,8 +2051,8 @@ void DCTStream::restart() {
 GBool DCTStream::readMCURow() {
   int data1[64];
   Guchar data2[64];
-  Guchar *p1, *p2;
-  int pY, pCb, pCr, pR, pG, pB;
+  Guchar *p1, *p2, *p3;
+  int pY, pCb, pCr, pR, pG, pB, crR, crG;
   int h, v, horiz, vert, hSub, vSub;
   int x1, x2, y2, x3, y3, x4, y4, x5, y5, cc, i;
   int c;
@@ -2089,7 +2089,43 @@ GBool DCTStream::readMCURow() {
 	  }
 	  transformDataUnit(quantTables[compInfo[cc].quantTable],
 			    data1, data2);
-	  if (hSub == 1 && vSub == 1) {
+	  if (cc == 2 && colorXform && numComps >= 3) {
+	    // Y and Cb for this MCU are already in rowBuf, so convert
+	    // to RGB (or CMY) while storing the Cr samples instead of
+	    // making a second pass over the MCU
+	    i = 0;
+	    for (y3 = 0, y4 = 0; y3 < 8; ++y3, y4 += vSub) {
+	      for (x3 = 0, x4 = 0; x3 < 8; ++x3, x4 += hSub) {
+		pCr = data2[i] - 128;
+		crR = dctCrToR * pCr + 32768;
+		crG = dctCrToG * pCr + 32768;
+		for (y5 = 0; y5 < vSub; ++y5) {
+		  p1 = &rowBuf[0][y2+y4+y5][x1+x2+x4];
+		  p2 = &rowBuf[1][y2+y4+y5][x1+x2+x4];
+		  p3 = &rowBuf[2][y2+y4+y5][x1+x2+x4];
+		  for (x5 = 0; x5 < hSub; ++x5) {
+		    pY = p1[x5] << 16;
+		    pCb = p2[x5] - 128;
+		    pR = dctClip[dctClipOffset + ((pY + crR) >> 16)];
+		    pG = dctClip[dctClipOffset +
+				 ((pY + dctCbToG * pCb + crG) >> 16)];
+		    pB = dctClip[dctClipOffset +
+				 ((pY + dctCbToB * pCb + 32768) >> 16)];
+		    // YCbCrK to CMYK (K is passed through unchanged)
+		    if (numComps == 4) {
+		      pR = 255 - pR;
+		      pG = 255 - pG;
+		      pB = 255 - pB;
+		    }
+		    p1[x5] = (Guchar)pR;
+		    p2[x5] = (Guchar)pG;
+		    p3[x5] = (Guchar)pB;
+		  }
+		}
+		++i;
+	      }
+	    }
+	  } else if (hSub == 1 && vSub == 1) {
 	    for (y3 = 0, i = 0; y3 < 8; ++y3, i += 8) {
 	      p1 = &rowBuf[cc][y2+y3][x1+x2];
 	      p1[0] = data2[i];
@@ -2129,41 +2165,6 @@ GBool DCTStream::readMCURow() {
       }
     }
     --restartCtr;
-
-    // color space conversion
-    if (colorXform) {
-      // convert YCbCr to RGB
-      if (numComps == 3) {
-	for (y2 = 0; y2 < mcuHeight; ++y2) {
-	  for (x2 = 0; x2 < mcuWidth; ++x2) {
-	    pY = rowBuf[0][y2][x1+x2];
-	    pCb = rowBuf[1][y2][x1+x2] - 128;
-	    pCr = rowBuf[2][y2][x1+x2] - 128;
-	    pR = ((pY << 16) + dctCrToR * pCr + 32768) >> 16;
-	    rowBuf[0][y2][x1+x2] = dctClip[dctClipOffset + pR];
-	    pG = ((pY << 16) + dctCbToG * pCb + dctCrToG * pCr + 32768) >> 16;
-	    rowBuf[1][y2][x1+x2] = dctClip[dctClipOffset + pG];
-	    pB = ((pY << 16) + dctCbToB * pCb + 32768) >> 16;
-	    rowBuf[2][y2][x1+x2] = dctClip[dctClipOffset + pB];
-	  }
-	}
-      // convert YCbCrK to CMYK (K is passed through unchanged)
-      } else if (numComps == 4) {
-	for (y2 = 0; y2 < mcuHeight; ++y2) {
-	  for (x2 = 0; x2 < mcuWidth; ++x2) {
-	    pY = rowBuf[0][y2][x1+x2];
-	    pCb = rowBuf[1][y2][x1+x2] - 128;
-	    pCr = rowBuf[2][y2][x1+x2] - 128;
-	    pR = ((pY << 16) + dctCrToR * pCr + 32768) >> 16;
-	    rowBuf[0][y2][x1+x2] = 255 - dctClip[dctClipOffset + pR];
-	    pG = ((pY << 16) + dctCbToG * pCb + dctCrToG * pCr + 32768) >> 16;
-	    rowBuf[1][y2][x1+x2] = 255 - dctClip[dctClipOffset + pG];
-	    pB = ((pY << 16) + dctCbToB * pCb + 32768) >> 16;
-	    rowBuf[2][y2][x1+x2] = 255 - dctClip[dctClipOffset + pB];
-	  }
-	}
-      }
-    }
   }
   return gTrue;
 }
@@ -2598,6 +2599,21 @@ void DCTStream::transformDataUnit(Guchar *quantTable,
   int *p;
   int i;
 
+  // check for an all-zero AC block (very common in flat image
+  // areas) -- the row and column passes below reduce to a single
+  // constant, so skip them entirely
+  for (i = 1; i < 64; ++i) {
+    if (dataIn[i] != 0) {
+      break;
+    }
+  }
+  if (i == 64) {
+    t = (dctSqrt2 * (dataIn[0] * quantTable[0]) + 512) >> 10;
+    t = (dctSqrt2 * t + 8192) >> 14;
+    memset(dataOut, dctClip[dctClipOffset + 128 + ((t + 8) >> 4)], 64);
+    return;
+  }
+
   // dequant
   for (i = 0; i < 64; ++i) {
     dataIn[i] *= quantTable[i];
@@ -2749,6 +2765,20 @@ int DCTStream::readHuffSym(DCTHuffTable *table) {
   Gushort code;
   int bit;
   int codeBits;
+  int look;
+
+  // fast path: look up codes of up to dctHuffLookBits bits directly
+  if (inputBits < dctHuffLookBits) {
+    fillInputBuf();
+  }
+  if (inputBits >= dctHuffLookBits) {
+    look = table->lookup[(inputBuf >> (inputBits - dctHuffLookBits)) &
+			 ((1 << dctHuffLookBits) - 1)];
+    if (look) {
+      inputBits -= look >> 8;
+      return look & 0xff;
+    }
+  }
 
   code = 0;
   codeBits = 0;
@@ -2774,11 +2804,20 @@ int DCTStream::readAmp(int size) {
   int amp, bit;
   int bits;
 
-  amp = 0;
-  for (bits = 0; bits < size; ++bits) {
-    if ((bit = readBit()) == EOF)
-      return 9999;
-    amp = (amp << 1) + bit;
+  // fast path: take all the bits from the input buffer at once
+  if (inputBits < size) {
+    fillInputBuf();
+  }
+  if (inputBits >= size) {
+    inputBits -= size;
+    amp = (inputBuf >> inputBits) & ((1 << size) - 1);
+  } else {
+    amp = 0;
+    for (bits = 0; bits < size; ++bits) {
+      if ((bit = readBit()) == EOF)
+	return 9999;
+      amp = (amp << 1) + bit;
+    }
   }
   if (amp < (1 << (size - 1)))
     amp -= (1 << size) - 1;
@@ -2809,6 +2848,24 @@ int DCTStream::readBit() {
   return bit;
 }
 
+// Top up the input buffer a byte at a time, so that readHuffSym and
+// readAmp can consume several bits per call.  This stops short of any
+// 0xff byte (a stuffed 0xff00 pair or a marker), leaving it to
+// readBit, so that restart and EOI markers are never consumed here.
+void DCTStream::fillInputBuf() {
+  int c;
+
+  while (inputBits <= 16) {
+    c = str->lookChar();
+    if (c == EOF || c == 0xff) {
+      break;
+    }
+    str->getChar();
+    inputBuf = (inputBuf << 8) | c;
+    inputBits += 8;
+  }
+}
+
 GBool DCTStream::readHeader() {
   GBool doScan;
   int n;
@@ -3012,7 +3069,7 @@ GBool DCTStream::readHuffmanTables() {
   int index;
   Gushort code;
   Guchar sym;
-  int i;
+  int i, j, k, k0, k1;
   int c;
 
   length = read16() - 2;
@@ -3047,6 +3104,22 @@ GBool DCTStream::readHuffmanTables() {
     for (i = 0; i < sym; ++i)
       tbl->sym[i] = str->getChar();
     length -= sym;
+
+    // build the lookahead table
+    memset(tbl->lookup, 0, sizeof(tbl->lookup));
+    for (i = 1; i <= dctHuffLookBits; ++i) {
+      for (j = 0; j < tbl->numCodes[i]; ++j) {
+	code = tbl->firstCode[i] + j;
+	if (code >= (1 << i)) {
+	  break;
+	}
+	k0 = code << (dctHuffLookBits - i);
+	k1 = (code + 1) << (dctHuffLookBits - i);
+	for (k = k0; k < k1; ++k) {
+	  tbl->lookup[k] = (i << 8) | tbl->sym[(tbl->firstSym[i] + j) & 0xff];
+	}
+      }
+    }
   }
   return gTrue;
 }
@@ -556,12 +556,21 @@ struct DCTScanInfo {
   int ah, al;			// successive approximation parameters
 };
 
+// DCT Huffman lookahead: number of bits used to index the lookup
+// table
+#define dctHuffLookBits 8
+
 // DCT Huffman decoding table
 struct DCTHuffTable {
   Guchar firstSym[17];		// first symbol for this bit length
   Gushort firstCode[17];	// first code for this bit length
   Gushort numCodes[17];		// number of codes of this bit length
   Guchar sym[256];		// symbols
+  Gushort lookup[1 << dctHuffLookBits];
+				// (code length << 8) | symbol for all
+				//   codes of <= dctHuffLookBits bits,
+				//   indexed by the next dctHuffLookBits
+				//   input bits; 0 if the code is longer
 };
 
 class DCTStream: public FilterStream {
@@ -603,7 +612,7 @@ private:
   int restartCtr;		// MCUs left until restart
   int restartMarker;		// next restart marker
   int eobRun;			// number of EOBs left in the current run
-  int inputBuf;			// input buffer for variable length codes
+  Guint inputBuf;		// input buffer for variable length codes
   int inputBits;		// number of valid bits in input buffer
 
   void restart();
@@ -621,6 +630,7 @@ private:
   int readHuffSym(DCTHuffTable *table);
   int readAmp(int size);
   int readBit();
+  void fillInputBuf();
   GBool readHeader();
   GBool readBaselineSOF();
   GBool readProgressiveSOF();